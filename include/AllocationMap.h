@@ -0,0 +1,103 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* AllocationMap
+ *
+ * Map of which byte ranges of a file system are allocated.  Filled in by the
+ * FileSystem::read_allocation_map() implementations which decode the on disk allocation
+ * structures of an unmounted file system, so that GParted's internal copy and move can
+ * skip unused space.
+ */
+
+#ifndef GPARTED_ALLOCATIONMAP_H
+#define GPARTED_ALLOCATIONMAP_H
+
+#include "Utils.h"
+
+#include <glibmm/ustring.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+// Byte range, relative to the start of a file system.
+struct Extent
+{
+	Byte_Value offset = 0;
+	Byte_Value length = 0;
+
+	Extent() = default;
+	Extent(Byte_Value offset_, Byte_Value length_) : offset(offset_), length(length_)  {};
+};
+
+typedef std::vector<Extent> ExtentVector;
+
+
+// Decode little and big endian on disk integers from unaligned byte buffers.
+inline uint16_t get_le16(const unsigned char* p)
+	{ return static_cast<uint16_t>(p[0] | p[1] << 8); }
+inline uint32_t get_le32(const unsigned char* p)
+	{ return get_le16(p) | static_cast<uint32_t>(get_le16(p + 2)) << 16; }
+inline uint64_t get_le64(const unsigned char* p)
+	{ return get_le32(p) | static_cast<uint64_t>(get_le32(p + 4)) << 32; }
+inline uint16_t get_be16(const unsigned char* p)
+	{ return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+inline uint32_t get_be32(const unsigned char* p)
+	{ return static_cast<uint32_t>(get_be16(p)) << 16 | get_be16(p + 2); }
+inline uint64_t get_be64(const unsigned char* p)
+	{ return static_cast<uint64_t>(get_be32(p)) << 32 | get_be32(p + 4); }
+
+
+class AllocationMap
+{
+public:
+	AllocationMap(const Glib::ustring& device_path, Byte_Value fs_offset, Byte_Value fs_length);
+	~AllocationMap();
+	AllocationMap(const AllocationMap& src) = delete;             // Copy construction prohibited
+	AllocationMap& operator=(const AllocationMap& rhs) = delete;  // Copy assignment prohibited
+
+	bool open();
+	bool read(Byte_Value offset, void* buf, size_t count) const;
+	Byte_Value get_fs_length() const  { return m_fs_length; };
+
+	void add_allocated(Byte_Value offset, Byte_Value length);
+	void add_allocated_bits(const unsigned char* bitmap, Byte_Value num_bits,
+	                        Byte_Value offset, Byte_Value unit_size);
+	ExtentVector get_extents() const;
+
+	static ExtentVector align_extents(const ExtentVector& extents, Byte_Value alignment,
+	                                  Byte_Value min_gap, Byte_Value length);
+	static ExtentVector clip_extents(const ExtentVector& extents, Byte_Value offset, Byte_Value length);
+	static Byte_Value total_length(const ExtentVector& extents);
+
+private:
+	Glib::ustring m_device_path;
+	Byte_Value    m_fs_offset = 0;  // Byte offset of the file system on the device
+	Byte_Value    m_fs_length = 0;
+	int           m_fd        = -1;
+	ExtentVector  m_extents;        // Allocated ranges in the order added
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_ALLOCATIONMAP_H */
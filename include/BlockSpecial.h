@@ -20,6 +20,8 @@
  * Representation of a POSIX block special file, e.g. /dev/sda1.  Also
  * tracks the major, minor device numbers so that different names for
  * the same block device can be compared equal.
+ * Names are interned in a registry and referred to by a small integer
+ * handle, so BlockSpecial objects are trivially copyable values.
  * Refs: mknod(1) and mknod(2).
  */
 
@@ -27,6 +29,8 @@
 #define GPARTED_BLOCKSPECIAL_H
 
 #include <glibmm/ustring.h>
+#include <sys/types.h>
+#include <unordered_map>
 
 
 namespace GParted
@@ -39,13 +43,15 @@ public:
 	BlockSpecial() = default;
 	BlockSpecial( const Glib::ustring & name );
 
-	Glib::ustring m_name;         // E.g. Block special file {"/dev/sda1", 8, 1},
-	unsigned long m_major = 0UL;  // plain file {"FILENAME", 0, 0} and empty object
-	unsigned long m_minor = 0UL;  // {"", 0, 0}.
+	const Glib::ustring& get_name() const;
+
+	unsigned int  m_name_id = 0U;  // Handle of the interned name.  E.g. Block special file
+	unsigned long m_major   = 0UL; // {"/dev/sda1", 8, 1}, plain file {"FILENAME", 0, 0} and
+	unsigned long m_minor   = 0UL; // empty object {"", 0, 0}.
 
 	static void clear_cache();
-	static void register_block_special( const Glib::ustring & name,
-	                                    unsigned long major, unsigned long minor );
+	static BlockSpecial register_block_special( const Glib::ustring & name,
+	                                            unsigned long major, unsigned long minor );
 };
 
 
@@ -57,6 +63,22 @@ bool operator==( const BlockSpecial & lhs, const BlockSpecial & rhs );
 bool operator<( const BlockSpecial & lhs, const BlockSpecial & rhs );
 
 
+// Hash index of the BlockSpecial objects in a cache vector, to find the first entry equal
+// to a name without a linear search.  Entries are indexed by device number, or by name
+// handle for names which aren't block special files.
+class BlockSpecialIndex
+{
+public:
+	void clear();
+	void add(const BlockSpecial& bs, unsigned int index);
+	int find(const Glib::ustring& name) const;
+
+private:
+	std::unordered_map<dev_t, unsigned int>        m_by_devnum;
+	std::unordered_map<unsigned int, unsigned int> m_by_name_id;
+};
+
+
 }  // namespace GParted
 
 
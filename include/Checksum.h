@@ -0,0 +1,55 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Checksum
+ *
+ * CRC-32C (Castagnoli) checksum used to verify data copied by GParted's internal block
+ * copy.  Uses the SSE4.2 CRC32 instruction when the CPU has it, otherwise a slicing-by-8
+ * table implementation.
+ */
+
+#ifndef GPARTED_CHECKSUM_H
+#define GPARTED_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace GParted
+{
+
+
+class Checksum
+{
+friend class ChecksumTest;  // To allow unit testing to compare the implementations.
+
+public:
+	static uint32_t crc32c(uint32_t crc, const void* buf, size_t length);
+	static bool crc32c_accelerated();
+
+private:
+	Checksum();  // Not instantiable
+
+	static uint32_t crc32c_slice8(uint32_t crc, const void* buf, size_t length);
+	static uint32_t crc32c_sse42(uint32_t crc, const void* buf, size_t length);
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_CHECKSUM_H */
@@ -0,0 +1,104 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* CommandRunner
+ *
+ * Runs an external command in its own process group, capturing stdout and stderr, and
+ * waits for it in the calling thread using poll(2) on the pipes and a pidfd of the child.
+ * Doesn't need the Glib/Gtk main loop so any number of commands can be run at once from
+ * any threads.  Progress tracking callbacks run in the waiting thread.  An optional
+ * timeout stops a hung command holding up the thread waiting for it.
+ */
+
+#ifndef GPARTED_COMMANDRUNNER_H
+#define GPARTED_COMMANDRUNNER_H
+
+#include "PipeCapture.h"
+
+#include <glibmm/thread.h>
+#include <glibmm/ustring.h>
+#include <sigc++/signal.h>
+#include <sigc++/slot.h>
+#include <sys/types.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+class CommandRunner
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Timer
+	{
+		std::chrono::milliseconds interval;
+		Clock::time_point         next;
+		sigc::slot<bool>          slot;
+	};
+
+public:
+	CommandRunner(const Glib::ustring& command, Glib::ustring& output, Glib::ustring& error);
+	~CommandRunner();
+	CommandRunner(const CommandRunner& src) = delete;             // Copy construction prohibited
+	CommandRunner& operator=(const CommandRunner& rhs) = delete;  // Copy assignment prohibited
+
+	bool start(const char* input, bool use_C_locale);
+	int wait();
+	void add_timer(unsigned int interval_ms, const sigc::slot<bool>& slot);
+	void set_timeout(unsigned int seconds);
+	void send_signal(int sig);
+
+	sigc::signal<void>& signal_output_update()  { return m_output_capture->signal_update; };
+	sigc::signal<void>& signal_error_update()   { return m_error_capture->signal_update; };
+	const Glib::ustring& get_start_error() const  { return m_start_error; };
+	const Glib::ustring& get_input_error() const  { return m_input_error; };
+	int get_exit_status() const                   { return m_exit_status; };
+	bool timed_out() const                        { return m_timed_out; };
+
+private:
+	void abandon();
+	bool reap(bool block);
+
+	Glib::ustring                m_command;
+	Glib::ustring&               m_output;
+	Glib::ustring&               m_error;
+	std::unique_ptr<PipeCapture> m_output_capture;
+	std::unique_ptr<PipeCapture> m_error_capture;
+	pid_t                        m_pid         = -1;
+	int                          m_pidfd       = -1;      // -1 when pidfd_open(2) unsupported
+	int                          m_out         = -1;
+	int                          m_err         = -1;
+	bool                         m_reaped      = false;
+	int                          m_exit_status = 255;     // Set to actual value by reap()
+	Glib::ustring                m_start_error;
+	Glib::ustring                m_input_error;
+	std::vector<Timer>           m_timers;
+	std::chrono::seconds         m_timeout{0};            // 0 when no timeout
+	bool                         m_timed_out   = false;
+	Glib::Mutex                  m_mutex;                 // Protects m_pid, m_reaped against send_signal()
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_COMMANDRUNNER_H */
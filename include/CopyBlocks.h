@@ -17,11 +17,17 @@
 #ifndef GPARTED_COPYBLOCKS_H
 #define GPARTED_COPYBLOCKS_H
 
+#include "AllocationMap.h"
+#include "MoveJournal.h"
 #include "OperationDetail.h"
 #include "Utils.h"
 
 #include <glibmm/ustring.h>
+#include <glibmm/thread.h>
 #include <parted/parted.h>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
 #include <vector>
 
 
@@ -36,37 +42,168 @@ public:
 	           Sector               src_start,
 	           Sector               dst_start,
 	           Byte_Value           in_length,
+	           const ExtentVector&  in_extents,
 	           Byte_Value           in_blocksize,
 	           OperationDetail&     in_operationdetail,
 	           Byte_Value&          in_total_done,
 	           Byte_Value           in_total_length,
-	           bool                 cancel_safe);
+	           bool                 cancel_safe,
+	           bool                 in_tune = false,
+	           bool                 in_verify = false,
+	           MoveJournal*         in_journal = nullptr);
 
 	bool set_progress_info();
+	void set_finished();
 	bool copy();
 
 private:
+	struct AlignedFree
+	{
+		void operator()(char* p) const  { free(p); }
+	};
+
+	// One buffer in the ring between the reader and writer stages of the copy.
+	// Page aligned as required for direct I/O.
+	struct Block
+	{
+		std::unique_ptr<char, AlignedFree> buf;
+		Byte_Value                         bufsize    = 0;
+		Sector                             offset_src = 0;
+		Sector                             offset_dst = 0;
+		Sector                             num_src    = 0;  // Sectors to read from the source
+		Sector                             num_dst    = 0;  // Sectors to write to the destination
+		Byte_Value                         length     = 0;  // Negative when copying backwards
+		Byte_Value                         skipped    = 0;  // Unallocated bytes passed over
+		                                                    // before this block, same sign
+		bool                               read_ok    = false;
+		uint32_t                           crc        = 0;  // Of the source data, when verifying
+	};
+
+	// A block written to the destination and waiting to be read back and checked.
+	struct WrittenBlock
+	{
+		Sector     offset_dst;
+		Sector     num_dst;
+		Byte_Value length;
+		uint32_t   crc;
+	};
+
+	// Range of destination sectors found to differ from the source.
+	struct Mismatch
+	{
+		Sector     start;
+		Sector     num;
+	};
+
 	void copy_thread();
-	void copy_block();
+	void read_thread();
+	bool queue_block(Byte_Value start, Byte_Value count, Byte_Value skipped, Byte_Value abs_blocksize);
+	bool alloc_ring();
+	bool alloc_block(Block& block, Byte_Value abs_blocksize);
+	void tune(double rate);
+	bool verify_written();
+	bool read_block(Block& block);
+	bool write_block(const Block& block);
+	bool write_run(const Block& block, Sector start, Sector num, bool zero);
+	bool write_sectors(const char* buf, Sector offset, Sector num);
+	void open_direct_io();
+	void close_direct_io();
+	void open_zeroout();
+	void close_zeroout();
+	bool open_offload();
+	void close_offload();
+	bool offload_copy();
+	bool checkpoint_before(Byte_Value skipped, Byte_Value count);
+	bool checkpoint(Byte_Value progress);
 	void set_cancel(bool force);
 
 	const Glib::ustring& src_device;
 	const Glib::ustring& dst_device;
-	Byte_Value           length        = 0;
-	Byte_Value           blocksize     = 0;
+	Byte_Value           length          = 0;
+	ExtentVector         extents;                  // Ranges to copy, relative to the start
+	Byte_Value           blocksize       = 0;
 	OperationDetail&     operationdetail;
 	Byte_Value&          total_done;
-	Byte_Value           total_length  = 0;
-	std::vector<char>    buf;
-	Byte_Value           done          = 0;
-	PedDevice*           lp_device_src = nullptr;
-	PedDevice*           lp_device_dst = nullptr;
-	Sector               offset_src    = 0;
-	Sector               offset_dst    = 0;
-	bool                 success       = false;
+	Byte_Value           total_length    = 0;
+	Byte_Value           done            = 0;
+	PedDevice*           lp_device_src   = nullptr;
+	PedDevice*           lp_device_dst   = nullptr;
+	Sector               offset_src      = 0;
+	Sector               offset_dst      = 0;
+	bool                 success         = false;
 	Glib::ustring        error_message;
-	bool                 cancel        = false;
-	bool                 cancel_safe   = false;
+	bool                 foreground      = true;   // Copying from GParted_Core::mainthread
+	bool                 finished        = false;  // Background only, guarded by
+	Glib::Mutex          finished_mutex;           // finished_mutex
+	Glib::Cond           finished_cond;
+	std::vector<Glib::ustring>* libparted_messages = nullptr;  // Of the thread calling copy()
+	bool                 cancel          = false;
+	bool                 cancel_safe     = false;
+	bool                 direct_io       = false;
+	int                  fd_src          = -1;     // Direct I/O file descriptors, or -1
+	int                  fd_dst          = -1;     // when copying using libparted
+	int                  fd_zeroout      = -1;     // For BLKZEROOUT of zero runs, or -1
+	Byte_Value           zeroed          = 0;      // Bytes zeroed rather than written
+
+	// In kernel copying between the files backing loop devices.
+	int                  fd_offload_src  = -1;
+	int                  fd_offload_dst  = -1;
+	Byte_Value           offload_src_offset = 0;   // Byte offsets of the loop devices
+	Byte_Value           offload_dst_offset = 0;   // within their backing files
+	bool                 offloaded       = false;  // Copy was done using copy_file_range()
+
+	// Checkpointing of the progress of an overlapping move so that it can be resumed.
+	MoveJournal*         journal         = nullptr;
+	Byte_Value           checkpoint_interval = 0;  // Most bytes to write between checkpoints
+	Byte_Value           checkpoint_done = 0;      // Progress recorded by the last checkpoint
+
+	// Ring of buffers passed from read_thread() to the writer in copy_thread().
+	// Slots [ring_tail, ring_tail + ring_count) are filled and owned by the writer,
+	// all other slots are owned by the reader.
+	std::vector<Block>   ring;
+	unsigned int         ring_head       = 0;      // Next slot the reader fills
+	unsigned int         ring_tail       = 0;      // Next slot the writer empties
+	unsigned int         ring_count      = 0;
+	unsigned int         ring_depth      = 0;      // Slots in use, at most ring.size()
+	bool                 reader_done     = false;
+	bool                 stop_reader     = false;
+	Glib::Mutex          ring_mutex;
+	Glib::Cond           ring_cond;
+	Glib::Mutex          io_mutex;                 // Serialises libparted I/O when the
+	                                               // source and destination are the
+	                                               // same PedDevice
+
+	// Runtime tuning of the block size and queue depth.  The writer measures the
+	// throughput and sets tuned_blocksize and tuned_depth, which the reader applies
+	// to the following blocks.  Guarded by ring_mutex.
+	bool                 tune_enabled    = false;
+	Byte_Value           tuned_blocksize = 0;
+	unsigned int         tuned_depth     = 0;
+	std::vector<Glib::ustring> tuning_log;         // Decisions not yet added to the
+	                                               // operation details
+	// Controller state, only used by the writer.
+	double               tune_rate       = 0.0;    // Throughput of the accepted settings
+	bool                 tune_stepped    = false;  // Settings changed for the last window
+	bool                 tune_depth_next = false;  // Step queue depth rather than block size
+	int                  tune_dir_size   = 1;      // Direction of the next step of each
+	int                  tune_dir_depth  = 1;      // setting, 1 = up, -1 = down
+	Byte_Value           tune_prev_size  = 0;      // Settings to return to when the last
+	unsigned int         tune_prev_depth = 0;      // step made things worse
+	unsigned int         tune_hold       = 0;      // Windows to wait before the next step
+	unsigned int         tune_backoff    = 1;
+
+	// Verification of the copied data.  Checksums of the source blocks are calculated
+	// by the reader.  The writer reads back batches of written blocks and compares.
+	bool                 verify_enabled  = false;
+	int                  fd_verify       = -1;
+	Block                verify_block;             // Buffer for reading back
+	std::vector<WrittenBlock> written;             // Not yet verified
+	Byte_Value           written_bytes   = 0;
+	Byte_Value           verified        = 0;
+	std::vector<Mismatch> mismatches;
+	Byte_Value           hash_bytes_src  = 0;      // Checksummed by the reader
+	double               hash_seconds_src = 0.0;   // Checksumming time in the reader
+	double               hash_seconds_dst = 0.0;   // and the writer
 };
 
 
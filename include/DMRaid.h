@@ -82,6 +82,7 @@ private:
 	static bool udevadm_found ;
 	static std::vector<Glib::ustring> dmraid_devices ;
 	static std::vector<DMRaid_Member> dmraid_member_cache;
+	static BlockSpecialIndex dmraid_member_index;
 };
 
 
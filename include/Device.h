@@ -71,6 +71,8 @@ public:
 	bool readonly;  // Must changes to the partition table be prevented because the OS
 	                // can't be informed of the changes while other partitions are
 			// busy.
+	bool incomplete;  // Did an external command time out while searching the device, so
+	                  // some details may be missing.
 
 protected:
 	void copy_fields_without_partitions(Device& dest) const;
@@ -0,0 +1,72 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* DeviceMonitor
+ *
+ * Listens to kernel block device uevents to track which disk devices have changed since
+ * they were last scanned, so that refreshing only needs to search those devices again.
+ * Changes to devices built on top of other devices, mounts and swap, which can affect
+ * the state of any device, and failing to receive uevents all require every device to be
+ * scanned again.
+ */
+
+#ifndef GPARTED_DEVICEMONITOR_H
+#define GPARTED_DEVICEMONITOR_H
+
+#include <glibmm/ustring.h>
+#include <glib.h>
+#include <set>
+#include <string>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+class DeviceMonitor
+{
+public:
+	DeviceMonitor() = default;
+	~DeviceMonitor();
+	DeviceMonitor(const DeviceMonitor& src) = delete;             // Copy construction prohibited
+	DeviceMonitor& operator=(const DeviceMonitor& rhs) = delete;  // Copy assignment prohibited
+
+	void start();
+	bool get_changed_devices(std::vector<Glib::ustring>& device_paths);
+	void mark_changed(const Glib::ustring& device_path);
+	void mark_all_changed();
+	void reset();
+
+private:
+	static gboolean _on_uevent(GIOChannel* source, GIOCondition condition, gpointer data);
+	void read_uevents();
+	void add_uevent(const char* buf, size_t len);
+	static std::string read_state();
+
+	int                     m_fd          = -1;
+	guint                   m_source_id   = 0;
+	bool                    m_all_changed = true;  // Until first scanned
+	std::set<Glib::ustring> m_changed;             // Paths of changed disk devices
+	std::string             m_state;               // Mounts, swap and SW RAID when last scanned
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_DEVICEMONITOR_H */
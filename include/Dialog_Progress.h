@@ -22,9 +22,13 @@
 #include "Utils.h"
 #include "Device.h"
 #include "Operation.h"
+#include "OperationScheduler.h"
 #include "Partition.h"
+#include "ProgressBar.h"
 
+#include <gtkmm/box.h>
 #include <gtkmm/dialog.h>
+#include <gtkmm/label.h>
 #include <gtkmm/progressbar.h>
 #include <gtkmm/treeview.h>
 #include <gtkmm/treestore.h>
@@ -50,11 +54,54 @@ public:
 	sigc::signal< bool, Operation * > signal_apply_operation ;
 
 private:
+	// Snapshot of an updated operation detail, passed from the thread applying the
+	// operation to the Glib/Gtk main loop.
+	struct DetailUpdate
+	{
+		Dialog_Progress*      dialog;
+		Glib::ustring         treepath;
+		Glib::ustring         description;
+		Glib::ustring         elapsed_time;
+		OperationDetailStatus status;
+		bool                  progress_running;
+		double                progress_fraction;
+		Glib::ustring         progress_text;
+	};
+
+	struct OperationCompletion
+	{
+		Dialog_Progress* dialog;
+		unsigned int     index;
+		bool             success;
+	};
+
+	// Widgets showing the progress of one operation currently being applied.  One per
+	// independent chain of operations being applied concurrently.
+	struct CurrentRow
+	{
+		Gtk::Label       label;
+		Gtk::ProgressBar progressbar;
+		Gtk::Label       label_sub;
+		Glib::ustring    progress_text;
+		Glib::ustring    label_sub_text;
+		bool             pulsing   = false;
+		int              operation = -1;  // Index of the operation shown or -1 when unused
+	};
+
 	void on_signal_update( const OperationDetail & operationdetail ) ;
-	void update_gui_elements() ;
+	static gboolean _apply_update(gpointer data);
+	void apply_update(const DetailUpdate& update);
+	void update_gui_elements(CurrentRow& row);
 	void on_signal_show() ;
+	void start_ready_operations();
+	void apply_operation_thread(unsigned int index);
+	static gboolean _operation_completed(gpointer data);
+	void operation_completed(unsigned int index, bool success);
+	void update_completed_count();
+	CurrentRow* find_current_row(const Glib::ustring& treepath);
 	void on_cell_data_description( Gtk::CellRenderer * renderer, const Gtk::TreeModel::iterator & iter) ;
 	bool cancel_timeout();
+	bool cancel_running_operations(bool force);
 	void on_cancel() ;
 	void on_save() ;
 	void write_device_details(const Device& device, std::ofstream& out);
@@ -66,9 +113,8 @@ private:
 	bool pulsebar_pulse();
 
 	// Child widgets
-	Gtk::Label          m_label_current;
-	Gtk::ProgressBar    m_progressbar_current;
-	Gtk::Label          m_label_current_sub;
+	Gtk::Box            m_vbox_current;
+	std::vector<std::unique_ptr<CurrentRow>> m_current_rows;
 	Gtk::ProgressBar    m_progressbar_all;
 	Gtk::Expander       m_expander_details;
 	Gtk::ScrolledWindow m_scrolledwindow;
@@ -103,12 +149,13 @@ private:
 	const double               m_fraction               = 1.0;
 	bool                       m_success                = true;
 	bool                       m_cancel                 = false;
-	unsigned int               m_curr_op                = 0;
 	unsigned int               m_warnings               = 0;
-	Glib::ustring              m_progress_text;
-	Glib::ustring              m_label_current_sub_text;
 	unsigned int               m_cancel_countdown       = 0;
 
+	OperationScheduler         m_scheduler;
+	std::vector<std::unique_ptr<ProgressBar>> m_progressbars;  // One per operation
+	unsigned int               m_num_running            = 0;
+
 	sigc::connection pulsetimer;
 	sigc::connection canceltimer;
 };
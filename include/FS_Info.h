@@ -49,6 +49,7 @@ public:
 	static void load_cache_for_device_and_partition_names(
 	                        const std::vector<DeviceAndPartitionNames>& dev_ptn_names);
 	static void load_cache_for_one_device_name(const Glib::ustring& device_name);
+	static void remove_cache_entries(const std::vector<Glib::ustring>& paths);
 	static Glib::ustring get_fs_type( const Glib::ustring & path );
 	static Glib::ustring get_label( const Glib::ustring & path, bool & found );
 	static Glib::ustring get_uuid( const Glib::ustring & path );
@@ -59,6 +60,7 @@ private:
 	static bool not_initialised_then_error();
 	static void set_command_found();
 	static FS_Entry& get_cache_entry_by_path(const Glib::ustring& path);
+	static void add_cache_entry(const FS_Entry& fs_entry);
 	static void run_blkid_load_cache(const std::vector<Glib::ustring>& paths);
 	static void apply_blkid_whole_drive_zfs_detection_workaround(
 	                        const std::vector<DeviceAndPartitionNames>& dev_ptn_names);
@@ -70,6 +72,7 @@ private:
 	static Glib::ustring full_blkid_version;
 	static bool need_blkid_vfat_cache_update_workaround;
 	static std::vector<FS_Entry> fs_info_cache;
+	static BlockSpecialIndex fs_info_index;
 };
 
 
@@ -31,6 +31,9 @@ namespace GParted
 {
 
 
+class AllocationMap;
+
+
 enum CUSTOM_TEXT
 {
 	CTEXT_NONE,
@@ -117,6 +120,7 @@ public:
 			   OperationDetail & operationdetail ) { return false; };
 	virtual bool check_repair( const Partition & partition, OperationDetail & operationdetail ) { return false; };
 	virtual bool remove( const Partition & partition, OperationDetail & operationdetail ) { return true; };
+	virtual bool read_allocation_map(AllocationMap& map)                    { return false; };
 
 protected:
 	static Glib::ustring mk_temp_dir(const Glib::ustring& infix, OperationDetail& operationdetail);
@@ -18,9 +18,11 @@
 #ifndef GPARTED_GPARTED_CORE_H
 #define GPARTED_GPARTED_CORE_H
 
+#include "AllocationMap.h"
 #include "BlockSpecial.h"
 #include "Device.h"
 #include "FileSystem.h"
+#include "MoveJournal.h"
 #include "Operation.h"
 #include "Partition.h"
 #include "PartitionLUKS.h"
@@ -33,6 +35,8 @@
 #include <fstream>
 #include <glibmm/thread.h>
 #include <glibmm/ustring.h>
+#include <sigc++/signal.h>
+#include <sigc++/slot.h>
 #include <memory>
 
 
@@ -40,6 +44,7 @@ namespace GParted
 {
 
 
+class UdevSettle;
 class VGDevice;
 
 
@@ -56,11 +61,21 @@ public:
 	static void find_supported_core();
 	void find_supported_filesystems() ;
 	void set_user_devices( const std::vector<Glib::ustring> & user_devices ) ;
+	void set_verify_copies(bool verify)  { m_verify_copies = verify; };
 	void set_devices(std::vector<std::unique_ptr<Device>>& devices);
 	void set_devices_thread(std::vector<std::unique_ptr<Device>>* pdevices);
+	bool refresh_devices(std::vector<std::unique_ptr<Device>>& devices,
+	                     const std::vector<Glib::ustring>& device_paths);
+	void refresh_devices_thread(std::vector<std::unique_ptr<Device>>* pdevices,
+	                            const std::vector<Glib::ustring>* pdevice_paths, bool* psuccess);
 
 	bool valid_partition(const Device& device, Partition& partition, Glib::ustring& error);
 	bool apply_operation_to_disk( Operation * operation );
+	static void acquire_core_lock();
+	static bool try_acquire_core_lock();
+	static bool release_core_lock();
+	static std::vector<Glib::ustring>* get_libparted_messages();
+	static void redirect_libparted_messages(std::vector<Glib::ustring>* messages);
 
 	bool set_disklabel( const Device & device, const Glib::ustring & disklabel );
 	bool new_disklabel( const Glib::ustring & device_path, const Glib::ustring & disklabel,
@@ -73,6 +88,12 @@ public:
 	static std::vector<Glib::ustring> get_disklabeltypes() ;
 	std::map<Glib::ustring, bool> get_available_flags( const Partition & partition ) ;
 	Glib::ustring get_thread_status_message() ;
+	bool start_reading_usage();
+	void set_usage_priority_device(const Glib::ustring& device_path);
+	void cancel_reading_usage();
+
+	sigc::signal<void, const Glib::ustring&> signal_usage_read;      // Device path of partition read
+	sigc::signal<void>                       signal_usage_finished;
 
 	static FileSystem * get_filesystem_object( FSType fstype );
 	static bool supported_filesystem( FSType fstype );
@@ -90,6 +111,13 @@ public:
 private:
 	//detectionstuff..
 	void set_thread_status_message( Glib::ustring msg ) ;
+	static bool has_multi_device_member(const Device& device);
+	static void load_caches(const std::vector<sigc::slot<void>>& loaders);
+	void confirm_device(unsigned int index, const std::vector<PedDevice*>* lp_devices,
+	                    std::vector<Glib::ustring>* useable_paths);
+	void probe_device(unsigned int index, const std::vector<Glib::ustring>* device_names,
+	                  std::vector<std::unique_ptr<Device>>* devices);
+	static void set_device_incomplete(Device& device);
 	static Glib::ustring get_partition_path(const PedPartition *lp_partition);
 	void set_device_from_disk( Device & device, const Glib::ustring & device_path );
 	void set_device_serial_number( Device & device );
@@ -112,6 +140,11 @@ private:
 	bool set_mountpoints_helper( Partition & partition, const Glib::ustring & path );
 	bool is_busy(const Glib::ustring& device_path, FSType fstype, const Glib::ustring& partition_path);
 	void set_used_sectors( Partition & partition, PedDisk* lp_disk );
+	void read_used_sectors(Partition& partition, PedDisk* lp_disk);
+	void read_usage_thread();
+	void read_spindle_usage(unsigned int index);
+	static gboolean _usage_read(gpointer data);
+	static gboolean _usage_finished(gpointer data);
 	void mounted_fs_set_used_sectors(Partition& partition);
 	void LP_set_used_sectors( Partition & partition, PedDisk* lp_disk ) ;
 	void set_flags( Partition & partition, PedPartition* lp_partition ) ;
@@ -141,7 +174,12 @@ private:
 	           OperationDetail & operationdetail );
 	bool move_filesystem( const Partition & partition_old,
 			      const Partition & partition_new,
-			      OperationDetail & operationdetail ) ;
+			      OperationDetail & operationdetail,
+			      MoveJournal & journal );
+	bool resume_move( MoveJournal & journal,
+	                  const Partition & partition_all_space,
+	                  const Partition & partition_new,
+	                  OperationDetail & operationdetail );
 	bool resize_move_filesystem_using_libparted( const Partition & partition_old,
 				      		     const Partition & partition_new,
 					      	     OperationDetail & operationdetail ) ;
@@ -194,7 +232,8 @@ private:
 	                               const Partition & partition_dst,
 	                               OperationDetail & operationdetail,
 	                               Byte_Value & total_done,
-	                               bool cancel_safe );
+	                               bool cancel_safe,
+	                               MoveJournal * journal );
 	bool copy_blocks( const Glib::ustring & src_device,
 	                  const Glib::ustring & dst_device,
 	                  Sector src_start,
@@ -202,9 +241,12 @@ private:
 	                  Byte_Value src_sector_size,
 	                  Byte_Value dst_sector_size,
 	                  Byte_Value src_length,
+	                  const ExtentVector & extents,
 	                  OperationDetail & operationdetail,
 	                  Byte_Value & total_done,
-	                  bool cancel_safe );
+	                  bool cancel_safe,
+	                  MoveJournal * journal = nullptr );
+	ExtentVector read_allocation_map( const Partition & partition );
 	void rollback_move_filesystem( const Partition & partition_src,
 	                               const Partition & partition_dst,
 	                               OperationDetail & operationdetail,
@@ -242,7 +284,7 @@ private:
 	static void destroy_device_and_disk( PedDevice*& lp_device, PedDisk*& lp_disk );
 	static bool commit( PedDisk* lp_disk );
 	static bool commit_to_os( PedDisk* lp_disk, std::time_t timeout );
-	static void settle_device( std::time_t timeout );
+	static void settle_device(UdevSettle& settle, std::time_t timeout);
 	static bool useable_device(const PedDevice* lp_device);
 	static PedPartition* get_lp_partition( const PedDisk* lp_disk, const Partition & partition );
 
@@ -251,7 +293,31 @@ private:
 	std::vector<PedPartitionFlag> m_all_libparted_flags;
 	std::vector<Glib::ustring>    m_user_devices;           // From command line; sorted, useable names only
 	bool                          m_probe_devices         = false;
+	bool                          m_verify_copies         = false;  // Read back and check internal copies
+	bool                          m_caches_incomplete     = false;  // Command timed out loading caches
 	Glib::ustring                 m_thread_status_message;  // Used to pass data to show_pulsebar method
+	Glib::Mutex                   m_thread_status_mutex;    // Set by concurrent probing threads
+
+	// Partitions whose file system usage is read in the background after the devices
+	// are searched.  Grouped by device so only one partition of each disk is read at a
+	// time.
+	struct UsageSpindle
+	{
+		Glib::ustring           path;        // Device path of the partitions
+		std::vector<Partition*> partitions;
+		bool                    taken;       // Being read by a thread
+	};
+	struct UsageCompletion
+	{
+		GParted_Core* core;
+		Partition*    partition;
+		Partition*    result;     // Usage and messages read for partition
+	};
+	bool                          m_queue_usage           = false;
+	std::vector<UsageSpindle>     m_usage_spindles;         // Queued holding the core lock
+	Glib::ustring                 m_usage_priority_path;    // Device the user is looking at
+	bool                          m_usage_cancel          = false;
+	Glib::Mutex                   m_usage_mutex;            // Protects taken, priority and cancel
 
 	static std::unique_ptr<SupportedFileSystems> supported_filesystems;
 };
@@ -57,11 +57,11 @@ class LUKS_Info
 {
 public:
 	static void clear_cache();
+	static void load_cache();
 	static const LUKS_Mapping & get_cache_entry( const Glib::ustring & path );
 
 private:
 	static void initialise_if_required();
-	static void load_cache();
 	static const LUKS_Mapping & get_cache_entry_internal( const Glib::ustring & path );
 
 	static std::vector<LUKS_Mapping> luks_mapping_cache;
@@ -30,7 +30,10 @@
 #include "VGDevice.h"
 
 #include <glibmm/ustring.h>
+#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -70,11 +73,19 @@ struct LVM2_LV
 };
 
 
+// Fields of one row of an lvm report, by field name.
+typedef std::map<std::string, std::string> LVM2_ReportRow;
+
+
 class LVM2_Info
 {
+friend class LVM2_InfoTest;  // To allow unit testing to parse canned reports and
+                             // inspect the caches.
+
 public:
 	static bool is_lvm2_supported();
 	static void clear_cache();
+	static void load_cache();
 	static const Glib::ustring& get_vg_name_for_pv(const Glib::ustring& path);
 	static Byte_Value get_pv_size_bytes(const Glib::ustring& path);
 	static Byte_Value get_pv_free_bytes(const Glib::ustring& path);
@@ -96,6 +107,17 @@ private:
 	static void initialize_if_required();
 	static void set_command_found();
 	static void load_lvm2_info_cache();
+	static bool load_lvm2_fullreport();
+	static bool parse_lvm2_fullreport(const Glib::ustring& output);
+	static void add_report_row(const std::string& report, const LVM2_ReportRow& row);
+	static void add_pv(const Glib::ustring& pv_name, const Glib::ustring& pv_size,
+	                   const Glib::ustring& pv_free, const Glib::ustring& vg_name);
+	static void add_vg(const Glib::ustring& vg_name, const Glib::ustring& vg_attr,
+	                   const Glib::ustring& extent_size, const Glib::ustring& extent_count,
+	                   const Glib::ustring& free_count, const Glib::ustring& vg_uuid);
+	static void add_lv(const Glib::ustring& vg_name, const Glib::ustring& lv_name,
+	                   const Glib::ustring& lv_path, const Glib::ustring& lv_size,
+	                   const Glib::ustring& lv_metadata_size, const Glib::ustring& lv_attr);
 	static const LVM2_PV & get_pv_cache_entry_by_name( const Glib::ustring & pvname );
 	static const LVM2_VG & get_vg_cache_entry_by_name( const Glib::ustring & vgname );
 	static const LVM2_LV& get_lv_cache_entry_by_path(const Glib::ustring& lv_path);
@@ -106,6 +128,9 @@ private:
 	static std::vector<LVM2_PV> lvm2_pv_cache;
 	static std::vector<LVM2_VG> lvm2_vg_cache;
 	static std::vector<LVM2_LV> lvm2_lv_cache;
+	static BlockSpecialIndex lvm2_pv_index;
+	static std::unordered_map<std::string, unsigned int> lvm2_vg_index;
+	static std::unordered_map<std::string, unsigned int> lvm2_lv_index;
 	static std::vector<Glib::ustring> error_messages ;
 };
 
@@ -0,0 +1,94 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* MoveJournal
+ *
+ * Side file recording the progress of an internal move of a file system within an
+ * overlapping range of sectors.  CopyBlocks checkpoints how much has been durably copied
+ * so that when GParted is killed, or the power fails, part way through, a later run can
+ * resume the move from the last checkpoint instead of leaving a half moved file system.
+ * There is one journal file per partition being moved.
+ */
+
+#ifndef GPARTED_MOVEJOURNAL_H
+#define GPARTED_MOVEJOURNAL_H
+
+#include "Partition.h"
+#include "Utils.h"
+
+#include <glibmm/ustring.h>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+class MoveJournal
+{
+public:
+	MoveJournal() = default;
+	MoveJournal(const MoveJournal& src) = delete;             // Copy construction prohibited
+	MoveJournal& operator=(const MoveJournal& rhs) = delete;  // Copy assignment prohibited
+
+	bool begin(const Partition& partition_old, const Partition& partition_new);
+	bool load(const Glib::ustring& filename);
+	bool load_for(const Partition& partition);
+	bool checkpoint(Byte_Value done);
+	void close();
+	void end();
+
+	bool active() const                          { return m_active; };
+	bool matches(const Partition& partition_all_space, const Partition& partition_new) const;
+	Byte_Value get_checkpoint_interval() const;
+
+	const Glib::ustring& get_device_path() const { return m_device_path; };
+	int get_partition_number() const             { return m_partition_number; };
+	Byte_Value get_sector_size() const           { return m_sector_size; };
+	FSType get_fstype() const                    { return m_fstype; };
+	Sector get_all_space_start() const           { return m_all_space_start; };
+	Sector get_all_space_end() const             { return m_all_space_end; };
+	Sector get_src_start() const                 { return m_src_start; };
+	Sector get_dst_start() const                 { return m_dst_start; };
+	Sector get_sector_length() const             { return m_sector_length; };
+	Byte_Value get_done() const                  { return m_done; };
+
+	Glib::ustring get_filename() const;
+	static std::vector<Glib::ustring> find_journals();
+
+private:
+	bool write() const;
+
+	bool          m_active           = false;
+	Glib::ustring m_device_path;
+	int           m_partition_number = 0;
+	Byte_Value    m_sector_size      = 0;
+	FSType        m_fstype           = FS_UNKNOWN;
+	Sector        m_all_space_start  = 0;  // Partition encompassing the old and new
+	Sector        m_all_space_end    = 0;  // file system positions during the move
+	Sector        m_src_start        = 0;
+	Sector        m_dst_start        = 0;
+	Sector        m_sector_length    = 0;  // Of the file system being moved
+	Byte_Value    m_done             = 0;  // Bytes durably copied from the copy edge
+	Byte_Value    m_done_base        = 0;  // Already copied when this run started
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_MOVEJOURNAL_H */
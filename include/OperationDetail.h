@@ -85,7 +85,8 @@ class OperationDetail
 {
 
 friend class Dialog_Progress;  // To allow Dialog_Progress::on_signal_update() to call
-                               // get_progressbar() and get direct access to the progress bar.
+                               // get_progressbar() and get direct access to the progress bar,
+                               // and to give each operation its own with set_progressbar().
 
 public:	
 	OperationDetail() = default;
@@ -127,6 +128,8 @@ private:
 	void on_update( const OperationDetail & operationdetail ) ;
 	void cancel( bool force );
 	const ProgressBar& get_progressbar() const;
+	ProgressBar& get_progressbar();
+	void set_progressbar(ProgressBar* progressbar);
 
 	int execute_command_internal(const Glib::ustring& command, const char* input, ExecFlags flags,
 	                             StreamSlot stream_progress_slot,
@@ -143,6 +146,7 @@ private:
 	                      // set_success_and_capture_errors() and add_child().
 	bool                  m_no_more_children = false;
 	OperationDetailVector m_sub_details;
+	ProgressBar*          m_progressbar      = nullptr;  // Shared by the whole tree
 
 	sigc::connection      m_connection_cancel;
 };
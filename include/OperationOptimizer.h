@@ -0,0 +1,77 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* OperationOptimizer
+ *
+ * Planning pass over the pending operations before applying them.  Folds each chain of
+ * resize/move operations of a partition into a single operation, so that the file system
+ * data is moved once rather than once per step, even when other operations are queued in
+ * between.  The folding is done on a plan of the queue, leaving the pending operations
+ * untouched until the plan is committed.
+ */
+
+#ifndef GPARTED_OPERATIONOPTIMIZER_H
+#define GPARTED_OPERATIONOPTIMIZER_H
+
+#include "Operation.h"
+#include "Partition.h"
+#include "Utils.h"
+
+#include <memory>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+class OperationOptimizer
+{
+public:
+	OperationOptimizer(const OperationVector& operations);
+	OperationOptimizer(const OperationOptimizer& src) = delete;             // Copy construction prohibited
+	OperationOptimizer& operator=(const OperationOptimizer& rhs) = delete;  // Copy assignment prohibited
+
+	unsigned int get_num_operations() const  { return m_plan.size(); };
+	const Operation& get_operation(unsigned int index) const;
+	bool changed() const                     { return m_plan.size() != m_operations.size(); };
+	Byte_Value get_bytes_saved() const       { return m_bytes_saved; };
+	void commit(OperationVector& operations);
+
+	static bool operations_affect_same_partition(const Operation& first_op, const Operation& second_op);
+
+private:
+	struct Step
+	{
+		unsigned int               index;     // Index of the pending operation, or
+		std::unique_ptr<Operation> combined;  // the operation folded from several
+	};
+
+	bool fold_resize_move(unsigned int first);
+	static bool operation_overlaps(const Operation& operation, const Partition& partition);
+	static Byte_Value get_moved_bytes(const Operation& operation);
+
+	const OperationVector& m_operations;
+	std::vector<Step>      m_plan;
+	Byte_Value             m_bytes_saved = 0;
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_OPERATIONOPTIMIZER_H */
@@ -0,0 +1,65 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* OperationScheduler
+ *
+ * Orders the pending operations for applying concurrently.  Builds a dependency graph
+ * where each operation depends on the previous operation using any of the same devices,
+ * so operations on independent disks can run at the same time while operations on each
+ * disk still run in the order they were queued.
+ */
+
+#ifndef GPARTED_OPERATIONSCHEDULER_H
+#define GPARTED_OPERATIONSCHEDULER_H
+
+#include "Operation.h"
+
+#include <glibmm/ustring.h>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+class OperationScheduler
+{
+public:
+	OperationScheduler(const OperationVector& operations);
+	OperationScheduler(const OperationScheduler& src) = delete;             // Copy construction prohibited
+	OperationScheduler& operator=(const OperationScheduler& rhs) = delete;  // Copy assignment prohibited
+
+	std::vector<unsigned int> take_ready();
+	void set_completed(unsigned int index);
+	unsigned int get_num_completed() const  { return m_num_completed; };
+
+private:
+	static void get_resources(const Operation& operation, std::vector<Glib::ustring>& resources,
+	                          bool& global);
+	void add_dependency(unsigned int before, unsigned int after);
+
+	std::vector<std::vector<unsigned int>> m_dependents;  // Operations waiting for each operation
+	std::vector<unsigned int>              m_num_waiting;  // Incomplete operations each one waits for
+	std::vector<bool>                      m_started;
+	unsigned int                           m_num_completed = 0;
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_OPERATIONSCHEDULER_H */
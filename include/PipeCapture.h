@@ -22,8 +22,6 @@
 #include <stddef.h>            // typedef size_t
 #include <glib.h>              // typedef gunichar
 #include <glibmm/ustring.h>
-#include <glibmm/refptr.h>
-#include <glibmm/iochannel.h>
 #include <sigc++/signal.h>
 
 
@@ -38,17 +36,18 @@ public:
 	PipeCapture( int fd, Glib::ustring &buffer );
 
 	void connect_signal();
+	bool OnReadable();
+	void flush();
 	sigc::signal<void> signal_eof;
 	sigc::signal<void> signal_update;
 
 private:
-	bool OnReadable( Glib::IOCondition condition );
 	static gboolean _OnReadable( GIOChannel *source,
 	                             GIOCondition condition,
 	                             gpointer data );
 
-	Glib::RefPtr<Glib::IOChannel> m_channel;                     // Wrapper around fd
-	std::vector<char>             m_readbuf;                     // Bytes read from IOChannel (fd)
+	int                           m_fd;                          // Read end of pipe
+	std::vector<char>             m_readbuf;                     // Bytes read from pipe (fd)
 	size_t                        m_fill_offset        = 0;      // Filling offset into m_readbuf
 	std::vector<gunichar>         m_linevec;                     // Current line stored as UCS-4 characters
 	size_t                        m_cursor             = 0;      // Cursor position index into m_linevec
@@ -73,6 +73,7 @@ private:
 	static bool cache_initialised;
 	static bool mdadm_found;
 	static std::vector<SWRaid_Member> swraid_info_cache;
+	static BlockSpecialIndex swraid_info_index;
 };
 
 
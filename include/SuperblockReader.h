@@ -0,0 +1,67 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* SuperblockReader
+ *
+ * Reads the size and free space figures of a file system directly from its on disk
+ * superblock, or other few KiB of metadata, in process.  Returns the same figures as
+ * the file system specific tools print, saving a command per partition when reading
+ * usage.  The FileSystem::set_used_sectors() implementations fall back to running the
+ * tools when the metadata can't be read or decoded.
+ */
+
+#ifndef GPARTED_SUPERBLOCKREADER_H
+#define GPARTED_SUPERBLOCKREADER_H
+
+#include "Utils.h"
+
+#include <glibmm/ustring.h>
+#include <stddef.h>
+
+
+namespace GParted
+{
+
+
+class SuperblockReader
+{
+public:
+	SuperblockReader(const Glib::ustring& path);
+	~SuperblockReader();
+	SuperblockReader(const SuperblockReader& src) = delete;             // Copy construction prohibited
+	SuperblockReader& operator=(const SuperblockReader& rhs) = delete;  // Copy assignment prohibited
+
+	bool open();
+	bool read_ext2(long long& block_count, long long& block_size, long long& free_blocks);
+	bool read_xfs(long long& block_size, long long& data_blocks, long long& free_data_blocks);
+	bool read_btrfs(long long& total_bytes, long long& bytes_used, long long& sector_size,
+	                long long& dev_item_total_bytes);
+	bool read_fat(long long& logical_sector_size, long long& cluster_size,
+	              long long& logical_sectors, long long& bytes_free);
+
+private:
+	bool read(Byte_Value offset, void* buf, size_t count) const;
+
+	Glib::ustring m_path;
+	int           m_fd = -1;
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_SUPERBLOCKREADER_H */
@@ -0,0 +1,78 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* UdevSettle
+ *
+ * Waits for udev to finish processing the uevents of one disk device and its partitions,
+ * rather than for the whole udev event queue as "udevadm settle" does.  Construct before
+ * the action which changes the disk, so that its kernel uevents are seen, then call
+ * wait() after it.  Kernel uevents for the disk are matched to the events udev
+ * re-broadcasts after running its rules by sequence number.  When udev processes none of
+ * the disk's uevents wait() returns false for the whole queue to be settled instead.
+ */
+
+#ifndef GPARTED_UDEVSETTLE_H
+#define GPARTED_UDEVSETTLE_H
+
+#include <glibmm/ustring.h>
+#include <stddef.h>
+#include <chrono>
+#include <ctime>
+#include <set>
+#include <string>
+
+
+namespace GParted
+{
+
+
+class UdevSettle
+{
+friend class UdevSettleTest;  // To allow unit testing to call private methods.
+
+	typedef std::chrono::steady_clock Clock;
+
+public:
+	UdevSettle(const Glib::ustring& device_path);
+	~UdevSettle();
+	UdevSettle(const UdevSettle& src) = delete;             // Copy construction prohibited
+	UdevSettle& operator=(const UdevSettle& rhs) = delete;  // Copy assignment prohibited
+
+	bool wait(std::time_t timeout);
+
+private:
+	void read_uevents();
+	void add_kernel_uevent(const char* buf, size_t len);
+	void add_udev_event(const char* buf, size_t len);
+	bool is_disk_device(const std::string& devname, const std::string& devtype,
+	                    const std::string& devpath) const;
+
+	std::string                  m_disk_name;               // Kernel name, e.g. "sda", "nvme0n1"
+	bool                         m_any_dm         = false;  // Match all device-mapper devices
+	int                          m_fd             = -1;
+	bool                         m_udev_running   = false;
+	bool                         m_lost_uevents   = false;
+	bool                         m_udev_processed = false;  // Has udev processed any uevent of the disk
+	std::set<unsigned long long> m_pending;                 // Kernel uevent SEQNUMs not yet processed by udev
+	Clock::time_point            m_last_uevent;
+};
+
+
+}  // namespace GParted
+
+
+#endif /* GPARTED_UDEVSETTLE_H */
@@ -29,7 +29,7 @@
 #include <gtkmm/image.h>
 #include <gdkmm/pixbuf.h>
 #include <glibmm/ustring.h>
-#include <glibmm/spawn.h>
+#include <sigc++/slot.h>
 #include <iostream>
 #include <ctime>
 #include <vector>
@@ -127,6 +127,8 @@ enum SIZE_UNIT
 	UNIT_TIB	= 5
 } ;
 
+class CommandRunner;
+
 class Utils
 {
 public:
@@ -168,7 +170,14 @@ public:
 	                            Glib::ustring & output,
 	                            Glib::ustring & error,
 				    bool use_C_locale = false );
-	static int get_failure_status(const Glib::SpawnError& e);
+	static int wait_for_command(CommandRunner& runner);
+	static unsigned int get_command_timeout();
+	static void set_thread_command_timeout(bool enabled);
+	static unsigned int get_timed_out_count();
+	static unsigned int get_thread_timed_out_count();
+	static void run_concurrently(unsigned int count, unsigned int max_threads,
+	                             const sigc::slot<void, unsigned int>& work);
+	static int get_failure_status(int spawn_errno);
 	static int decode_wait_status( int wait_status );
 	static std::string convert_ustring(const Glib::ustring& ustr);
 	static Glib::ustring regexp_label( const Glib::ustring & text
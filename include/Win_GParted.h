@@ -20,6 +20,7 @@
 
 
 #include "Device.h"
+#include "DeviceMonitor.h"
 #include "DrawingAreaVisualDisk.h"
 #include "GParted_Core.h"
 #include "HBoxOperations.h"
@@ -81,7 +82,6 @@ private:
 
 	void add_operation(const Device& device, std::unique_ptr<Operation> operation);
 	bool merge_operation(const Operation& candidate);
-	static bool operations_affect_same_partition(const Operation& first_op, const Operation& second_op);
 	void Refresh_Visual();
 	bool valid_display_partition_ptr( const Partition * partition_ptr );
 	bool Quit_Check_Operations();
@@ -166,9 +166,16 @@ private:
 	void on_show() ;
 
 	bool initial_device_refresh();
+	void check_interrupted_moves();
+	void offer_resume_move(const Glib::ustring& filename);
 	void menu_gparted_refresh_devices();
+	void start_reading_usage();
+	void on_usage_read(const Glib::ustring& device_path);
+	void on_usage_finished();
+	bool refresh_usage_visual();
 	void menu_gparted_features();
 	void menu_gparted_quit();
+	void menu_edit_verify_copies();
 	void menu_view_harddisk_info();
 	void menu_view_operations();
 	void show_disklabel_unrecognized(const Glib::ustring& device_name);
@@ -285,6 +292,7 @@ private:
 		MENU_UNDO_OPERATION,
 		MENU_CLEAR_OPERATIONS,
 		MENU_APPLY_OPERATIONS,
+		MENU_VERIFY_COPIES,
 		MENU_VIEW,
 		MENU_DEVICE_INFORMATION,
 		MENU_PENDING_OPERATIONS,
@@ -320,6 +328,7 @@ private:
 	                                               // open_operationslist() early-exits on first use.
 
 	GParted_Core gparted_core ;
+	DeviceMonitor m_device_monitor;  // Tracks which devices need scanning again
 	// The Device menu's "Create Partition Table" item; disabled while a Volume
 	// Group is displayed since LVM VGs are read-only (issue #316).
 	Gtk::MenuItem*            m_create_partition_table_item = nullptr;
@@ -334,6 +343,13 @@ private:
 	//stuff for progress overview and pulsebar
 	bool pulsebar_pulse();
 	sigc::connection pulsetimer;
+
+	// File system usage is read in the background after scanning devices.  Devices
+	// can be looked at meanwhile but not changed.
+	bool             m_reading_usage           = false;
+	bool             m_quit_after_usage        = false;  // Window closed while reading usage
+	bool             m_check_moves_after_usage = false;
+	sigc::connection m_usage_refresh_timer;              // Batches redrawing read usage
 };
 
 
@@ -19,6 +19,7 @@
 #ifndef GPARTED_EXT2_H
 #define GPARTED_EXT2_H
 
+#include "AllocationMap.h"
 #include "FileSystem.h"
 #include "OperationDetail.h"
 #include "Partition.h"
@@ -51,6 +52,7 @@ public:
 	bool copy( const Partition & partition_new,
 	           Partition & partition_old,
 	           OperationDetail & operationdetail );
+	bool read_allocation_map(AllocationMap& map);
 
 private:
 	void resize_progress( OperationDetail *operationdetail );
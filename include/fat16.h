@@ -19,6 +19,7 @@
 #ifndef GPARTED_FAT16_H
 #define GPARTED_FAT16_H
 
+#include "AllocationMap.h"
 #include "FileSystem.h"
 #include "OperationDetail.h"
 #include "Partition.h"
@@ -45,10 +46,14 @@ public:
 	bool write_uuid( const Partition & partition, OperationDetail & operationdetail ) ;
 	bool create( const Partition & new_partition, OperationDetail & operationdetail ) ;
 	bool check_repair( const Partition & partition, OperationDetail & operationdetail ) ;
+	bool read_allocation_map(AllocationMap& map);
 
 private:
 	static Glib::ustring sanitize_label(const Glib::ustring& label);
 	static Glib::ustring remove_spaces(const Glib::ustring& str);
+	static bool mtools_read_usage(Partition& partition, long long& logical_sector_size,
+	                              long long& cluster_size, long long& logical_sectors,
+	                              long long& bytes_free);
 
 	const FSType m_specific_fstype     = FS_UNKNOWN;
 	bool         m_ignore_label_noname = false;
@@ -19,6 +19,7 @@
 #ifndef GPARTED_XFS_H
 #define GPARTED_XFS_H
 
+#include "AllocationMap.h"
 #include "FileSystem.h"
 #include "OperationDetail.h"
 #include "Partition.h"
@@ -46,6 +47,7 @@ public:
 		   Partition & dest_part,
 		   OperationDetail & operationdetail ) ;
 	bool check_repair( const Partition & partition, OperationDetail & operationdetail ) ;
+	bool read_allocation_map(AllocationMap& map);
 
 private:
 	bool copy_progress( OperationDetail * operationdetail );
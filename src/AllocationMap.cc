@@ -0,0 +1,225 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AllocationMap.h"
+#include "Utils.h"
+
+#include <glibmm/ustring.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+// Always treat this much at the start and end of the file system as allocated.  Covers
+// boot sectors, backup boot sectors and similar stored outside of the space described by
+// a file system's own allocation structures.
+static const Byte_Value ALWAYS_ALLOCATED_SIZE = 1 * MEBIBYTE;
+
+
+static bool extent_offset_less(const Extent& lhs, const Extent& rhs)
+{
+	return lhs.offset < rhs.offset;
+}
+
+
+AllocationMap::AllocationMap(const Glib::ustring& device_path, Byte_Value fs_offset, Byte_Value fs_length)
+ : m_device_path(device_path), m_fs_offset(fs_offset), m_fs_length(fs_length)
+{
+}
+
+
+AllocationMap::~AllocationMap()
+{
+	if (m_fd != -1)
+		close(m_fd);
+}
+
+
+bool AllocationMap::open()
+{
+	if (m_fd == -1)
+		m_fd = ::open(m_device_path.c_str(), O_RDONLY | O_CLOEXEC);
+	return m_fd != -1;
+}
+
+
+// Read count bytes from offset, relative to the start of the file system.  Fails rather
+// than reading outside of the file system.
+bool AllocationMap::read(Byte_Value offset, void* buf, size_t count) const
+{
+	if (m_fd == -1 || offset < 0 || offset + (Byte_Value)count > m_fs_length)
+		return false;
+
+	char* p = static_cast<char*>(buf);
+	off_t pos = m_fs_offset + offset;
+	while (count > 0)
+	{
+		ssize_t n = pread(m_fd, p, count, pos);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p     += n;
+		count -= n;
+		pos   += n;
+	}
+	return true;
+}
+
+
+void AllocationMap::add_allocated(Byte_Value offset, Byte_Value length)
+{
+	if (length <= 0)
+		return;
+
+	// Extend the previous extent when contiguous to keep the map small when the
+	// allocation structures are decoded in order.
+	if (m_extents.size() > 0 && m_extents.back().offset + m_extents.back().length == offset)
+		m_extents.back().length += length;
+	else
+		m_extents.push_back(Extent(offset, length));
+}
+
+
+// Add the allocated units from a bitmap, least significant bit of each byte first, where
+// bit 0 describes the unit_size bytes at offset.
+void AllocationMap::add_allocated_bits(const unsigned char* bitmap, Byte_Value num_bits,
+                                       Byte_Value offset, Byte_Value unit_size)
+{
+	Byte_Value run_start = -1;
+	for (Byte_Value i = 0; i < num_bits; )
+	{
+		unsigned char byte = bitmap[i / 8];
+		// Skip whole bytes which don't end or start a run.
+		if (i % 8 == 0 && i + 8 <= num_bits && ((byte == 0x00 && run_start == -1) ||
+		                                        (byte == 0xFF && run_start != -1)   ))
+		{
+			i += 8;
+			continue;
+		}
+
+		bool allocated = (byte >> (i % 8)) & 1;
+		if (allocated && run_start == -1)
+		{
+			run_start = i;
+		}
+		else if (! allocated && run_start != -1)
+		{
+			add_allocated(offset + run_start * unit_size, (i - run_start) * unit_size);
+			run_start = -1;
+		}
+		i++;
+	}
+	if (run_start != -1)
+		add_allocated(offset + run_start * unit_size, (num_bits - run_start) * unit_size);
+}
+
+
+// Return the sorted, merged allocated extents, including the always allocated ranges at
+// the start and end of the file system.
+ExtentVector AllocationMap::get_extents() const
+{
+	ExtentVector sorted = m_extents;
+	sorted.push_back(Extent(0, std::min(ALWAYS_ALLOCATED_SIZE, m_fs_length)));
+	sorted.push_back(Extent(std::max(0LL, m_fs_length - ALWAYS_ALLOCATED_SIZE),
+	                        std::min(ALWAYS_ALLOCATED_SIZE, m_fs_length)));
+	std::sort(sorted.begin(), sorted.end(), extent_offset_less);
+
+	ExtentVector merged;
+	for (unsigned int i = 0; i < sorted.size(); i++)
+	{
+		Byte_Value start = std::max(0LL, sorted[i].offset);
+		Byte_Value end   = std::min(m_fs_length, sorted[i].offset + sorted[i].length);
+		if (start >= end)
+			continue;
+
+		if (merged.size() > 0 && start <= merged.back().offset + merged.back().length)
+		{
+			Byte_Value merged_end = std::max(end, merged.back().offset + merged.back().length);
+			merged.back().length = merged_end - merged.back().offset;
+		}
+		else
+		{
+			merged.push_back(Extent(start, end - start));
+		}
+	}
+	return merged;
+}
+
+
+// Round sorted extents outwards to multiples of alignment, limited to length, and merge
+// extents separated by less than min_gap bytes.  Skipping small gaps costs more in
+// extra I/O requests than it saves.
+ExtentVector AllocationMap::align_extents(const ExtentVector& extents, Byte_Value alignment,
+                                          Byte_Value min_gap, Byte_Value length)
+{
+	ExtentVector aligned;
+	for (unsigned int i = 0; i < extents.size(); i++)
+	{
+		Byte_Value start = Utils::floor_size(extents[i].offset, alignment);
+		Byte_Value end   = std::min(length, Utils::ceil_size(extents[i].offset + extents[i].length,
+		                                                     alignment));
+		if (start >= end)
+			continue;
+
+		if (aligned.size() > 0 && start - (aligned.back().offset + aligned.back().length) < min_gap)
+		{
+			Byte_Value merged_end = std::max(end, aligned.back().offset + aligned.back().length);
+			aligned.back().length = merged_end - aligned.back().offset;
+		}
+		else
+		{
+			aligned.push_back(Extent(start, end - start));
+		}
+	}
+	return aligned;
+}
+
+
+// Return the parts of sorted extents within the byte range [offset, offset+length),
+// relative to offset.
+ExtentVector AllocationMap::clip_extents(const ExtentVector& extents, Byte_Value offset, Byte_Value length)
+{
+	ExtentVector clipped;
+	for (unsigned int i = 0; i < extents.size(); i++)
+	{
+		Byte_Value start = std::max(offset, extents[i].offset);
+		Byte_Value end   = std::min(offset + length, extents[i].offset + extents[i].length);
+		if (start < end)
+			clipped.push_back(Extent(start - offset, end - start));
+	}
+	return clipped;
+}
+
+
+Byte_Value AllocationMap::total_length(const ExtentVector& extents)
+{
+	Byte_Value total = 0;
+	for (unsigned int i = 0; i < extents.size(); i++)
+		total += extents[i].length;
+	return total;
+}
+
+
+}  // namespace GParted
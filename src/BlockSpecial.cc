@@ -14,6 +14,7 @@
  *  along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+
 #include "BlockSpecial.h"
 
 #include <glibmm/ustring.h>
@@ -21,69 +22,109 @@
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <unistd.h>
-#include <map>
+#include <deque>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
 
 
 namespace GParted
 {
 
 
-struct MM_Number
+static_assert(std::is_trivially_copyable<BlockSpecial>::value, "BlockSpecial must be trivially copyable");
+
+
+struct NameEntry
 {
+	Glib::ustring m_name;
 	unsigned long m_major;
 	unsigned long m_minor;
+	bool          m_known;  // Are the major, minor numbers current?
 };
 
-typedef std::map<Glib::ustring, MM_Number> MMNumberMapping;
+// Registry of interned names, indexed by name handle, and the major, minor number pairs
+// cached for them.  Handle 0 is the empty name.  A deque so that references to names
+// remain valid as more are added.
+// E.g.
+//     name_registry[0] = {""         , 0, 0, true}
+//     name_registry[1] = {"/dev/sda" , 8, 0, true}
+//     name_registry[2] = {"/dev/sda1", 8, 1, true}
+//     name_registry[3] = {"proc"     , 0, 0, true}
+static std::deque<NameEntry> name_registry = {{"", 0UL, 0UL, true}};
 
-// Associative array caching name to major, minor number pairs
+// Hash table from name to handle in the above registry.
 // E.g.
-//     mm_number_cache["/dev/sda"]  = {8, 0}
-//     mm_number_cache["/dev/sda1"] = {8, 1}
-//     mm_number_cache["proc"]      = {0, 0}
-//     mm_number_cache["sysfs"]     = {0, 0}
-static MMNumberMapping mm_number_cache;
+//     name_ids[""]          = 0
+//     name_ids["/dev/sda"]  = 1
+//     name_ids["/dev/sda1"] = 2
+//     name_ids["proc"]      = 3
+static std::unordered_map<std::string, unsigned int> name_ids = {{"", 0U}};
 
 
-BlockSpecial::BlockSpecial(const Glib::ustring& name) : m_name(name)
+// Return the registry entry for name, adding one if not already interned.
+static unsigned int intern_name(const Glib::ustring& name)
 {
-	MMNumberMapping::const_iterator mm_num_iter = mm_number_cache.find( name );
-	if ( mm_num_iter != mm_number_cache.end() )
+	std::pair<std::unordered_map<std::string, unsigned int>::iterator, bool> ins =
+	        name_ids.emplace(name.raw(), name_registry.size());
+	if (ins.second)
 	{
-		// Use already cached major, minor pair
-		m_major = mm_num_iter->second.m_major;
-		m_minor = mm_num_iter->second.m_minor;
-		return;
+		NameEntry entry = {name, 0UL, 0UL, false};
+		name_registry.push_back(entry);
 	}
+	return ins.first->second;
+}
+
 
-	MM_Number pair = {0UL, 0UL};
-	// Call stat(name, ...) to get the major, minor pair
-	struct stat sb;
-	if ( stat( name.c_str(), &sb ) == 0 && S_ISBLK( sb.st_mode ) )
+BlockSpecial::BlockSpecial(const Glib::ustring& name) : m_name_id(intern_name(name))
+{
+	NameEntry& entry = name_registry[m_name_id];
+	if (! entry.m_known)
 	{
-		m_major = major( sb.st_rdev );
-		m_minor = minor( sb.st_rdev );
-		pair.m_major = m_major;
-		pair.m_minor = m_minor;
+		// Call stat(name, ...) to get the major, minor pair
+		entry.m_major = 0UL;
+		entry.m_minor = 0UL;
+		struct stat sb;
+		if ( stat( name.c_str(), &sb ) == 0 && S_ISBLK( sb.st_mode ) )
+		{
+			entry.m_major = major( sb.st_rdev );
+			entry.m_minor = minor( sb.st_rdev );
+		}
+		entry.m_known = true;
 	}
-	// Add new cache entry for name to major, minor pair
-	mm_number_cache[name] = pair;
+	m_major = entry.m_major;
+	m_minor = entry.m_minor;
+}
+
+
+const Glib::ustring& BlockSpecial::get_name() const
+{
+	return name_registry[m_name_id].m_name;
 }
 
 
+// Forget the cached major, minor pairs so that they are queried from the file system
+// again.  Names stay interned because existing BlockSpecial objects refer to them.
 void BlockSpecial::clear_cache()
 {
-	mm_number_cache.clear();
+	for (unsigned int i = 1; i < name_registry.size(); i++)
+		name_registry[i].m_known = false;
 }
 
-void BlockSpecial::register_block_special( const Glib::ustring & name,
-                                           unsigned long major, unsigned long minor )
+// Add new, or update existing, registry entry for name to major, minor pair and return
+// the BlockSpecial object for it.
+BlockSpecial BlockSpecial::register_block_special( const Glib::ustring & name,
+                                                   unsigned long major, unsigned long minor )
 {
-	MM_Number pair;
-	pair.m_major = major;
-	pair.m_minor = minor;
-	// Add new, or update existing, cache entry for name to major, minor pair
-	mm_number_cache[name] = pair;
+	BlockSpecial bs;
+	bs.m_name_id = intern_name(name);
+	bs.m_major   = major;
+	bs.m_minor   = minor;
+	NameEntry& entry = name_registry[bs.m_name_id];
+	entry.m_major = major;
+	entry.m_minor = minor;
+	entry.m_known = true;
+	return bs;
 }
 
 bool operator==( const BlockSpecial & lhs, const BlockSpecial & rhs )
@@ -92,19 +133,55 @@ bool operator==( const BlockSpecial & lhs, const BlockSpecial & rhs )
 		// Match block special files by major, minor device numbers.
 		return lhs.m_major == rhs.m_major && lhs.m_minor == rhs.m_minor;
 	else
-		// For non-block special files fall back to name string compare.
-		return lhs.m_name == rhs.m_name;
+		// For non-block special files fall back to name compare, by interned handle.
+		return lhs.m_name_id == rhs.m_name_id;
 }
 
 bool operator<( const BlockSpecial & lhs, const BlockSpecial & rhs )
 {
 	if ( lhs.m_major == 0 && rhs.m_major == 0 && lhs.m_minor == 0 && rhs.m_minor == 0 )
 		// Two non-block special files are ordered by name.
-		return lhs.m_name < rhs.m_name;
+		return lhs.m_name_id != rhs.m_name_id && lhs.get_name() < rhs.get_name();
 	else
 		// Block special files are ordered by major, minor device numbers.
 		return lhs.m_major < rhs.m_major || ( lhs.m_major == rhs.m_major && lhs.m_minor < rhs.m_minor );
 }
 
+void BlockSpecialIndex::clear()
+{
+	m_by_devnum.clear();
+	m_by_name_id.clear();
+}
+
+// Add BlockSpecial object at position index in the cache vector.  Only the first of
+// equal entries is ever found, matching a linear search.
+void BlockSpecialIndex::add(const BlockSpecial& bs, unsigned int index)
+{
+	if (bs.m_major > 0UL || bs.m_minor > 0UL)
+		m_by_devnum.emplace(makedev(bs.m_major, bs.m_minor), index);
+	m_by_name_id.emplace(bs.m_name_id, index);
+}
+
+// Return the position of the first entry equal to BlockSpecial(name), or -1 when not
+// found.
+int BlockSpecialIndex::find(const Glib::ustring& name) const
+{
+	BlockSpecial bs(name);
+	if (bs.m_major > 0UL || bs.m_minor > 0UL)
+	{
+		std::unordered_map<dev_t, unsigned int>::const_iterator devnum_iter =
+		        m_by_devnum.find(makedev(bs.m_major, bs.m_minor));
+		if (devnum_iter == m_by_devnum.end())
+			return -1;
+		return devnum_iter->second;
+	}
+
+	// Not a block special file so matches by name.
+	std::unordered_map<unsigned int, unsigned int>::const_iterator name_iter = m_by_name_id.find(bs.m_name_id);
+	if (name_iter == m_by_name_id.end())
+		return -1;
+	return name_iter->second;
+}
+
 
 }  // namespace GParted
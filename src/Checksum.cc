@@ -0,0 +1,152 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Checksum.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define HAVE_CRC32C_SSE42 1
+#endif
+
+
+namespace GParted
+{
+
+
+// CRC-32C polynomial, bit reversed.
+static const uint32_t CRC32C_POLY = 0x82F63B78;
+
+
+// Tables for the slicing-by-8 algorithm.  crc32c_table[0] is the classic byte at a time
+// table and crc32c_table[k] advances a byte through k further zero bytes.
+struct Crc32cTable
+{
+	uint32_t entry[8][256];
+
+	Crc32cTable()
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+			for (unsigned int bit = 0; bit < 8; bit++)
+				crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+			entry[0][i] = crc;
+		}
+		for (unsigned int k = 1; k < 8; k++)
+			for (unsigned int i = 0; i < 256; i++)
+				entry[k][i] = (entry[k-1][i] >> 8) ^ entry[0][entry[k-1][i] & 0xFF];
+	}
+};
+
+
+static uint32_t slice8_update(uint32_t crc, const unsigned char* p, size_t length)
+{
+	static const Crc32cTable table;  // Thread safe initialisation on first use
+	const uint32_t (*t)[256] = table.entry;
+
+	while (length > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0)
+	{
+		crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		length--;
+	}
+	while (length >= 8)
+	{
+		uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24);
+		uint32_t hi =       (p[4] | p[5] << 8 | p[6] << 16 | static_cast<uint32_t>(p[7]) << 24);
+		crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+		      t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+		p      += 8;
+		length -= 8;
+	}
+	while (length > 0)
+	{
+		crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		length--;
+	}
+	return crc;
+}
+
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t sse42_update(uint32_t crc, const unsigned char* p, size_t length)
+{
+	while (length > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0)
+	{
+		crc = _mm_crc32_u8(crc, *p++);
+		length--;
+	}
+	uint64_t crc64 = crc;
+	while (length >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		crc64   = _mm_crc32_u64(crc64, word);
+		p      += 8;
+		length -= 8;
+	}
+	crc = static_cast<uint32_t>(crc64);
+	while (length > 0)
+	{
+		crc = _mm_crc32_u8(crc, *p++);
+		length--;
+	}
+	return crc;
+}
+#endif
+
+
+// Extend crc, starting from 0, over another length bytes of buf.
+uint32_t Checksum::crc32c(uint32_t crc, const void* buf, size_t length)
+{
+	if (crc32c_accelerated())
+		return crc32c_sse42(crc, buf, length);
+	return crc32c_slice8(crc, buf, length);
+}
+
+
+uint32_t Checksum::crc32c_slice8(uint32_t crc, const void* buf, size_t length)
+{
+	return ~slice8_update(~crc, static_cast<const unsigned char*>(buf), length);
+}
+
+
+// Only call when crc32c_accelerated() reports the CPU has the SSE4.2 CRC32 instruction.
+uint32_t Checksum::crc32c_sse42(uint32_t crc, const void* buf, size_t length)
+{
+#ifdef HAVE_CRC32C_SSE42
+	return ~sse42_update(~crc, static_cast<const unsigned char*>(buf), length);
+#else
+	return crc32c_slice8(crc, buf, length);
+#endif
+}
+
+
+bool Checksum::crc32c_accelerated()
+{
+#ifdef HAVE_CRC32C_SSE42
+	static const bool sse42 = __builtin_cpu_supports("sse4.2");
+	return sse42;
+#else
+	return false;
+#endif
+}
+
+
+}  // namespace GParted
@@ -0,0 +1,468 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../config.h"
+#include "CommandRunner.h"
+#include "PipeCapture.h"
+#include "Utils.h"
+
+#include <glibmm/shell.h>
+#include <glibmm/stringutils.h>
+#include <glibmm/thread.h>
+#include <glibmm/ustring.h>
+#include <sigc++/bind.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+extern char** environ;
+
+
+namespace GParted
+{
+
+
+namespace  // unnamed
+{
+
+
+// How often to check for the child exiting when pidfd_open(2) isn't available.
+static const int CHILD_POLL_INTERVAL = 50;  // Milliseconds
+
+// How long a timed out command is given to exit after SIGTERM, and then after SIGKILL
+// before it is abandoned.
+static const std::chrono::seconds TERM_GRACE_PERIOD(5);
+static const std::chrono::seconds KILL_GRACE_PERIOD(5);
+
+
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	int fd = syscall(SYS_pidfd_open, pid, 0);
+	if (fd >= 0)
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+#else
+	return -1;
+#endif
+}
+
+
+#ifndef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+// Close all inherited file descriptors in the child so that it only gets stdin, stdout
+// and stderr, as Glib::spawn_async_with_pipes() did.  LVM commands complain about leaked
+// file descriptors.  Closing is added to the spawn file actions so that only the child is
+// affected, rather than changing the flags of descriptors other threads are using.
+static void add_close_from(posix_spawn_file_actions_t& actions, int lowfd)
+{
+	DIR* dir = opendir("/proc/self/fd");
+	if (dir == nullptr)
+		return;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != nullptr)
+	{
+		int fd = atoi(entry->d_name);
+		if (fd >= lowfd && fd != dirfd(dir))
+			posix_spawn_file_actions_addclose(&actions, fd);
+	}
+	closedir(dir);
+}
+#endif
+
+
+// Reap an abandoned child whenever it finally exits.  A process stuck in uninterruptible
+// sleep waiting for a failing disk doesn't even respond to SIGKILL until the I/O
+// completes.
+static void reap_abandoned_child(pid_t pid)
+{
+	while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+		;
+}
+
+
+// Copy of the environment with LC_ALL=C.
+static std::vector<std::string> C_locale_environment()
+{
+	std::vector<std::string> env;
+	for (char** e = environ; *e != nullptr; e++)
+		if (strncmp(*e, "LC_ALL=", 7) != 0)
+			env.push_back(*e);
+	env.push_back("LC_ALL=C");
+	return env;
+}
+
+
+}  // unnamed namespace
+
+
+CommandRunner::CommandRunner(const Glib::ustring& command, Glib::ustring& output, Glib::ustring& error)
+ : m_command(command), m_output(output), m_error(error)
+{
+}
+
+
+CommandRunner::~CommandRunner()
+{
+	// Don't leave a zombie when wait() wasn't called.
+	if (m_pid > 0 && ! m_reaped)
+		reap(true);
+	if (m_pidfd >= 0)
+		close(m_pidfd);
+	if (m_out >= 0)
+		close(m_out);
+	if (m_err >= 0)
+		close(m_err);
+}
+
+
+// Start the command in a new process group, writing a small amount of input to its stdin
+// when not NULL.  Returns false when the command couldn't be started, with the reason
+// reported by get_start_error() and a shell style exit status from get_exit_status().
+bool CommandRunner::start(const char* input, bool use_C_locale)
+{
+	std::vector<std::string> argv;
+	try
+	{
+		argv = Glib::shell_parse_argv(m_command);
+	}
+	catch (Glib::ShellError& e)
+	{
+		m_start_error = e.what();
+		m_exit_status = Utils::get_failure_status(EINVAL);
+		return false;
+	}
+	if (argv.empty())
+	{
+		m_start_error = "Empty command";
+		m_exit_status = Utils::get_failure_status(EINVAL);
+		return false;
+	}
+
+	int in_pipe[2]  = {-1, -1};
+	int out_pipe[2] = {-1, -1};
+	int err_pipe[2] = {-1, -1};
+	if ((input != nullptr && pipe2(in_pipe, O_CLOEXEC) != 0) ||
+	    pipe2(out_pipe, O_CLOEXEC) != 0                      ||
+	    pipe2(err_pipe, O_CLOEXEC) != 0                        )
+	{
+		int e = errno;
+		m_start_error = "Failed to create pipes for child process (" + Glib::strerror(e) + ")";
+		m_exit_status = Utils::get_failure_status(e);
+		for (int fd : {in_pipe[0], in_pipe[1], out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1]})
+			if (fd >= 0)
+				close(fd);
+		return false;
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (input != nullptr)
+		posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+	else
+		posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+	posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+	posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#else
+	add_close_from(actions, STDERR_FILENO + 1);
+#endif
+
+	// New process group so that cancelling also interrupts any grandchildren, and
+	// default signal handling as worker threads may block signals.
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	sigset_t sigs;
+	sigemptyset(&sigs);
+	posix_spawnattr_setsigmask(&attr, &sigs);
+	sigaddset(&sigs, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &sigs);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+	std::vector<char*> c_argv;
+	for (unsigned int i = 0; i < argv.size(); i++)
+		c_argv.push_back(const_cast<char*>(argv[i].c_str()));
+	c_argv.push_back(nullptr);
+
+	std::vector<std::string> env;
+	std::vector<char*> c_envp;
+	char** envp = environ;
+	if (use_C_locale)
+	{
+		env = C_locale_environment();
+		for (unsigned int i = 0; i < env.size(); i++)
+			c_envp.push_back(const_cast<char*>(env[i].c_str()));
+		c_envp.push_back(nullptr);
+		envp = c_envp.data();
+	}
+
+	pid_t pid;
+	int rc = posix_spawnp(&pid, c_argv[0], &actions, &attr, c_argv.data(), envp);
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	close(out_pipe[1]);
+	close(err_pipe[1]);
+	if (input != nullptr)
+		close(in_pipe[0]);
+	if (rc != 0)
+	{
+		m_start_error = "Failed to execute child process \"" + Glib::ustring(argv[0]) + "\" (" +
+		                Glib::strerror(rc) + ")";
+		m_exit_status = Utils::get_failure_status(rc);
+		close(out_pipe[0]);
+		close(err_pipe[0]);
+		if (input != nullptr)
+			close(in_pipe[1]);
+		return false;
+	}
+
+	m_mutex.lock();
+	m_pid = pid;
+	m_mutex.unlock();
+	m_pidfd = open_pidfd(pid);
+	m_out = out_pipe[0];
+	m_err = err_pipe[0];
+	fcntl(m_out, F_SETFL, O_NONBLOCK);
+	fcntl(m_err, F_SETFL, O_NONBLOCK);
+	m_output_capture.reset(new PipeCapture(m_out, m_output));
+	m_error_capture.reset(new PipeCapture(m_err, m_error));
+
+	if (input != nullptr)
+	{
+		// Write small amount of input to pipe to the child process.  Linux will
+		// always accept up to 4096 bytes without blocking.  See pipe(7).
+		size_t len = strlen(input);
+		ssize_t written = write(in_pipe[1], input, len);
+		if (written == -1 || (size_t)written < len)
+		{
+			m_input_error = "Write to child failed: " + Glib::strerror(errno);
+			std::cerr << m_input_error << std::endl;
+		}
+		close(in_pipe[1]);
+	}
+
+	return true;
+}
+
+
+// Run slot every interval_ms while waiting, until it returns false.  Add before wait().
+void CommandRunner::add_timer(unsigned int interval_ms, const sigc::slot<bool>& slot)
+{
+	Timer timer;
+	timer.interval = std::chrono::milliseconds(interval_ms);
+	timer.next     = Clock::now() + timer.interval;
+	timer.slot     = slot;
+	m_timers.push_back(timer);
+}
+
+
+// Give the command seconds to finish once wait() is called.  After that it is sent
+// SIGTERM, then SIGKILL, and then abandoned with timed_out() reporting true.  Set before
+// wait().
+void CommandRunner::set_timeout(unsigned int seconds)
+{
+	m_timeout = std::chrono::seconds(seconds);
+}
+
+
+// Capture stdout and stderr until both reach EOF and the command has exited.  Returns the
+// exit status of the command, or 124 like timeout(1) when it timed out.
+int CommandRunner::wait()
+{
+	bool out_open = true;
+	bool err_open = true;
+	int  signals_sent = 0;  // Number of SIGTERM, SIGKILL escalations after the deadline
+	Clock::time_point deadline = Clock::now() + m_timeout;
+	while (out_open || err_open || ! m_reaped)
+	{
+		if (m_timeout.count() > 0 && Clock::now() >= deadline)
+		{
+			m_timed_out = true;
+			if (signals_sent == 0)
+			{
+				send_signal(SIGTERM);
+				deadline += TERM_GRACE_PERIOD;
+			}
+			else if (signals_sent == 1)
+			{
+				send_signal(SIGKILL);
+				deadline += KILL_GRACE_PERIOD;
+			}
+			else
+			{
+				abandon();
+				break;
+			}
+			signals_sent++;
+		}
+
+		struct pollfd fds[3];
+		nfds_t nfds = 0;
+		int out_index = -1;
+		int err_index = -1;
+		int pid_index = -1;
+		if (out_open)
+		{
+			fds[nfds] = {m_out, POLLIN, 0};
+			out_index = nfds++;
+		}
+		if (err_open)
+		{
+			fds[nfds] = {m_err, POLLIN, 0};
+			err_index = nfds++;
+		}
+		if (! m_reaped && m_pidfd >= 0)
+		{
+			fds[nfds] = {m_pidfd, POLLIN, 0};
+			pid_index = nfds++;
+		}
+
+		int timeout = -1;
+		if (! m_reaped && m_pidfd < 0)
+			timeout = CHILD_POLL_INTERVAL;
+		Clock::time_point now = Clock::now();
+		for (unsigned int i = 0; i < m_timers.size(); i++)
+		{
+			long long until = std::chrono::duration_cast<std::chrono::milliseconds>(
+			                          m_timers[i].next - now).count();
+			if (until < 0)
+				until = 0;
+			if (timeout < 0 || until < timeout)
+				timeout = until;
+		}
+		if (m_timeout.count() > 0)
+		{
+			long long until = std::chrono::duration_cast<std::chrono::milliseconds>(
+			                          deadline - now).count() + 1;
+			if (until < 0)
+				until = 0;
+			if (timeout < 0 || until < timeout)
+				timeout = until;
+		}
+
+		if (poll(fds, nfds, timeout) < 0)
+		{
+			if (errno != EINTR)
+			{
+				std::cerr << "Poll of child process failed: " << Glib::strerror(errno) << std::endl;
+				usleep(CHILD_POLL_INTERVAL * 1000);
+			}
+			continue;
+		}
+
+		if (out_index >= 0 && fds[out_index].revents)
+			out_open = m_output_capture->OnReadable();
+		if (err_index >= 0 && fds[err_index].revents)
+			err_open = m_error_capture->OnReadable();
+		if (! m_reaped && (pid_index < 0 || fds[pid_index].revents))
+			reap(false);
+
+		now = Clock::now();
+		for (unsigned int i = 0; i < m_timers.size(); )
+		{
+			if (now < m_timers[i].next)
+			{
+				i++;
+			}
+			else if (m_timers[i].slot())
+			{
+				// Don't try to catch up when a slot took longer than its interval.
+				m_timers[i].next += m_timers[i].interval;
+				if (m_timers[i].next <= now)
+					m_timers[i].next = now + m_timers[i].interval;
+				i++;
+			}
+			else
+			{
+				m_timers.erase(m_timers.begin() + i);
+			}
+		}
+	}
+
+	if (m_timed_out)
+		m_exit_status = 124;
+	return m_exit_status;
+}
+
+
+// Send signal to the process group of the command.  Safe to call from any thread.
+void CommandRunner::send_signal(int sig)
+{
+	m_mutex.lock();
+	// Once reaped the process group id may have been reused.
+	if (m_pid > 0 && ! m_reaped)
+		kill(-m_pid, sig);
+	m_mutex.unlock();
+}
+
+
+// Stop waiting for a command which hasn't exited even after SIGKILL, keeping the output
+// captured so far.
+void CommandRunner::abandon()
+{
+	m_output_capture->flush();
+	m_error_capture->flush();
+
+	m_mutex.lock();
+	m_reaped = true;
+	m_mutex.unlock();
+	std::cerr << "Abandoned command which did not exit after being killed: " << m_command << std::endl;
+	Glib::Thread::create(sigc::bind(sigc::ptr_fun(&reap_abandoned_child), m_pid), false);
+}
+
+
+// Collect the exit status of the command once it has exited.  Returns false when still
+// running.
+bool CommandRunner::reap(bool block)
+{
+	int wait_status;
+	pid_t rc;
+	// Hold the mutex while reaping so that send_signal() never signals a process group
+	// id which has just been freed for reuse.  Only the destructor blocks.
+	if (! block)
+		m_mutex.lock();
+	do
+		rc = waitpid(m_pid, &wait_status, block ? 0 : WNOHANG);
+	while (rc < 0 && errno == EINTR);
+	if (rc != 0)
+		m_reaped = true;
+	if (! block)
+		m_mutex.unlock();
+	if (rc == 0)
+		return false;  // Still running
+
+	if (rc == m_pid)
+		m_exit_status = Utils::decode_wait_status(wait_status);
+	return true;
+}
+
+
+}  // namespace GParted
@@ -17,8 +17,13 @@
  */
 
 #include "CopyBlocks.h"
+#include "AllocationMap.h"
+#include "Checksum.h"
+#include "GParted_Core.h"
+#include "MoveJournal.h"
 #include "OperationDetail.h"
 #include "Utils.h"
+#include "../config.h"
 
 #include <glibmm/ustring.h>
 #include <glibmm/thread.h>
@@ -26,12 +31,54 @@
 #include <gtkmm/main.h>
 #include <sigc++/signal.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <sys/sysmacros.h>
 
 
 namespace GParted
 {
 
 
+// Number of buffers in the ring between the reader and writer stages.  Allows the
+// source to be read while the previous blocks are still being written.
+static const unsigned int COPY_QUEUE_DEPTH = 4;
+
+// Bounds and parameters for runtime tuning of the block size and queue depth.
+static const Byte_Value   TUNE_MIN_BLOCKSIZE = 512 * KIBIBYTE;
+static const Byte_Value   TUNE_MAX_BLOCKSIZE = 16 * MEBIBYTE;
+static const unsigned int TUNE_MIN_DEPTH     = 2;
+static const unsigned int TUNE_MAX_DEPTH     = 8;
+static const Byte_Value   TUNE_MAX_MEMORY    = 64 * MEBIBYTE;  // Block size x queue depth
+static const double       TUNE_WINDOW        = 5.0;   // Seconds per throughput measurement
+static const double       TUNE_MIN_GAIN      = 0.05;  // Smaller changes are treated as noise
+static const unsigned int TUNE_MAX_BACKOFF   = 32;    // Most windows between steps
+
+// Amount of copied data read back and checked at a time when verifying.  Limits the
+// checksums held in memory and how often the destination is flushed.
+static const Byte_Value   VERIFY_BATCH_SIZE  = 256 * MEBIBYTE;
+
+// Most destination ranges which differ from the source to list individually.
+static const unsigned int VERIFY_MAX_REPORTED = 10;
+
+// Granularity at which blocks are checked for zeros.  Runs of whole zero chunks are
+// zeroed on the destination with BLKZEROOUT instead of being written.
+static const Byte_Value   ZERO_CHUNK_SIZE    = 64 * KIBIBYTE;
+
+// Amount passed to each copy_file_range() call.  Bounds the time between progress
+// updates and cancellation checks.
+static const Byte_Value   OFFLOAD_CHUNK_SIZE = 64 * MEBIBYTE;
+
+
 void CopyBlocks::set_cancel( bool force )
 {
 	if ( force || cancel_safe )
@@ -43,22 +90,32 @@ CopyBlocks::CopyBlocks( const Glib::ustring & in_src_device,
                         Sector src_start,
                         Sector dst_start,
                         Byte_Value in_length,
+                        const ExtentVector & in_extents,
                         Byte_Value in_blocksize,
                         OperationDetail & in_operationdetail,
                         Byte_Value & in_total_done,
                         Byte_Value in_total_length,
-                        bool in_cancel_safe) :
+                        bool in_cancel_safe,
+                        bool in_tune,
+                        bool in_verify,
+                        MoveJournal * in_journal ) :
 	src_device( in_src_device ),
 	dst_device ( in_dst_device ),
 	length ( in_length ),
+	extents ( in_extents ),
 	blocksize ( in_blocksize ),
 	operationdetail ( in_operationdetail ),
 	total_done ( in_total_done ),
 	total_length ( in_total_length ),
 	offset_src ( src_start ),
 	offset_dst ( dst_start ),
-	cancel_safe ( in_cancel_safe )
+	cancel_safe ( in_cancel_safe ),
+	journal ( in_journal ),
+	tune_enabled ( in_tune ),
+	verify_enabled ( in_verify )
 {
+	if (journal != nullptr)
+		checkpoint_interval = journal->get_checkpoint_interval();
 	operationdetail.signal_cancel.connect(
 		sigc::mem_fun(*this, &CopyBlocks::set_cancel));
 	if (operationdetail.m_cancelflag)
@@ -71,11 +128,26 @@ bool CopyBlocks::set_progress_info()
 	Byte_Value done = llabs(this->done);
 	operationdetail.run_progressbar( (double)(total_done+done), (double)total_length, PROGRESSBAR_TEXT_COPY_BYTES );
 	OperationDetail &operationdetail = this->operationdetail.get_last_child().get_last_child();
-	operationdetail.set_description(
-		Glib::ustring::compose( /*TO TRANSLATORS: looks like  1.00 MiB of 16.00 MiB copied */
-				_("%1 of %2 copied"),
-				Utils::format_size( done, 1 ), Utils::format_size( length, 1 ) ),
-		FONT_ITALIC );
+	if (verify_enabled)
+		operationdetail.set_description(
+			Glib::ustring::compose( /*TO TRANSLATORS: looks like  1.00 MiB of 16.00 MiB copied, 512.00 KiB verified */
+					_("%1 of %2 copied, %3 verified"),
+					Utils::format_size( done, 1 ), Utils::format_size( length, 1 ),
+					Utils::format_size( verified, 1 ) ),
+			FONT_ITALIC );
+	else
+		operationdetail.set_description(
+			Glib::ustring::compose( /*TO TRANSLATORS: looks like  1.00 MiB of 16.00 MiB copied */
+					_("%1 of %2 copied"),
+					Utils::format_size( done, 1 ), Utils::format_size( length, 1 ) ),
+			FONT_ITALIC );
+
+	ring_mutex.lock();
+	std::vector<Glib::ustring> decisions;
+	decisions.swap(tuning_log);
+	ring_mutex.unlock();
+	for (unsigned int i = 0; i < decisions.size(); i++)
+		operationdetail.add_child(OperationDetail(decisions[i], STATUS_NONE, FONT_ITALIC));
 	return false;
 }
 
@@ -87,6 +159,13 @@ static bool mainquit( CopyBlocks *cb )
 	return false;
 }
 
+static gboolean _set_finished( gpointer data )
+{
+	CopyBlocks *cb = (CopyBlocks *)data;
+	cb->set_finished();
+	return false;
+}
+
 static gboolean _set_progress_info( gpointer data )
 {
 	CopyBlocks *cb = (CopyBlocks *)data;
@@ -95,40 +174,132 @@ static gboolean _set_progress_info( gpointer data )
 
 void CopyBlocks::copy_thread()
 {
-	if ( ped_device_open( lp_device_src ) &&
-	     (lp_device_src == lp_device_dst || ped_device_open( lp_device_dst ) ) )
-	{
-		Byte_Value src_sector_size = lp_device_src ->sector_size;
-		Byte_Value dst_sector_size = lp_device_dst ->sector_size;
+	GParted_Core::redirect_libparted_messages(libparted_messages);
 
+	if ( success )
+	{
 		//Handle situation where we need to perform the copy beginning
 		//  with the end of the partition and finishing with the start.
 		if ( offset_src < offset_dst )
-		{
 			blocksize -= 2*blocksize;
-			done -= 2*done;
-			offset_src += length / src_sector_size;
-			/* Handle situation where src sector size is smaller than dst sector size and an additional partial dst sector is required. */
-			offset_dst += (length + (dst_sector_size - 1)) / dst_sector_size;
+
+		success = alloc_ring();
+		if (success)
+		{
+			open_direct_io();
+			open_zeroout();
+		}
+		if (success && verify_enabled)
+		{
+			// Read back with direct I/O when copying that way, otherwise through the
+			// page cache with the written data dropped first.
+			int flags = O_RDONLY | O_CLOEXEC;
+#ifdef ENABLE_DIRECT_IO
+			if (direct_io)
+				flags |= O_DIRECT;
+#endif
+			fd_verify = open(dst_device.c_str(), flags);
+			if (fd_verify < 0)
+			{
+				error_message = Glib::ustring::compose(_("Failed to open %1 to verify the copy"),
+				                                       dst_device);
+				success = false;
+			}
 		}
-		success = true;
 	} else success = false;
 
 	ped_device_sync( lp_device_dst );
 
-	if ( success && done != 0 )
+	// Verifying needs the data to pass through the reader so only use in kernel
+	// copying when not verifying.
+	if (success && ! verify_enabled && open_offload())
 	{
-		Byte_Value b = blocksize;
-		blocksize = done;
-		done = 0;
-		/* copy partial block first */
-		copy_block();
-		blocksize = b;
+		if (lp_device_src != lp_device_dst)
+			ped_device_sync(lp_device_src);
+		offloaded = offload_copy();
+		close_offload();
 	}
+
+	Glib::Thread* reader = nullptr;
+	if (success && ! offloaded)
+		reader = Glib::Thread::create(sigc::mem_fun(*this, &CopyBlocks::read_thread), true);
+
+	// Writer stage.  Write each block in the order read, stopping at the first
+	// failure so that done always describes a contiguous copied range.
 	Glib::Timer timer_progress_timeout;
-	while( success && llabs( done ) < length )
+	Glib::Timer timer_window;
+	Byte_Value  window_bytes = 0;
+	while (reader != nullptr)
 	{
-		copy_block();
+		ring_mutex.lock();
+		while (ring_count == 0 && ! reader_done)
+			ring_cond.wait(ring_mutex);
+		if (ring_count == 0)
+		{
+			ring_mutex.unlock();
+			break;
+		}
+		Block& block = ring[ring_tail];
+		ring_mutex.unlock();
+
+		if ( cancel )
+		{
+			error_message = _("Operation Canceled");
+			success = false;
+			break;
+		}
+		if (! block.read_ok && block.buf == nullptr)
+		{
+			error_message = Glib::ustring::compose(_("Failed to allocate %1 copy buffer"),
+			                                       Utils::format_size(block.bufsize, 1));
+			success = false;
+			break;
+		}
+		if (! block.read_ok)
+		{
+			error_message = Glib::ustring::compose( _("Error while reading block at sector %1"), block.offset_src );
+			success = false;
+			break;
+		}
+		if (block.num_dst > 0 && ! checkpoint_before(block.skipped, block.length))
+		{
+			success = false;
+			break;
+		}
+		if (block.num_dst > 0 && ! write_block(block))
+		{
+			error_message = Glib::ustring::compose( _("Error while writing block at sector %1"), block.offset_dst );
+			success = false;
+			break;
+		}
+		done += block.skipped + block.length;
+		window_bytes += llabs(block.length);
+		if (verify_enabled && block.num_dst > 0)
+		{
+			WrittenBlock wb = {block.offset_dst, block.num_dst, llabs(block.length), block.crc};
+			written.push_back(wb);
+			written_bytes += wb.length;
+		}
+
+		ring_mutex.lock();
+		ring_tail = (ring_tail + 1) % ring_depth;
+		ring_count--;
+		ring_cond.signal();
+		ring_mutex.unlock();
+
+		if (tune_enabled && timer_window.elapsed() >= TUNE_WINDOW)
+		{
+			tune(window_bytes / timer_window.elapsed());
+			window_bytes = 0;
+			timer_window.reset();
+		}
+
+		if (written_bytes >= VERIFY_BATCH_SIZE && ! verify_written())
+		{
+			success = false;
+			break;
+		}
+
 		if ( timer_progress_timeout .elapsed() >= 0.5 )
 		{
 			// Cross thread registration of callback (this copy_thread() is
@@ -140,112 +311,940 @@ void CopyBlocks::copy_thread()
 		}
 	}
 
-	//close and destroy the devices..
-	ped_device_close( lp_device_src );
-	ped_device_destroy( lp_device_src );
+	if (reader != nullptr)
+	{
+		ring_mutex.lock();
+		stop_reader = true;
+		ring_cond.signal();
+		ring_mutex.unlock();
+		reader->join();
+	}
 
-	if ( src_device != dst_device )
+	// Record the final progress so that the next copy of the move starts from here.
+	if (success && journal != nullptr)
+		success = checkpoint(done);
+
+	if (success && verify_enabled)
+		success = verify_written();
+	if (success && mismatches.size() > 0)
 	{
-		ped_device_close( lp_device_dst );
-		ped_device_destroy( lp_device_dst );
+		error_message = _("Copied data differs from the source");
+		success = false;
+	}
+	if (fd_verify >= 0)
+	{
+		close(fd_verify);
+		fd_verify = -1;
 	}
 
+	close_zeroout();
+	close_direct_io();
+
 	// Cross thread registration of callbacks.  Must use thread-safe C/Glib
 	// g_idle_add().
 	//
 	//set progress bar current info on completion
 	g_idle_add( _set_progress_info, this );
-	g_idle_add( (GSourceFunc)mainquit, this );
+	if ( foreground )
+		g_idle_add( (GSourceFunc)mainquit, this );
+	else
+		// Queued after all the progress updates so that they have been done
+		// before copy() continues.
+		g_idle_add( _set_finished, this );
 }
 
-bool CopyBlocks::copy()
+
+void CopyBlocks::set_finished()
 {
-	if ( blocksize > length )
-		blocksize = length;
+	finished_mutex.lock();
+	finished = true;
+	finished_cond.signal();
+	finished_mutex.unlock();
+}
 
-	operationdetail.run_progressbar( (double)total_done, (double)total_length, PROGRESSBAR_TEXT_COPY_BYTES );
 
-	done = length % blocksize;
+// Reader stage.  Reads blocks ahead of the writer into free ring slots.  Reading ahead
+// is safe for overlapping moves because the copy direction is chosen so that each write
+// only lands on source sectors which have already been read.
+void CopyBlocks::read_thread()
+{
+	GParted_Core::redirect_libparted_messages(libparted_messages);
 
-	lp_device_src = ped_device_get( src_device.c_str() );
-	lp_device_dst = src_device != dst_device ? ped_device_get( dst_device.c_str() ) : lp_device_src;
-	//add an empty sub which we will constantly update in the loop
-	operationdetail.get_last_child().add_child( OperationDetail( "", STATUS_NONE ) );
+	// Split each extent into blocks at multiples of the current block size from its
+	// start, keeping every block aligned whichever direction the extents are copied in
+	// and however the block size is tuned.
+	bool       backwards = blocksize < 0;
+	Byte_Value position  = backwards ? length : 0;  // Edge of the span read so far
+	bool       more      = true;
+	for (unsigned int i = 0; more && i < extents.size(); i++)
+	{
+		const Extent& extent = backwards ? extents[extents.size() - 1 - i] : extents[i];
+		Byte_Value extent_end = extent.offset + extent.length;
+		Byte_Value cursor     = backwards ? extent_end : extent.offset;
+		while (more && cursor != (backwards ? extent.offset : extent_end))
+		{
+			ring_mutex.lock();
+			Byte_Value abs_blocksize = tuned_blocksize;
+			ring_mutex.unlock();
+			// A block must not overwrite its own source when it can be resumed.
+			if (journal != nullptr)
+				abs_blocksize = std::min(abs_blocksize, checkpoint_interval);
 
-	buf.resize(llabs(blocksize));
+			Byte_Value start;
+			Byte_Value end;
+			if (backwards)
+			{
+				start = extent.offset + Utils::floor_size(cursor - extent.offset - 1, abs_blocksize);
+				end   = cursor;
+			}
+			else
+			{
+				start = cursor;
+				end   = std::min(cursor + abs_blocksize, extent_end);
+			}
+			more = queue_block(start, end - start, backwards ? position - end : start - position,
+			                   abs_blocksize);
+			position = cursor = backwards ? start : end;
+		}
+	}
+	// Account for any unallocated space after the last extent.
+	if (more && position != (backwards ? 0 : length))
+		queue_block(position, 0, backwards ? position : length - position, 0);
 
-	Glib::Thread::create(sigc::mem_fun(*this, &CopyBlocks::copy_thread), false);
-	Gtk::Main::run();
+	ring_mutex.lock();
+	reader_done = true;
+	ring_cond.signal();
+	ring_mutex.unlock();
+}
 
-	total_done += llabs(done);
 
-	if (done == length || ! success)
+// Read count bytes from start, relative to the start of the copy, into the next free
+// ring slot and pass it to the writer.  Returns false when the reader should stop.
+bool CopyBlocks::queue_block(Byte_Value start, Byte_Value count, Byte_Value skipped, Byte_Value abs_blocksize)
+{
+	ring_mutex.lock();
+	// A change of queue depth is applied once the writer has emptied the ring.
+	while ((ring_count >= ring_depth || (tuned_depth != ring_depth && ring_count > 0)) &&
+	       ! stop_reader                                                                  )
+		ring_cond.wait(ring_mutex);
+	if (stop_reader)
 	{
-		//final description
-		operationdetail.get_last_child().get_last_child().set_description(
-				Glib::ustring::compose( /*TO TRANSLATORS: looks like  1.00 MiB of 16.00 MiB copied */
-						  _("%1 of %2 copied"),
-						  Utils::format_size( llabs( done ), 1 ),
-						  Utils::format_size( length, 1 ) ),
-				FONT_ITALIC );
+		ring_mutex.unlock();
+		return false;
+	}
+	if (tuned_depth != ring_depth)
+	{
+		// The reader owns every slot now.  Release all the buffers so that memory
+		// use follows the new queue depth.
+		ring_depth = tuned_depth;
+		ring_head  = 0;
+		ring_tail  = 0;
+		for (unsigned int i = 0; i < ring.size(); i++)
+		{
+			ring[i].buf.reset();
+			ring[i].bufsize = 0;
+		}
+	}
+	Block& block = ring[ring_head];
+	ring_mutex.unlock();
 
-		if (! success && ! error_message.empty())
-			operationdetail.get_last_child().get_last_child().add_child(
-					OperationDetail( error_message, STATUS_NONE, FONT_ITALIC ) );
+	//Handle case where src and dst sector sizes are different.
+	//    E.g.,  5 sectors x 512 bytes/sector = ??? 2048 byte sectors
+	Byte_Value sector_size_src = lp_device_src ->sector_size;
+	Byte_Value sector_size_dst = lp_device_dst ->sector_size;
+	Byte_Value sign            = (blocksize < 0) ? -1 : 1;
+	block.length     = sign * count;
+	block.skipped    = sign * skipped;
+	block.offset_src = offset_src + start / sector_size_src;
+	block.offset_dst = offset_dst + start / sector_size_dst;
+	block.num_src    = (count + (sector_size_src - 1)) / sector_size_src;
+	block.num_dst    = (count + (sector_size_dst - 1)) / sector_size_dst;
+	block.read_ok    = ! cancel                                         &&
+	                   (count == 0 || alloc_block(block, abs_blocksize)) &&
+	                   read_block(block);
+	if (block.read_ok && verify_enabled && count > 0)
+	{
+		Glib::Timer timer;
+		block.crc = Checksum::crc32c(0, block.buf.get(), count);
+		hash_seconds_src += timer.elapsed();
+		hash_bytes_src   += count;
 	}
 
-	if ( total_done == total_length || ! success )
-		operationdetail.stop_progressbar();
+	ring_mutex.lock();
+	ring_head = (ring_head + 1) % ring_depth;
+	ring_count++;
+	ring_cond.signal();
+	ring_mutex.unlock();
 
-	return success;
+	return block.read_ok;
 }
 
-void CopyBlocks::copy_block()
+
+bool CopyBlocks::alloc_ring()
 {
-	Byte_Value sector_size_src = lp_device_src ->sector_size;
-	Byte_Value sector_size_dst = lp_device_dst ->sector_size;
+	ring.resize(tune_enabled ? TUNE_MAX_DEPTH : COPY_QUEUE_DEPTH);
+	ring_depth      = COPY_QUEUE_DEPTH;
+	tuned_depth     = ring_depth;
+	tuned_blocksize = llabs(blocksize);
+	for (unsigned int i = 0; i < ring_depth; i++)
+	{
+		if (! alloc_block(ring[i], tuned_blocksize))
+		{
+			error_message = Glib::ustring::compose(_("Failed to allocate %1 copy buffer"),
+			                                       Utils::format_size(ring[i].bufsize, 1));
+			return false;
+		}
+	}
+	return true;
+}
 
-	//Handle case where src and dst sector sizes are different.
-	//    E.g.,  5 sectors x 512 bytes/sector = ??? 2048 byte sectors
-	Sector num_blocks_src = (llabs(blocksize) + (sector_size_src - 1) ) / sector_size_src;
-	Sector num_blocks_dst = (llabs(blocksize) + (sector_size_dst - 1) ) / sector_size_dst;
 
-	//Handle situation where we are performing copy operation beginning
-	//  with the end of the partition and finishing with the start.
-	if ( blocksize < 0 )
+// Ensure the block's buffer holds at least abs_blocksize bytes, in whole sectors of both
+// devices.  Buffers are grown as the block size is tuned upwards.
+bool CopyBlocks::alloc_block(Block& block, Byte_Value abs_blocksize)
+{
+	Byte_Value bufsize = std::max(Utils::ceil_size(abs_blocksize, lp_device_src->sector_size),
+	                              Utils::ceil_size(abs_blocksize, lp_device_dst->sector_size));
+	if (block.buf != nullptr && block.bufsize >= bufsize)
+		return true;
+
+	void* p = nullptr;
+	block.buf.reset();
+	block.bufsize = bufsize;
+	if (posix_memalign(&p, sysconf(_SC_PAGESIZE), bufsize) != 0)
+		return false;
+	block.buf.reset(static_cast<char*>(p));
+	return true;
+}
+
+
+static bool tune_within_bounds(Byte_Value blocksize, unsigned int depth)
+{
+	return blocksize >= TUNE_MIN_BLOCKSIZE && blocksize <= TUNE_MAX_BLOCKSIZE &&
+	       depth     >= TUNE_MIN_DEPTH     && depth     <= TUNE_MAX_DEPTH     &&
+	       blocksize * depth <= TUNE_MAX_MEMORY;
+}
+
+
+// Hill climbing controller for the block size and queue depth, run by the writer after
+// each measurement window with the throughput achieved.  One setting at a time is
+// doubled or halved.  A step which improves the throughput is kept and followed by
+// another in the same direction.  Otherwise the previous settings are restored and the
+// other setting is tried next, after a wait which grows while steps keep failing.  This
+// keeps following changes in device and system load for the whole copy.
+void CopyBlocks::tune(double rate)
+{
+	if (tune_stepped)
+	{
+		tune_stepped = false;
+		if (rate >= tune_rate * (1.0 + TUNE_MIN_GAIN))
+		{
+			tune_rate    = rate;
+			tune_backoff = 1;
+		}
+		else
+		{
+			if (tune_depth_next)
+				tune_dir_depth = -tune_dir_depth;
+			else
+				tune_dir_size = -tune_dir_size;
+			tune_depth_next = ! tune_depth_next;
+			tune_hold       = tune_backoff;
+			tune_backoff    = std::min(tune_backoff * 2, TUNE_MAX_BACKOFF);
+
+			Glib::Mutex::Lock lock(ring_mutex);
+			tuned_blocksize = tune_prev_size;
+			tuned_depth     = tune_prev_depth;
+			tuning_log.push_back(Glib::ustring::compose(
+			        /*TO TRANSLATORS: looks like  95.20 MiB/s, returning to block size 4.00 MiB and queue depth 4 */
+			        _("%1/s, returning to block size %2 and queue depth %3"),
+			        Utils::format_size((Byte_Value)rate, 1),
+			        Utils::format_size(tuned_blocksize, 1),
+			        tuned_depth));
+			return;
+		}
+	}
+	else
 	{
-		offset_src += (blocksize / sector_size_src);
-		offset_dst += (blocksize / sector_size_dst);
+		// Measurement of the current settings.
+		tune_rate = rate;
+		if (tune_hold > 0)
+		{
+			tune_hold--;
+			return;
+		}
 	}
 
-	if ( cancel )
+	// Step the chosen setting, turning around at its bounds.
+	Byte_Value   new_blocksize = tuned_blocksize;
+	unsigned int new_depth     = tuned_depth;
+	for (unsigned int attempt = 0; attempt < 2; attempt++)
 	{
-		error_message = _("Operation Canceled");
-		success = false;
+		if (tune_depth_next)
+			new_depth = (tune_dir_depth > 0) ? tuned_depth * 2 : tuned_depth / 2;
+		else
+			new_blocksize = (tune_dir_size > 0) ? tuned_blocksize * 2 : tuned_blocksize / 2;
+		if (tune_within_bounds(new_blocksize, new_depth))
+			break;
+
+		new_blocksize = tuned_blocksize;
+		new_depth     = tuned_depth;
+		if (tune_depth_next)
+			tune_dir_depth = -tune_dir_depth;
+		else
+			tune_dir_size = -tune_dir_size;
+	}
+	if (new_blocksize == tuned_blocksize && new_depth == tuned_depth)
+	{
+		// This setting can't be changed either way.
+		tune_depth_next = ! tune_depth_next;
+		return;
+	}
+
+	tune_prev_size  = tuned_blocksize;
+	tune_prev_depth = tuned_depth;
+	tune_stepped    = true;
+
+	Glib::Mutex::Lock lock(ring_mutex);
+	tuned_blocksize = new_blocksize;
+	tuned_depth     = new_depth;
+	tuning_log.push_back(Glib::ustring::compose(
+	        /*TO TRANSLATORS: looks like  95.20 MiB/s, trying block size 8.00 MiB and queue depth 4 */
+	        _("%1/s, trying block size %2 and queue depth %3"),
+	        Utils::format_size((Byte_Value)rate, 1),
+	        Utils::format_size(new_blocksize, 1),
+	        new_depth));
+}
+
+
+static bool read_all(int fd, char* buf, Byte_Value count, Byte_Value offset)
+{
+	while (count > 0)
+	{
+		ssize_t n = pread(fd, buf, count, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf    += n;
+		count  -= n;
+		offset += n;
+	}
+	return true;
+}
+
+
+static bool write_all(int fd, const char* buf, Byte_Value count, Byte_Value offset)
+{
+	while (count > 0)
+	{
+		ssize_t n = pwrite(fd, buf, count, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf    += n;
+		count  -= n;
+		offset += n;
+	}
+	return true;
+}
+
+
+// Read back the blocks written since the last check and compare their checksums with
+// those calculated when the source was read.  The destination is flushed and the
+// written ranges dropped from the page cache first so that the data really comes back
+// from the device.  Differing ranges are recorded and the copy continues so that all
+// of them can be reported.
+bool CopyBlocks::verify_written()
+{
+	if (fd_dst >= 0)
+	{
+		fsync(fd_dst);
+	}
+	else
+	{
+		Glib::Mutex::Lock lock(io_mutex, Glib::NOT_LOCK);
+		if (lp_device_src == lp_device_dst)
+			lock.acquire();
+		ped_device_sync(lp_device_dst);
+	}
+
+	Byte_Value sector_size_dst = lp_device_dst->sector_size;
+	for (unsigned int i = 0; i < written.size(); i++)
+	{
+		const WrittenBlock& wb = written[i];
+		Byte_Value offset = wb.offset_dst * sector_size_dst;
+		Byte_Value count  = wb.num_dst * sector_size_dst;
+		if (! alloc_block(verify_block, wb.length))
+		{
+			error_message = Glib::ustring::compose(_("Failed to allocate %1 copy buffer"),
+			                                       Utils::format_size(verify_block.bufsize, 1));
+			return false;
+		}
+		posix_fadvise(fd_verify, offset, count, POSIX_FADV_DONTNEED);
+		if (! read_all(fd_verify, verify_block.buf.get(), count, offset))
+		{
+			error_message = Glib::ustring::compose(_("Error while reading block at sector %1"),
+			                                       wb.offset_dst);
+			return false;
+		}
+
+		Glib::Timer timer;
+		uint32_t crc = Checksum::crc32c(0, verify_block.buf.get(), wb.length);
+		hash_seconds_dst += timer.elapsed();
+
+		if (crc != wb.crc)
+		{
+			// Merge with the previous range when adjacent, in either copy direction.
+			if (mismatches.size() > 0 && mismatches.back().start + mismatches.back().num == wb.offset_dst)
+			{
+				mismatches.back().num += wb.num_dst;
+			}
+			else if (mismatches.size() > 0 && wb.offset_dst + wb.num_dst == mismatches.back().start)
+			{
+				mismatches.back().start = wb.offset_dst;
+				mismatches.back().num  += wb.num_dst;
+			}
+			else
+			{
+				Mismatch m = {wb.offset_dst, wb.num_dst};
+				mismatches.push_back(m);
+			}
+		}
+		verified += wb.length;
+	}
+
+	written.clear();
+	written_bytes = 0;
+	return true;
+}
+
+
+bool CopyBlocks::read_block(Block& block)
+{
+	if (block.num_src == 0)
+		return true;
+	if (fd_src >= 0)
+		return read_all(fd_src, block.buf.get(),
+		                block.num_src    * lp_device_src->sector_size,
+		                block.offset_src * lp_device_src->sector_size);
+
+	// libparted seeks and then reads using the single file descriptor of the
+	// PedDevice so access must be serialised when copying within one device.
+	Glib::Mutex::Lock lock(io_mutex, Glib::NOT_LOCK);
+	if (lp_device_src == lp_device_dst)
+		lock.acquire();
+	return ped_device_read(lp_device_src, block.buf.get(), block.offset_src, block.num_src);
+}
+
+
+// True when all length bytes of buf are zero.  Checks the first byte and then compares
+// the buffer with itself offset by one byte, letting the C library's vectorised memcmp()
+// do the scanning.
+static bool is_zero(const char* buf, Byte_Value length)
+{
+	return length > 0 && buf[0] == 0 && memcmp(buf, buf + 1, length - 1) == 0;
+}
+
+
+// Write a block, splitting it into runs of zero and non-zero chunks when BLKZEROOUT is
+// available.  Zero runs are then zeroed by the device without transferring any data,
+// which also lets thin provisioned storage and SSDs avoid allocating space for them.
+bool CopyBlocks::write_block(const Block& block)
+{
+	if (fd_zeroout < 0)
+		return write_sectors(block.buf.get(), block.offset_dst, block.num_dst);
+
+	Byte_Value sector_size   = lp_device_dst->sector_size;
+	Sector     chunk_sectors = std::max(1LL, ZERO_CHUNK_SIZE / sector_size);
+	Sector     run_start     = 0;
+	bool       run_zero      = false;
+	for (Sector s = 0; s < block.num_dst; s += chunk_sectors)
+	{
+		Sector num  = std::min(chunk_sectors, block.num_dst - s);
+		bool   zero = num == chunk_sectors && is_zero(block.buf.get() + s * sector_size, num * sector_size);
+		if (s > run_start && zero != run_zero)
+		{
+			if (! write_run(block, run_start, s - run_start, run_zero))
+				return false;
+			run_start = s;
+		}
+		run_zero = zero;
+	}
+	return write_run(block, run_start, block.num_dst - run_start, run_zero);
+}
+
+
+bool CopyBlocks::write_run(const Block& block, Sector start, Sector num, bool zero)
+{
+	Byte_Value sector_size = lp_device_dst->sector_size;
+#ifdef BLKZEROOUT
+	if (zero && fd_zeroout >= 0)
+	{
+		uint64_t range[2] = {(uint64_t)((block.offset_dst + start) * sector_size),
+		                     (uint64_t)(num * sector_size)};
+		if (ioctl(fd_zeroout, BLKZEROOUT, range) == 0)
+		{
+			zeroed += num * sector_size;
+			return true;
+		}
+		// Not supported by this device.  Write zeros like any other data for the
+		// rest of the copy.
+		close_zeroout();
+	}
+#endif
+	return write_sectors(block.buf.get() + start * sector_size, block.offset_dst + start, num);
+}
+
+
+bool CopyBlocks::write_sectors(const char* buf, Sector offset, Sector num)
+{
+	if (fd_dst >= 0)
+		return write_all(fd_dst, buf,
+		                 num    * lp_device_dst->sector_size,
+		                 offset * lp_device_dst->sector_size);
+
+	Glib::Mutex::Lock lock(io_mutex, Glib::NOT_LOCK);
+	if (lp_device_src == lp_device_dst)
+		lock.acquire();
+	return ped_device_write(lp_device_dst, buf, offset, num);
+}
+
+
+#ifdef ENABLE_DIRECT_IO
+// Open a block device for direct I/O.  Only accepted when the device's logical block
+// size evenly divides the sector size used for the copy, so that every offset and
+// length is suitably aligned.  Returns -1 when direct I/O can't be used.
+static int open_direct(const Glib::ustring& path, int flags, Byte_Value sector_size)
+{
+	int fd = open(path.c_str(), flags | O_DIRECT | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	struct stat st;
+	int logical_block_size = 0;
+	if (fstat(fd, &st) != 0                                 ||
+	    ! S_ISBLK(st.st_mode)                               ||
+	    ioctl(fd, BLKSSZGET, &logical_block_size) != 0      ||
+	    logical_block_size <= 0                             ||
+	    sector_size % logical_block_size != 0                 )
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+#endif
+
+
+// Switch to direct I/O when both devices allow it, otherwise leave the copy using the
+// buffered libparted path.
+void CopyBlocks::open_direct_io()
+{
+#ifdef ENABLE_DIRECT_IO
+	fd_src = open_direct(src_device, O_RDONLY, lp_device_src->sector_size);
+	if (fd_src < 0)
+		return;
+	fd_dst = open_direct(dst_device, O_WRONLY, lp_device_dst->sector_size);
+	if (fd_dst < 0)
+	{
+		close(fd_src);
+		fd_src = -1;
 		return;
 	}
+	direct_io = true;
+#endif
+}
+
+
+// Open the destination for zeroing runs of zeros with BLKZEROOUT.  Only block devices
+// support it.
+void CopyBlocks::open_zeroout()
+{
+#ifdef BLKZEROOUT
+	int fd = open(dst_device.c_str(), O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || ! S_ISBLK(st.st_mode))
+	{
+		close(fd);
+		return;
+	}
+	fd_zeroout = fd;
+#endif
+}
+
+
+void CopyBlocks::close_zeroout()
+{
+	if (fd_zeroout >= 0)
+	{
+		close(fd_zeroout);
+		fd_zeroout = -1;
+	}
+}
+
+
+#ifdef HAVE_COPY_FILE_RANGE
+// Find the file backing a loop device and the byte offset of the device within it.
+static bool get_loop_backing_file(const Glib::ustring& device, std::string& file, Byte_Value& offset)
+{
+	struct stat st;
+	if (stat(device.c_str(), &st) != 0 || ! S_ISBLK(st.st_mode))
+		return false;
+
+	Glib::ustring sysfs_dir = Glib::ustring::compose("/sys/dev/block/%1:%2/loop/",
+	                                                 major(st.st_rdev), minor(st.st_rdev));
+	std::ifstream backing_file((sysfs_dir + "backing_file").c_str());
+	std::ifstream offset_file((sysfs_dir + "offset").c_str());
+	if (! std::getline(backing_file, file) || file.empty() || ! (offset_file >> offset))
+		return false;
+	// The kernel appends " (deleted)" to the name of a backing file which has been
+	// removed and so can't be opened by name.
+	return file.find(" (deleted)") == std::string::npos;
+}
+
+
+static bool copy_range(int fd_in, Byte_Value offset_in, int fd_out, Byte_Value offset_out,
+                       Byte_Value count, int& error)
+{
+	loff_t off_in  = offset_in;
+	loff_t off_out = offset_out;
+	while (count > 0)
+	{
+		ssize_t n = copy_file_range(fd_in, &off_in, fd_out, &off_out, count, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			error = (n < 0) ? errno : EIO;
+			return false;
+		}
+		count -= n;
+	}
+	return true;
+}
+#endif
+
+
+// Open the backing files when both devices are loop devices so that the copy can be
+// done by the kernel, which can reflink on file systems which support it, rather than
+// through user space buffers.
+bool CopyBlocks::open_offload()
+{
+#ifdef HAVE_COPY_FILE_RANGE
+	std::string src_file;
+	std::string dst_file;
+	if (! get_loop_backing_file(src_device, src_file, offload_src_offset) ||
+	    ! get_loop_backing_file(dst_device, dst_file, offload_dst_offset)   )
+		return false;
+
+	fd_offload_src = open(src_file.c_str(), O_RDONLY | O_CLOEXEC);
+	fd_offload_dst = open(dst_file.c_str(), O_WRONLY | O_CLOEXEC);
+	if (fd_offload_src < 0 || fd_offload_dst < 0)
+	{
+		close_offload();
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+void CopyBlocks::close_offload()
+{
+	if (fd_offload_dst >= 0)
+	{
+		fsync(fd_offload_dst);
+		close(fd_offload_dst);
+		fd_offload_dst = -1;
+	}
+	if (fd_offload_src >= 0)
+	{
+		close(fd_offload_src);
+		fd_offload_src = -1;
+	}
+}
+
+
+// Copy the extents between the loop device backing files with copy_file_range().  Returns
+// false, having copied nothing, when the kernel or file systems can't do this so that the
+// caller falls back to copying through user space.  Otherwise returns true with success
+// and done set just like the reader and writer do.
+bool CopyBlocks::offload_copy()
+{
+#ifdef HAVE_COPY_FILE_RANGE
+	Byte_Value sector_size_src = lp_device_src->sector_size;
+	Byte_Value sector_size_dst = lp_device_dst->sector_size;
+	Byte_Value src_base = offload_src_offset + offset_src * sector_size_src;
+	Byte_Value dst_base = offload_dst_offset + offset_dst * sector_size_dst;
+
+	// copy_file_range() refuses overlapping ranges within one file, so when moving
+	// within a file copy at most the move distance at a time.  Copying in the chosen
+	// direction keeps each call's source ahead of the data already overwritten.
+	Byte_Value chunk_size = OFFLOAD_CHUNK_SIZE;
+	struct stat st_src;
+	struct stat st_dst;
+	if (fstat(fd_offload_src, &st_src) != 0 || fstat(fd_offload_dst, &st_dst) != 0)
+		return false;
+	if (st_src.st_dev == st_dst.st_dev && st_src.st_ino == st_dst.st_ino)
+		chunk_size = std::min(chunk_size, llabs(dst_base - src_base));
+	if (chunk_size <= 0)
+		return false;
 
-	if ( blocksize != 0 )
+	bool       backwards = blocksize < 0;
+	Byte_Value sign      = backwards ? -1 : 1;
+	Byte_Value position  = backwards ? length : 0;  // Edge of the span copied so far
+	Glib::Timer timer_progress_timeout;
+	for (unsigned int i = 0; i < extents.size(); i++)
 	{
-		if (ped_device_read(lp_device_src, buf.data(), offset_src, num_blocks_src))
+		const Extent& extent = backwards ? extents[extents.size() - 1 - i] : extents[i];
+		Byte_Value extent_end = extent.offset + extent.length;
+		Byte_Value cursor     = backwards ? extent_end : extent.offset;
+		while (cursor != (backwards ? extent.offset : extent_end))
 		{
-			if (ped_device_write(lp_device_dst, buf.data(), offset_dst, num_blocks_dst))
-				success = true;
-			else {
-				error_message = Glib::ustring::compose( _("Error while writing block at sector %1"), offset_dst );
+			if (cancel)
+			{
+				error_message = _("Operation Canceled");
+				success = false;
+				return true;
+			}
+
+			Byte_Value start = backwards ? std::max(extent.offset, cursor - chunk_size) : cursor;
+			Byte_Value end   = backwards ? cursor : std::min(cursor + chunk_size, extent_end);
+			if (! checkpoint_before(sign * (backwards ? position - end : start - position),
+			                        sign * (end - start)                                  ))
+			{
+				success = false;
+				return true;
+			}
+			int error = 0;
+			if (! copy_range(fd_offload_src, src_base + start, fd_offload_dst, dst_base + start,
+			                 end - start, error))
+			{
+				if (done == 0 && (error == EXDEV || error == EOPNOTSUPP || error == ENOSYS ||
+				                  error == EINVAL                                              ))
+					return false;
+				error_message = Glib::ustring::compose(_("Error while writing block at sector %1"),
+				                                       offset_dst + start / sector_size_dst);
 				success = false;
+				return true;
+			}
+			done += sign * ((backwards ? position - end : start - position) + end - start);
+			position = cursor = backwards ? start : end;
+
+			if (timer_progress_timeout.elapsed() >= 0.5)
+			{
+				g_idle_add(_set_progress_info, this);
+				timer_progress_timeout.reset();
 			}
 		}
+	}
+	done += sign * (backwards ? position : length - position);
+
+	// The destination loop device's page cache didn't see the new data written to
+	// its backing file.  Flush and invalidate it.
+	int fd = open(dst_device.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd >= 0)
+	{
+		ioctl(fd, BLKFLSBUF, 0);
+		close(fd);
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+// Checkpoint the progress before writing a block which would take the writes further
+// than the checkpoint interval beyond the last checkpoint.  Skipped and count are signed
+// like done.
+bool CopyBlocks::checkpoint_before(Byte_Value skipped, Byte_Value count)
+{
+	if (journal == nullptr || llabs(done + skipped + count) - checkpoint_done <= checkpoint_interval)
+		return true;
+	// Nothing needs copying in the skipped range so it can be recorded as done.
+	return checkpoint(done + skipped);
+}
+
+
+// Make everything written so far durable then record progress, which is signed like done,
+// in the move journal.
+bool CopyBlocks::checkpoint(Byte_Value progress)
+{
+	if (fd_offload_dst >= 0)
+	{
+		fdatasync(fd_offload_dst);
+	}
+	else if (fd_dst >= 0)
+	{
+		fsync(fd_dst);
+	}
+	else
+	{
+		Glib::Mutex::Lock lock(io_mutex, Glib::NOT_LOCK);
+		if (lp_device_src == lp_device_dst)
+			lock.acquire();
+		ped_device_sync(lp_device_dst);
+	}
+
+	if (! journal->checkpoint(total_done + llabs(progress)))
+	{
+		error_message = Glib::ustring::compose(_("Failed to record the progress of the move in %1"),
+		                                       journal->get_filename());
+		return false;
+	}
+	checkpoint_done = llabs(progress);
+	return true;
+}
+
+
+void CopyBlocks::close_direct_io()
+{
+	if (fd_dst >= 0)
+	{
+		// Flush the device's volatile write cache, as ped_device_close() does for
+		// the libparted path.
+		fsync(fd_dst);
+		close(fd_dst);
+		fd_dst = -1;
+	}
+	if (fd_src >= 0)
+	{
+		close(fd_src);
+		fd_src = -1;
+	}
+}
+
+
+bool CopyBlocks::copy()
+{
+	if ( blocksize > length )
+		blocksize = length;
+
+	operationdetail.run_progressbar( (double)total_done, (double)total_length, PROGRESSBAR_TEXT_COPY_BYTES );
+
+	lp_device_src = ped_device_get( src_device.c_str() );
+	lp_device_dst = src_device != dst_device ? ped_device_get( dst_device.c_str() ) : lp_device_src;
+	//add an empty sub which we will constantly update in the loop
+	operationdetail.get_last_child().add_child( OperationDetail( "", STATUS_NONE ) );
+
+	// Open the devices here rather than in copy_thread() so that all libparted calls
+	// other than device I/O are made with the core lock held.
+	success = ped_device_open( lp_device_src ) &&
+	          (lp_device_src == lp_device_dst || ped_device_open( lp_device_dst ));
+
+	foreground = (Glib::Thread::self() == GParted_Core::mainthread);
+	libparted_messages = GParted_Core::get_libparted_messages();
+	Glib::Thread::create(sigc::mem_fun(*this, &CopyBlocks::copy_thread), false);
+	if ( foreground )
+	{
+		Gtk::Main::run();
+	}
+	else
+	{
+		// Let operations on other disks be applied while waiting.
+		bool relock = GParted_Core::release_core_lock();
+		finished_mutex.lock();
+		while ( ! finished )
+			finished_cond.wait( finished_mutex );
+		finished_mutex.unlock();
+		if ( relock )
+			GParted_Core::acquire_core_lock();
+	}
+
+	//close and destroy the devices..
+	ped_device_close( lp_device_src );
+	ped_device_destroy( lp_device_src );
+
+	if ( src_device != dst_device )
+	{
+		ped_device_close( lp_device_dst );
+		ped_device_destroy( lp_device_dst );
+	}
+
+	total_done += llabs(done);
+
+	if (done == length || ! success)
+	{
+		//final description
+		if (verify_enabled)
+			operationdetail.get_last_child().get_last_child().set_description(
+					Glib::ustring::compose( /*TO TRANSLATORS: looks like  1.00 MiB of 16.00 MiB copied, 512.00 KiB verified */
+							  _("%1 of %2 copied, %3 verified"),
+							  Utils::format_size( llabs( done ), 1 ),
+							  Utils::format_size( length, 1 ),
+							  Utils::format_size( verified, 1 ) ),
+					FONT_ITALIC );
 		else
-			error_message = Glib::ustring::compose( _("Error while reading block at sector %1"), offset_src ) ;
+			operationdetail.get_last_child().get_last_child().set_description(
+					Glib::ustring::compose( /*TO TRANSLATORS: looks like  1.00 MiB of 16.00 MiB copied */
+							  _("%1 of %2 copied"),
+							  Utils::format_size( llabs( done ), 1 ),
+							  Utils::format_size( length, 1 ) ),
+					FONT_ITALIC );
+
+		if (! success && ! error_message.empty())
+			operationdetail.get_last_child().get_last_child().add_child(
+					OperationDetail( error_message, STATUS_NONE, FONT_ITALIC ) );
 	}
-	if ( blocksize > 0 )
+
+	if (direct_io && ! offloaded)
+		operationdetail.get_last_child().get_last_child().add_child(
+				OperationDetail(_("using direct I/O"), STATUS_NONE, FONT_ITALIC));
+
+	if (offloaded)
+		operationdetail.get_last_child().get_last_child().add_child(
+				OperationDetail(_("using in kernel copying between loop device backing files"),
+				                STATUS_NONE, FONT_ITALIC));
+
+	if (zeroed > 0)
+		operationdetail.get_last_child().get_last_child().add_child(
+				OperationDetail(Glib::ustring::compose(
+				        /*TO TRANSLATORS: looks like  1.00 GiB of zeros not transferred, zeroed by the device */
+				        _("%1 of zeros not transferred, zeroed by the device"),
+				        Utils::format_size(zeroed, 1)),
+				        STATUS_NONE, FONT_ITALIC));
+
+	if (verify_enabled && verified > 0)
 	{
-		offset_src += (blocksize / sector_size_src);
-		offset_dst += (blocksize / sector_size_dst);
+		OperationDetail& progress_od = operationdetail.get_last_child().get_last_child();
+		double hash_seconds = hash_seconds_src + hash_seconds_dst;
+		Byte_Value hash_rate = (hash_seconds > 0.0) ? (Byte_Value)((hash_bytes_src + verified) / hash_seconds)
+		                                            : 0;
+		progress_od.add_child(OperationDetail(
+				/*TO TRANSLATORS: looks like  verified 16.00 MiB using CRC-32C at 4.50 GiB/s */
+				Glib::ustring::compose(_("verified %1 using CRC-32C at %2/s"),
+				                       Utils::format_size(verified, 1),
+				                       Utils::format_size(hash_rate, 1)),
+				STATUS_NONE, FONT_ITALIC));
+
+		for (unsigned int i = 0; i < mismatches.size() && i < VERIFY_MAX_REPORTED; i++)
+			progress_od.add_child(OperationDetail(
+					/*TO TRANSLATORS: looks like  data differs at sectors 2048 to 4095 of /dev/sdb */
+					Glib::ustring::compose(_("data differs at sectors %1 to %2 of %3"),
+					                       mismatches[i].start,
+					                       mismatches[i].start + mismatches[i].num - 1,
+					                       dst_device),
+					STATUS_ERROR, FONT_ITALIC));
+		if (mismatches.size() > VERIFY_MAX_REPORTED)
+			progress_od.add_child(OperationDetail(
+					/*TO TRANSLATORS: looks like  data differs in 5 more ranges */
+					Glib::ustring::compose(_("data differs in %1 more ranges"),
+					                       mismatches.size() - VERIFY_MAX_REPORTED),
+					STATUS_ERROR, FONT_ITALIC));
 	}
-	if( success )
-		done += blocksize;
+
+	if ( total_done == total_length || ! success )
+		operationdetail.stop_progressbar();
+
+	return success;
 }
 
 
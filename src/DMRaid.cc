@@ -46,6 +46,7 @@ namespace GParted
 //                            [{BlockSpecial("/dev/sdc"), "/dev/mapper/isw_ecccdhhiga_MyArray"},
 //                             {BlockSpecial("/dev/sdd"), "/dev/mapper/isw_ecccdhhiga_MyArray"}
 //                            ]
+// dmraid_member_index      - Index of the above by member.
 
 //Initialize static data elements
 bool DMRaid::dmraid_cache_initialized = false ;
@@ -54,6 +55,7 @@ bool DMRaid::dmsetup_found = false ;
 bool DMRaid::udevadm_found  = false ;
 std::vector<Glib::ustring> DMRaid::dmraid_devices ;
 std::vector<DMRaid_Member> DMRaid::dmraid_member_cache;
+BlockSpecialIndex DMRaid::dmraid_member_index;
 
 
 void DMRaid::load_cache()
@@ -69,6 +71,7 @@ void DMRaid::load_dmraid_cache()
 	Glib::ustring output, error ;
 	dmraid_devices .clear() ;
 	dmraid_member_cache.clear();
+	dmraid_member_index.clear();
 
 	// Load active DMRaid array names.
 	if ( dmraid_found )
@@ -89,6 +92,7 @@ void DMRaid::load_dmraid_cache()
 			DMRaid_Member memb;
 			memb.member = BlockSpecial(members[j]);
 			memb.array  = DEV_MAPPER_PATH + dmraid_devices[i];
+			dmraid_member_index.add(memb.member, dmraid_member_cache.size());
 			dmraid_member_cache.push_back(memb);
 		}
 	}
@@ -505,7 +509,7 @@ bool DMRaid::update_dev_map_entry( const Partition & partition, OperationDetail
 bool DMRaid::is_member(const Glib::ustring& member_path)
 {
 	const DMRaid_Member& memb = get_cache_entry_by_member(member_path);
-	if (memb.member.m_name.length() > 0)
+	if (memb.member.get_name().length() > 0)
 		return true;
 
 	return false;
@@ -562,16 +566,13 @@ std::vector<Glib::ustring> DMRaid::lookup_dmraid_members(const Glib::ustring& ar
 }
 
 
-// Perform linear search of the cache to find the matching member.
+// Look up the matching member in the cache index.
 // Return found cache entry or not found substitute.
 const DMRaid_Member& DMRaid::get_cache_entry_by_member(const Glib::ustring& member_path)
 {
-	BlockSpecial bs = BlockSpecial(member_path);
-	for (unsigned int i = 0; i < dmraid_member_cache.size(); i++)
-	{
-		if (bs == dmraid_member_cache[i].member)
-			return dmraid_member_cache[i];
-	}
+	int i = dmraid_member_index.find(member_path);
+	if (i >= 0)
+		return dmraid_member_cache[i];
 
 	static const DMRaid_Member notfound_memb = {BlockSpecial(), ""};
 	return notfound_memb;
@@ -51,6 +51,7 @@ void Device::Reset()
 	max_prims                 = 0;
 	highest_busy              = 0;
 	readonly                  = false;
+	incomplete                = false;
 	path                      = "";
 	max_partition_name_length = 0;
 }
@@ -77,6 +78,7 @@ void Device::copy_fields_without_partitions(Device& dest) const
 	dest.max_prims                 = this->max_prims;
 	dest.highest_busy              = this->highest_busy;
 	dest.readonly                  = this->readonly;
+	dest.incomplete                = this->incomplete;
 	dest.path                      = this->path;
 	dest.max_partition_name_length = this->max_partition_name_length;
 }
@@ -0,0 +1,219 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DeviceMonitor.h"
+
+#include <glibmm/miscutils.h>
+#include <glibmm/ustring.h>
+#include <glib.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+// Files whose contents affect the busy state of devices without the devices changing.
+static const char* STATE_FILES[] = { "/proc/mounts", "/proc/swaps", "/proc/mdstat", "/etc/fstab" };
+
+
+DeviceMonitor::~DeviceMonitor()
+{
+	if (m_source_id > 0)
+		g_source_remove(m_source_id);
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+
+// Start listening for kernel uevents.  When not possible every refresh scans all devices.
+void DeviceMonitor::start()
+{
+	m_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+	if (m_fd < 0)
+		return;
+
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;  // Kernel uevents, rather than those re-broadcast by udev
+	if (bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+		return;
+	}
+
+	GIOChannel* channel = g_io_channel_unix_new(m_fd);
+	m_source_id = g_io_add_watch(channel, G_IO_IN, _on_uevent, this);
+	g_io_channel_unref(channel);
+}
+
+
+// Get the paths of the disk devices which have changed since the last scan.  Returns
+// false when all devices have to be scanned again.
+bool DeviceMonitor::get_changed_devices(std::vector<Glib::ustring>& device_paths)
+{
+	if (m_fd >= 0)
+		read_uevents();
+	if (m_fd < 0 || m_all_changed || read_state() != m_state)
+		return false;
+
+	device_paths.assign(m_changed.begin(), m_changed.end());
+	return true;
+}
+
+
+// Record a change made by GParted itself, which doesn't always generate a uevent.
+void DeviceMonitor::mark_changed(const Glib::ustring& device_path)
+{
+	m_changed.insert(device_path);
+}
+
+
+void DeviceMonitor::mark_all_changed()
+{
+	m_all_changed = true;
+}
+
+
+// Forget the changes after scanning, including the uevents caused by the scan itself.
+void DeviceMonitor::reset()
+{
+	if (m_fd >= 0)
+		read_uevents();
+	m_changed.clear();
+	m_all_changed = false;
+	m_state = read_state();
+}
+
+
+gboolean DeviceMonitor::_on_uevent(GIOChannel* source, GIOCondition condition, gpointer data)
+{
+	DeviceMonitor* monitor = static_cast<DeviceMonitor*>(data);
+	monitor->read_uevents();
+	return true;
+}
+
+
+void DeviceMonitor::read_uevents()
+{
+	char buf[8192];
+	while (true)
+	{
+		struct sockaddr_nl addr;
+		struct iovec iov = { buf, sizeof(buf) };
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name    = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov     = &iov;
+		msg.msg_iovlen  = 1;
+		ssize_t len = recvmsg(m_fd, &msg, 0);
+		if (len < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			// Uevents were dropped because they weren't read quickly enough.
+			if (errno == ENOBUFS)
+			{
+				m_all_changed = true;
+				continue;
+			}
+			return;  // EAGAIN, no more uevents
+		}
+
+		// Only accept uevents sent by the kernel.
+		if (addr.nl_pid != 0)
+			continue;
+		add_uevent(buf, len);
+	}
+}
+
+
+// Record the disk device changed by a uevent.  A uevent is an "ACTION@DEVPATH" header
+// followed by NUL terminated "KEY=VALUE" strings.
+void DeviceMonitor::add_uevent(const char* buf, size_t len)
+{
+	std::string subsystem;
+	std::string devpath;
+	std::string devname;
+	std::string devtype;
+	const char* end = buf + len;
+	const char* p   = buf + strnlen(buf, len) + 1;
+	while (p < end)
+	{
+		size_t n = strnlen(p, end - p);
+		std::string field(p, n);
+		p += n + 1;
+		if (field.compare(0, 10, "SUBSYSTEM=") == 0)
+			subsystem = field.substr(10);
+		else if (field.compare(0, 8, "DEVPATH=") == 0)
+			devpath = field.substr(8);
+		else if (field.compare(0, 8, "DEVNAME=") == 0)
+			devname = field.substr(8);
+		else if (field.compare(0, 8, "DEVTYPE=") == 0)
+			devtype = field.substr(8);
+	}
+	if (subsystem != "block" || devname.empty())
+		return;
+
+	// A partition belongs to the disk named by its parent in the sysfs device path.
+	// Sysfs names use '!' in place of '/', such as "cciss!c0d0".
+	std::string disk_name = devname;
+	if (devtype == "partition")
+	{
+		disk_name = Glib::path_get_basename(Glib::path_get_dirname(devpath));
+		std::replace(disk_name.begin(), disk_name.end(), '!', '/');
+	}
+
+	// Device-mapper and SW RAID devices are built on top of other devices so may
+	// change what is shown for any of them.
+	if (disk_name.compare(0, 3, "dm-") == 0 || disk_name.compare(0, 2, "md") == 0)
+	{
+		m_all_changed = true;
+		return;
+	}
+
+	m_changed.insert("/dev/" + disk_name);
+}
+
+
+std::string DeviceMonitor::read_state()
+{
+	std::string state;
+	for (unsigned int i = 0; i < G_N_ELEMENTS(STATE_FILES); i++)
+	{
+		std::ifstream file(STATE_FILES[i]);
+		std::ostringstream contents;
+		contents << file.rdbuf();
+		state += contents.str();
+		state += '\0';
+	}
+	return state;
+}
+
+
+}  // namespace GParted
@@ -19,21 +19,25 @@
 #include "Device.h"
 #include "GParted_Core.h"
 #include "OperationDetail.h"
+#include "OperationScheduler.h"
 #include "Partition.h"
 #include "ProgressBar.h"
 #include "Utils.h"
 
 #include <glibmm/miscutils.h>
 #include <glibmm/main.h>
+#include <glibmm/thread.h>
 #include <glibmm/ustring.h>
 #include <gtkmm/stock.h>
 #include <gtkmm/main.h>
 #include <gtkmm/messagedialog.h>
 #include <gtkmm/filechooserdialog.h>
 #include <memory>
+#include <sigc++/bind.h>
 #include <sigc++/signal.h>
 #include <vector>
 #include <algorithm>
+#include <stdlib.h>
 
 
 namespace GParted
@@ -48,7 +52,8 @@ Dialog_Progress::Dialog_Progress(const std::vector<std::unique_ptr<Device>>& dev
    m_icon_info   (Utils::mk_pixbuf(*this, Gtk::Stock::INFO,           Gtk::ICON_SIZE_LARGE_TOOLBAR)),
    m_icon_warning(Utils::mk_pixbuf(*this, Gtk::Stock::DIALOG_WARNING, Gtk::ICON_SIZE_LARGE_TOOLBAR)),
    m_devices(devices), m_operations(operations),
-   m_fraction(1.0 / operations.size())
+   m_fraction(1.0 / operations.size()),
+   m_scheduler(operations)
 {
 	this ->set_title( _("Applying pending operations") ) ;
 	this->property_default_width() = 700;
@@ -64,18 +69,10 @@ Dialog_Progress::Dialog_Progress(const std::vector<std::unique_ptr<Device>>& dev
 	str_temp += "\n";
 	vbox->pack_start(*Utils::mk_label(str_temp), Gtk::PACK_SHRINK);
 
-	// WH: this->get_content_area() / vbox / m_label_current
-	m_label_current.set_xalign(0.0);
-	vbox->pack_start(m_label_current, Gtk::PACK_SHRINK);
-
-	// WH: this->get_content_area() / vbox / m_progressbar_current
-	m_progressbar_current.set_pulse_step(0.01);
-	m_progressbar_current.set_show_text();
-	vbox->pack_start(m_progressbar_current, Gtk::PACK_SHRINK);
-
-	// WH: this->get_content_area() / vbox / m_label_current_sub
-	m_label_current_sub.set_xalign(0.0);
-	vbox->pack_start(m_label_current_sub, Gtk::PACK_SHRINK);
+	// WH: this->get_content_area() / vbox / m_vbox_current
+	// Filled with a row for each operation being applied.  See start_ready_operations().
+	m_vbox_current.set_orientation(Gtk::ORIENTATION_VERTICAL);
+	vbox->pack_start(m_vbox_current, Gtk::PACK_SHRINK);
 
 	// WH: this->get_content_area() / vbox / "Completed Operations:"
 	vbox->pack_start(*Utils::mk_label("<b>" + Glib::ustring(_("Completed Operations:")) + "</b>"),
@@ -124,6 +121,9 @@ Dialog_Progress::Dialog_Progress(const std::vector<std::unique_ptr<Device>>& dev
 		Gtk::TreeRow treerow = *(m_treestore_operations->append());
 		treerow[m_treeview_operations_columns.operation_description] =
 		                m_operations[i]->m_operation_detail.get_description();
+
+		m_progressbars.push_back(std::make_unique<ProgressBar>());
+		m_operations[i]->m_operation_detail.set_progressbar(m_progressbars.back().get());
 	}
 
 	this ->signal_show() .connect( sigc::mem_fun(*this, &Dialog_Progress::on_signal_show) );
@@ -131,19 +131,50 @@ Dialog_Progress::Dialog_Progress(const std::vector<std::unique_ptr<Device>>& dev
 }
 
 
+// Called from the thread applying the operation, or from the Glib/Gtk main loop for
+// progress of external commands.  Queue a snapshot of the operation detail to update
+// the display from the main loop, keeping updates in order whichever thread made them.
 void Dialog_Progress::on_signal_update( const OperationDetail & operationdetail ) 
 {
-	Gtk::TreeModel::iterator iter = m_treestore_operations->get_iter(operationdetail.get_treepath());
+	const ProgressBar& progressbar = operationdetail.get_progressbar();
+	DetailUpdate* update = new DetailUpdate;
+	update->dialog            = this;
+	update->treepath          = operationdetail.get_treepath();
+	update->description       = operationdetail.get_description();
+	update->elapsed_time      = operationdetail.get_elapsed_time();
+	update->status            = operationdetail.get_status();
+	update->progress_running  = progressbar.running();
+	update->progress_fraction = progressbar.get_fraction();
+	update->progress_text     = progressbar.get_text();
+
+	// Cross thread registration of callback.  Must use thread-safe C/Glib
+	// g_idle_add().
+	g_idle_add(_apply_update, update);
+}
+
+
+gboolean Dialog_Progress::_apply_update(gpointer data)
+{
+	DetailUpdate* update = static_cast<DetailUpdate*>(data);
+	update->dialog->apply_update(*update);
+	delete update;
+	return false;
+}
+
+
+void Dialog_Progress::apply_update(const DetailUpdate& update)
+{
+	Gtk::TreeModel::iterator iter = m_treestore_operations->get_iter(update.treepath);
 
 	//i added the second check after get_iter() in gtk+-2.10 seems to behave differently from gtk+-2.8 
-	if (iter && m_treestore_operations->get_string(iter) == operationdetail.get_treepath())
+	if (iter && m_treestore_operations->get_string(iter) == update.treepath)
 	{
 		Gtk::TreeRow treerow = *iter ;
 
-		treerow[m_treeview_operations_columns.operation_description] = operationdetail.get_description();
-		treerow[m_treeview_operations_columns.elapsed_time] = operationdetail.get_elapsed_time();
+		treerow[m_treeview_operations_columns.operation_description] = update.description;
+		treerow[m_treeview_operations_columns.elapsed_time] = update.elapsed_time;
 
-		switch ( operationdetail .get_status() )
+		switch (update.status)
 		{
 			case STATUS_EXECUTE:
 				treerow[m_treeview_operations_columns.status_icon] = m_icon_execute;
@@ -167,88 +198,97 @@ void Dialog_Progress::on_signal_update( const OperationDetail & operationdetail
 				break ;
 		}
 
-		//update the gui elements..
-		if ( operationdetail .get_status() == STATUS_EXECUTE )
-			m_label_current_sub_text = operationdetail.get_description();
+		//update the gui elements of the row showing this operation..
+		CurrentRow* row = find_current_row(update.treepath);
+		if (row == nullptr)
+			return;
+
+		if (update.status == STATUS_EXECUTE)
+			row->label_sub_text = update.description;
 
-		const ProgressBar& progressbar_src = operationdetail.get_progressbar();
-		if ( progressbar_src.running() )
+		if (update.progress_running)
 		{
-			if ( pulsetimer.connected() )
-				pulsetimer.disconnect();
-			m_progressbar_current.set_fraction(progressbar_src.get_fraction());
-			m_progress_text = progressbar_src.get_text();
+			row->pulsing = false;
+			row->progressbar.set_fraction(update.progress_fraction);
+			row->progress_text = update.progress_text;
 		}
 		else
 		{
+			if (! row->pulsing)
+				row->progress_text.clear();
+			row->pulsing = true;
 			if ( ! pulsetimer.connected() )
-			{
 				pulsetimer = Glib::signal_timeout().connect(
 				                sigc::mem_fun( *this, &Dialog_Progress::pulsebar_pulse ), 100 );
-				m_progress_text.clear();
-			}
 		}
-		update_gui_elements();
+		update_gui_elements(*row);
 	}
 	else//it's an new od which needs to be added to the model.
 	{
-		unsigned int pos = operationdetail .get_treepath() .rfind( ":" ) ;
-		if ( pos < operationdetail .get_treepath() .length() )
-			iter = m_treestore_operations->get_iter(operationdetail.get_treepath().substr(
-			                        0, operationdetail.get_treepath().rfind(":")));
+		unsigned int pos = update.treepath.rfind(":");
+		if (pos < update.treepath.length())
+			iter = m_treestore_operations->get_iter(update.treepath.substr(0, pos));
 		else
-			iter = m_treestore_operations->get_iter(operationdetail.get_treepath());
+			iter = m_treestore_operations->get_iter(update.treepath);
 
 		if ( iter)
 		{
 			m_treestore_operations->append(static_cast<Gtk::TreeRow>(*iter).children());
-			on_signal_update( operationdetail ) ;
+			apply_update(update);
 		}
 	}
 }
 
 
-void Dialog_Progress::update_gui_elements()
+void Dialog_Progress::update_gui_elements(CurrentRow& row)
 {
-	m_label_current_sub.set_markup("<i>" + m_label_current_sub_text + "</i>\n");
+	row.label_sub.set_markup("<i>" + row.label_sub_text + "</i>\n");
 
 	//To ensure progress bar height remains the same, add a space in case message is empty
-	m_progressbar_current.set_text(m_progress_text + " ");
+	row.progressbar.set_text(row.progress_text + " ");
 }
 
 
 bool Dialog_Progress::pulsebar_pulse()
 {
-	m_progressbar_current.pulse();
-	return true;
+	bool pulsing = false;
+	for (unsigned int i = 0; i < m_current_rows.size(); i++)
+	{
+		if (m_current_rows[i]->operation >= 0 && m_current_rows[i]->pulsing)
+		{
+			m_current_rows[i]->progressbar.pulse();
+			pulsing = true;
+		}
+	}
+	return pulsing;
 }
 
 
-void Dialog_Progress::on_signal_show()
+// Return the row showing the operation to which the operation detail with treepath
+// belongs, or nullptr when it isn't being shown.
+Dialog_Progress::CurrentRow* Dialog_Progress::find_current_row(const Glib::ustring& treepath)
 {
-	for (m_curr_op = 0; m_curr_op < m_operations.size() && m_success && ! m_cancel; m_curr_op++)
-	{
-		m_operations[m_curr_op]->m_operation_detail.signal_update.connect(
-			sigc::mem_fun( this, &Dialog_Progress::on_signal_update ) ) ;
-
-		m_label_current.set_markup("<b>" + m_operations[m_curr_op]->m_description + "</b>");
-
-		m_progressbar_all.set_text(Glib::ustring::compose(_("%1 of %2 operations completed"),
-		                                                  m_curr_op, m_operations.size()));
-		m_progressbar_all.set_fraction(std::min(m_fraction * m_curr_op, 1.0));
-
-		//set status to 'execute'
-		m_operations[m_curr_op]->m_operation_detail.set_status(STATUS_EXECUTE);
+	int operation = atoi(treepath.substr(0, treepath.find(":")).c_str());
+	for (unsigned int i = 0; i < m_current_rows.size(); i++)
+		if (m_current_rows[i]->operation == operation)
+			return m_current_rows[i].get();
+	return nullptr;
+}
 
-		//set focus...
-		Gtk::TreeRow treerow = m_treestore_operations->children()[m_curr_op];
-		m_treeview_operations.set_cursor(static_cast<Gtk::TreePath>(treerow));
 
-		m_success = signal_apply_operation.emit(m_operations[m_curr_op].get());
+void Dialog_Progress::on_signal_show()
+{
+	for (unsigned int i = 0; i < m_operations.size(); i++)
+		m_operations[i]->m_operation_detail.signal_update.connect(
+			sigc::mem_fun( this, &Dialog_Progress::on_signal_update ) ) ;
 
-		//set status (succes/error) for this operation
-		m_operations[m_curr_op]->m_operation_detail.set_success_and_capture_errors(m_success);
-	}
+	// Apply operations on independent disks concurrently, each on its own thread, and
+	// wait for them all to complete.  Operations on the same disk are applied in the
+	// order queued.  See OperationScheduler.
+	update_completed_count();
+	start_ready_operations();
+	while (m_num_running > 0)
+		Gtk::Main::run();
 
 	//add save button
 	this ->add_button( _("_Save Details"), Gtk::RESPONSE_OK ) ; //there's no enum for SAVE
@@ -261,18 +301,9 @@ void Dialog_Progress::on_signal_show()
 
 	pulsetimer.disconnect();
 
-	if (m_cancel)
-	{
-		m_progressbar_current.set_text(_("Operation cancelled"));
-		m_progressbar_current.set_fraction(0.0);
-	}
-	else
-	{
+	if (! m_cancel)
 		//hide 'current operation' stuff
-		m_label_current.hide();
-		m_progressbar_current.hide();
-		m_label_current_sub.hide();
-	}
+		m_vbox_current.hide();
 
 	//deal with succes/error...
 	if (m_success)
@@ -321,6 +352,135 @@ void Dialog_Progress::on_signal_show()
 	} 
 }
 
+// Start applying every operation which no longer waits for any other, unless an
+// operation has failed or the user has cancelled.
+void Dialog_Progress::start_ready_operations()
+{
+	if (! m_success || m_cancel)
+		return;
+
+	std::vector<unsigned int> ready = m_scheduler.take_ready();
+	for (unsigned int i = 0; i < ready.size(); i++)
+	{
+		unsigned int index = ready[i];
+
+		// Reuse the row of a completed operation, usually the previous one in the
+		// same chain.
+		CurrentRow* row = nullptr;
+		for (unsigned int j = 0; row == nullptr && j < m_current_rows.size(); j++)
+			if (m_current_rows[j]->operation < 0)
+				row = m_current_rows[j].get();
+		if (row == nullptr)
+		{
+			m_current_rows.push_back(std::make_unique<CurrentRow>());
+			row = m_current_rows.back().get();
+			row->label.set_xalign(0.0);
+			row->progressbar.set_pulse_step(0.01);
+			row->progressbar.set_show_text();
+			row->label_sub.set_xalign(0.0);
+			m_vbox_current.pack_start(row->label, Gtk::PACK_SHRINK);
+			m_vbox_current.pack_start(row->progressbar, Gtk::PACK_SHRINK);
+			m_vbox_current.pack_start(row->label_sub, Gtk::PACK_SHRINK);
+		}
+		row->operation = index;
+		row->pulsing = false;
+		row->progress_text.clear();
+		row->label_sub_text.clear();
+		row->label.set_markup("<b>" + m_operations[index]->m_description + "</b>");
+		row->progressbar.set_fraction(0.0);
+		update_gui_elements(*row);
+		row->label.show();
+		row->progressbar.show();
+		row->label_sub.show();
+
+		//set status to 'execute'
+		m_operations[index]->m_operation_detail.set_status(STATUS_EXECUTE);
+
+		//set focus...
+		Gtk::TreeRow treerow = m_treestore_operations->children()[index];
+		m_treeview_operations.set_cursor(static_cast<Gtk::TreePath>(treerow));
+
+		m_num_running++;
+		Glib::Thread::create(sigc::bind(sigc::mem_fun(*this, &Dialog_Progress::apply_operation_thread),
+		                                index),
+		                     false);
+	}
+}
+
+
+void Dialog_Progress::apply_operation_thread(unsigned int index)
+{
+	bool success = signal_apply_operation.emit(m_operations[index].get());
+
+	//set status (succes/error) for this operation
+	GParted_Core::acquire_core_lock();
+	m_operations[index]->m_operation_detail.set_success_and_capture_errors(success);
+	GParted_Core::release_core_lock();
+
+	OperationCompletion* completion = new OperationCompletion;
+	completion->dialog  = this;
+	completion->index   = index;
+	completion->success = success;
+
+	// Cross thread registration of callback (this apply_operation_thread() is not
+	// GParted_Core::mainthread where the Glib/Gtk main loop runs the callback).
+	// Must use thread-safe C/Glib g_idle_add().
+	g_idle_add(_operation_completed, completion);
+}
+
+
+gboolean Dialog_Progress::_operation_completed(gpointer data)
+{
+	OperationCompletion* completion = static_cast<OperationCompletion*>(data);
+	completion->dialog->operation_completed(completion->index, completion->success);
+	delete completion;
+	return false;
+}
+
+
+void Dialog_Progress::operation_completed(unsigned int index, bool success)
+{
+	m_num_running--;
+	m_success = m_success && success;
+	m_scheduler.set_completed(index);
+
+	for (unsigned int i = 0; i < m_current_rows.size(); i++)
+	{
+		CurrentRow& row = *m_current_rows[i];
+		if (row.operation != (int)index)
+			continue;
+		row.operation = -1;
+		if (m_cancel)
+		{
+			row.pulsing = false;
+			row.progress_text = _("Operation cancelled");
+			row.progressbar.set_fraction(0.0);
+			update_gui_elements(row);
+		}
+		else
+		{
+			row.label.hide();
+			row.progressbar.hide();
+			row.label_sub.hide();
+		}
+	}
+
+	start_ready_operations();
+	update_completed_count();
+	if (m_num_running == 0)
+		Gtk::Main::quit();
+}
+
+
+void Dialog_Progress::update_completed_count()
+{
+	unsigned int completed = m_scheduler.get_num_completed();
+	m_progressbar_all.set_text(Glib::ustring::compose(_("%1 of %2 operations completed"),
+	                                                  completed, m_operations.size()));
+	m_progressbar_all.set_fraction(std::min(m_fraction * completed, 1.0));
+}
+
+
 void Dialog_Progress::on_cell_data_description( Gtk::CellRenderer * renderer, const Gtk::TreeModel::iterator & iter )
 {
 	dynamic_cast<Gtk::CellRendererText *>( renderer ) ->property_markup() = 
@@ -352,9 +512,13 @@ void Dialog_Progress::on_cancel()
 	if (m_cancel == false)
 	{
 		// First time.  The pressed button was labelled [Cancel].
-		// (Cancel will only succeed in ending the operation early if the current
-		// action is cancel safe).
-		m_operations[m_curr_op]->m_operation_detail.signal_cancel.emit(false);
+		// (Cancel will only succeed in ending the operations early if their
+		// current actions are cancel safe).
+		if (cancel_running_operations(false))
+			Glib::signal_timeout().connect(
+					sigc::bind(sigc::mem_fun(*this, &Dialog_Progress::cancel_running_operations),
+					           false),
+					100);
 		m_cancel = true;
 
 		// signal_cancel.emit() doesn't report success or failure.  In case the
@@ -391,12 +555,32 @@ void Dialog_Progress::on_cancel()
 		{
 			// Force cancel confirmed.  Do it.
 			m_cancelbutton->set_sensitive(false);
-			m_operations[m_curr_op]->m_operation_detail.signal_cancel.emit(true);
+			if (cancel_running_operations(true))
+				Glib::signal_timeout().connect(
+						sigc::bind(sigc::mem_fun(*this, &Dialog_Progress::cancel_running_operations),
+						           true),
+						100);
 		}
 	}
 }
 
 
+// Cancel all operations currently being applied.  Their operation details are being
+// added to by the threads applying them so only do this while holding the core lock,
+// which those threads have released while waiting for commands or block copies.
+// Returns true when the lock wasn't available so that it is called again as a timeout.
+bool Dialog_Progress::cancel_running_operations(bool force)
+{
+	if (! GParted_Core::try_acquire_core_lock())
+		return true;
+	for (unsigned int i = 0; i < m_current_rows.size(); i++)
+		if (m_current_rows[i]->operation >= 0)
+			m_operations[m_current_rows[i]->operation]->m_operation_detail.signal_cancel.emit(force);
+	GParted_Core::release_core_lock();
+	return false;
+}
+
+
 void Dialog_Progress::on_save()
 {
 	Gtk::FileChooserDialog dialog( _("Save Details"), Gtk::FILE_CHOOSER_ACTION_SAVE ) ;
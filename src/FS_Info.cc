@@ -18,11 +18,17 @@
 #include "FS_Info.h"
 #include "BlockSpecial.h"
 #include "Utils.h"
+#include "../config.h"
 
+#ifdef ENABLE_LIBBLKID
+#include <blkid/blkid.h>
+#endif
 #include <iostream>
 #include <glibmm/ustring.h>
 #include <glibmm/miscutils.h>
 #include <glibmm/shell.h>
+#include <sigc++/bind.h>
+#include <algorithm>
 #include <vector>
 
 
@@ -53,6 +59,61 @@ bool FS_Info::need_blkid_vfat_cache_update_workaround = true;
 //     ]
 std::vector<FS_Entry> FS_Info::fs_info_cache;
 
+// Index of the above by path, to find entries without a linear search.
+BlockSpecialIndex FS_Info::fs_info_index;
+
+
+#ifdef ENABLE_LIBBLKID
+// Most paths probed with libblkid at the same time.
+static const unsigned int LIBBLKID_MAX_THREADS = 8;
+
+// Result of probing one path with libblkid.
+struct LibblkidResult
+{
+	bool     found = false;
+	FS_Entry fs_entry;
+};
+
+
+static Glib::ustring get_libblkid_value(blkid_probe pr, const char* name)
+{
+	const char* data = nullptr;
+	if (blkid_probe_lookup_value(pr, name, &data, nullptr) != 0 || data == nullptr)
+		return "";
+	return data;
+}
+
+
+// Probe one path with libblkid, getting the same details as the blkid command plus the
+// label.  Called concurrently so only touches the result for this path.
+static void run_libblkid_probe(unsigned int index, const std::vector<Glib::ustring>* paths,
+                               std::vector<LibblkidResult>* results)
+{
+	blkid_probe pr = blkid_new_probe_from_filename((*paths)[index].c_str());
+	if (pr == nullptr)
+		return;
+
+	blkid_probe_enable_superblocks(pr, 1);
+	blkid_probe_set_superblocks_flags(pr, BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
+	                                      BLKID_SUBLKS_UUID | BLKID_SUBLKS_LABEL    );
+	// Also report whole disk devices containing partition tables, like blkid does.
+	blkid_probe_enable_partitions(pr, 1);
+	if (blkid_do_safeprobe(pr) == 0)
+	{
+		FS_Entry& fs_entry = (*results)[index].fs_entry;
+		(*results)[index].found = true;
+		fs_entry.type     = get_libblkid_value(pr, "TYPE");
+		fs_entry.sec_type = get_libblkid_value(pr, "SEC_TYPE");
+		fs_entry.uuid     = get_libblkid_value(pr, "UUID");
+		// The label is read without blkid's encoding so is known for every file
+		// system, even when it doesn't have one.
+		fs_entry.have_label = (fs_entry.type != "");
+		fs_entry.label      = get_libblkid_value(pr, "LABEL");
+	}
+	blkid_free_probe(pr);
+}
+#endif
+
 
 const Glib::ustring& FS_Info::get_blkid_version_string()
 {
@@ -65,6 +126,7 @@ void FS_Info::clear_cache()
 {
 	set_command_found();
 	fs_info_cache.clear();
+	fs_info_index.clear();
 	fs_info_cache_initialized = true;
 }
 
@@ -99,6 +161,23 @@ void FS_Info::load_cache_for_one_device_name(const Glib::ustring& device_name)
 }
 
 
+// Remove the cache entries for the named paths, before loading them again for devices
+// which have changed.
+void FS_Info::remove_cache_entries(const std::vector<Glib::ustring>& paths)
+{
+	for (unsigned int i = 0; i < fs_info_cache.size(); i++)
+	{
+		if (std::find(paths.begin(), paths.end(), fs_info_cache[i].path.get_name()) != paths.end())
+			fs_info_cache.erase(fs_info_cache.begin() + i--);
+	}
+
+	// Positions of the remaining entries have changed so index them again.
+	fs_info_index.clear();
+	for (unsigned int i = 0; i < fs_info_cache.size(); i++)
+		fs_info_index.add(fs_info_cache[i].path, i);
+}
+
+
 // Retrieve the file system type for the path
 Glib::ustring FS_Info::get_fs_type( const Glib::ustring & path )
 {
@@ -142,26 +221,25 @@ Glib::ustring FS_Info::get_label( const Glib::ustring & path, bool & found )
 		return "";
 	}
 
-	BlockSpecial bs = BlockSpecial( path );
-	for ( unsigned int i = 0 ; i < fs_info_cache.size() ; i ++ )
-		if ( bs == fs_info_cache[i].path )
-		{
-			if ( fs_info_cache[i].have_label || fs_info_cache[i].type == "" )
-			{
-				// Already have the label or this is a blank cache entry
-				// for a whole disk device containing a partition table,
-				// so no label.
-				found = fs_info_cache[i].have_label;
-				return fs_info_cache[i].label;
-			}
+	int i = fs_info_index.find(path);
+	if (i < 0)
+	{
+		found = false;
+		return "";
+	}
 
-			// Run blkid to get the label for this one partition, update the
-			// cache and return the found label.
-			found = run_blkid_update_cache_one_label( fs_info_cache[i] );
-			return fs_info_cache[i].label;
-		}
-	found = false;
-	return "";
+	if ( fs_info_cache[i].have_label || fs_info_cache[i].type == "" )
+	{
+		// Already have the label or this is a blank cache entry for a whole disk
+		// device containing a partition table, so no label.
+		found = fs_info_cache[i].have_label;
+		return fs_info_cache[i].label;
+	}
+
+	// Run blkid to get the label for this one partition, update the cache and return
+	// the found label.
+	found = run_blkid_update_cache_one_label( fs_info_cache[i] );
+	return fs_info_cache[i].label;
 }
 
 // Retrieve the uuid given for the path
@@ -182,7 +260,7 @@ Glib::ustring FS_Info::get_path_by_uuid( const Glib::ustring & uuid )
 
 	for ( unsigned int i = 0 ; i < fs_info_cache.size() ; i ++ )
 		if ( uuid == fs_info_cache[i].uuid )
-			return fs_info_cache[i].path.m_name;
+			return fs_info_cache[i].path.get_name();
 
 	return "";
 }
@@ -196,7 +274,7 @@ Glib::ustring FS_Info::get_path_by_label( const Glib::ustring & label )
 	update_fs_info_cache_all_labels();
 	for ( unsigned int i = 0 ; i < fs_info_cache.size() ; i ++ )
 		if ( label == fs_info_cache[i].label )
-			return fs_info_cache[i].path.m_name;
+			return fs_info_cache[i].path.get_name();
 
 	return "";
 }
@@ -213,6 +291,15 @@ bool FS_Info::not_initialised_then_error()
 
 void FS_Info::set_command_found()
 {
+#ifdef ENABLE_LIBBLKID
+	// Probing in process with libblkid, which reads the devices directly without
+	// using the blkid cache so doesn't need the FAT16/FAT32 workaround.
+	const char* version = nullptr;
+	blkid_get_library_version(&version, nullptr);
+	blkid_found = true;
+	full_blkid_version = Glib::ustring("libblkid ") + version;
+	need_blkid_vfat_cache_update_workaround = false;
+#else
 	blkid_found = (! Glib::find_program_in_path( "blkid" ) .empty() ) ;
 	if (! blkid_found)
 	{
@@ -237,21 +324,28 @@ void FS_Info::set_command_found()
 				(blkid_major_ver < 2                            ||
 				 (blkid_major_ver == 2 && blkid_minor_ver < 23)   );
 	}
+#endif
 }
 
 
 FS_Entry& FS_Info::get_cache_entry_by_path(const Glib::ustring& path)
 {
-	BlockSpecial bs = BlockSpecial( path );
-	for ( unsigned int i = 0 ; i < fs_info_cache.size() ; i ++ )
-		if ( bs == fs_info_cache[i].path )
-			return fs_info_cache[i];
+	int i = fs_info_index.find(path);
+	if (i >= 0)
+		return fs_info_cache[i];
 
 	static FS_Entry not_found;  // {BlockSpecial(), "", "", "", false, ""}
 	return not_found;
 }
 
 
+void FS_Info::add_cache_entry(const FS_Entry& fs_entry)
+{
+	fs_info_index.add(fs_entry.path, fs_info_cache.size());
+	fs_info_cache.push_back(fs_entry);
+}
+
+
 void FS_Info::run_blkid_load_cache(const std::vector<Glib::ustring>& paths)
 {
 	// Parse blkid output line by line extracting mandatory field: path and optional
@@ -275,6 +369,21 @@ void FS_Info::run_blkid_load_cache(const std::vector<Glib::ustring>& paths)
 		// No paths requested, nothing to do.
 		return;
 
+#ifdef ENABLE_LIBBLKID
+	// Probe each path once, concurrently as probing mostly waits for the devices to
+	// be read.
+	std::vector<LibblkidResult> results(paths.size());
+	Utils::run_concurrently(paths.size(), LIBBLKID_MAX_THREADS,
+	                        sigc::bind(sigc::ptr_fun(&run_libblkid_probe), &paths, &results));
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		if (results[i].found)
+		{
+			results[i].fs_entry.path = BlockSpecial(paths[i]);
+			add_cache_entry(results[i].fs_entry);
+		}
+	}
+#else
 	Glib::ustring cmd = "blkid";
 	for (unsigned int i = 0; i < paths.size(); i++)
 		cmd.append(" " + Glib::shell_quote(paths[i]));
@@ -296,9 +405,10 @@ void FS_Info::run_blkid_load_cache(const std::vector<Glib::ustring>& paths)
 			fs_entry.type     = Utils::regexp_label(lines[i], " TYPE=\"([^\"]*)\"");
 			fs_entry.sec_type = Utils::regexp_label(lines[i], " SEC_TYPE=\"([^\"]*)\"");
 			fs_entry.uuid     = Utils::regexp_label(lines[i], " UUID=\"([^\"]*)\"");
-			fs_info_cache.push_back(fs_entry);
+			add_cache_entry(fs_entry);
 		}
 	}
+#endif
 
 	return;
 }
@@ -364,7 +474,7 @@ bool FS_Info::run_blkid_update_cache_one_label( FS_Entry & fs_entry )
 	// label without blkid's default non-reversible encoding.
 	Glib::ustring output;
 	Glib::ustring error;
-	bool success = ! Utils::execute_command( "blkid -o value -s LABEL " + Glib::shell_quote( fs_entry.path.m_name ),
+	bool success = ! Utils::execute_command( "blkid -o value -s LABEL " + Glib::shell_quote( fs_entry.path.get_name() ),
 	                                         output, error, true );
 	if ( ! success )
 		return false;
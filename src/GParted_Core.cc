@@ -17,6 +17,7 @@
 
 
 #include "GParted_Core.h"
+#include "AllocationMap.h"
 #include "BCache_Info.h"
 #include "BlockSpecial.h"
 #include "CopyBlocks.h"
@@ -27,6 +28,7 @@
 #include "LVM2_Info.h"
 #include "LUKS_Info.h"
 #include "Mount_Info.h"
+#include "MoveJournal.h"
 #include "Operation.h"
 #include "OperationCopy.h"
 #include "Partition.h"
@@ -35,6 +37,7 @@
 #include "Proc_Partitions_Info.h"
 #include "SupportedFileSystems.h"
 #include "SWRaid_Info.h"
+#include "UdevSettle.h"
 #include "Utils.h"
 #include "VGDevice.h"
 #include "../config.h"
@@ -50,19 +53,31 @@
 #include <stdint.h>
 #include <endian.h>
 #include <glibmm/miscutils.h>
+#include <glibmm/timer.h>
 #include <glibmm/fileutils.h>
 #include <glibmm/shell.h>
 #include <gtkmm/messagedialog.h>
 #include <gtkmm/main.h>
 #include <sigc++/bind.h>
 #include <sigc++/signal.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
 #include <memory>
 #include <set>
 #include <utility>
 #include <vector>
 
 
-std::vector<Glib::ustring> libparted_messages ; //see ped_exception_handler()
+// Messages reported by libparted, collected per thread so that messages reported while
+// probing or applying operations on one disk aren't attributed to another.  See
+// ped_exception_handler().
+thread_local std::vector<Glib::ustring> libparted_messages;
+// Threads working for another thread, such as those copying blocks, report into the
+// messages of that thread instead.  See redirect_libparted_messages().
+static thread_local std::vector<Glib::ustring>* libparted_messages_target = nullptr;
+Glib::Mutex libparted_messages_mutex;
 
 
 namespace GParted
@@ -72,10 +87,27 @@ namespace GParted
 const std::time_t SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS = 1;
 const std::time_t SETTLE_DEVICE_APPLY_MAX_WAIT_SECONDS = 10;
 
+// Most devices confirmed or searched at the same time when scanning.
+const unsigned int PROBE_MAX_THREADS = 8;
+
+// Most disks whose file system usage is read at the same time when scanning.  Only one
+// partition of each disk is read at a time.
+const unsigned int USAGE_MAX_THREADS = 8;
+
 static bool udevadm_found = false;
 
 static const Glib::ustring GPARTED_BUG( _("GParted Bug") );
 
+// Only one thread uses libparted and the caches at a time.  Operations are applied, and
+// devices probed, concurrently only while waiting for external commands and block copies,
+// which release the lock.  See acquire_core_lock().
+static Glib::Mutex core_mutex;
+static thread_local bool core_mutex_held = false;
+
+// Seconds spent waiting for udev to settle devices by the operation being applied by this
+// thread.  See settle_device().
+static thread_local double settle_seconds = 0.0;
+
 
 GParted_Core::GParted_Core()
 {
@@ -107,6 +139,14 @@ Glib::ustring GParted_Core::get_version_and_config_string()
 #ifdef USE_LIBPARTED_DMRAID
 	str += " --enable-libparted-dmraid";
 	added_config_flag = true;
+#endif
+#ifdef ENABLE_DIRECT_IO
+	str += " --enable-direct-io";
+	added_config_flag = true;
+#endif
+#ifdef ENABLE_LIBBLKID
+	str += " --enable-libblkid";
+	added_config_flag = true;
 #endif
 	if (! added_config_flag)
 		str += " (none)";
@@ -160,14 +200,36 @@ void GParted_Core::set_devices_thread(std::vector<std::unique_ptr<Device>>* pdev
 	std::vector<std::unique_ptr<Device>>& devices = *pdevices;
 	devices .clear() ;
 
+	// Don't let a hung command stop the search.  Also applies to the threads searching
+	// devices concurrently.
+	Utils::set_thread_command_timeout(true);
+
 	// Initialise and load caches needed for device discovery.
 	BlockSpecial::clear_cache();            // MUST BE FIRST.  Cache of name to major, minor
 	                                        // numbers incrementally loaded when BlockSpecial
 	                                        // objects are created in the following caches.
 	Proc_Partitions_Info::load_cache();     // SHOULD BE SECOND.  Caches /proc/partitions and
 	                                        // pre-populates BlockSpecial cache.
-	DMRaid::load_cache();
-	LVM2_Info::clear_cache();
+
+	// The remaining caches are loaded concurrently as they are independent and
+	// mostly wait for external commands.  Those not needed for device discovery are
+	// loaded now too, except for the ones needing the discovered device names or,
+	// like Mount_Info, the FS_Info cache.  LUKS_Info cache is loaded now, rather than
+	// on first use, as devices are searched concurrently.
+	unsigned int timed_out_count = Utils::get_timed_out_count();
+	Glib::Timer cache_timer;
+	std::vector<sigc::slot<void>> loaders;
+	loaders.push_back(sigc::ptr_fun(&DMRaid::load_cache));
+	loaders.push_back(sigc::ptr_fun(&FS_Info::clear_cache));
+	loaders.push_back(sigc::ptr_fun(&SWRaid_Info::load_cache));
+	loaders.push_back(sigc::ptr_fun(&LUKS_Info::load_cache));
+	if (! m_probe_devices)
+		// LVM2_Info cache needed to identify Volume Groups named on the
+		// command line.
+		loaders.push_back(sigc::ptr_fun(&LVM2_Info::load_cache));
+	set_thread_status_message(_("Loading device information"));
+	load_caches(loaders);
+	double cache_seconds = cache_timer.elapsed();
 
 	// Vectors of sorted, useable device and Volume Group names either probed or named
 	// on the command line.
@@ -196,37 +258,35 @@ void GParted_Core::set_devices_thread(std::vector<std::unique_ptr<Device>>* pdev
 				set_thread_status_message(Glib::ustring::compose(_("Scanning %1"),
 				                                                 dmraid_device_names[i]));
 #ifndef USE_LIBPARTED_DMRAID
+				UdevSettle settle(dmraid_device_names[i]);
 				DMRaid::create_dev_map_entries(dmraid_device_names[i]);
-				settle_device(SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS);
+				settle_device(settle, SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS);
 #endif
 				ped_device_get(dmraid_device_names[i].c_str());
 			}
 		}
 
+		std::vector<PedDevice*> lp_devices;
 		PedDevice* lp_device = ped_device_get_next(nullptr);
 		while ( lp_device ) 
 		{
-			/* TO TRANSLATORS: looks like   Confirming /dev/sda */
-			set_thread_status_message( Glib::ustring::compose( _("Confirming %1"), lp_device->path ) );
-
-			//only add this device if we can read the first sector (which means it's a real device)
-			if ( useable_device( lp_device ) )
-				device_names.push_back(lp_device->path);
-
+			lp_devices.push_back(lp_device);
 			lp_device = ped_device_get_next( lp_device ) ;
 		}
 
-		std::sort(device_names.begin(), device_names.end());
-
-		// Get useable Volume Group names
-		set_thread_status_message(_("Scanning LVM"));
-		vg_names = LVM2_Info::get_vgnames();
-		for (unsigned int i = 0; i < vg_names.size(); i++)
+		// Confirm the devices concurrently as reading from some devices can take a
+		// long time, especially when they don't respond.
+		std::vector<Glib::ustring> useable_paths(lp_devices.size());
+		Utils::run_concurrently(lp_devices.size(), PROBE_MAX_THREADS,
+		                        sigc::bind(sigc::mem_fun(*this, &GParted_Core::confirm_device),
+		                                   &lp_devices, &useable_paths));
+		for (unsigned int i = 0; i < useable_paths.size(); i++)
 		{
-			if (! LVM2_Info::is_useable_vg(vg_names[i]))
-				vg_names.erase(vg_names.begin() + i--);
+			if (! useable_paths[i].empty())
+				device_names.push_back(useable_paths[i]);
 		}
-		std::sort(vg_names.begin(), vg_names.end());
+
+		std::sort(device_names.begin(), device_names.end());
 	}
 	else
 	{
@@ -261,8 +321,9 @@ void GParted_Core::set_devices_thread(std::vector<std::unique_ptr<Device>>* pdev
 			if (DMRaid::is_dmraid_supported()               &&
 			    DMRaid::is_dmraid_device(m_user_devices[i])   )
 			{
+				UdevSettle settle(m_user_devices[i]);
 				DMRaid::create_dev_map_entries(DMRaid::get_dmraid_name(m_user_devices[i]));
-				settle_device( SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS );
+				settle_device(settle, SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS);
 			}
 #endif
 
@@ -275,25 +336,49 @@ void GParted_Core::set_devices_thread(std::vector<std::unique_ptr<Device>>* pdev
 		}
 	}
 
-	// Initialise and load caches needed for content discovery.
-	FS_Info::clear_cache();
+	// Load the remaining caches needed for content discovery, again concurrently.
+	cache_timer.start();
 	const std::vector<DeviceAndPartitionNames> dev_ptn_names =
 	                Proc_Partitions_Info::get_device_and_partition_names_for(device_names);
-	FS_Info::load_cache_for_device_and_partition_names(dev_ptn_names);
+	loaders.clear();
+	loaders.push_back(sigc::bind(sigc::ptr_fun(&FS_Info::load_cache_for_device_and_partition_names),
+	                             dev_ptn_names));
+	if (m_probe_devices)
+		loaders.push_back(sigc::ptr_fun(&LVM2_Info::load_cache));
+	set_thread_status_message(_("Loading device information"));
+	load_caches(loaders);
 	Mount_Info::load_cache();
 	btrfs::clear_cache();
-	SWRaid_Info::load_cache();
-	LUKS_Info::clear_cache();
+	cache_seconds += cache_timer.elapsed();
+	/* TO TRANSLATORS: looks like   Loaded device information in 1.3 seconds */
+	set_thread_status_message(Glib::ustring::compose(_("Loaded device information in %1 seconds"),
+	                          Glib::ustring::format(std::fixed, std::setprecision(1), cache_seconds)));
+	// Commands which timed out may have left any device with missing details.
+	m_caches_incomplete = Utils::get_timed_out_count() != timed_out_count;
 
-	for (unsigned int i = 0; i < device_names.size(); i++)
+	if (m_probe_devices)
 	{
-		/*TO TRANSLATORS: looks like Searching /dev/sda partitions */ 
-		set_thread_status_message(Glib::ustring::compose(_("Searching %1 partitions"), device_names[i]));
-		std::unique_ptr<Device> temp_device = std::make_unique<Device>();
-		set_device_from_disk(*temp_device, device_names[i]);
-		devices.push_back(std::move(temp_device));
+		// Get useable Volume Group names
+		vg_names = LVM2_Info::get_vgnames();
+		for (unsigned int i = 0; i < vg_names.size(); i++)
+		{
+			if (! LVM2_Info::is_useable_vg(vg_names[i]))
+				vg_names.erase(vg_names.begin() + i--);
+		}
+		std::sort(vg_names.begin(), vg_names.end());
 	}
 
+	// Search the devices concurrently, keeping them in the sorted order of their names.
+	// File system usage is queued to be read afterwards by start_reading_usage().
+	m_usage_spindles.clear();
+	m_queue_usage = true;
+	std::vector<std::unique_ptr<Device>> probed_devices(device_names.size());
+	Utils::run_concurrently(device_names.size(), PROBE_MAX_THREADS,
+	                        sigc::bind(sigc::mem_fun(*this, &GParted_Core::probe_device),
+	                                   &device_names, &probed_devices));
+	for (unsigned int i = 0; i < probed_devices.size(); i++)
+		devices.push_back(std::move(probed_devices[i]));
+
 	// LVM2 read-only support: enumerate Volume Groups and add each one to the
 	// device list as a VGDevice.  A VG is shown like a disk and its Logical
 	// Volumes like partitions.  GParted does not modify LVM objects here.  VGs
@@ -309,8 +394,11 @@ void GParted_Core::set_devices_thread(std::vector<std::unique_ptr<Device>>* pdev
 		                                                 temp_vg->get_path()));
 		populate_vgdevice_partitions(*temp_vg);
 		temp_vg->readonly = temp_vg->exported || temp_vg->partial;
+		if (m_caches_incomplete)
+			set_device_incomplete(*temp_vg);
 		devices.push_back(std::move(temp_vg));
 	}
+	m_queue_usage = false;
 
 	set_thread_status_message("") ;
 
@@ -321,15 +409,238 @@ void GParted_Core::set_devices_thread(std::vector<std::unique_ptr<Device>>* pdev
 }
 
 
+// Refresh just the named disk devices, searching them again and keeping the already
+// scanned details of all the other devices.  Returns false, leaving devices unchanged,
+// when all devices need to be scanned again with set_devices() instead.
+bool GParted_Core::refresh_devices(std::vector<std::unique_ptr<Device>>& devices,
+                                   const std::vector<Glib::ustring>& device_paths)
+{
+	// Changes to members of multi-device storage change what is shown for the other
+	// members and the Volume Groups too.
+	for (unsigned int i = 0; i < devices.size(); i++)
+	{
+		if (std::find(device_paths.begin(), device_paths.end(), devices[i]->get_path()) != device_paths.end() &&
+		    has_multi_device_member(*devices[i])                                                                   )
+			return false;
+	}
+
+	bool success = false;
+	Glib::Thread::create(sigc::bind(sigc::mem_fun(*this, &GParted_Core::refresh_devices_thread),
+	                                &devices, &device_paths, &success),
+	                     false);
+	Gtk::Main::run();
+	return success;
+}
+
+
+void GParted_Core::refresh_devices_thread(std::vector<std::unique_ptr<Device>>* pdevices,
+                                          const std::vector<Glib::ustring>* pdevice_paths,
+                                          bool* psuccess)
+{
+	std::vector<std::unique_ptr<Device>>& devices = *pdevices;
+	const std::vector<Glib::ustring>& device_paths = *pdevice_paths;
+	Utils::set_thread_command_timeout(true);
+
+	// Changed devices may have been removed and their names reused so reload the
+	// names to major, minor numbers cache.
+	BlockSpecial::clear_cache();
+	Proc_Partitions_Info::load_cache();
+
+	// Changed devices which still exist and are useable.
+	const std::vector<Glib::ustring>& proc_device_names = Proc_Partitions_Info::get_device_paths();
+	const std::vector<Glib::ustring>& known_names = m_probe_devices ? proc_device_names : m_user_devices;
+	std::vector<Glib::ustring> device_names;
+	for (unsigned int i = 0; i < device_paths.size(); i++)
+	{
+		if (std::find(known_names.begin(), known_names.end(), device_paths[i]) == known_names.end())
+			continue;
+
+		set_thread_status_message(Glib::ustring::compose(_("Confirming %1"), device_paths[i]));
+		PedDevice* lp_device = ped_device_get(device_paths[i].c_str());
+		if (lp_device != nullptr && useable_device(lp_device))
+			device_names.push_back(device_paths[i]);
+	}
+
+	// Replace the FS_Info cache entries for the partitions the changed devices had
+	// with those they have now.
+	std::vector<Glib::ustring> old_names;
+	for (unsigned int i = 0; i < devices.size(); i++)
+	{
+		if (std::find(device_paths.begin(), device_paths.end(), devices[i]->get_path()) == device_paths.end())
+			continue;
+		old_names.push_back(devices[i]->get_path());
+		const PartitionVector& partitions = devices[i]->partitions;
+		for (unsigned int j = 0; j < partitions.size(); j++)
+		{
+			old_names.push_back(partitions[j].get_path());
+			for (unsigned int k = 0; k < partitions[j].logicals.size(); k++)
+				old_names.push_back(partitions[j].logicals[k].get_path());
+		}
+	}
+	FS_Info::remove_cache_entries(old_names);
+	const std::vector<DeviceAndPartitionNames> dev_ptn_names =
+	                Proc_Partitions_Info::get_device_and_partition_names_for(device_names);
+	unsigned int timed_out_count = Utils::get_timed_out_count();
+	FS_Info::load_cache_for_device_and_partition_names(dev_ptn_names);
+	m_caches_incomplete = Utils::get_timed_out_count() != timed_out_count;
+	btrfs::clear_cache();
+
+	m_usage_spindles.clear();
+	m_queue_usage = true;
+	std::vector<std::unique_ptr<Device>> probed_devices(device_names.size());
+	Utils::run_concurrently(device_names.size(), PROBE_MAX_THREADS,
+	                        sigc::bind(sigc::mem_fun(*this, &GParted_Core::probe_device),
+	                                   &device_names, &probed_devices));
+	m_queue_usage = false;
+
+	*psuccess = true;
+	for (unsigned int i = 0; i < probed_devices.size(); i++)
+	{
+		if (has_multi_device_member(*probed_devices[i]))
+			*psuccess = false;
+	}
+	if (! *psuccess)
+		// The searched devices are discarded, so is their queued usage.
+		m_usage_spindles.clear();
+
+	if (*psuccess)
+	{
+		// Merge the searched devices with the unchanged ones, keeping disk devices
+		// sorted by name before the Volume Groups.
+		std::vector<std::unique_ptr<Device>> disk_devices;
+		std::vector<std::unique_ptr<Device>> vg_devices;
+		for (unsigned int i = 0; i < devices.size(); i++)
+		{
+			if (! devices[i]->is_partition_table_device())
+				vg_devices.push_back(std::move(devices[i]));
+			else if (std::find(device_paths.begin(), device_paths.end(), devices[i]->get_path()) == device_paths.end())
+				disk_devices.push_back(std::move(devices[i]));
+		}
+		for (unsigned int i = 0; i < probed_devices.size(); i++)
+			disk_devices.push_back(std::move(probed_devices[i]));
+		std::sort(disk_devices.begin(), disk_devices.end(),
+		          [](const std::unique_ptr<Device>& lhs, const std::unique_ptr<Device>& rhs)
+		          { return lhs->get_path() < rhs->get_path(); });
+
+		devices = std::move(disk_devices);
+		for (unsigned int i = 0; i < vg_devices.size(); i++)
+			devices.push_back(std::move(vg_devices[i]));
+	}
+
+	set_thread_status_message("");
+
+	// Cross thread registration of callback (this refresh_devices_thread() is not
+	// GParted_Core::mainthread where the Glib/Gtk main loop runs the callback).
+	// Must use thread-safe C/Glib g_idle_add().
+	g_idle_add((GSourceFunc)_mainquit, nullptr);
+}
+
+
+// Does the device contain a member of multi-device storage, which ties what is shown for
+// it to other devices?
+bool GParted_Core::has_multi_device_member(const Device& device)
+{
+	for (unsigned int i = 0; i < device.partitions.size(); i++)
+	{
+		const PartitionVector& logicals = device.partitions[i].logicals;
+		std::vector<const Partition*> partitions;
+		partitions.push_back(&device.partitions[i]);
+		for (unsigned int j = 0; j < logicals.size(); j++)
+			partitions.push_back(&logicals[j]);
+
+		for (unsigned int j = 0; j < partitions.size(); j++)
+		{
+			FSType fstype = partitions[j]->get_filesystem_partition().fstype;
+			if (fstype == FS_LVM2_PV || fstype == FS_LINUX_SWRAID || fstype == FS_ATARAID ||
+			    fstype == FS_BCACHE                                                          )
+				return true;
+		}
+	}
+	return false;
+}
+
+
+static void load_cache_thread(unsigned int index, const std::vector<sigc::slot<void>>* loaders)
+{
+	GParted_Core::acquire_core_lock();
+	(*loaders)[index]();
+	GParted_Core::release_core_lock();
+}
+
+
+// Run the cache loaders concurrently.  They hold the core lock, as the caches share the
+// BlockSpecial cache, which is released while each waits for its external commands.
+void GParted_Core::load_caches(const std::vector<sigc::slot<void>>& loaders)
+{
+	Utils::run_concurrently(loaders.size(), PROBE_MAX_THREADS,
+	                        sigc::bind(sigc::ptr_fun(&load_cache_thread), &loaders));
+}
+
+
+void GParted_Core::confirm_device(unsigned int index, const std::vector<PedDevice*>* lp_devices,
+                                  std::vector<Glib::ustring>* useable_paths)
+{
+	const PedDevice* lp_device = (*lp_devices)[index];
+	/* TO TRANSLATORS: looks like   Confirming /dev/sda (2 of 5 devices) */
+	set_thread_status_message(Glib::ustring::compose(_("Confirming %1 (%2 of %3 devices)"),
+	                                                 lp_device->path, index + 1, lp_devices->size()));
+
+	// Only add this device if we can read the first sector (which means it's a real
+	// device).  Doesn't use libparted so doesn't need the core lock.
+	if (useable_device(lp_device))
+		(*useable_paths)[index] = lp_device->path;
+}
+
+
+void GParted_Core::probe_device(unsigned int index, const std::vector<Glib::ustring>* device_names,
+                                std::vector<std::unique_ptr<Device>>* devices)
+{
+	/* TO TRANSLATORS: looks like   Searching /dev/sda partitions (2 of 5 devices) */
+	set_thread_status_message(Glib::ustring::compose(_("Searching %1 partitions (%2 of %3 devices)"),
+	                                                 (*device_names)[index], index + 1,
+	                                                 device_names->size()));
+
+	// A command which doesn't respond before its timeout is killed so that only the
+	// device it was searching is affected, rather than the whole scan waiting for it.
+	unsigned int timed_out_count = Utils::get_thread_timed_out_count();
+	std::unique_ptr<Device> temp_device = std::make_unique<Device>();
+	acquire_core_lock();
+	set_device_from_disk(*temp_device, (*device_names)[index]);
+	release_core_lock();
+	if (m_caches_incomplete || Utils::get_thread_timed_out_count() != timed_out_count)
+		set_device_incomplete(*temp_device);
+	(*devices)[index] = std::move(temp_device);
+}
+
+
+// Mark a device whose details may be missing because an external command timed out.
+// Prevent changes to its partition table, as the partitions may be in use in ways not
+// discovered, and report it against every partition.
+void GParted_Core::set_device_incomplete(Device& device)
+{
+	device.incomplete = true;
+	device.readonly   = true;
+	for (unsigned int i = 0; i < device.partitions.size(); i++)
+		device.partitions[i].push_back_message(
+		        /* TO TRANSLATORS: looks like   Searching /dev/sdb did not complete because
+		         * an external command timed out.  Some information may be missing.
+		         */
+		        Glib::ustring::compose(_("Searching %1 did not complete because an external command timed out.  Some information may be missing."),
+		                               device.get_path()));
+}
+
+
 void GParted_Core::set_thread_status_message( Glib::ustring msg )
 {
 	//Remember to clear status message when finished with thread.
+	Glib::Mutex::Lock lock(m_thread_status_mutex);
 	m_thread_status_message = msg;
 }
 
 
 Glib::ustring GParted_Core::get_thread_status_message( )
 {
+	Glib::Mutex::Lock lock(m_thread_status_mutex);
 	return m_thread_status_message;
 }
 
@@ -391,8 +702,13 @@ bool GParted_Core::valid_partition(const Device& device, Partition& partition, G
 
 bool GParted_Core::apply_operation_to_disk( Operation * operation )
 {
+	acquire_core_lock();
 	bool success = false;
-	libparted_messages .clear() ;
+	settle_seconds = 0.0;
+	{
+		Glib::Mutex::Lock lock(libparted_messages_mutex);
+		libparted_messages.clear();
+	}
 	operation->m_operation_detail.signal_capture_errors.connect(
 			sigc::mem_fun( *this, &GParted_Core::capture_libparted_messages ) );
 
@@ -449,6 +765,22 @@ bool GParted_Core::apply_operation_to_disk( Operation * operation )
 			// sequence of operations now being applied.
 			operation->get_partition_new().set_path( operation->get_partition_original().get_path() );
 
+			// A move interrupted in an earlier run of GParted leaves the partition
+			// encompassing both the old and new file system positions.  Resume the
+			// move from the journal rather than resizing and moving again.
+			{
+				MoveJournal journal;
+				if (journal.load_for(operation->get_partition_original()) &&
+				    journal.matches(operation->get_partition_original(), operation->get_partition_new()))
+				{
+					success = resume_move(journal,
+					                      operation->get_partition_original(),
+					                      operation->get_partition_new(),
+					                      operation->m_operation_detail);
+					break;
+				}
+			}
+
 			success = resize_move(operation->get_partition_original(),
 			                      operation->get_partition_new(),
 			                      operation->m_operation_detail);
@@ -512,9 +844,65 @@ bool GParted_Core::apply_operation_to_disk( Operation * operation )
 			break;
 	}
 
+	if (settle_seconds > 0.0)
+		operation->m_operation_detail.add_child(OperationDetail(
+		        /* TO TRANSLATORS: looks like   waited 0.4 seconds for udev to settle devices */
+		        Glib::ustring::compose(_("waited %1 seconds for udev to settle devices"),
+		                               Glib::ustring::format(std::fixed, std::setprecision(1), settle_seconds)),
+		        STATUS_INFO, FONT_ITALIC));
+
+	release_core_lock();
 	return success;
 }
 
+
+// Applying operations and probing devices runs on worker threads, one per independent
+// chain of operations (see OperationScheduler) or per device being probed, with the lock
+// held throughout except while waiting for an external command or block copy to finish.
+// This keeps libparted and the caches single threaded while still overlapping the long
+// running parts of the work on different disks.
+void GParted_Core::acquire_core_lock()
+{
+	core_mutex.lock();
+	core_mutex_held = true;
+}
+
+
+bool GParted_Core::try_acquire_core_lock()
+{
+	if (! core_mutex.trylock())
+		return false;
+	core_mutex_held = true;
+	return true;
+}
+
+
+// Release the lock if held by this thread.  Returns whether it was released so that
+// the caller knows to acquire it again after waiting.
+bool GParted_Core::release_core_lock()
+{
+	if (! core_mutex_held)
+		return false;
+	core_mutex_held = false;
+	core_mutex.unlock();
+	return true;
+}
+
+
+// Return the libparted messages which this thread reports into.
+std::vector<Glib::ustring>* GParted_Core::get_libparted_messages()
+{
+	return (libparted_messages_target != nullptr) ? libparted_messages_target : &libparted_messages;
+}
+
+
+// Report the libparted messages of this thread into messages, as returned by
+// get_libparted_messages() on the thread it works for.
+void GParted_Core::redirect_libparted_messages(std::vector<Glib::ustring>* messages)
+{
+	libparted_messages_target = messages;
+}
+
 bool GParted_Core::set_disklabel( const Device & device, const Glib::ustring & disklabel )
 {
 	const Glib::ustring& device_path = device.get_path();
@@ -1832,7 +2220,173 @@ bool GParted_Core::is_busy(const Glib::ustring& device_path, FSType fstype, cons
 }
 
 
+// Set the file system usage of the partition.  While searching devices this is queued
+// and read in the background by start_reading_usage(), except when read using libparted
+// which needs the open disk.
 void GParted_Core::set_used_sectors( Partition & partition, PedDisk* lp_disk )
+{
+	bool supported      = supported_filesystem(partition.fstype);
+	bool libparted_read = supported && ! partition.busy && get_fs(partition.fstype).read == FS::LIBPARTED;
+	if (m_queue_usage && (supported || partition.busy) && ! libparted_read)
+	{
+		unsigned int i = 0;
+		while (i < m_usage_spindles.size() && m_usage_spindles[i].path != partition.device_path)
+			i++;
+		if (i == m_usage_spindles.size())
+		{
+			UsageSpindle spindle;
+			spindle.path  = partition.device_path;
+			spindle.taken = false;
+			m_usage_spindles.push_back(spindle);
+		}
+		m_usage_spindles[i].partitions.push_back(&partition);
+		return;
+	}
+
+	read_used_sectors(partition, lp_disk);
+}
+
+
+// Start reading the file system usage queued while searching devices.  Partitions are
+// displayed while their usage is read in the background, with signal_usage_read emitted
+// as each one is updated and signal_usage_finished once all have been.  Devices must not
+// be searched again or changed until then.  Returns false when there is nothing to read.
+bool GParted_Core::start_reading_usage()
+{
+	if (m_usage_spindles.empty())
+		return false;
+
+	m_usage_cancel = false;
+	Glib::Thread::create(sigc::mem_fun(*this, &GParted_Core::read_usage_thread), false);
+	return true;
+}
+
+
+// Read the usage of the partitions of the device the user is looking at first.
+void GParted_Core::set_usage_priority_device(const Glib::ustring& device_path)
+{
+	Glib::Mutex::Lock lock(m_usage_mutex);
+	m_usage_priority_path = device_path;
+}
+
+
+// Stop reading usage after the partitions currently being read.  signal_usage_finished
+// is still emitted.
+void GParted_Core::cancel_reading_usage()
+{
+	Glib::Mutex::Lock lock(m_usage_mutex);
+	m_usage_cancel = true;
+}
+
+
+// Usage commands can be slow, and mostly wait for the disk, so the partitions of
+// different disks are read concurrently while the partitions of each disk are read one
+// after another.
+void GParted_Core::read_usage_thread()
+{
+	Utils::set_thread_command_timeout(true);
+	Utils::run_concurrently(m_usage_spindles.size(), USAGE_MAX_THREADS,
+	                        sigc::mem_fun(*this, &GParted_Core::read_spindle_usage));
+	set_thread_status_message("");
+
+	// Cross thread registration of callback (this read_usage_thread() is not
+	// GParted_Core::mainthread where the Glib/Gtk main loop runs the callback).
+	// Must use thread-safe C/Glib g_idle_add().
+	g_idle_add(_usage_finished, this);
+}
+
+
+// Read the usage of the partitions of one disk, taking the disk the user is looking at
+// when it hasn't been read yet, otherwise the next one queued.  Each partition's usage
+// is read into a separate Partition object, as the displayed one is only updated by the
+// main thread, and passed back to it when read.
+void GParted_Core::read_spindle_usage(unsigned int index)
+{
+	m_usage_mutex.lock();
+	unsigned int spindle = m_usage_spindles.size();
+	for (unsigned int i = 0; i < m_usage_spindles.size(); i++)
+	{
+		if (m_usage_spindles[i].taken)
+			continue;
+		if (spindle == m_usage_spindles.size())
+			spindle = i;
+		if (m_usage_spindles[i].path == m_usage_priority_path)
+		{
+			spindle = i;
+			break;
+		}
+	}
+	m_usage_spindles[spindle].taken = true;
+	m_usage_mutex.unlock();
+
+	const std::vector<Partition*>& partitions = m_usage_spindles[spindle].partitions;
+	for (unsigned int i = 0; i < partitions.size(); i++)
+	{
+		m_usage_mutex.lock();
+		bool cancel = m_usage_cancel;
+		m_usage_mutex.unlock();
+		if (cancel)
+			break;
+
+		const Partition& partition = *partitions[i];
+		Partition* result = new Partition();
+		result->Set(partition.device_path,
+		            partition.get_path(),
+		            partition.partition_number,
+		            partition.type,
+		            partition.fstype,
+		            partition.sector_start,
+		            partition.sector_end,
+		            partition.sector_size,
+		            partition.inside_extended,
+		            partition.busy);
+		result->add_mountpoints(partition.get_mountpoints());
+
+		acquire_core_lock();
+		/* TO TRANSLATORS: looks like   Reading /dev/sda1 file system usage */
+		set_thread_status_message(Glib::ustring::compose(_("Reading %1 file system usage"),
+		                                                 partition.get_path()));
+		read_used_sectors(*result, nullptr);
+		release_core_lock();
+
+		UsageCompletion* completion = new UsageCompletion;
+		completion->core      = this;
+		completion->partition = partitions[i];
+		completion->result    = result;
+		g_idle_add(_usage_read, completion);
+	}
+}
+
+
+gboolean GParted_Core::_usage_read(gpointer data)
+{
+	UsageCompletion* completion = static_cast<UsageCompletion*>(data);
+	Partition& partition = *completion->partition;
+	const Partition& result = *completion->result;
+	partition.sectors_used          = result.sectors_used;
+	partition.sectors_unused        = result.sectors_unused;
+	partition.sectors_unallocated   = result.sectors_unallocated;
+	partition.significant_threshold = result.significant_threshold;
+	partition.fs_block_size         = result.fs_block_size;
+	partition.append_messages(result.get_messages());
+	completion->core->signal_usage_read.emit(partition.device_path);
+
+	delete completion->result;
+	delete completion;
+	return false;
+}
+
+
+gboolean GParted_Core::_usage_finished(gpointer data)
+{
+	GParted_Core* core = static_cast<GParted_Core*>(data);
+	core->m_usage_spindles.clear();
+	core->signal_usage_finished.emit();
+	return false;
+}
+
+
+void GParted_Core::read_used_sectors(Partition& partition, PedDisk* lp_disk)
 {
 	if (supported_filesystem(partition.fstype))
 	{
@@ -2466,11 +3020,12 @@ bool GParted_Core::move( const Partition & partition_old,
 	// Make old partition all encompassing and if move file system fails then return
 	// partition table to original state
 	bool success = false;
+	MoveJournal journal;
 	if ( resize_move_partition( partition_old, *partition_all_space, operationdetail, true ) )
 	{
 		// Note move of file system is from old values to new values, not from the
 		// all encompassing values.
-		if ( ! move_filesystem( partition_old, partition_new, operationdetail ) )
+		if ( ! move_filesystem( partition_old, partition_new, operationdetail, journal ) )
 		{
 			operationdetail.add_child( OperationDetail( _("rollback last change to the partition") ) );
 
@@ -2496,11 +3051,17 @@ bool GParted_Core::move( const Partition & partition_old,
 		}
 	}
 
-	// Make new partition from all encompassing partition
+	// Make new partition from all encompassing partition.  Keep the move journal until
+	// the partition has been changed so that an interruption before then can still be
+	// resumed.
 	if ( success )
 	{
-		success =    resize_move_partition( *partition_all_space, partition_new, operationdetail, false )
-		          && update_bootsector( partition_new, operationdetail );
+		success = resize_move_partition( *partition_all_space, partition_new, operationdetail, false );
+		if ( success )
+			journal.end();
+		else
+			journal.close();
+		success = success && update_bootsector( partition_new, operationdetail );
 	}
 
 	delete partition_all_space;
@@ -2518,7 +3079,8 @@ bool GParted_Core::move( const Partition & partition_old,
 
 bool GParted_Core::move_filesystem( const Partition & partition_old,
 		   		    const Partition & partition_new,
-				    OperationDetail & operationdetail ) 
+				    OperationDetail & operationdetail,
+				    MoveJournal & journal )
 {
 	if ( partition_new .sector_start < partition_old .sector_start )
 		operationdetail .add_child( OperationDetail( _("move file system to the left") ) ) ;
@@ -2546,16 +3108,26 @@ bool GParted_Core::move_filesystem( const Partition & partition_old,
 		case FS::GPARTED:
 			if ( partition_new .test_overlap( partition_old ) )
 			{
+				// Journal the progress of the overlapping move so that it can
+				// be resumed if GParted or the computer stops part way through.
+				if ( ! journal.begin( partition_old, partition_new ) )
+					operationdetail.get_last_child().add_child( OperationDetail(
+						Glib::ustring::compose( _("Failed to create move journal %1.  An interrupted move can't be resumed"),
+						                        journal.get_filename() ),
+						STATUS_NONE, FONT_ITALIC ) );
+
 				success = copy_filesystem_internal(partition_old,
 				                                   partition_new,
 				                                   operationdetail.get_last_child(),
 				                                   total_done,
-				                                   true);
+				                                   true,
+				                                   journal.active() ? &journal : nullptr);
 
 				operationdetail.get_last_child().get_last_child()
 				                        .set_success_and_capture_errors(success);
 				if (! success)
 				{
+					journal.end();
 					rollback_move_filesystem( partition_old,
 					                          partition_new,
 					                          operationdetail.get_last_child(),
@@ -2567,7 +3139,8 @@ bool GParted_Core::move_filesystem( const Partition & partition_old,
 				                                   partition_new,
 				                                   operationdetail.get_last_child(),
 				                                   total_done,
-				                                   true);
+				                                   true,
+				                                   nullptr);
 
 			break ;
 		case FS::LIBPARTED:
@@ -2588,6 +3161,72 @@ bool GParted_Core::move_filesystem( const Partition & partition_old,
 }
 
 
+// Complete a move of a file system which was interrupted in an earlier run of GParted,
+// continuing the copy from the last checkpoint in the move journal, then shrink the all
+// encompassing partition to the new position of the file system.
+bool GParted_Core::resume_move( MoveJournal & journal,
+                                const Partition & partition_all_space,
+                                const Partition & partition_new,
+                                OperationDetail & operationdetail )
+{
+	Byte_Value sector_size = journal.get_sector_size();
+	Sector     src_start   = journal.get_src_start();
+	Sector     dst_start   = journal.get_dst_start();
+	Byte_Value length      = journal.get_sector_length() * sector_size;
+	Byte_Value done        = journal.get_done();
+
+	operationdetail.add_child( OperationDetail( Glib::ustring::compose(
+			/*TO TRANSLATORS: looks like   resume interrupted move of file system with 1.00 GiB of 4.00 GiB already moved */
+			_("resume interrupted move of file system with %1 of %2 already moved"),
+			Utils::format_size( done, 1 ), Utils::format_size( length, 1 ) ) ) );
+
+	// Copy the remaining range in the same direction as before.  The data already
+	// moved is at the end of the file system when moving right and at the start when
+	// moving left.  Unused space can't be skipped as the half moved file system's
+	// allocation structures can't be read.
+	bool success = true;
+	Byte_Value remaining = length - done;
+	if ( remaining > 0 )
+	{
+		Sector skip = ( dst_start > src_start ) ? 0 : done / sector_size;
+		Byte_Value total_done = 0;
+		success = copy_blocks( partition_all_space.device_path,
+		                       partition_all_space.device_path,
+		                       src_start + skip,
+		                       dst_start + skip,
+		                       sector_size,
+		                       sector_size,
+		                       remaining,
+		                       ExtentVector( 1, Extent( 0, remaining ) ),
+		                       operationdetail.get_last_child(),
+		                       total_done,
+		                       false,
+		                       &journal );
+	}
+	operationdetail.get_last_child().set_success_and_capture_errors( success );
+	if ( ! success )
+	{
+		// Keep the journal so that the move can be resumed again.
+		journal.close();
+		return false;
+	}
+
+	success = resize_move_partition( partition_all_space, partition_new, operationdetail, false );
+	if ( success )
+		journal.end();
+	else
+		journal.close();
+	if ( ! success || ! update_bootsector( partition_new, operationdetail ) )
+		return false;
+
+	if (partition_new.fstype == FS_LINUX_SWAP)
+		// linux-swap is recreated, not moved
+		return recreate_linux_swap_filesystem( partition_new, operationdetail );
+
+	return check_repair_filesystem( partition_new, operationdetail );
+}
+
+
 bool GParted_Core::resize_move_filesystem_using_libparted( const Partition & partition_old,
 		  	      		            	   const Partition & partition_new,
 						    	   OperationDetail & operationdetail ) 
@@ -2617,7 +3256,17 @@ bool GParted_Core::resize_move_filesystem_using_libparted( const Partition & par
 				lp_geom = ped_geometry_new( lp_device,
 							    partition_new .sector_start,
 							    partition_new .get_sector_length() ) ;
-				if ( lp_geom )
+				if ( lp_geom && Glib::Thread::self() != GParted_Core::mainthread )
+				{
+					// Already applying on a worker thread so the GUI isn't blocked.
+					// Resize with the core lock held as libparted isn't thread safe.
+					return_value = ped_file_system_resize( fs, lp_geom, nullptr );
+					if ( return_value )
+						commit( lp_disk ) ;
+
+					ped_geometry_destroy( lp_geom );
+				}
+				else if ( lp_geom )
 				{
 					// Use thread for libparted FS resize call to avoid blocking GUI
 					Glib::Thread::create( sigc::bind<PedFileSystem *, PedGeometry *, bool *>(
@@ -3339,23 +3988,20 @@ bool GParted_Core::copy_filesystem_internal( const Partition & partition_src,
                                              bool cancel_safe )
 {
 	Sector dummy ;
-	return copy_blocks( partition_src.device_path,
-	                    partition_dst.device_path,
-	                    partition_src.sector_start,
-	                    partition_dst.sector_start,
-	                    partition_src.sector_size,
-	                    partition_dst.sector_size,
-	                    partition_src.get_byte_length(),
-	                    operationdetail,
-	                    dummy,
-	                    cancel_safe );
+	return copy_filesystem_internal( partition_src,
+	                                 partition_dst,
+	                                 operationdetail,
+	                                 dummy,
+	                                 cancel_safe,
+	                                 nullptr );
 }
 
 bool GParted_Core::copy_filesystem_internal( const Partition & partition_src,
                                              const Partition & partition_dst,
                                              OperationDetail & operationdetail,
                                              Byte_Value & total_done,
-                                             bool cancel_safe )
+                                             bool cancel_safe,
+                                             MoveJournal * journal )
 {
 	return copy_blocks( partition_src.device_path,
 	                    partition_dst.device_path,
@@ -3364,11 +4010,34 @@ bool GParted_Core::copy_filesystem_internal( const Partition & partition_src,
 	                    partition_src.sector_size,
 	                    partition_dst.sector_size,
 	                    partition_src.get_byte_length(),
+	                    read_allocation_map( partition_src ),
 	                    operationdetail,
 	                    total_done,
-	                    cancel_safe );
+	                    cancel_safe,
+	                    journal );
 }
-	
+
+
+// Return the allocated extents of the file system in partition so that the internal copy
+// can skip unused space.  Falls back to the whole partition when there is no reader for
+// the file system type or its allocation structures can't be decoded.
+ExtentVector GParted_Core::read_allocation_map( const Partition & partition )
+{
+	Byte_Value length = partition.get_byte_length();
+	ExtentVector extents;
+	FileSystem* p_filesystem = get_filesystem_object(partition.fstype);
+	if (p_filesystem != nullptr)
+	{
+		AllocationMap map(partition.device_path, partition.sector_start * partition.sector_size, length);
+		if (map.open() && p_filesystem->read_allocation_map(map))
+			extents = map.get_extents();
+	}
+	if (extents.empty())
+		extents.push_back(Extent(0, length));
+	return extents;
+}
+
+
 bool GParted_Core::copy_blocks( const Glib::ustring & src_device,
                                 const Glib::ustring & dst_device,
                                 Sector src_start,
@@ -3376,9 +4045,11 @@ bool GParted_Core::copy_blocks( const Glib::ustring & src_device,
                                 Byte_Value src_sector_size,
                                 Byte_Value dst_sector_size,
                                 Byte_Value src_length,
+                                const ExtentVector & extents,
                                 OperationDetail & operationdetail,
                                 Byte_Value & total_done,
-                                bool cancel_safe )
+                                bool cancel_safe,
+                                MoveJournal * journal )
 {
 	operationdetail .add_child( OperationDetail( _("using internal algorithm"), STATUS_NONE ) ) ;
 	operationdetail .add_child( OperationDetail(
@@ -3386,6 +4057,20 @@ bool GParted_Core::copy_blocks( const Glib::ustring & src_device,
 		                  _("copy %1"), Utils::format_size( src_length, 1 ) ),
 		STATUS_NONE ) ) ;
 
+	// Copy whole sectors of both devices and don't bother skipping small gaps between
+	// allocated extents.
+	ExtentVector aligned_extents = AllocationMap::align_extents( extents,
+	                                                             std::max( src_sector_size, dst_sector_size ),
+	                                                             1 * MEBIBYTE,
+	                                                             src_length );
+	Byte_Value allocated_length = AllocationMap::total_length( aligned_extents );
+	if ( allocated_length < src_length )
+		operationdetail .add_child( OperationDetail(
+			Glib::ustring::compose( /*TO TRANSLATORS: looks like  skip 1.00 GiB of unused space */
+			                  _("skip %1 of unused space"),
+			                  Utils::format_size( src_length - allocated_length, 1 ) ),
+			STATUS_NONE ) ) ;
+
 	operationdetail .add_child( OperationDetail( _("finding optimal block size"), STATUS_NONE ) ) ;
 
 	Byte_Value benchmark_blocksize = (1 * MEBIBYTE) ;
@@ -3406,11 +4091,13 @@ bool GParted_Core::copy_blocks( const Glib::ustring & src_device,
 	total_done = 0 ;
 	Byte_Value done = 0 ;
 	Glib::Timer timer ;
-	double smallest_time = 1000000 ;
+	double smallest_time_per_byte = 1000000 ;
 	bool success = true;
 	OperationDetail & benchmark_od = operationdetail.get_last_child();
 
-	//Benchmark copy times using different block sizes to determine optimal size
+	//Benchmark copy times using different block sizes to determine the starting block
+	//  size.  CopyBlocks keeps tuning the block size and queue depth for the rest of
+	//  the copy.
 	while (success                                        &&
 	       llabs(done) + benchmark_copysize <= src_length &&
 	       benchmark_blocksize <= benchmark_copysize        )
@@ -3421,26 +4108,37 @@ bool GParted_Core::copy_blocks( const Glib::ustring & src_device,
 				                       Utils::format_size(benchmark_copysize, 1),
 				                       Utils::format_size(benchmark_blocksize, 1))));
 
+		Byte_Value benchmark_start = ( dst_start > src_start ) ? src_length - benchmark_copysize + done
+		                                                       : done;
+		ExtentVector benchmark_extents = AllocationMap::clip_extents( aligned_extents,
+		                                                              benchmark_start,
+		                                                              benchmark_copysize );
 		timer .reset() ;
 		success = CopyBlocks(src_device,
 		                     dst_device,
 		                     offset_read  + (done / src_sector_size),
 		                     offset_write + (done / dst_sector_size),
 		                     benchmark_copysize,
+		                     benchmark_extents,
 		                     benchmark_blocksize,
 		                     benchmark_od,
 		                     total_done,
 		                     src_length,
-		                     cancel_safe).copy();
+		                     cancel_safe,
+		                     false,
+		                     m_verify_copies,
+		                     journal).copy();
 		timer.stop() ;
 
 		benchmark_od.get_last_child().add_child( OperationDetail(
 			Glib::ustring::compose( _("%1 seconds"), timer .elapsed() ), STATUS_NONE, FONT_ITALIC ) ) ;
 		benchmark_od.get_last_child().set_success_and_capture_errors(success);
 
-		if ( timer .elapsed() <= smallest_time )
+		// Compare time per byte actually copied as unused space is skipped.
+		Byte_Value benchmark_used = AllocationMap::total_length( benchmark_extents );
+		if ( benchmark_used > 0 && timer .elapsed() / benchmark_used <= smallest_time_per_byte )
 		{
-			smallest_time = timer .elapsed() ;
+			smallest_time_per_byte = timer .elapsed() / benchmark_used ;
 			optimal_blocksize = benchmark_blocksize ; 
 		}
 		benchmark_blocksize *= 2 ;
@@ -3471,11 +4169,17 @@ bool GParted_Core::copy_blocks( const Glib::ustring & src_device,
 		                     src_start + ((done > 0 ? done : 0) / src_sector_size),
 		                     dst_start + ((done > 0 ? done : 0) / dst_sector_size),
 		                     remaining_length,
+		                     AllocationMap::clip_extents( aligned_extents,
+		                                                  done > 0 ? done : 0,
+		                                                  remaining_length ),
 		                     optimal_blocksize,
 		                     operationdetail,
 		                     total_done,
 		                     src_length,
-		                     cancel_safe).copy();
+		                     cancel_safe,
+		                     true,
+		                     m_verify_copies,
+		                     journal).copy();
 		operationdetail.get_last_child().set_success_and_capture_errors(success);
 	}
 
@@ -3522,11 +4226,21 @@ void GParted_Core::rollback_move_filesystem( const Partition & partition_src,
 		{
 			operationdetail.add_child( OperationDetail( _("rollback failed file system move") ) );
 
-			//and copy it back (NOTE the reversed dst and src)
-			bool success = copy_filesystem_internal( *temp_dst,
-			                                         *temp_src,
-			                                         operationdetail.get_last_child(),
-			                                         false );
+			//and copy it back (NOTE the reversed dst and src).  Copy all of the
+			//  partially moved range as it isn't a whole file system from which
+			//  an allocation map can be read.
+			Byte_Value dummy;
+			bool success = copy_blocks( temp_dst->device_path,
+			                            temp_src->device_path,
+			                            temp_dst->sector_start,
+			                            temp_src->sector_start,
+			                            temp_dst->sector_size,
+			                            temp_src->sector_size,
+			                            temp_dst->get_byte_length(),
+			                            ExtentVector( 1, Extent( 0, temp_dst->get_byte_length() ) ),
+			                            operationdetail.get_last_child(),
+			                            dummy,
+			                            false );
 
 			operationdetail.get_last_child().set_success_and_capture_errors( success );
 		}
@@ -4235,6 +4949,7 @@ bool GParted_Core::erase_filesystem_signatures( const Partition & partition, Ope
 		if ( device_is_open )
 		{
 			flush_success = ped_device_sync( lp_device ) ;
+			UdevSettle settle(lp_device->path);
 			ped_device_close( lp_device ) ;
 
 			// (#83) Wait for udev rules to complete after this
@@ -4242,7 +4957,7 @@ bool GParted_Core::erase_filesystem_signatures( const Partition & partition, Ope
 			// following file system specific manipulation commands on the
 			// whole disk device in format(), after this
 			// erase_filesystem_signatures().
-			settle_device(SETTLE_DEVICE_APPLY_MAX_WAIT_SECONDS);
+			settle_device(settle, SETTLE_DEVICE_APPLY_MAX_WAIT_SECONDS);
 		}
 		od.get_last_child().set_success_and_capture_errors( flush_success );
 		overall_success = overall_success && flush_success;
@@ -4337,14 +5052,18 @@ bool GParted_Core::update_bootsector(const Partition& partition, OperationDetail
 
 void GParted_Core::capture_libparted_messages( OperationDetail & operationdetail, bool success )
 {
-	if ( libparted_messages.size() > 0 )
+	std::vector<Glib::ustring> messages;
+	libparted_messages_mutex.lock();
+	messages.swap(libparted_messages);
+	libparted_messages_mutex.unlock();
+
+	if ( messages.size() > 0 )
 	{
 		operationdetail.add_child( OperationDetail( _("libparted messages"),
 		                                            success ? STATUS_INFO : STATUS_ERROR ) );
-		for ( unsigned int i = 0 ; i < libparted_messages.size() ; i++ )
+		for ( unsigned int i = 0 ; i < messages.size() ; i++ )
 			operationdetail.get_last_child().add_child(
-					OperationDetail( libparted_messages[i], STATUS_NONE, FONT_ITALIC ) );
-		libparted_messages.clear();
+					OperationDetail( messages[i], STATUS_NONE, FONT_ITALIC ) );
 	}
 }
 
@@ -4372,6 +5091,11 @@ bool GParted_Core::useable_device(const PedDevice* lp_device)
 
 bool GParted_Core::get_device( const Glib::ustring & device_path, PedDevice *& lp_device, bool flush )
 {
+	// Only listen for uevents when ped_device_get() will flush the device.  Start
+	// before it to see the uevents it triggers.
+	std::unique_ptr<UdevSettle> settle;
+	if (flush)
+		settle = std::make_unique<UdevSettle>(device_path);
 	lp_device = ped_device_get(device_path.c_str());
 	if (! lp_device)
 		return false;
@@ -4388,7 +5112,7 @@ bool GParted_Core::get_device( const Glib::ustring & device_path, PedDevice *& l
 		// device FAT32 file system looks like it's partitioned and
 		// ped_device_get() still opens partition devices read-write when
 		// flushing, so still triggers device changes and udev rule execution.
-		settle_device(SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS);
+		settle_device(*settle, SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS);
 	}
 
 	return true;
@@ -4399,13 +5123,14 @@ bool GParted_Core::get_disk(PedDevice *lp_device, PedDisk*& lp_disk)
 {
 	g_assert(lp_device != nullptr);  // Bug: Not initialised by call to ped_device_get() or ped_device_get_next()
 
+	UdevSettle settle(lp_device->path);
 	lp_disk = ped_disk_new(lp_device);
 
 	// (#762941)(!46) After ped_disk_new() wait for triggered udev rules to complete
 	// which remove and re-add all the partition specific /dev entries to avoid FS
 	// specific commands failing because they happen to be running when the needed
 	// /dev/PTN entries don't exist.
-	settle_device(SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS);
+	settle_device(settle, SETTLE_DEVICE_PROBE_MAX_WAIT_SECONDS);
 
 	return (lp_disk != nullptr);
 }
@@ -4452,10 +5177,11 @@ bool GParted_Core::commit( PedDisk* lp_disk )
 
 	if ( opened )
 	{
+		UdevSettle settle(lp_disk->dev->path);
 		ped_device_close( lp_disk->dev );
 		// Wait for udev rules to complete and partition device nodes to settle
 		// from this ped_device_close().
-		settle_device( SETTLE_DEVICE_APPLY_MAX_WAIT_SECONDS );
+		settle_device(settle, SETTLE_DEVICE_APPLY_MAX_WAIT_SECONDS);
 	}
 
 	return success;
@@ -4464,6 +5190,7 @@ bool GParted_Core::commit( PedDisk* lp_disk )
 
 bool GParted_Core::commit_to_os( PedDisk* lp_disk, std::time_t timeout )
 {
+	UdevSettle settle(lp_disk->dev->path);
 	bool success;
 #ifndef USE_LIBPARTED_DMRAID
 	if (DMRaid::is_dmraid_device(lp_disk->dev->path))
@@ -4474,18 +5201,32 @@ bool GParted_Core::commit_to_os( PedDisk* lp_disk, std::time_t timeout )
 
 	// Wait for udev rules to complete and partition device nodes to settle from above
 	// ped_disk_commit_to_os() initiated kernel update of the partitions.
-	settle_device( timeout ) ;
+	settle_device(settle, timeout);
 
 	return success;
 }
 
 
-void GParted_Core::settle_device( std::time_t timeout )
+// Wait for udev rules to complete for just the disk device, and its partitions, being
+// followed by settle.  Falls back to waiting for the whole udev event queue when the
+// uevents couldn't be followed.  Other threads can use libparted and the caches while
+// waiting.
+void GParted_Core::settle_device(UdevSettle& settle, std::time_t timeout)
 {
-	if (udevadm_found)
-		Utils::execute_command( "udevadm settle --timeout=" + Utils::num_to_str( timeout ) ) ;
-	else
-		sleep( timeout ) ;
+	bool relock = release_core_lock();
+	Glib::Timer timer;
+
+	if (! settle.wait(timeout))
+	{
+		if (udevadm_found)
+			Utils::execute_command( "udevadm settle --timeout=" + Utils::num_to_str( timeout ) ) ;
+		else
+			sleep( timeout ) ;
+	}
+
+	settle_seconds += timer.elapsed();
+	if (relock)
+		acquire_core_lock();
 }
 
 PedPartition* GParted_Core::get_lp_partition( const PedDisk* lp_disk, const Partition & partition )
@@ -4546,6 +5287,7 @@ public:
 struct ped_exception_ctx {
 	PedExceptionOption ret;
 	PedException *e;
+	std::vector<Glib::ustring> *messages;
 	Glib::Mutex mutex;
 	Glib::Cond cond;
 };
@@ -4554,7 +5296,9 @@ static bool _ped_exception_handler( struct ped_exception_ctx *ctx )
 {
 	std::cerr << ctx->e->message << std::endl;
 
-	libparted_messages.push_back( ctx->e->message );
+	libparted_messages_mutex.lock();
+	ctx->messages->push_back( ctx->e->message );
+	libparted_messages_mutex.unlock();
 	char optcount = 0;
 	int opt = 0;
 	for( char c = 0; c < 10; c++ )
@@ -4587,6 +5331,7 @@ PedExceptionOption GParted_Core::ped_exception_handler( PedException * e )
 	struct ped_exception_ctx ctx;
 	ctx.ret = PED_EXCEPTION_UNHANDLED;
 	ctx.e = e;
+	ctx.messages = get_libparted_messages();
 	if (Glib::Thread::self() != GParted_Core::mainthread) {
 		ctx.mutex.lock();
 
@@ -48,17 +48,6 @@ const LUKS_Mapping & LUKS_Info::get_cache_entry( const Glib::ustring & path )
 	return get_cache_entry_internal( path );
 }
 
-//Private methods
-
-void LUKS_Info::initialise_if_required()
-{
-	if ( ! cache_initialised )
-	{
-		load_cache();
-		cache_initialised = true;
-	}
-}
-
 void LUKS_Info::load_cache()
 {
 	luks_mapping_cache.clear();
@@ -141,6 +130,17 @@ void LUKS_Info::load_cache()
 
 		luks_mapping_cache.push_back( luks_map );
 	}
+	cache_initialised = true;
+}
+
+//Private methods
+
+void LUKS_Info::initialise_if_required()
+{
+	if ( ! cache_initialised )
+	{
+		load_cache();
+	}
 }
 
 // Return LUKS cache entry for the named underlying block device path,
@@ -154,8 +154,8 @@ const LUKS_Mapping & LUKS_Info::get_cache_entry_internal( const Glib::ustring &
 		{
 			// Store underlying block device path in the BlockSpecial object
 			// if not already known.  Not required, just for completeness.
-			if ( ! luks_mapping_cache[i].container.m_name.length() )
-				luks_mapping_cache[i].container.m_name = path;
+			if ( ! luks_mapping_cache[i].container.get_name().length() )
+				luks_mapping_cache[i].container = bs;
 
 			return luks_mapping_cache[i];
 		}
@@ -21,6 +21,12 @@
 #include "VGDevice.h"
 
 #include <glibmm/miscutils.h>
+#include <glib.h>
+#include <sigc++/functors/ptr_fun.h>
+#include <sigc++/slot.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
 
 
 namespace GParted
@@ -72,6 +78,9 @@ enum LV_BIT
 //                         {"Test_VG5", "testpool", "/dev/Test_VG5/testpool",  209715200,          4194304, true  , 't'    },
 //                         {"Test_VG5", "thinvol0", "/dev/Test_VG5/thinvol0", 1073741824,               -1, true  , 'V'    }
 //                        ]
+//  lvm2_pv_index, lvm2_vg_index, lvm2_lv_index
+//                      - Hash indexes of the above caches by pv_name, vg_name and lv_path
+//                        respectively, giving the position of the first matching entry.
 //  error_messages      - String vector storing whole cache error messages.
 
 
@@ -81,9 +90,211 @@ bool LVM2_Info::lvm_found = false;
 std::vector<LVM2_PV> LVM2_Info::lvm2_pv_cache;
 std::vector<LVM2_VG> LVM2_Info::lvm2_vg_cache;
 std::vector<LVM2_LV> LVM2_Info::lvm2_lv_cache;
+BlockSpecialIndex LVM2_Info::lvm2_pv_index;
+std::unordered_map<std::string, unsigned int> LVM2_Info::lvm2_vg_index;
+std::unordered_map<std::string, unsigned int> LVM2_Info::lvm2_lv_index;
 std::vector<Glib::ustring> LVM2_Info::error_messages;
 
 
+// Minimal streaming reader for the JSON written by "lvm fullreport --reportformat json".
+// It walks the text once without building a document and passes each object found
+// directly in an array, whose members are all strings, to the row_found slot along with
+// the name of the array.  E.g.
+//     {"report": [{"vg": [{"vg_name":"Test_VG3", ...}], "pv": [{"pv_name":"/dev/sdb15", ...}, ...], ...}]}
+// passes ("vg", {vg_name: "Test_VG3", ...}), ("pv", {pv_name: "/dev/sdb15", ...}), ...
+typedef sigc::slot<void, const std::string&, const LVM2_ReportRow&> ReportRowSlot;
+
+static bool parse_json_value(const char*& p, const std::string& array_name, const ReportRowSlot& row_found);
+
+
+static void skip_json_space(const char*& p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+		p++;
+}
+
+
+// Read the 4 hex digits of a \u escape.
+static bool parse_json_hex4(const char* p, gunichar& ch)
+{
+	if (strspn(p, "0123456789abcdefABCDEF") < 4)
+		return false;
+	ch = g_ascii_strtoull(std::string(p, 4).c_str(), nullptr, 16);
+	return true;
+}
+
+
+static bool parse_json_string(const char*& p, std::string& str)
+{
+	if (*p != '"')
+		return false;
+	p++;
+	str.clear();
+	while (*p != '"')
+	{
+		if (*p == '\0')
+			return false;
+		if (*p != '\\')
+		{
+			str += *p++;
+			continue;
+		}
+		p++;
+		switch (*p)
+		{
+			case 'b': str += '\b'; break;
+			case 'f': str += '\f'; break;
+			case 'n': str += '\n'; break;
+			case 'r': str += '\r'; break;
+			case 't': str += '\t'; break;
+			case 'u':
+			{
+				gunichar ch;
+				if (! parse_json_hex4(p + 1, ch))
+					return false;
+				p += 4;
+				if (ch >= 0xD800 && ch <= 0xDBFF)
+				{
+					// Characters outside the Basic Multilingual Plane are
+					// escaped as a UTF-16 surrogate pair, high then low.
+					gunichar low;
+					if (p[1] != '\\' || p[2] != 'u'          ||
+					    ! parse_json_hex4(p + 3, low)          ||
+					    low < 0xDC00 || low > 0xDFFF              )
+						return false;
+					ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+					p += 6;
+				}
+				else if (ch >= 0xDC00 && ch <= 0xDFFF)
+				{
+					return false;  // Low surrogate without a high surrogate
+				}
+				char utf8[6];
+				str.append(utf8, g_unichar_to_utf8(ch, utf8));
+				break;
+			}
+			case '\0': return false;
+			default:  str += *p; break;  // '"', '\\' and '/'
+		}
+		p++;
+	}
+	p++;
+	return true;
+}
+
+
+static bool parse_json_array(const char*& p, const std::string& array_name, const ReportRowSlot& row_found)
+{
+	p++;  // '['
+	skip_json_space(p);
+	if (*p == ']')
+	{
+		p++;
+		return true;
+	}
+	while (true)
+	{
+		if (! parse_json_value(p, array_name, row_found))
+			return false;
+		skip_json_space(p);
+		if (*p == ']')
+		{
+			p++;
+			return true;
+		}
+		if (*p != ',')
+			return false;
+		p++;
+	}
+}
+
+
+static bool parse_json_object(const char*& p, const std::string& array_name, const ReportRowSlot& row_found)
+{
+	p++;  // '{'
+	LVM2_ReportRow row;
+	bool all_strings = true;
+	skip_json_space(p);
+	if (*p == '}')
+	{
+		p++;
+		return true;
+	}
+	while (true)
+	{
+		std::string name;
+		skip_json_space(p);
+		if (! parse_json_string(p, name))
+			return false;
+		skip_json_space(p);
+		if (*p != ':')
+			return false;
+		p++;
+		skip_json_space(p);
+		if (*p == '"')
+		{
+			if (! parse_json_string(p, row[name]))
+				return false;
+		}
+		else
+		{
+			all_strings = false;
+			if (*p == '[')
+			{
+				if (! parse_json_array(p, name, row_found))
+					return false;
+			}
+			else if (! parse_json_value(p, "", row_found))
+				return false;
+		}
+		skip_json_space(p);
+		if (*p == '}')
+		{
+			p++;
+			break;
+		}
+		if (*p != ',')
+			return false;
+		p++;
+	}
+
+	if (all_strings && array_name != "")
+		row_found(array_name, row);
+	return true;
+}
+
+
+static bool parse_json_value(const char*& p, const std::string& array_name, const ReportRowSlot& row_found)
+{
+	skip_json_space(p);
+	if (*p == '{')
+		return parse_json_object(p, array_name, row_found);
+	if (*p == '[')
+		return parse_json_array(p, "", row_found);
+	if (*p == '"')
+	{
+		std::string str;
+		return parse_json_string(p, str);
+	}
+
+	// Number, true, false or null.
+	const char* start = p;
+	while (*p != '\0' && strchr(",]} \t\n\r", *p) == nullptr)
+		p++;
+	return p > start;
+}
+
+
+// Return the named field of a report row, or "" when not present.
+static Glib::ustring get_report_field(const LVM2_ReportRow& row, const char* name)
+{
+	LVM2_ReportRow::const_iterator it = row.find(name);
+	if (it == row.end())
+		return "";
+	return it->second;
+}
+
+
 bool LVM2_Info::is_lvm2_supported()
 {
 	set_command_found() ;
@@ -96,10 +307,21 @@ void LVM2_Info::clear_cache()
 	lvm2_pv_cache.clear();
 	lvm2_vg_cache.clear();
 	lvm2_lv_cache.clear();
+	lvm2_pv_index.clear();
+	lvm2_vg_index.clear();
+	lvm2_lv_index.clear();
 	lvm2_info_cache_initialized = false;
 }
 
 
+void LVM2_Info::load_cache()
+{
+	set_command_found();
+	load_lvm2_info_cache();
+	lvm2_info_cache_initialized = true;
+}
+
+
 const Glib::ustring& LVM2_Info::get_vg_name_for_pv(const Glib::ustring& path)
 {
 	initialize_if_required() ;
@@ -197,7 +419,7 @@ std::vector<Glib::ustring> LVM2_Info::get_vg_members(const Glib::ustring& vgname
 	{
 		if ( vgname == lvm2_pv_cache[i].vg_name )
 		{
-			members.push_back( lvm2_pv_cache[i].pv_name.m_name );
+			members.push_back( lvm2_pv_cache[i].pv_name.get_name() );
 		}
 	}
 
@@ -294,7 +516,7 @@ std::unique_ptr<VGDevice> LVM2_Info::make_vgdevice(const Glib::ustring& vgname)
 	for (unsigned int j = 0; j < lvm2_pv_cache.size(); j++)
 	{
 		if (lvm2_pv_cache[j].vg_name == vg.vg_name)
-			vgdev->pv_paths.push_back(lvm2_pv_cache[j].pv_name.m_name);
+			vgdev->pv_paths.push_back(lvm2_pv_cache[j].pv_name.get_name());
 	}
 
 	for (unsigned int j = 0; j < lvm2_lv_cache.size(); j++)
@@ -338,11 +560,7 @@ std::vector<Glib::ustring> LVM2_Info::get_error_messages(const Glib::ustring& pa
 void LVM2_Info::initialize_if_required()
 {
 	if (! lvm2_info_cache_initialized)
-	{
-		set_command_found() ;
-		load_lvm2_info_cache();
-		lvm2_info_cache_initialized = true;
-	}
+		load_cache();
 }
 
 
@@ -361,9 +579,16 @@ void LVM2_Info::load_lvm2_info_cache()
 	lvm2_pv_cache .clear() ;
 	lvm2_vg_cache.clear();
 	lvm2_lv_cache.clear();
+	lvm2_pv_index.clear();
+	lvm2_vg_index.clear();
+	lvm2_lv_index.clear();
 	error_messages .clear() ;
 	if ( lvm_found )
 	{
+		// Try reading everything with a single lvm command first.
+		if (load_lvm2_fullreport())
+			return;
+
 		//The OS is expected to fully enable LVM, this scan does
 		//  not do the full job.  It is included incase anything
 		//  is changed not using lvm commands.
@@ -392,14 +617,8 @@ void LVM2_Info::load_lvm2_info_cache()
 					Utils::split( Utils::trim( lines[i] ), fields, "," );
 					if ( fields.size() < PVFIELD_COUNT )
 						continue;  // Not enough fields
-					if ( fields[PVFIELD_PV_NAME] == "" )
-						continue;  // Empty PV name
-					LVM2_PV pv;
-					pv.pv_name = BlockSpecial( fields[PVFIELD_PV_NAME] );
-					pv.pv_size = lvm2_size_to_num(fields[PVFIELD_PV_SIZE]);
-					pv.pv_free = lvm2_size_to_num(fields[PVFIELD_PV_FREE]);
-					pv.vg_name = fields[PVFIELD_VG_NAME];
-					lvm2_pv_cache.push_back( pv );
+					add_pv(fields[PVFIELD_PV_NAME], fields[PVFIELD_PV_SIZE],
+					       fields[PVFIELD_PV_FREE], fields[PVFIELD_VG_NAME]);
 				}
 			}
 		}
@@ -437,16 +656,9 @@ void LVM2_Info::load_lvm2_info_cache()
 					Utils::split(Utils::trim(lines[i]), fields, ",");
 					if (fields.size() < VGDEVFIELD_COUNT)
 						continue;  // Not enough fields
-					if (fields[VGDEVFIELD_VG_NAME] == "")
-						continue;
-					LVM2_VG vg;
-					vg.vg_name  = fields[VGDEVFIELD_VG_NAME];
-					vg.vg_attr  = fields[VGDEVFIELD_VG_ATTR];
-					vg.pe_size  = lvm2_size_to_num(fields[VGDEVFIELD_VG_EXTENT_SIZE]);
-					vg.total_pe = lvm2_size_to_num(fields[VGDEVFIELD_VG_EXTENT_COUNT]);
-					vg.free_pe  = lvm2_size_to_num(fields[VGDEVFIELD_VG_FREE_COUNT]);
-					vg.uuid     = fields[VGDEVFIELD_VG_UUID];
-					lvm2_vg_cache.push_back(vg);
+					add_vg(fields[VGDEVFIELD_VG_NAME], fields[VGDEVFIELD_VG_ATTR],
+					       fields[VGDEVFIELD_VG_EXTENT_SIZE], fields[VGDEVFIELD_VG_EXTENT_COUNT],
+					       fields[VGDEVFIELD_VG_FREE_COUNT], fields[VGDEVFIELD_VG_UUID]);
 				}
 			}
 		}
@@ -484,28 +696,9 @@ void LVM2_Info::load_lvm2_info_cache()
 					Utils::split(Utils::trim(lines[i] ), fields, ",");
 					if (fields.size() < LVFIELD_COUNT)
 						continue;  // Not enough fields
-					// Thin-pool LVs have an empty lv_path (LVM does not give them
-					// that property), so skip on an empty lv_name instead.  A
-					// thin pool can still be queried via its full path, which is
-					// synthesised below.
-					if (fields[LVFIELD_VG_NAME] == "" || fields[LVFIELD_LV_NAME] == "")
-						continue;
-					LVM2_LV lv;
-					lv.vg_name = fields[LVFIELD_VG_NAME];
-					lv.lv_name = fields[LVFIELD_LV_NAME];
-					lv.lv_path = fields[LVFIELD_LV_PATH];
-					if (lv.lv_path == "")
-						lv.lv_path = "/dev/" + lv.vg_name + "/" + lv.lv_name;
-					lv.lv_size = lvm2_size_to_num(fields[LVFIELD_LV_SIZE]);
-					// Thin pools report a metadata (tmeta) size; other LVs
-					// leave this column empty, parsing to -1.
-					lv.lv_metadata_size = lvm2_size_to_num(fields[LVFIELD_LV_METADATA_SIZE]);
-					lv.active  = (fields[LVFIELD_LV_ATTR].size() >= 5   &&
-					              fields[LVFIELD_LV_ATTR][4]     == 'a'   );
-					lv.segtype = (fields[LVFIELD_LV_ATTR].size() >= 1)
-					             ? static_cast<char>(fields[LVFIELD_LV_ATTR][0])
-					             : '\0';
-					lvm2_lv_cache.push_back(lv);
+					add_lv(fields[LVFIELD_VG_NAME], fields[LVFIELD_LV_NAME],
+					       fields[LVFIELD_LV_PATH], fields[LVFIELD_LV_SIZE],
+					       fields[LVFIELD_LV_METADATA_SIZE], fields[LVFIELD_LV_ATTR]);
 				}
 			}
 		}
@@ -532,30 +725,160 @@ void LVM2_Info::load_lvm2_info_cache()
 }
 
 
-// Performs linear search of the PV cache to find the first matching pv_name.
-// Returns found cache entry or not found substitute.
-const LVM2_PV& LVM2_Info::get_pv_cache_entry_by_name(const Glib::ustring& pvname)
+// Load the PV, VG and LV caches from a single "lvm fullreport" command, which only scans
+// the devices once, instead of separate vgscan, pvs, vgs and lvs commands.  Returns false
+// when not possible, such as with lvm versions before 2.02.158 without JSON reports, so
+// that the caller can fall back to the separate commands.
+bool LVM2_Info::load_lvm2_fullreport()
+{
+	Glib::ustring cmd = "lvm fullreport --config \"log{command_names=0}\" --reportformat json "
+	                    "--nosuffix --units b "
+	                    "--configreport pv -o pv_name,pv_size,pv_free,vg_name "
+	                    "--configreport vg -o vg_name,vg_attr,vg_extent_size,vg_extent_count,vg_free_count,vg_uuid "
+	                    "--configreport lv -o vg_name,lv_name,lv_path,lv_size,lv_metadata_size,lv_attr "
+	                    "--configreport pvseg -o pvseg_start --configreport seg -o seg_start";
+	Glib::ustring output;
+	Glib::ustring error;
+	if (Utils::execute_command(cmd, output, error, true) != 0)
+		return false;
+
+	return parse_lvm2_fullreport(output);
+}
+
+
+// Load the PV, VG and LV caches from the JSON output of "lvm fullreport".  Returns false,
+// leaving the caches empty, when the output can't be parsed.
+bool LVM2_Info::parse_lvm2_fullreport(const Glib::ustring& output)
 {
-	BlockSpecial bs_pvname( pvname );
-	for ( unsigned int i = 0 ; i < lvm2_pv_cache.size() ; i ++ )
+	const char* p = output.c_str();
+	if (! parse_json_value(p, "", sigc::ptr_fun(&add_report_row)))
 	{
-		if ( bs_pvname == lvm2_pv_cache[i].pv_name )
-			return lvm2_pv_cache[i];
+		lvm2_pv_cache.clear();
+		lvm2_vg_cache.clear();
+		lvm2_lv_cache.clear();
+		lvm2_pv_index.clear();
+		lvm2_vg_index.clear();
+		lvm2_lv_index.clear();
+		return false;
 	}
+
+	// The report is grouped by VG.  Order PVs by name, the same as the pvs command.
+	std::stable_sort(lvm2_pv_cache.begin(), lvm2_pv_cache.end(),
+	                 [](const LVM2_PV& lhs, const LVM2_PV& rhs)
+	                 { return lhs.pv_name.get_name() < rhs.pv_name.get_name(); });
+	lvm2_pv_index.clear();
+	for (unsigned int i = 0; i < lvm2_pv_cache.size(); i++)
+		lvm2_pv_index.add(lvm2_pv_cache[i].pv_name, i);
+	return true;
+}
+
+
+void LVM2_Info::add_report_row(const std::string& report, const LVM2_ReportRow& row)
+{
+	if (report == "pv")
+	{
+		// Orphan PVs are reported in the "#orphans_lvm2" VG by some lvm versions.
+		Glib::ustring vg_name = get_report_field(row, "vg_name");
+		if (vg_name.compare(0, 1, "#") == 0)
+			vg_name.clear();
+		add_pv(get_report_field(row, "pv_name"), get_report_field(row, "pv_size"),
+		       get_report_field(row, "pv_free"), vg_name);
+	}
+	else if (report == "vg")
+	{
+		if (get_report_field(row, "vg_name").compare(0, 1, "#") == 0)
+			return;
+		add_vg(get_report_field(row, "vg_name"), get_report_field(row, "vg_attr"),
+		       get_report_field(row, "vg_extent_size"), get_report_field(row, "vg_extent_count"),
+		       get_report_field(row, "vg_free_count"), get_report_field(row, "vg_uuid"));
+	}
+	else if (report == "lv")
+	{
+		add_lv(get_report_field(row, "vg_name"), get_report_field(row, "lv_name"),
+		       get_report_field(row, "lv_path"), get_report_field(row, "lv_size"),
+		       get_report_field(row, "lv_metadata_size"), get_report_field(row, "lv_attr"));
+	}
+}
+
+
+void LVM2_Info::add_pv(const Glib::ustring& pv_name, const Glib::ustring& pv_size,
+                       const Glib::ustring& pv_free, const Glib::ustring& vg_name)
+{
+	if (pv_name == "")
+		return;  // Empty PV name
+	LVM2_PV pv;
+	pv.pv_name = BlockSpecial(pv_name);
+	pv.pv_size = lvm2_size_to_num(pv_size);
+	pv.pv_free = lvm2_size_to_num(pv_free);
+	pv.vg_name = vg_name;
+	lvm2_pv_index.add(pv.pv_name, lvm2_pv_cache.size());
+	lvm2_pv_cache.push_back(pv);
+}
+
+
+void LVM2_Info::add_vg(const Glib::ustring& vg_name, const Glib::ustring& vg_attr,
+                       const Glib::ustring& extent_size, const Glib::ustring& extent_count,
+                       const Glib::ustring& free_count, const Glib::ustring& vg_uuid)
+{
+	if (vg_name == "")
+		return;
+	LVM2_VG vg;
+	vg.vg_name  = vg_name;
+	vg.vg_attr  = vg_attr;
+	vg.pe_size  = lvm2_size_to_num(extent_size);
+	vg.total_pe = lvm2_size_to_num(extent_count);
+	vg.free_pe  = lvm2_size_to_num(free_count);
+	vg.uuid     = vg_uuid;
+	lvm2_vg_index.emplace(vg.vg_name.raw(), lvm2_vg_cache.size());
+	lvm2_vg_cache.push_back(vg);
+}
+
+
+void LVM2_Info::add_lv(const Glib::ustring& vg_name, const Glib::ustring& lv_name,
+                       const Glib::ustring& lv_path, const Glib::ustring& lv_size,
+                       const Glib::ustring& lv_metadata_size, const Glib::ustring& lv_attr)
+{
+	// Thin-pool LVs have an empty lv_path (LVM does not give them that property), so
+	// skip on an empty lv_name instead.  A thin pool can still be queried via its
+	// full path, which is synthesised below.
+	if (vg_name == "" || lv_name == "")
+		return;
+	LVM2_LV lv;
+	lv.vg_name = vg_name;
+	lv.lv_name = lv_name;
+	lv.lv_path = lv_path;
+	if (lv.lv_path == "")
+		lv.lv_path = "/dev/" + lv.vg_name + "/" + lv.lv_name;
+	lv.lv_size = lvm2_size_to_num(lv_size);
+	// Thin pools report a metadata (tmeta) size; other LVs leave this field empty,
+	// parsing to -1.
+	lv.lv_metadata_size = lvm2_size_to_num(lv_metadata_size);
+	lv.active  = (lv_attr.size() >= 5 && lv_attr[4] == 'a');
+	lv.segtype = (lv_attr.size() >= 1) ? static_cast<char>(lv_attr[0]) : '\0';
+	lvm2_lv_index.emplace(lv.lv_path.raw(), lvm2_lv_cache.size());
+	lvm2_lv_cache.push_back(lv);
+}
+
+
+// Looks up the first matching pv_name in the PV cache index.
+// Returns found cache entry or not found substitute.
+const LVM2_PV& LVM2_Info::get_pv_cache_entry_by_name(const Glib::ustring& pvname)
+{
+	int i = lvm2_pv_index.find(pvname);
+	if (i >= 0)
+		return lvm2_pv_cache[i];
 	static LVM2_PV not_found;  // {BlockSpecial(), -1, -1, ""}
 	return not_found;
 }
 
 
-// Performs linear search of the VG cache to find the first matching vg_name.
+// Looks up the first matching vg_name in the VG cache index.
 // Returns found cache entry or not found substitute.
 const LVM2_VG& LVM2_Info::get_vg_cache_entry_by_name(const Glib::ustring& vgname)
 {
-	for ( unsigned int i = 0 ; i < lvm2_vg_cache.size() ; i ++ )
-	{
-		if ( vgname == lvm2_vg_cache[i].vg_name )
-			return lvm2_vg_cache[i];
-	}
+	std::unordered_map<std::string, unsigned int>::const_iterator it = lvm2_vg_index.find(vgname.raw());
+	if (it != lvm2_vg_index.end())
+		return lvm2_vg_cache[it->second];
 	static LVM2_VG not_found;  // {"", "", -1, -1, -1, ""}
 	return not_found;
 }
@@ -564,11 +887,9 @@ const LVM2_VG& LVM2_Info::get_vg_cache_entry_by_name(const Glib::ustring& vgname
 const LVM2_LV& LVM2_Info::get_lv_cache_entry_by_path(const Glib::ustring& lv_path)
 {
 	initialize_if_required();
-	for (unsigned int i = 0; i < lvm2_lv_cache.size(); i++)
-	{
-		if (lvm2_lv_cache[i].lv_path == lv_path)
-			return lvm2_lv_cache[i];
-	}
+	std::unordered_map<std::string, unsigned int>::const_iterator it = lvm2_lv_index.find(lv_path.raw());
+	if (it != lvm2_lv_index.end())
+		return lvm2_lv_cache[it->second];
 	static LVM2_LV not_found;  // {"", "", "", -1, -1, false, '\0'}
 	return not_found;
 }
@@ -244,7 +244,7 @@ bool Mount_Info::have_rootfs_dev( MountMapping & map )
 	{
 		if ( ! iter_mp->second.mountpoints.empty() && iter_mp->second.mountpoints[0] == "/" )
 		{
-			if ( iter_mp->first.m_name != "rootfs" && iter_mp->first.m_name != "/dev/root" )
+			if ( iter_mp->first.get_name() != "rootfs" && iter_mp->first.get_name() != "/dev/root" )
 				return true;
 		}
 	}
@@ -291,15 +291,15 @@ const MountEntry& Mount_Info::find(MountMapping& map, const Glib::ustring& path)
 	std::vector<BlockSpecial> ref_nodes;
 	for (iter_mp = map.begin(); iter_mp != map.end(); ++iter_mp)
 	{
-		if (iter_mp->first.m_name.compare(0, 5, "UUID=")  == 0 ||
-		    iter_mp->first.m_name.compare(0, 6, "LABEL=") == 0   )
+		if (iter_mp->first.get_name().compare(0, 5, "UUID=")  == 0 ||
+		    iter_mp->first.get_name().compare(0, 6, "LABEL=") == 0   )
 		{
 			ref_nodes.push_back(iter_mp->first);
 		}
 	}
 	for (unsigned i = 0; i < ref_nodes.size(); i++)
 	{
-		Glib::ustring node = lookup_uuid_or_label(ref_nodes[i].m_name);
+		Glib::ustring node = lookup_uuid_or_label(ref_nodes[i].get_name());
 		if (! node.empty())
 		{
 			// Insert new mount entry and delete the old one.
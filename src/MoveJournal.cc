@@ -0,0 +1,268 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MoveJournal.h"
+#include "Partition.h"
+#include "Utils.h"
+
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <glibmm/ustring.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+static const char*      JOURNAL_HEADER       = "GParted move journal 1";
+static const char*      JOURNAL_PREFIX       = "move-journal-";
+
+// Most bytes copied between checkpoints.  Bounds the work repeated after resuming and
+// how often the destination is flushed.
+static const Byte_Value JOURNAL_MAX_INTERVAL = 256 * MEBIBYTE;
+
+
+// Start journalling the move of the file system in partition_old to the position of
+// partition_new.
+bool MoveJournal::begin(const Partition& partition_old, const Partition& partition_new)
+{
+	m_device_path      = partition_old.device_path;
+	m_partition_number = partition_old.partition_number;
+	m_sector_size      = partition_old.sector_size;
+	m_fstype           = partition_old.fstype;
+	m_all_space_start  = std::min(partition_old.sector_start, partition_new.sector_start);
+	m_all_space_end    = std::max(partition_old.sector_end, partition_new.sector_end);
+	m_src_start        = partition_old.sector_start;
+	m_dst_start        = partition_new.sector_start;
+	m_sector_length    = partition_old.get_sector_length();
+	m_done             = 0;
+	m_done_base        = 0;
+	m_active           = write();
+	return m_active;
+}
+
+
+// Load the journal left by an interrupted move, ready to continue checkpointing after
+// the progress already recorded.
+bool MoveJournal::load(const Glib::ustring& filename)
+{
+	m_active = false;
+	std::ifstream in(filename.c_str());
+	std::string line;
+	if (! std::getline(in, line) || line != JOURNAL_HEADER)
+		return false;
+
+	int fields = 0;
+	while (std::getline(in, line))
+	{
+		std::string::size_type eq = line.find('=');
+		if (eq == std::string::npos)
+			continue;
+		std::string key   = line.substr(0, eq);
+		std::string value = line.substr(eq + 1);
+		long long   num   = atoll(value.c_str());
+		if (key == "device")                { m_device_path      = value;                    fields++; }
+		else if (key == "partition_number") { m_partition_number = num;                      fields++; }
+		else if (key == "sector_size")      { m_sector_size      = num;                      fields++; }
+		else if (key == "fstype")           { m_fstype           = static_cast<FSType>(num); fields++; }
+		else if (key == "all_space_start")  { m_all_space_start  = num;                      fields++; }
+		else if (key == "all_space_end")    { m_all_space_end    = num;                      fields++; }
+		else if (key == "src_start")        { m_src_start        = num;                      fields++; }
+		else if (key == "dst_start")        { m_dst_start        = num;                      fields++; }
+		else if (key == "sector_length")    { m_sector_length    = num;                      fields++; }
+		else if (key == "done")             { m_done             = num;                      fields++; }
+	}
+	if (fields != 10 || m_sector_size <= 0 || m_sector_length <= 0 || m_src_start == m_dst_start ||
+	    m_done < 0 || m_done > m_sector_length * m_sector_size                                     )
+		return false;
+
+	m_done_base = m_done;
+	m_active    = filename == get_filename();
+	return m_active;
+}
+
+
+// Load the journal, if any, of an interrupted move of the file system in partition.
+bool MoveJournal::load_for(const Partition& partition)
+{
+	m_device_path      = partition.device_path;
+	m_partition_number = partition.partition_number;
+	return load(get_filename());
+}
+
+
+// Record that done bytes, from the copy edge, have been copied by this run and are
+// durably on the destination.
+bool MoveJournal::checkpoint(Byte_Value done)
+{
+	if (! m_active)
+		return false;
+	m_done = m_done_base + done;
+	return write();
+}
+
+
+// Stop journalling, leaving the journal file so that the move can be resumed.
+void MoveJournal::close()
+{
+	m_active = false;
+}
+
+
+// Stop journalling and remove the journal file as the move has either completed or been
+// rolled back.
+void MoveJournal::end()
+{
+	if (! m_active)
+		return;
+	m_active = false;
+	g_unlink(get_filename().c_str());
+}
+
+
+// Is the journal for the move from the all encompassing partition to the new partition?
+bool MoveJournal::matches(const Partition& partition_all_space, const Partition& partition_new) const
+{
+	return m_active                                                              &&
+	       partition_all_space.device_path      == m_device_path                 &&
+	       partition_all_space.partition_number == m_partition_number            &&
+	       partition_all_space.sector_start     == m_all_space_start             &&
+	       partition_all_space.sector_end       == m_all_space_end               &&
+	       partition_new.sector_start           == m_dst_start                   &&
+	       partition_new.sector_end             == m_dst_start + m_sector_length - 1;
+}
+
+
+// Most bytes which may be written between checkpoints.  When resuming, the range after
+// the last checkpoint is copied again from the source so writes must not have reached the
+// source sectors of that range.  Writes land the move distance ahead of the data being
+// read so limit the bytes between checkpoints to the distance.
+Byte_Value MoveJournal::get_checkpoint_interval() const
+{
+	Byte_Value distance = llabs(m_dst_start - m_src_start) * m_sector_size;
+	return std::min(distance, JOURNAL_MAX_INTERVAL);
+}
+
+
+static Glib::ustring get_journal_dir()
+{
+	return Glib::build_filename(Glib::get_user_data_dir(), "gparted");
+}
+
+
+// Name of the journal file for the partition, like
+// ~/.local/share/gparted/move-journal-sda-3.
+Glib::ustring MoveJournal::get_filename() const
+{
+	return Glib::build_filename(get_journal_dir(),
+	                            JOURNAL_PREFIX + Glib::path_get_basename(m_device_path) + "-" +
+	                            Utils::num_to_str(m_partition_number));
+}
+
+
+// Return the names of all journal files left by interrupted moves.
+std::vector<Glib::ustring> MoveJournal::find_journals()
+{
+	std::vector<Glib::ustring> filenames;
+	try
+	{
+		Glib::Dir dir(get_journal_dir());
+		for (Glib::Dir::iterator it = dir.begin(); it != dir.end(); ++it)
+		{
+			Glib::ustring name = *it;
+			if (name.compare(0, strlen(JOURNAL_PREFIX), JOURNAL_PREFIX) == 0 &&
+			    name.find('.') == Glib::ustring::npos                             )
+				filenames.push_back(Glib::build_filename(get_journal_dir(), name));
+		}
+	}
+	catch (const Glib::FileError&)
+	{
+		// No journal directory so no journals.
+	}
+	return filenames;
+}
+
+
+// Atomically replace the journal file with the current state, making it durable before
+// returning.
+bool MoveJournal::write() const
+{
+	std::ostringstream out;
+	out << JOURNAL_HEADER << "\n"
+	    << "device="           << m_device_path      << "\n"
+	    << "partition_number=" << m_partition_number << "\n"
+	    << "sector_size="      << m_sector_size      << "\n"
+	    << "fstype="           << m_fstype           << "\n"
+	    << "all_space_start="  << m_all_space_start  << "\n"
+	    << "all_space_end="    << m_all_space_end    << "\n"
+	    << "src_start="        << m_src_start        << "\n"
+	    << "dst_start="        << m_dst_start        << "\n"
+	    << "sector_length="    << m_sector_length    << "\n"
+	    << "done="             << m_done             << "\n";
+	std::string contents = out.str();
+
+	Glib::ustring filename = get_filename();
+	Glib::ustring dirname  = get_journal_dir();
+	Glib::ustring tmpname  = filename + ".new";
+	if (g_mkdir_with_parents(dirname.c_str(), 0700) != 0)
+		return false;
+
+	int fd = open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return false;
+	const char* p     = contents.data();
+	size_t      count = contents.size();
+	bool        ok    = true;
+	while (ok && count > 0)
+	{
+		ssize_t n = ::write(fd, p, count);
+		if (n < 0 && errno == EINTR)
+			continue;
+		ok     = n > 0;
+		p     += (ok ? n : 0);
+		count -= (ok ? n : 0);
+	}
+	ok = fsync(fd) == 0 && ok;
+	ok = ::close(fd) == 0 && ok;
+	if (! ok || rename(tmpname.c_str(), filename.c_str()) != 0)
+	{
+		g_unlink(tmpname.c_str());
+		return false;
+	}
+
+	// Make the rename durable too.
+	int dir_fd = open(dirname.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir_fd < 0)
+		return false;
+	ok = fsync(dir_fd) == 0;
+	::close(dir_fd);
+	return ok;
+}
+
+
+}  // namespace GParted
@@ -17,21 +17,14 @@
 
 #include "OperationDetail.h"
 
-#include "PipeCapture.h"
+#include "CommandRunner.h"
 #include "ProgressBar.h"
 #include "Utils.h"
 
-#include <cerrno>
 #include <ctime>
-#include <fcntl.h>
 #include <glibmm/exception.h>
-#include <glibmm/main.h>
 #include <glibmm/markup.h>
-#include <glibmm/shell.h>
-#include <glibmm/spawn.h>
-#include <glibmm/stringutils.h>
 #include <glibmm/ustring.h>
-#include <gtkmm/main.h>
 #include <iostream>
 #include <memory>
 #include <sigc++/bind.h>
@@ -39,8 +32,6 @@
 #include <sigc++/signal.h>
 #include <signal.h>
 #include <stddef.h>
-#include <string.h>
-#include <unistd.h>
 #include <vector>
 
 
@@ -52,44 +43,20 @@ namespace  // unnamed
 {
 
 
-// The single progress bar for the current operation
+// The single progress bar for operations which haven't been given their own
 static ProgressBar single_progressbar;
 
 
-// Single set of coordination data between execute_command_internal() and helpers
-static struct CommandStatus
+// Captured output of the command being run by execute_command_internal().  One per
+// thread as operations on different disks are applied concurrently on worker threads.
+// Progress tracking callbacks run in the same thread while the command is waited for.
+struct CommandOutput
 {
-	bool          running     = false;
-	int           pipecount   = 0;
 	Glib::ustring output;
 	Glib::ustring error;
-	int           exit_status = 0;
-} cmd_status;
+};
 
-
-static void setup_child_process()
-{
-	setpgrp();
-}
-
-
-static void execute_command_eof()
-{
-	if (--cmd_status.pipecount)
-		return;  // Wait for second pipe to encounter EOF.
-	if (! cmd_status.running)  // Already got exit status.
-		Gtk::Main::quit();
-}
-
-
-static void store_exit_status(GPid pid, int status)
-{
-	cmd_status.exit_status = Utils::decode_wait_status(status);
-	cmd_status.running = false;
-	if (cmd_status.pipecount == 0)  // Both pipes finished first.
-		Gtk::Main::quit();
-	Glib::spawn_close_pid(pid);
-}
+static thread_local CommandOutput cmd_output;
 
 
 static void update_command_output(OperationDetail* operationdetail, Glib::ustring* str)
@@ -98,10 +65,10 @@ static void update_command_output(OperationDetail* operationdetail, Glib::ustrin
 }
 
 
-static void cancel_command(bool force, Glib::Pid pid, bool cancel_safe)
+static void cancel_command(bool force, CommandRunner* runner, bool cancel_safe)
 {
 	if (force || cancel_safe)
-		kill(-pid, SIGINT);
+		runner->send_signal(SIGINT);
 }
 
 
@@ -253,6 +220,7 @@ void OperationDetail::add_child( const OperationDetail & operationdetail )
 	child->m_time_start        = operationdetail.m_time_start;
 	child->m_time_elapsed      = operationdetail.m_time_elapsed;
 	child->m_no_more_children  = operationdetail.m_no_more_children;
+	child->m_progressbar       = this->m_progressbar;
 	child->m_connection_cancel = this->signal_cancel.connect(
 	                                sigc::mem_fun(child, &OperationDetail::cancel));
 
@@ -335,17 +303,19 @@ OperationDetail & OperationDetail::get_last_child()
 
 void OperationDetail::run_progressbar( double progress, double target, ProgressBar_Text text_mode )
 {
-	if ( ! single_progressbar.running() )
-		single_progressbar.start( target, text_mode );
-	single_progressbar.update( progress );
+	ProgressBar& progressbar = get_progressbar();
+	if ( ! progressbar.running() )
+		progressbar.start( target, text_mode );
+	progressbar.update( progress );
 	signal_update.emit( *this );
 }
 
 void OperationDetail::stop_progressbar()
 {
-	if ( single_progressbar.running() )
+	ProgressBar& progressbar = get_progressbar();
+	if ( progressbar.running() )
 	{
-		single_progressbar.stop();
+		progressbar.stop();
 		signal_update.emit( *this );
 	}
 }
@@ -391,13 +361,13 @@ int OperationDetail::execute_command(const Glib::ustring& command, ExecFlags fla
 
 const Glib::ustring& OperationDetail::get_command_output()
 {
-	return cmd_status.output;
+	return cmd_output.output;
 }
 
 
 const Glib::ustring& OperationDetail::get_command_error()
 {
-	return cmd_status.error;
+	return cmd_output.error;
 }
 
 
@@ -422,102 +392,73 @@ void OperationDetail::cancel( bool force )
 
 const ProgressBar& OperationDetail::get_progressbar() const
 {
+	if (m_progressbar != nullptr)
+		return *m_progressbar;
 	return single_progressbar;
 }
 
 
+ProgressBar& OperationDetail::get_progressbar()
+{
+	if (m_progressbar != nullptr)
+		return *m_progressbar;
+	return single_progressbar;
+}
+
+
+void OperationDetail::set_progressbar(ProgressBar* progressbar)
+{
+	m_progressbar = progressbar;
+}
+
+
 int OperationDetail::execute_command_internal(const Glib::ustring& command, const char *input, ExecFlags flags,
                                               StreamSlot stream_progress_slot,
                                               TimedSlot timed_progress_slot)
 {
 	add_child(OperationDetail(command, STATUS_EXECUTE, FONT_BOLD_ITALIC));
 	OperationDetail& cmd_operationdetail = get_last_child();
-	Glib::Pid pid;
-	int in = -1;
-	// set up pipes for capture
-	int out;
-	int err;
-	// spawn external process
-	cmd_status.running = true;
-	cmd_status.pipecount = 2;
-	cmd_status.exit_status = 255;  // Set to actual value by store_exit_status()
-	try {
-		Glib::spawn_async_with_pipes(std::string("."),
-		                             Glib::shell_parse_argv(command),
-		                             Glib::SPAWN_DO_NOT_REAP_CHILD | Glib::SPAWN_SEARCH_PATH,
-		                             sigc::ptr_fun(setup_child_process),
-		                             &pid,
-		                             (input != nullptr) ? &in : 0,
-		                             &out,
-		                             &err);
-	}
-	catch (Glib::SpawnError &e)
+	CommandRunner runner(command, cmd_output.output, cmd_output.error);
+	if (! runner.start(input, false))
 	{
-		std::cerr << e.what() << std::endl;
-		cmd_operationdetail.add_child(OperationDetail( e.what(), STATUS_ERROR, FONT_ITALIC));
-		return Utils::get_failure_status(e);
+		std::cerr << runner.get_start_error() << std::endl;
+		cmd_operationdetail.add_child(OperationDetail(runner.get_start_error(), STATUS_ERROR, FONT_ITALIC));
+		return runner.get_exit_status();
 	}
-	fcntl(out, F_SETFL, O_NONBLOCK);
-	fcntl(err, F_SETFL, O_NONBLOCK);
-	Glib::signal_child_watch().connect(sigc::ptr_fun(store_exit_status), pid);
-	PipeCapture outputcapture(out, cmd_status.output);
-	PipeCapture errorcapture(err, cmd_status.error);
-	outputcapture.signal_eof.connect(sigc::ptr_fun(execute_command_eof));
-	errorcapture.signal_eof.connect(sigc::ptr_fun(execute_command_eof));
-	cmd_operationdetail.add_child(OperationDetail(cmd_status.output, STATUS_NONE, FONT_MONOSPACE));
-	cmd_operationdetail.add_child(OperationDetail(cmd_status.error, STATUS_NONE, FONT_MONOSPACE));
+	if (! runner.get_input_error().empty())
+		cmd_operationdetail.add_child(OperationDetail(runner.get_input_error(), STATUS_NONE, FONT_ITALIC));
+
+	cmd_operationdetail.add_child(OperationDetail(cmd_output.output, STATUS_NONE, FONT_MONOSPACE));
+	cmd_operationdetail.add_child(OperationDetail(cmd_output.error, STATUS_NONE, FONT_MONOSPACE));
 	OperationDetailVector& children = cmd_operationdetail.get_children();
-	outputcapture.signal_update.connect(sigc::bind(sigc::ptr_fun(update_command_output),
-	                                               children[children.size() - 2].get(),
-	                                               &cmd_status.output));
-	errorcapture.signal_update.connect(sigc::bind(sigc::ptr_fun(update_command_output),
-	                                              children[children.size() - 1].get(),
-	                                              &cmd_status.error));
-	sigc::connection timed_conn;
+	runner.signal_output_update().connect(sigc::bind(sigc::ptr_fun(update_command_output),
+	                                                 children[children.size() - 2].get(),
+	                                                 &cmd_output.output));
+	runner.signal_error_update().connect(sigc::bind(sigc::ptr_fun(update_command_output),
+	                                                children[children.size() - 1].get(),
+	                                                &cmd_output.error));
 	if (flags & EXEC_PROGRESS_STDOUT && ! stream_progress_slot.empty())
 		// Register progress tracking callback called when stdout updates
-		outputcapture.signal_update.connect(sigc::bind(stream_progress_slot, &cmd_operationdetail));
+		runner.signal_output_update().connect(sigc::bind(stream_progress_slot, &cmd_operationdetail));
 	else if (flags & EXEC_PROGRESS_STDERR && ! stream_progress_slot.empty())
 		// Register progress tracking callback called when stderr updates
-		errorcapture.signal_update.connect(sigc::bind(stream_progress_slot, &cmd_operationdetail));
+		runner.signal_error_update().connect(sigc::bind(stream_progress_slot, &cmd_operationdetail));
 	else if (flags & EXEC_PROGRESS_TIMED && ! timed_progress_slot.empty())
 		// Register progress tracking callback called every 500 ms
-		timed_conn = Glib::signal_timeout().connect(sigc::bind(timed_progress_slot, &cmd_operationdetail), 500);
-	outputcapture.connect_signal();
-	errorcapture.connect_signal();
+		runner.add_timer(500, sigc::bind(timed_progress_slot, &cmd_operationdetail));
 
 	sigc::connection connection_command_cancel = cmd_operationdetail.signal_cancel.connect(
 				sigc::bind(sigc::ptr_fun(cancel_command),
-				           pid,
+				           &runner,
 				           flags & EXEC_CANCEL_SAFE));
 
-	if (input != nullptr && in != -1)
-	{
-		// Write small amount of input to pipe to the child process.  Linux will
-		// always accept up to 4096 bytes without blocking.  See pipe(7).
-		size_t len = strlen(input);
-		ssize_t written = write(in, input, len);
-		if (written == -1 || (size_t)written < len)
-		{
-			int e = errno;
-			std::cerr << "Write to child failed: " << Glib::strerror(e) << std::endl;
-			cmd_operationdetail.add_child(OperationDetail("Write to child failed: " + Glib::strerror(e),
-			                                              STATUS_NONE, FONT_ITALIC));
-		}
-		close(in);
-	}
-
-	Gtk::Main::run();
+	int exit_status = Utils::wait_for_command(runner);
 
 	if (flags & EXEC_CHECK_STATUS)
-		cmd_operationdetail.set_success_and_capture_errors(cmd_status.exit_status == 0);
-	close(out);
-	close(err);
+		cmd_operationdetail.set_success_and_capture_errors(exit_status == 0);
 	connection_command_cancel.disconnect();
-	if (timed_conn.connected())
-		timed_conn.disconnect();
 	cmd_operationdetail.stop_progressbar();
-	return cmd_status.exit_status;
+	return exit_status;
 }
 
 
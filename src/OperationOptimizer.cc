@@ -0,0 +1,243 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OperationOptimizer.h"
+#include "Operation.h"
+#include "OperationCopy.h"
+#include "OperationResizeMove.h"
+#include "Partition.h"
+#include "Utils.h"
+
+#include <glib.h>
+#include <glibmm/ustring.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+OperationOptimizer::OperationOptimizer(const OperationVector& operations)
+ : m_operations(operations)
+{
+	for (unsigned int i = 0; i < m_operations.size(); i++)
+		m_plan.push_back({i, nullptr});
+
+	for (unsigned int i = 0; i < m_plan.size(); )
+	{
+		// After a fold the operation at i is different so try it again.
+		if (! fold_resize_move(i))
+			i++;
+	}
+}
+
+
+const Operation& OperationOptimizer::get_operation(unsigned int index) const
+{
+	const Step& step = m_plan[index];
+	if (step.combined)
+		return *step.combined;
+	return *m_operations[step.index];
+}
+
+
+// Replace the pending operations with the folded ones.  Must be passed the same vector
+// the optimizer was constructed from.
+void OperationOptimizer::commit(OperationVector& operations)
+{
+	g_assert(&operations == &m_operations);  // Bug: Committing to a different operations vector
+
+	OperationVector folded;
+	for (unsigned int i = 0; i < m_plan.size(); i++)
+	{
+		if (m_plan[i].combined)
+			folded.push_back(std::move(m_plan[i].combined));
+		else
+			folded.push_back(std::move(operations[m_plan[i].index]));
+	}
+	m_plan.clear();
+	operations.swap(folded);
+}
+
+
+// Report whether the second candidate operation affects the same partition(s) as the
+// first target operation.
+bool OperationOptimizer::operations_affect_same_partition(const Operation& first_op, const Operation& second_op)
+{
+	if (first_op.m_type == OPERATION_DELETE)
+		// First target operation is deleting the partition so there is no
+		// partition to merge the second candidate operation into.
+		return false;
+
+	if (first_op.get_partition_new().get_path() == second_op.get_partition_original().get_path())
+		return true;
+
+	// A copy operation is considered to affect both the copied source and pasted
+	// target partitions, to prevent merging of operations past either.  Two copy
+	// operations have four partition combinations to check.  The one above covering
+	// all operations and three more below.
+	Glib::ustring first_copied_path;
+	if (first_op.m_type == OPERATION_COPY)
+	{
+		const OperationCopy& first_copy_op = static_cast<const OperationCopy&>(first_op);
+		first_copied_path = first_copy_op.get_partition_copied().get_path();
+
+		if (first_copied_path == second_op.get_partition_original().get_path())
+			return true;
+	}
+
+	Glib::ustring second_copied_path;
+	if (second_op.m_type == OPERATION_COPY)
+	{
+		const OperationCopy& second_copy_op = static_cast<const OperationCopy&>(second_op);
+		second_copied_path = second_copy_op.get_partition_copied().get_path();
+
+		if (first_op.get_partition_new().get_path() == second_copied_path)
+			return true;
+	}
+
+	if (first_op.m_type == OPERATION_COPY && second_op.m_type == OPERATION_COPY)
+	{
+		if (first_copied_path == second_copied_path)
+			return true;
+	}
+
+	return false;
+}
+
+
+// Try to fold the next resize/move of the same partition into the resize/move operation
+// at plan index first.  The combined operation is placed either at the position of the
+// first or the second, whichever keeps all the operations in between valid.  Those
+// operations must not use the sectors where the partition now is at the time they are
+// applied.
+bool OperationOptimizer::fold_resize_move(unsigned int first)
+{
+	const Operation& first_op = get_operation(first);
+	if (first_op.m_type != OPERATION_RESIZE_MOVE)
+		return false;
+
+	for (unsigned int second = first + 1; second < m_plan.size(); second++)
+	{
+		const Operation& second_op = get_operation(second);
+		if (! operations_affect_same_partition(first_op, second_op))
+		{
+			// Creating, deleting and pasting can renumber the partitions.
+			if (*second_op.m_device == *first_op.m_device &&
+			    (second_op.m_type == OPERATION_CREATE ||
+			     second_op.m_type == OPERATION_DELETE ||
+			     second_op.m_type == OPERATION_COPY     )  )
+				return false;
+			continue;
+		}
+
+		if (second_op.m_type != OPERATION_RESIZE_MOVE                     ||
+		    first_op.get_partition_new() != second_op.get_partition_original()  )
+			return false;
+
+		const Partition& old_position = first_op.get_partition_original();
+		const Partition& mid_position = first_op.get_partition_new();
+		const Partition& new_position = second_op.get_partition_new();
+		bool at_second = true;  // Partition stays at old_position until second
+		bool at_first  = true;  // Partition moves to new_position at first
+		for (unsigned int k = first + 1; k < second; k++)
+		{
+			const Operation& between_op = get_operation(k);
+			if (operation_overlaps(between_op, old_position) ||
+			    operation_overlaps(between_op, mid_position)   )
+				at_second = false;
+			if (operation_overlaps(between_op, mid_position) ||
+			    operation_overlaps(between_op, new_position)   )
+				at_first = false;
+		}
+		if (! at_second && ! at_first)
+			return false;
+
+		// Fold into a new operation so that the pending operations are left as
+		// they are.
+		std::unique_ptr<Operation> combined(new OperationResizeMove(*first_op.m_device,
+		                                                            old_position, mid_position));
+		combined->m_icon = first_op.m_icon;
+		if (! combined->merge_operations(second_op))
+			return false;
+		m_bytes_saved += get_moved_bytes(first_op) + get_moved_bytes(second_op)
+		                 - get_moved_bytes(*combined);
+
+		unsigned int index;
+		if (at_second)
+		{
+			m_plan[second] = {0, std::move(combined)};
+			m_plan.erase(m_plan.begin() + first);
+			index = second - 1;
+		}
+		else
+		{
+			m_plan[first] = {0, std::move(combined)};
+			m_plan.erase(m_plan.begin() + second);
+			index = first;
+		}
+
+		// Remove the combined operation when it puts the partition back where it
+		// started.
+		const Partition& orig = m_plan[index].combined->get_partition_original();
+		const Partition& curr = m_plan[index].combined->get_partition_new();
+		if (orig.sector_start == curr.sector_start && orig.sector_end == curr.sector_end)
+			m_plan.erase(m_plan.begin() + index);
+		return true;
+	}
+	return false;
+}
+
+
+// Report whether the operation uses any of the sectors of the partition.
+bool OperationOptimizer::operation_overlaps(const Operation& operation, const Partition& partition)
+{
+	std::vector<const Partition*> used;
+	used.push_back(&operation.get_partition_original());
+	used.push_back(&operation.get_partition_new());
+	if (operation.m_type == OPERATION_COPY)
+		used.push_back(&static_cast<const OperationCopy&>(operation).get_partition_copied());
+
+	for (unsigned int i = 0; i < used.size(); i++)
+	{
+		if (used[i]->device_path  == partition.device_path &&
+		    used[i]->sector_start <= partition.sector_end  &&
+		    partition.sector_start <= used[i]->sector_end    )
+			return true;
+	}
+	return false;
+}
+
+
+// Estimate of the bytes of file system data a resize/move operation moves.  Only the
+// used space when known, otherwise the whole partition.
+Byte_Value OperationOptimizer::get_moved_bytes(const Operation& operation)
+{
+	const Partition& partition_old = operation.get_partition_original();
+	if (operation.m_type != OPERATION_RESIZE_MOVE                               ||
+	    partition_old.sector_start == operation.get_partition_new().sector_start   )
+		return 0;
+
+	Sector sectors = partition_old.get_sectors_used();
+	if (sectors < 0)
+		sectors = partition_old.get_sector_length();
+	return sectors * partition_old.sector_size;
+}
+
+
+}  // namespace GParted
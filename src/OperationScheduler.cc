@@ -0,0 +1,140 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OperationScheduler.h"
+#include "Operation.h"
+#include "OperationCopy.h"
+#include "Partition.h"
+#include "Utils.h"
+
+#include <glibmm/ustring.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+OperationScheduler::OperationScheduler(const OperationVector& operations)
+ : m_dependents(operations.size()), m_num_waiting(operations.size(), 0),
+   m_started(operations.size(), false)
+{
+	std::map<Glib::ustring, unsigned int> last_user;  // Last operation using each resource
+	int last_global = -1;
+	for (unsigned int i = 0; i < operations.size(); i++)
+	{
+		std::vector<Glib::ustring> resources;
+		bool global = false;
+		get_resources(*operations[i], resources, global);
+
+		if (global)
+		{
+			// Depends on everything before and everything after depends on it.
+			for (unsigned int j = 0; j < i; j++)
+				add_dependency(j, i);
+			last_global = i;
+			continue;
+		}
+
+		if (last_global >= 0)
+			add_dependency(last_global, i);
+		for (unsigned int j = 0; j < resources.size(); j++)
+		{
+			std::map<Glib::ustring, unsigned int>::iterator it = last_user.find(resources[j]);
+			if (it != last_user.end())
+				add_dependency(it->second, i);
+			last_user[resources[j]] = i;
+		}
+	}
+}
+
+
+// Return the operations which have not yet been started and which no longer wait for any
+// other operation, marking them as started.
+std::vector<unsigned int> OperationScheduler::take_ready()
+{
+	std::vector<unsigned int> ready;
+	for (unsigned int i = 0; i < m_started.size(); i++)
+	{
+		if (! m_started[i] && m_num_waiting[i] == 0)
+		{
+			m_started[i] = true;
+			ready.push_back(i);
+		}
+	}
+	return ready;
+}
+
+
+void OperationScheduler::set_completed(unsigned int index)
+{
+	m_num_completed++;
+	for (unsigned int i = 0; i < m_dependents[index].size(); i++)
+		m_num_waiting[m_dependents[index][i]]--;
+}
+
+
+// Names of the resources which an operation uses, which must not be used by any other
+// operation at the same time.  Sets global when the operation may affect devices other
+// than those named so must not run alongside any other operation.
+void OperationScheduler::get_resources(const Operation& operation, std::vector<Glib::ustring>& resources,
+                                       bool& global)
+{
+	std::vector<const Partition*> partitions;
+	partitions.push_back(&operation.get_partition_original());
+	partitions.push_back(&operation.get_partition_new());
+	if (operation.m_type == OPERATION_COPY)
+		partitions.push_back(&static_cast<const OperationCopy&>(operation).get_partition_copied());
+
+	resources.push_back(operation.m_device->get_path());
+	for (unsigned int i = 0; i < partitions.size(); i++)
+	{
+		if (std::find(resources.begin(), resources.end(), partitions[i]->device_path) == resources.end())
+			resources.push_back(partitions[i]->device_path);
+
+		// Members of multi-device storage tie this operation to other devices.
+		FSType fstype = partitions[i]->get_filesystem_partition().fstype;
+		if (fstype == FS_LVM2_PV || fstype == FS_LINUX_SWRAID || fstype == FS_ATARAID ||
+		    fstype == FS_BCACHE                                                          )
+			global = true;
+	}
+
+	// As do devices built on top of other devices.
+	const Glib::ustring& device_path = operation.m_device->get_path();
+	if (device_path.compare(0, DEV_MAPPER_PATH.length(), DEV_MAPPER_PATH) == 0 ||
+	    device_path.compare(0, 7, "/dev/md")                              == 0 ||
+	    device_path.compare(0, 8, "/dev/dm-")                             == 0   )
+		global = true;
+
+	// File system objects are shared between partitions of the same type and some
+	// remember state while copying or moving.
+	if (operation.m_type == OPERATION_COPY || operation.m_type == OPERATION_RESIZE_MOVE)
+		resources.push_back("fs:" + Utils::num_to_str(operation.get_partition_new().fstype));
+}
+
+
+void OperationScheduler::add_dependency(unsigned int before, unsigned int after)
+{
+	if (std::find(m_dependents[before].begin(), m_dependents[before].end(), after) != m_dependents[before].end())
+		return;
+	m_dependents[before].push_back(after);
+	m_num_waiting[after]++;
+}
+
+
+}  // namespace GParted
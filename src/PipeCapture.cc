@@ -21,10 +21,13 @@
 #include <string>
 #include <vector>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include <glib.h>
+#include <glibmm/stringutils.h>
 #include <glibmm/ustring.h>
-#include <glibmm/iochannel.h>
 
 
 namespace GParted
@@ -94,6 +97,38 @@ static gunichar get_utf8_char_validated(const char* p, gssize max_len)
 }
 
 
+// Is the byte an ASCII character which the line discipline just stores in the current
+// line?  Multi-byte UTF-8 characters and the control characters acted on are processed one
+// at a time.
+static bool is_plain_ascii(unsigned char c)
+{
+	return c < 0x80 && c != '\b' && c != '\r' && c != '\n' && c != '\x01' && c != '\x02';
+}
+
+
+// Return the number of plain ASCII characters at the start of the buffer.  Checks 8 bytes
+// at a time for all being printable ASCII, 0x20 to 0x7F, by subtracting 0x20 from every
+// byte at once and testing for any top bits set, either from the subtraction borrowing or
+// already being set in the byte.
+static size_t plain_ascii_run_length(const char* p, const char* end)
+{
+	const uint64_t ONES     = 0x0101010101010101ULL;
+	const uint64_t TOP_BITS = 0x8080808080808080ULL;
+	const char* start = p;
+	while (end - p >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		if (((word | (word - 0x20 * ONES)) & TOP_BITS) != 0)
+			break;
+		p += 8;
+	}
+	while (p < end && is_plain_ascii(*p))
+		p++;
+	return p - start;
+}
+
+
 static void append_unichar_vector_to_utf8(std::string& str, const std::vector<gunichar>& ucvec)
 {
 	const size_t MAX_UTF8_BYTES = 6;
@@ -110,25 +145,26 @@ static void append_unichar_vector_to_utf8(std::string& str, const std::vector<gu
 
 
 PipeCapture::PipeCapture(int fd, Glib::ustring& buffer)
- : m_readbuf(64*KIBIBYTE),  // Construct vector of 64K chars (and zero initialise)
+ : m_fd(fd),
+   m_readbuf(64*KIBIBYTE),  // Construct vector of 64K chars (and zero initialise)
    m_callerbuf(buffer)
 {
 	m_callerbuf.clear();
 	m_callerbuf_uptodate = true;
-	// tie fd to string
-	// make channel
-	m_channel = Glib::IOChannel::create_from_fd(fd);
-	m_channel->set_encoding("");
 }
 
 
+// Capture from the Glib main loop.  Otherwise the owner polls the pipe itself and calls
+// OnReadable() whenever it is readable, as CommandRunner does.
 void PipeCapture::connect_signal()
 {
 	// connect handler to signal input/output
-	g_io_add_watch(m_channel->gobj(),
+	GIOChannel* channel = g_io_channel_unix_new(m_fd);
+	g_io_add_watch(channel,
 	               GIOCondition(G_IO_IN | G_IO_ERR | G_IO_HUP),
 	               _OnReadable,
 	               this);
+	g_io_channel_unref(channel);
 }
 
 
@@ -137,14 +173,15 @@ gboolean PipeCapture::_OnReadable( GIOChannel *source,
 				   gpointer data )
 {
 	PipeCapture *pc = static_cast<PipeCapture *>(data);
-	gboolean rc = pc->OnReadable( Glib::IOCondition(condition) );
+	gboolean rc = pc->OnReadable();
 	return rc;
 }
 
 
-bool PipeCapture::OnReadable( Glib::IOCondition condition )
+// Returns false once EOF has been reached.
+bool PipeCapture::OnReadable()
 {
-	// Reads UTF-8 characters from channel.  Provides minimal interpretation so
+	// Reads UTF-8 characters from pipe.  Provides minimal interpretation so
 	// programs which use text progress bars are displayed correctly.  Captures the
 	// output in a buffer and runs callbacks when updated or EOF reached.
 	//
@@ -175,6 +212,9 @@ bool PipeCapture::OnReadable( Glib::IOCondition condition )
 	// m_readbuf is drained the partial current line, is pasted into m_capturebuf at
 	// the offset where the last line starts.  (m_capturebuf stores UTF-8 encoded
 	// characters in a std::string for constant time access to m_line_start offset).
+	// As a fast path, runs of plain ASCII characters are added without decoding each
+	// one and a whole line of them is copied straight into m_capturebuf, skipping
+	// m_linevec.
 	// When m_readbuf is drained and there are registered update callbacks,
 	// m_capturebuf is copied into m_callerbuf and signal_update slot fired.
 	// (m_callerbuf stores UTF-8 encoded characters in a Glib::ustring).  When EOF is
@@ -196,15 +236,46 @@ bool PipeCapture::OnReadable( Glib::IOCondition condition )
 	//    slower as the string gets longer and all characters beyond those replaced
 	//    have to be moved in memory.
 
-	gsize bytes_read;
-	Glib::IOStatus status = m_channel->read(m_readbuf.data() + m_fill_offset, READBUF_SIZE - m_fill_offset, bytes_read);
-	if ( status == Glib::IO_STATUS_NORMAL )
+	ssize_t bytes_read = read(m_fd, m_readbuf.data() + m_fill_offset, READBUF_SIZE - m_fill_offset);
+	if (bytes_read < 0 && (errno == EINTR || errno == EAGAIN))
+		return true;  // Try again when next readable
+	if (bytes_read > 0)
 	{
 		const char* read_ptr = m_readbuf.data();
 		const char* end_ptr = m_readbuf.data() + m_fill_offset + bytes_read;
 		m_fill_offset = 0;
 		while ( read_ptr < end_ptr )
 		{
+			size_t run_length = plain_ascii_run_length(read_ptr, end_ptr);
+			if (run_length > 0)
+			{
+				if (m_linevec.empty() && run_length < (size_t)(end_ptr - read_ptr) &&
+				    read_ptr[run_length] == '\n'                                     )
+				{
+					// Complete line.  Copy with the new line character
+					// straight into the capture buffer.
+					m_capturebuf.resize(m_line_start);
+					m_capturebuf.append(read_ptr, run_length + 1);
+					m_line_start = m_capturebuf.size();
+					m_callerbuf_uptodate = false;
+					read_ptr += run_length + 1;
+					continue;
+				}
+
+				// Replace or append chars in current line.
+				for (size_t i = 0; i < run_length; i++)
+				{
+					gunichar uc = (unsigned char)read_ptr[i];
+					if (m_cursor < m_linevec.size())
+						m_linevec[m_cursor] = uc;
+					else
+						m_linevec.push_back(uc);
+					m_cursor ++;
+				}
+				read_ptr += run_length;
+				continue;
+			}
+
 			gunichar uc = get_utf8_char_validated(read_ptr, end_ptr - read_ptr);
 			if ( uc == UTF8_PARTIAL )
 			{
@@ -298,19 +369,27 @@ bool PipeCapture::OnReadable( Glib::IOCondition condition )
 		return true;
 	}
 
-	if ( status != Glib::IO_STATUS_EOF )
+	if (bytes_read < 0)
 	{
-		std::cerr << "Pipe IOChannel read failed" << std::endl;
+		std::cerr << "Pipe read failed: " << Glib::strerror(errno) << std::endl;
 	}
 
+	flush();
+	// signal completion
+	signal_eof.emit();
+	return false;
+}
+
+
+// Copy all output captured so far into the caller's buffer.  Done at EOF or by the owner
+// when it stops reading before EOF.
+void PipeCapture::flush()
+{
 	if (! m_callerbuf_uptodate)
 	{
 		m_callerbuf = m_capturebuf;
 		m_callerbuf_uptodate = true;
 	}
-	// signal completion
-	signal_eof.emit();
-	return false;
 }
 
 
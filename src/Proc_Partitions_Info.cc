@@ -102,15 +102,14 @@ void Proc_Partitions_Info::load_proc_partitions_info_cache()
 			if ( name == "" )
 				continue;
 
-			// Pre-populate BlockSpecial cache to avoid stat() call and save
+			// Pre-populate BlockSpecial registry to avoid stat() call and save
 			// all entries from /proc/partitions for device to partition
-			// mapping.
+			// mapping, using the registered object directly.
 			unsigned long maj;
 			unsigned long min;
 			if ( sscanf( line.c_str(), "%lu %lu", &maj, &min ) != 2 )
 				continue;
-			BlockSpecial::register_block_special( "/dev/" + name, maj, min );
-			all_entries_cache.push_back(BlockSpecial("/dev/" + name));
+			all_entries_cache.push_back(BlockSpecial::register_block_special("/dev/" + name, maj, min));
 
 			// Save recognised whole disk device names for later returning as
 			// the default GParted partitionable devices.
@@ -204,8 +203,8 @@ std::vector<Glib::ustring> Proc_Partitions_Info::get_partition_paths_for(const G
 	// Find following partition entries from /proc/partitions cache.
 	for (i++; i < all_entries_cache.size(); i++)
 	{
-		if (is_partition_of_device(all_entries_cache[i].m_name, bs.m_name))
-			partitions.push_back(all_entries_cache[i].m_name);
+		if (is_partition_of_device(all_entries_cache[i].get_name(), bs.get_name()))
+			partitions.push_back(all_entries_cache[i].get_name());
 		else
 			// No more partitions for this whole disk device.
 			break;
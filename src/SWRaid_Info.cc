@@ -45,11 +45,13 @@ namespace GParted
 //                      {BS("/dev/sdc") , FS_ATARAID     , "/dev/md126", "43060c4c-b0c0-c371-60bf-d43082e97d3c", ""         , true },
 //                      {BS("/dev/sdd") , FS_ATARAID     , "/dev/md126", "43060c4c-b0c0-c371-60bf-d43082e97d3c", ""         , true }
 //                     ]
+// swraid_info_index - Index of the above by member.
 
 // Initialise static data elements
 bool SWRaid_Info::cache_initialised = false;
 bool SWRaid_Info::mdadm_found = false;
 std::vector<SWRaid_Member> SWRaid_Info::swraid_info_cache;
+BlockSpecialIndex SWRaid_Info::swraid_info_index;
 
 void SWRaid_Info::load_cache()
 {
@@ -62,7 +64,7 @@ bool SWRaid_Info::is_member( const Glib::ustring & member_path )
 {
 	initialise_if_required();
 	const SWRaid_Member & memb = get_cache_entry_by_member( member_path );
-	if ( memb.member.m_name.length() > 0 )
+	if ( memb.member.get_name().length() > 0 )
 		return true;
 
 	return false;
@@ -139,6 +141,7 @@ void SWRaid_Info::load_swraid_info_cache()
 	Glib::ustring output, error;
 
 	swraid_info_cache.clear();
+	swraid_info_index.clear();
 
 	// Load SWRaid members into the cache.  Load member device, array UUID and array
 	// label (array name in mdadm terminology).
@@ -223,6 +226,7 @@ void SWRaid_Info::load_swraid_info_cache()
 					memb.uuid = uuid;
 					memb.label = label;
 					memb.active = false;
+					swraid_info_index.add(memb.member, swraid_info_cache.size());
 					swraid_info_cache.push_back( memb );
 				}
 				uuid.clear();
@@ -317,7 +321,7 @@ void SWRaid_Info::load_swraid_info_cache()
 				for ( unsigned int i = 0 ; i < members.size() ; i ++ )
 				{
 					SWRaid_Member & memb = get_cache_entry_by_member( members[i] );
-					if ( memb.member.m_name.length() > 0 )
+					if ( memb.member.get_name().length() > 0 )
 					{
 						// Update existing cache entry, setting
 						// array and active flag.
@@ -336,6 +340,7 @@ void SWRaid_Info::load_swraid_info_cache()
 						new_memb.uuid = "";
 						new_memb.label = "";
 						new_memb.active = true;
+						swraid_info_index.add(new_memb.member, swraid_info_cache.size());
 						swraid_info_cache.push_back( new_memb );
 					}
 				}
@@ -351,16 +356,13 @@ void SWRaid_Info::load_swraid_info_cache()
 	}
 }
 
-// Perform linear search of the cache to find the matching member.
+// Look up the matching member in the cache index.
 // Returns found cache entry or not found substitute.
 SWRaid_Member & SWRaid_Info::get_cache_entry_by_member( const Glib::ustring & member_path )
 {
-	BlockSpecial bs = BlockSpecial( member_path );
-	for ( unsigned int i = 0 ; i < swraid_info_cache.size() ; i ++ )
-	{
-		if ( bs == swraid_info_cache[i].member )
-			return swraid_info_cache[i];
-	}
+	int i = swraid_info_index.find(member_path);
+	if (i >= 0)
+		return swraid_info_cache[i];
 	static SWRaid_Member not_found;  // {BlockSpecial(), FS_UNKNOWN, "", "", "", false}
 	return not_found;
 }
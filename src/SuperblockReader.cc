@@ -0,0 +1,269 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SuperblockReader.h"
+#include "AllocationMap.h"
+#include "Utils.h"
+
+#include <glibmm/ustring.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+static const uint16_t EXT2_SUPER_MAGIC            = 0xEF53;
+static const uint32_t EXT4_FEATURE_INCOMPAT_64BIT = 0x0080;
+
+static const Byte_Value BTRFS_SUPER_INFO_OFFSET = 64 * KIBIBYTE;
+
+static const uint32_t FAT_FSINFO_SIG1 = 0x41615252;  // "RRaA"
+static const uint32_t FAT_FSINFO_SIG2 = 0x61417272;  // "rrAa"
+static const uint32_t FAT_FSINFO_UNKNOWN_FREE = 0xFFFFFFFF;
+static const Byte_Value FAT_CHUNK_SIZE = 3 * 256 * KIBIBYTE;
+
+
+SuperblockReader::SuperblockReader(const Glib::ustring& path)
+ : m_path(path)
+{
+}
+
+
+SuperblockReader::~SuperblockReader()
+{
+	if (m_fd != -1)
+		close(m_fd);
+}
+
+
+bool SuperblockReader::open()
+{
+	if (m_fd == -1)
+		m_fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+	return m_fd != -1;
+}
+
+
+// Same figures as "dumpe2fs -h" reports as Block count, Block size and Free blocks.
+bool SuperblockReader::read_ext2(long long& block_count, long long& block_size, long long& free_blocks)
+{
+	unsigned char sb[1024];
+	if (! read(1024, sb, sizeof(sb)) || get_le16(sb + 0x38) != EXT2_SUPER_MAGIC)
+		return false;
+
+	uint32_t log_block_size = get_le32(sb + 0x18);
+	if (log_block_size > 6)
+		return false;
+
+	uint64_t blocks = get_le32(sb + 0x04);
+	uint64_t free   = get_le32(sb + 0x0C);
+	if (get_le32(sb + 0x60) & EXT4_FEATURE_INCOMPAT_64BIT)
+	{
+		blocks |= static_cast<uint64_t>(get_le32(sb + 0x150)) << 32;
+		free   |= static_cast<uint64_t>(get_le32(sb + 0x158)) << 32;
+	}
+	if (blocks == 0 || free > blocks)
+		return false;
+
+	block_count = blocks;
+	block_size  = 1024LL << log_block_size;
+	free_blocks = free;
+	return true;
+}
+
+
+// Same figures as "xfs_db -r -c 'sb 0' -c 'print blocksize' -c 'print dblocks'
+// -c 'print fdblocks'" reports.
+bool SuperblockReader::read_xfs(long long& block_size, long long& data_blocks, long long& free_data_blocks)
+{
+	unsigned char sb[512];
+	if (! read(0, sb, sizeof(sb)) || memcmp(sb, "XFSB", 4) != 0)
+		return false;
+
+	uint32_t blocksize = get_be32(sb + 0x04);
+	uint64_t dblocks   = get_be64(sb + 0x08);
+	uint64_t fdblocks  = get_be64(sb + 0x90);
+	if (blocksize < 512 || blocksize > 65536 || (blocksize & (blocksize - 1)) != 0 ||
+	    dblocks == 0 || fdblocks > dblocks                                            )
+		return false;
+
+	block_size       = blocksize;
+	data_blocks      = dblocks;
+	free_data_blocks = fdblocks;
+	return true;
+}
+
+
+// Same figures as "btrfs inspect-internal dump-super" reports as total_bytes, bytes_used,
+// sectorsize and dev_item.total_bytes.
+bool SuperblockReader::read_btrfs(long long& total_bytes, long long& bytes_used, long long& sector_size,
+                                  long long& dev_item_total_bytes)
+{
+	unsigned char sb[4096];
+	if (! read(BTRFS_SUPER_INFO_OFFSET, sb, sizeof(sb)) || memcmp(sb + 0x40, "_BHRfS_M", 8) != 0 ||
+	    get_le64(sb + 0x30) != static_cast<uint64_t>(BTRFS_SUPER_INFO_OFFSET)                       )
+		return false;
+
+	uint64_t total    = get_le64(sb + 0x70);
+	uint64_t used     = get_le64(sb + 0x78);
+	uint32_t sectsize = get_le32(sb + 0x90);
+	uint64_t dev_total = get_le64(sb + 0xC9 + 0x08);  // dev_item.total_bytes
+	if (total == 0 || dev_total == 0 || dev_total > total || sectsize < 512 ||
+	    (sectsize & (sectsize - 1)) != 0                                         )
+		return false;
+
+	total_bytes          = total;
+	bytes_used           = used;
+	sector_size          = sectsize;
+	dev_item_total_bytes = dev_total;
+	return true;
+}
+
+
+// Same figures as "minfo" reports as sector size, cluster size and small or big size
+// and "mdir" reports as bytes free.  Like mtools, uses the free cluster count from the
+// FAT32 FS Information Sector when it is set, otherwise counts the free clusters in the
+// first FAT.
+bool SuperblockReader::read_fat(long long& logical_sector_size, long long& cluster_size,
+                                long long& logical_sectors, long long& bytes_free)
+{
+	unsigned char bs[512];
+	if (! read(0, bs, sizeof(bs)) || bs[510] != 0x55 || bs[511] != 0xAA)
+		return false;
+
+	Byte_Value bytes_per_sector    = get_le16(bs + 0x0B);
+	Byte_Value sectors_per_cluster = bs[0x0D];
+	Byte_Value reserved_sectors    = get_le16(bs + 0x0E);
+	Byte_Value num_fats            = bs[0x10];
+	Byte_Value root_entries        = get_le16(bs + 0x11);
+	Byte_Value total_sectors       = get_le16(bs + 0x13);
+	if (total_sectors == 0)
+		total_sectors = get_le32(bs + 0x20);
+	Byte_Value fat_sectors         = get_le16(bs + 0x16);
+	bool fat32 = fat_sectors == 0;
+	if (fat32)
+		fat_sectors = get_le32(bs + 0x24);
+
+	if (bytes_per_sector < 512 || bytes_per_sector > 4096 ||
+	    (bytes_per_sector & (bytes_per_sector - 1)) != 0     ||
+	    sectors_per_cluster == 0                             ||
+	    (sectors_per_cluster & (sectors_per_cluster - 1)) != 0 ||
+	    reserved_sectors == 0 || num_fats == 0 || fat_sectors == 0 || total_sectors == 0)
+		return false;
+
+	Byte_Value root_dir_sectors  = (root_entries * 32 + bytes_per_sector - 1) / bytes_per_sector;
+	Byte_Value first_data_sector = reserved_sectors + num_fats * fat_sectors + root_dir_sectors;
+	if (first_data_sector >= total_sectors)
+		return false;
+	Byte_Value cluster_count = (total_sectors - first_data_sector) / sectors_per_cluster;
+
+	Byte_Value free_clusters = -1;
+	uint16_t fsinfo_sector = get_le16(bs + 0x30);
+	if (fat32 && fsinfo_sector > 0 && fsinfo_sector < reserved_sectors)
+	{
+		unsigned char fsinfo[512];
+		if (read(fsinfo_sector * bytes_per_sector, fsinfo, sizeof(fsinfo)) &&
+		    get_le32(fsinfo + 0)   == FAT_FSINFO_SIG1                       &&
+		    get_le32(fsinfo + 484) == FAT_FSINFO_SIG2                       &&
+		    get_le32(fsinfo + 488) != FAT_FSINFO_UNKNOWN_FREE               &&
+		    get_le32(fsinfo + 488) <= cluster_count                           )
+			free_clusters = get_le32(fsinfo + 488);
+	}
+
+	if (free_clusters == -1)
+	{
+		// FAT type is determined solely by the count of clusters.
+		int fat_bits = 32;
+		if (cluster_count < 4085)
+			fat_bits = 12;
+		else if (cluster_count < 65525)
+			fat_bits = 16;
+		Byte_Value entry_size = (fat_bits == 32) ? 4 : 2;
+		Byte_Value fat_bytes  = (cluster_count + 2) * fat_bits / 8 + 2;
+		if (fat_bytes > fat_sectors * bytes_per_sector)
+			return false;
+
+		// Read the first FAT in chunks rather than all at once as a FAT32 FAT can
+		// be hundreds of MiB.  A chunk size which is a multiple of 3 bytes keeps
+		// FAT12 entry pairs together.
+		std::vector<unsigned char> buf(FAT_CHUNK_SIZE);
+		Byte_Value buf_start = 0;
+		Byte_Value buf_len   = 0;
+		free_clusters = 0;
+		for (Byte_Value cluster = 2; cluster < cluster_count + 2; cluster++)
+		{
+			Byte_Value entry_offset = cluster * fat_bits / 8;
+			if (entry_offset + entry_size > buf_start + buf_len)
+			{
+				buf_start = entry_offset;
+				buf_len   = std::min(FAT_CHUNK_SIZE, fat_bytes - buf_start);
+				if (! read(reserved_sectors * bytes_per_sector + buf_start, buf.data(), buf_len))
+					return false;
+			}
+
+			const unsigned char* p = buf.data() + (entry_offset - buf_start);
+			uint32_t entry;
+			if (fat_bits == 12)
+				entry = (cluster & 1) ? get_le16(p) >> 4 : get_le16(p) & 0x0FFF;
+			else if (fat_bits == 16)
+				entry = get_le16(p);
+			else
+				entry = get_le32(p) & 0x0FFFFFFF;
+			if (entry == 0)
+				free_clusters++;
+		}
+	}
+
+	logical_sector_size = bytes_per_sector;
+	cluster_size        = sectors_per_cluster;
+	logical_sectors     = total_sectors;
+	bytes_free          = free_clusters * sectors_per_cluster * bytes_per_sector;
+	return true;
+}
+
+
+bool SuperblockReader::read(Byte_Value offset, void* buf, size_t count) const
+{
+	if (m_fd == -1 || offset < 0)
+		return false;
+
+	char* p = static_cast<char*>(buf);
+	off_t pos = offset;
+	while (count > 0)
+	{
+		ssize_t n = pread(m_fd, p, count, pos);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p     += n;
+		count -= n;
+		pos   += n;
+	}
+	return true;
+}
+
+
+}  // namespace GParted
@@ -0,0 +1,303 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "UdevSettle.h"
+
+#include <glibmm/miscutils.h>
+#include <glibmm/ustring.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <string>
+
+
+namespace GParted
+{
+
+
+// Netlink multicast groups of kernel uevents and of the events udev re-broadcasts after
+// running its rules.
+static const unsigned int KERNEL_UEVENT_GROUP = 1;
+static const unsigned int UDEV_EVENT_GROUP    = 2;
+
+// Header of the events udev re-broadcasts, as struct monitor_netlink_header in systemd
+// sd-device-monitor.c.
+static const size_t   UDEV_HEADER_SIZE = 40;
+static const uint32_t UDEV_MONITOR_MAGIC = 0xfeedcafe;
+
+// Closing a disk opened for writing triggers a "change" uevent from udev's inotify watch
+// shortly afterwards, so wait this long after the last uevent for another one.
+static const std::chrono::milliseconds QUIET_PERIOD(100);
+
+// Socket receive buffer size, big enough for the burst of uevents from re-reading the
+// partition table of a disk with many partitions.
+static const int RECEIVE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+
+// Start listening for uevents of the disk device and its partitions.  When not possible
+// wait() returns false for the caller to settle the whole udev event queue instead.
+UdevSettle::UdevSettle(const Glib::ustring& device_path)
+{
+	// Kernel uevents name devices relative to /dev after following symlinks, such as
+	// /dev/mapper/NAME -> /dev/dm-N.
+	std::string path = device_path;
+	char* real_path = realpath(path.c_str(), nullptr);
+	if (real_path != nullptr)
+	{
+		path = real_path;
+		free(real_path);
+	}
+	if (path.compare(0, 5, "/dev/") == 0)
+		m_disk_name = path.substr(5);
+	else
+		m_disk_name = Glib::path_get_basename(path);
+
+	// Partitions of device-mapper devices, and the maps of a DMRaid array about to be
+	// created, are separate dm-N devices which can't be named in advance.
+	m_any_dm =    m_disk_name.compare(0, 3, "dm-") == 0
+	           || device_path.compare(0, 12, "/dev/mapper/") == 0;
+
+	m_udev_running = access("/run/udev/control", F_OK) == 0;
+
+	m_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+	if (m_fd < 0)
+		return;
+
+	// Receive the credentials of the sender to only trust events re-broadcast by root.
+	int on = 1;
+	setsockopt(m_fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+
+	// Uevents which overflow the receive buffer are lost.  SO_RCVBUFFORCE exceeds the
+	// rmem_max limit but needs CAP_NET_ADMIN, otherwise get as much as allowed.
+	int size = RECEIVE_BUFFER_SIZE;
+	if (setsockopt(m_fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0)
+		setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = KERNEL_UEVENT_GROUP | UDEV_EVENT_GROUP;
+	if (bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+
+UdevSettle::~UdevSettle()
+{
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+
+// Wait until udev has processed every uevent of the disk and its partitions and no more
+// have arrived for a short quiet period, or until the timeout.  Returns false when the
+// uevents couldn't be followed, or when udev didn't process any uevent of the disk.  The
+// "change" uevent udev triggers itself when a disk opened for writing is closed may not
+// have arrived within the quiet period, so the caller must then settle the whole udev
+// event queue instead.
+bool UdevSettle::wait(std::time_t timeout)
+{
+	if (m_fd < 0)
+		return false;
+
+	Clock::time_point deadline = Clock::now() + std::chrono::seconds(timeout);
+	m_last_uevent = Clock::now();
+	while (true)
+	{
+		read_uevents();
+		if (m_lost_uevents)
+			return false;
+
+		Clock::time_point now   = Clock::now();
+		Clock::time_point quiet = m_last_uevent + QUIET_PERIOD;
+		if (now >= deadline)
+			return true;
+		if (m_pending.empty() && now >= quiet)
+			return ! m_udev_running || m_udev_processed;
+
+		// While uevents are still being processed by udev wait for the next event,
+		// otherwise only until the end of the quiet period.
+		Clock::time_point until = m_pending.empty() ? std::min(quiet, deadline) : deadline;
+		int timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(until - now).count() + 1;
+
+		struct pollfd pfd = { m_fd, POLLIN, 0 };
+		if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+			return false;
+	}
+}
+
+
+void UdevSettle::read_uevents()
+{
+	char buf[8192];
+	char control[CMSG_SPACE(sizeof(struct ucred))];
+	while (true)
+	{
+		struct sockaddr_nl addr;
+		struct iovec iov = { buf, sizeof(buf) };
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name       = &addr;
+		msg.msg_namelen    = sizeof(addr);
+		msg.msg_iov        = &iov;
+		msg.msg_iovlen     = 1;
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+		ssize_t len = recvmsg(m_fd, &msg, 0);
+		if (len < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			// Uevents were dropped because they weren't read quickly enough.
+			if (errno == ENOBUFS)
+			{
+				m_lost_uevents = true;
+				continue;
+			}
+			return;  // EAGAIN, no more uevents
+		}
+		if (msg.msg_flags & MSG_TRUNC)
+			continue;
+
+		if (addr.nl_pid == 0)
+		{
+			add_kernel_uevent(buf, len);
+			continue;
+		}
+
+		// Otherwise an event re-broadcast by udev, which is only trusted from root.
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_CREDENTIALS)
+			continue;
+		struct ucred cred;
+		memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+		if (cred.uid != 0)
+			continue;
+		add_udev_event(buf, len);
+	}
+}
+
+
+// Record a kernel uevent of the disk or one of its partitions as pending until udev has
+// processed it.  A kernel uevent is an "ACTION@DEVPATH" header followed by NUL terminated
+// "KEY=VALUE" strings.
+void UdevSettle::add_kernel_uevent(const char* buf, size_t len)
+{
+	std::string subsystem;
+	std::string devpath;
+	std::string devname;
+	std::string devtype;
+	unsigned long long seqnum = 0;
+	const char* end = buf + len;
+	const char* p   = buf + strnlen(buf, len) + 1;
+	while (p < end)
+	{
+		size_t n = strnlen(p, end - p);
+		std::string field(p, n);
+		p += n + 1;
+		if (field.compare(0, 10, "SUBSYSTEM=") == 0)
+			subsystem = field.substr(10);
+		else if (field.compare(0, 8, "DEVPATH=") == 0)
+			devpath = field.substr(8);
+		else if (field.compare(0, 8, "DEVNAME=") == 0)
+			devname = field.substr(8);
+		else if (field.compare(0, 8, "DEVTYPE=") == 0)
+			devtype = field.substr(8);
+		else if (field.compare(0, 7, "SEQNUM=") == 0)
+			seqnum = strtoull(field.c_str() + 7, nullptr, 10);
+	}
+	if (subsystem != "block" || ! is_disk_device(devname, devtype, devpath))
+		return;
+
+	// Without udev running nothing will process the uevent, so just wait for the
+	// quiet period after it.
+	if (m_udev_running && seqnum > 0)
+		m_pending.insert(seqnum);
+	m_last_uevent = Clock::now();
+}
+
+
+// Clear a pending kernel uevent which udev has finished processing.  An event
+// re-broadcast by udev is a binary header followed by NUL terminated "KEY=VALUE" strings
+// including the SEQNUM of the kernel uevent.
+void UdevSettle::add_udev_event(const char* buf, size_t len)
+{
+	if (len < UDEV_HEADER_SIZE || memcmp(buf, "libudev", 8) != 0)
+		return;
+	uint32_t magic;
+	uint32_t properties_off;
+	uint32_t properties_len;
+	memcpy(&magic,          buf + 8,  sizeof(magic));
+	memcpy(&properties_off, buf + 16, sizeof(properties_off));
+	memcpy(&properties_len, buf + 20, sizeof(properties_len));
+	if (ntohl(magic) != UDEV_MONITOR_MAGIC                           ||
+	    properties_off < UDEV_HEADER_SIZE || properties_off > len    ||
+	    properties_len > len - properties_off                          )
+		return;
+
+	const char* end = buf + properties_off + properties_len;
+	const char* p   = buf + properties_off;
+	while (p < end)
+	{
+		size_t n = strnlen(p, end - p);
+		if (n > 7 && strncmp(p, "SEQNUM=", 7) == 0)
+		{
+			if (m_pending.erase(strtoull(std::string(p + 7, n - 7).c_str(), nullptr, 10)) > 0)
+			{
+				m_udev_processed = true;
+				m_last_uevent    = Clock::now();
+			}
+			return;
+		}
+		p += n + 1;
+	}
+}
+
+
+// Is the device named in a uevent the disk or one of its partitions?  A partition belongs
+// to the disk named by its parent in the sysfs device path.  Sysfs names use '!' in place
+// of '/', such as "cciss!c0d0".
+bool UdevSettle::is_disk_device(const std::string& devname, const std::string& devtype,
+                                const std::string& devpath) const
+{
+	if (devname.empty())
+		return false;
+	if (m_any_dm && devname.compare(0, 3, "dm-") == 0)
+		return true;
+	if (devname == m_disk_name)
+		return true;
+	if (devtype != "partition")
+		return false;
+
+	std::string parent_name = Glib::path_get_basename(Glib::path_get_dirname(devpath));
+	std::replace(parent_name.begin(), parent_name.end(), '!', '/');
+	return parent_name == m_disk_name;
+}
+
+
+}  // namespace GParted
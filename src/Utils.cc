@@ -16,8 +16,8 @@
  */
 
 #include "Utils.h"
+#include "CommandRunner.h"
 #include "GParted_Core.h"
-#include "PipeCapture.h"
 
 #include <sstream>
 #include <fstream>
@@ -32,17 +32,24 @@
 #include <glibmm/shell.h>
 #include <glibmm/fileutils.h>
 #include <glibmm/convert.h>
+#include <glibmm/miscutils.h>
 #include <gtkmm/main.h>
 #include <gtkmm/enums.h>
 #include <gtkmm/stock.h>
 #include <gtkmm/stockitem.h>
+#include <glibmm/thread.h>
+#include <sigc++/bind.h>
 #include <sigc++/signal.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_map>
 
 
 namespace GParted
@@ -53,66 +60,67 @@ namespace  // unnamed
 {
 
 
-class CommandStatus
-{
-public:
-	bool        running;
-	int         pipecount;
-	int         exit_status;
-	bool        foreground;
-	Glib::Mutex mutex;
-	Glib::Cond  cond;
-
-	void store_exit_status(GPid pid, int status);
-	void execute_command_eof();
-};
+// How often the Gtk main loop is run while waiting for a command on
+// GParted_Core::mainthread.
+static const unsigned int MAINLOOP_INTERVAL = 50;  // Milliseconds
 
 
-void CommandStatus::store_exit_status(GPid pid, int status)
-{
-	exit_status = Utils::decode_wait_status(status);
-	running = false;
-	if (pipecount == 0)  // pipes finished first
-	{
-		if (foreground)
-			Gtk::Main::quit();
-		else {
-			mutex.lock();
-			cond.signal();
-			mutex.unlock();
-		}
-	}
-	Glib::spawn_close_pid(pid);
-}
+// Default seconds external commands run by Utils::execute_command() are given to finish.
+// Overridden by environment variable GPARTED_COMMAND_TIMEOUT, where 0 means no timeout.
+static const unsigned int DEFAULT_COMMAND_TIMEOUT = 120;
 
 
-void CommandStatus::execute_command_eof()
+// Counts of commands which timed out, in all threads and in this thread.
+static std::atomic<unsigned int> timed_out_count(0);
+static thread_local unsigned int thread_timed_out_count = 0;
+
+// Are commands run by this thread given the command timeout?
+static thread_local bool thread_command_timeout = false;
+
+
+// Regular expressions compiled by Utils::regexp_label(), keyed by pattern.  The same
+// patterns are matched against the output of every device and partition so compile each
+// only once.  Patterns built from device names make the cache grow, so it's emptied when
+// it gets large.
+static const size_t REGEX_CACHE_MAX_SIZE = 512;
+static Glib::Mutex regex_cache_mutex;
+static std::unordered_map<std::string, Glib::RefPtr<Glib::Regex>> regex_cache;
+
+
+static bool run_pending_events()
 {
-	if (--pipecount)
-		return;  // wait for second pipe to eof
-	if (! running)  // already got exit status
-	{
-		if (foreground)
-			Gtk::Main::quit();
-		else {
-			mutex.lock();
-			cond.signal();
-			mutex.unlock();
-		}
-	}
+	while (Gtk::Main::events_pending())
+		Gtk::Main::iteration(false);
+	return true;
 }
 
 
-static void set_C_locale()
+// Tokenize() and split() search the UTF-8 bytes of the string rather than the characters.
+// Glib::ustring character positions are found by counting from the start of the string
+// on every call, making splitting long command output quadratic.  As UTF-8 multi-byte
+// characters never contain ASCII bytes, searching for ASCII delimiters byte by byte finds
+// the same positions.
+static Glib::ustring ustring_from_raw(const std::string& raw, std::string::size_type begin,
+                                      std::string::size_type end)
 {
-	setenv("LC_ALL", "C", 1);
+	if (end == std::string::npos)
+		end = raw.size();
+	return Glib::ustring(raw.begin() + begin, raw.begin() + end);
 }
 
 
-static void _store_exit_status(GPid pid, gint status, gpointer data)
+static Glib::RefPtr<Glib::Regex> get_compiled_regex(const Glib::ustring& pattern)
 {
-	CommandStatus *sp = (CommandStatus *)data;
-	sp->store_exit_status(pid, status);
+	Glib::Mutex::Lock lock(regex_cache_mutex);
+	std::unordered_map<std::string, Glib::RefPtr<Glib::Regex>>::const_iterator it = regex_cache.find(pattern.raw());
+	if (it != regex_cache.end())
+		return it->second;
+
+	Glib::RefPtr<Glib::Regex> regex = Glib::Regex::create(pattern, Glib::REGEX_CASELESS | Glib::REGEX_MULTILINE);
+	if (regex_cache.size() >= REGEX_CACHE_MAX_SIZE)
+		regex_cache.clear();
+	regex_cache[pattern.raw()] = regex;
+	return regex;
 }
 
 
@@ -715,73 +723,149 @@ int Utils::execute_command( const Glib::ustring & command,
                             Glib::ustring & error,
                             bool use_C_locale )
 {
-	Glib::Pid pid;
-	int in = -1;
-	// set up pipes for capture
-	int out, err;
-	CommandStatus status;
-	// spawn external process
-	status.running = true;
-	status.pipecount = 2;
-	status.foreground = (Glib::Thread::self() == GParted_Core::mainthread);
-	try {
-		Glib::spawn_async_with_pipes(
-			std::string( "." ),
-			Glib::shell_parse_argv( command ),
-			Glib::SPAWN_DO_NOT_REAP_CHILD | Glib::SPAWN_SEARCH_PATH,
-			use_C_locale ? sigc::ptr_fun(set_C_locale) : sigc::slot<void>(),
-			&pid,
-			(input != nullptr) ? &in : 0,
-			&out,
-			&err );
-	} catch (Glib::SpawnError &e) {
-		std::cerr << Utils::convert_ustring(e.what().raw()) << std::endl;
-		return Utils::get_failure_status( e );
+	CommandRunner runner(command, output, error);
+	if (! runner.start(input, use_C_locale))
+	{
+		std::cerr << Utils::convert_ustring(runner.get_start_error()) << std::endl;
+		return runner.get_exit_status();
 	}
-	fcntl( out, F_SETFL, O_NONBLOCK );
-	fcntl( err, F_SETFL, O_NONBLOCK );
-	g_child_watch_add( pid, _store_exit_status, &status );
-	//Lock mutex so we have time to setup pipecapture for output and error streams
-	//  before connecting the input/output signal handler
-	if( !status.foreground )
-		status.mutex.lock();
-	PipeCapture outputcapture( out, output );
-	PipeCapture errorcapture( err, error );
-	outputcapture.signal_eof.connect( sigc::mem_fun( status, &CommandStatus::execute_command_eof ) );
-	errorcapture.signal_eof.connect( sigc::mem_fun( status, &CommandStatus::execute_command_eof ) );
-	outputcapture.connect_signal();
-	errorcapture.connect_signal();
-
-	if (input != nullptr && in != -1)
+
+	if (thread_command_timeout)
+		runner.set_timeout(get_command_timeout());
+	int exit_status = wait_for_command(runner);
+	if (runner.timed_out())
+	{
+		Glib::ustring message = Glib::ustring::compose(
+		        /* TO TRANSLATORS: looks like   lvm pvs ... timed out after 120 seconds */
+		        _("%1 timed out after %2 seconds"), command, get_command_timeout());
+		std::cerr << message << std::endl;
+		if (! error.empty() && error[error.size()-1] != '\n')
+			error += "\n";
+		error += message + "\n";
+	}
+	return exit_status;
+}
+
+
+// Seconds external commands are given to finish, or 0 for no timeout.
+unsigned int Utils::get_command_timeout()
+{
+	static const unsigned int timeout = []()
+	{
+		std::string value = Glib::getenv("GPARTED_COMMAND_TIMEOUT");
+		char* end = nullptr;
+		unsigned long seconds = strtoul(value.c_str(), &end, 10);
+		if (value.empty() || *end != '\0')
+			return DEFAULT_COMMAND_TIMEOUT;
+		return static_cast<unsigned int>(seconds);
+	}();
+	return timeout;
+}
+
+
+// Give the commands run by the calling thread, and by the threads it starts with
+// run_concurrently(), the command timeout.  Only enabled by the threads searching devices
+// and reading usage.  Commands run to change devices, such as mount, swapon and vgchange
+// run by the user from the main window, are left to finish however long they take.
+void Utils::set_thread_command_timeout(bool enabled)
+{
+	thread_command_timeout = enabled;
+}
+
+
+// Number of commands which have timed out in all threads.
+unsigned int Utils::get_timed_out_count()
+{
+	return timed_out_count;
+}
+
+
+// Number of commands which have timed out in the calling thread.
+unsigned int Utils::get_thread_timed_out_count()
+{
+	return thread_timed_out_count;
+}
+
+
+// Wait for a started command to finish, returning its exit status.
+int Utils::wait_for_command(CommandRunner& runner)
+{
+	if (Glib::Thread::self() == GParted_Core::mainthread)
+		// Keep the GUI responsive while waiting.
+		runner.add_timer(MAINLOOP_INTERVAL, sigc::ptr_fun(run_pending_events));
+
+	// Let operations on other disks be applied while waiting.
+	bool relock = GParted_Core::release_core_lock();
+	int exit_status = runner.wait();
+	if (relock)
+		GParted_Core::acquire_core_lock();
+
+	if (runner.timed_out())
 	{
-		// Write small amount of input to pipe to the child process.  Linux will
-		// always accept up 4096 bytes without blocking.  See pipe(7).
-		size_t len = strlen( input );
-		ssize_t written = write( in, input, len );
-		if ( written == -1 || (size_t)written < len )
-			std::cerr << "Write to child failed: " << Glib::strerror( errno ) << std::endl;
-		close( in );
+		timed_out_count++;
+		thread_timed_out_count++;
 	}
+	return exit_status;
+}
 
-	if( status.foreground)
-		Gtk::Main::run();
-	else {
-		status.cond.wait( status.mutex );
-		status.mutex.unlock();
+// Indexes of the work still to be done, shared by the threads of run_concurrently().
+struct WorkQueue
+{
+	unsigned int                   count = 0;
+	unsigned int                   next  = 0;
+	Glib::Mutex                    mutex;
+	sigc::slot<void, unsigned int> work;
+	bool                           command_timeout = false;  // Of the starting thread
+};
+
+
+// Worker thread of run_concurrently() taking the next index from the queue until all
+// have been taken.
+static void work_thread(WorkQueue* queue)
+{
+	thread_command_timeout = queue->command_timeout;
+	while (true)
+	{
+		queue->mutex.lock();
+		unsigned int index = queue->next++;
+		queue->mutex.unlock();
+		if (index >= queue->count)
+			return;
+		queue->work(index);
 	}
-	close( out );
-	close( err );
-	return status.exit_status;
 }
 
+
+// Call work(index) for every index from 0 to count-1 on a pool of up to max_threads
+// threads, returning once all calls have finished.
+void Utils::run_concurrently(unsigned int count, unsigned int max_threads,
+                             const sigc::slot<void, unsigned int>& work)
+{
+	WorkQueue queue;
+	queue.count = count;
+	queue.work  = work;
+	queue.command_timeout = thread_command_timeout;
+
+	// Let the work take the core lock while waiting for it.
+	bool relock = GParted_Core::release_core_lock();
+	std::vector<Glib::Thread*> threads;
+	for (unsigned int i = 0; i < std::min(count, max_threads); i++)
+		threads.push_back(Glib::Thread::create(sigc::bind(sigc::ptr_fun(&work_thread), &queue), true));
+	for (unsigned int i = 0; i < threads.size(); i++)
+		threads[i]->join();
+	if (relock)
+		GParted_Core::acquire_core_lock();
+}
+
+
 // Return shell style exit status when failing to execute a command.  127 for command not
 // found and 126 otherwise.
 // NOTE:
 // Together get_failure_status() and decode_wait_status() provide complete shell style
 // exit status handling.  See bash(1) manual page, EXIT STATUS section for details.
-int Utils::get_failure_status(const Glib::SpawnError& e)
+int Utils::get_failure_status(int spawn_errno)
 {
-	if ( e.code() == Glib::SpawnError::NOENT )
+	if (spawn_errno == ENOENT)
 		return 127;
 	return 126;
 }
@@ -819,13 +903,11 @@ Glib::ustring Utils::regexp_label( const Glib::ustring & text
 {
 	//Extract text from a regular sub-expression or pattern.
 	//  E.g., "text we don't want (text we want)"
+	//  Only split at the first match as just the first sub-expression is wanted.
 	std::vector<Glib::ustring> results;
-	Glib::RefPtr<Glib::Regex> myregexp =
-		Glib::Regex::create( pattern
-		                   , Glib::REGEX_CASELESS | Glib::REGEX_MULTILINE
-		                   );
+	Glib::RefPtr<Glib::Regex> myregexp = get_compiled_regex( pattern );
 
-	results = myregexp ->split( text );
+	results = myregexp ->split( text, 0, static_cast<Glib::RegexMatchFlags>( 0 ), 2 );
 
 	if ( results .size() >= 2 )
 		return results[ 1 ] ;
@@ -889,23 +971,26 @@ Glib::ustring Utils::get_lang()
 //        -> tokens=["word1","word2]
 //The tokenize method copied and adapted from:
 //  http://www.linuxselfhelp.com/HOWTO/C++Programming-HOWTO-7.html
+//Delimiters must be ASCII characters.  (See ustring_from_raw()).
 void Utils::tokenize( const Glib::ustring& str,
                       std::vector<Glib::ustring>& tokens,
                       const Glib::ustring& delimiters = " " )
 {
+	const std::string& raw_str   = str.raw();
+	const std::string& raw_delim = delimiters.raw();
 	// Skip delimiters at beginning.
-	Glib::ustring::size_type lastPos = str.find_first_not_of(delimiters, 0);
+	std::string::size_type lastPos = raw_str.find_first_not_of(raw_delim, 0);
 	// Find first "non-delimiter".
-	Glib::ustring::size_type pos     = str.find_first_of(delimiters, lastPos);
+	std::string::size_type pos     = raw_str.find_first_of(raw_delim, lastPos);
 
-	while (Glib::ustring::npos != pos || Glib::ustring::npos != lastPos)
+	while (std::string::npos != pos || std::string::npos != lastPos)
 	{
 		// Found a token, add it to the vector.
-		tokens.push_back(str.substr(lastPos, pos - lastPos));
+		tokens.push_back(ustring_from_raw(raw_str, lastPos, pos));
 		// Skip delimiters.  Note the "not_of"
-		lastPos = str.find_first_not_of(delimiters, pos);
+		lastPos = raw_str.find_first_not_of(raw_delim, pos);
 		// Find next "non-delimiter"
-		pos = str.find_first_of(delimiters, lastPos);
+		pos = raw_str.find_first_of(raw_delim, lastPos);
 	}
 }
 
@@ -913,24 +998,25 @@ void Utils::tokenize( const Glib::ustring& str,
 //  http://stackoverflow.com/questions/236129/how-to-split-a-string-in-c/3616605#3616605
 //  E.g. using Utils::split(str, result, ":") for str -> result
 //  "" -> []   "a" -> ["a"]   "::" -> ["","",""]   ":a::bb" -> ["","a","","bb"]
+//Delimiters must be ASCII characters.  (See ustring_from_raw()).
 void Utils::split( const Glib::ustring& str,
                    std::vector<Glib::ustring>& result,
                    const Glib::ustring& delimiters     )
 {
+	const std::string& raw_str   = str.raw();
+	const std::string& raw_delim = delimiters.raw();
 	//Special case zero length string to empty vector
-	if ( str == "" )
+	if ( raw_str.empty() )
 		return ;
-	Glib::ustring::size_type fromPos  = 0 ;
-	Glib::ustring::size_type delimPos = str.find_first_of( delimiters );
-	while ( Glib::ustring::npos != delimPos )
+	std::string::size_type fromPos  = 0 ;
+	std::string::size_type delimPos = raw_str.find_first_of( raw_delim );
+	while ( std::string::npos != delimPos )
 	{
-		Glib::ustring word( str, fromPos, delimPos - fromPos ) ;
-		result .push_back( word ) ;
+		result .push_back( ustring_from_raw( raw_str, fromPos, delimPos ) ) ;
 		fromPos = delimPos + 1 ;
-		delimPos = str.find_first_of( delimiters, fromPos ) ;
+		delimPos = raw_str.find_first_of( raw_delim, fromPos ) ;
 	}
-	Glib::ustring word( str, fromPos ) ;
-	result. push_back( word ) ;
+	result. push_back( ustring_from_raw( raw_str, fromPos, std::string::npos ) ) ;
 }
 
 
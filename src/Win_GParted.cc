@@ -32,6 +32,7 @@
 #include "GParted_Core.h"
 #include "MenuHelpers.h"
 #include "Mount_Info.h"
+#include "MoveJournal.h"
 #include "Operation.h"
 #include "OperationCopy.h"
 #include "OperationCheck.h"
@@ -42,6 +43,7 @@
 #include "OperationChangeUUID.h"
 #include "OperationLabelFileSystem.h"
 #include "OperationNamePartition.h"
+#include "OperationOptimizer.h"
 #include "Partition.h"
 #include "PartitionVector.h"
 #include "PasswordRAMStore.h"
@@ -86,6 +88,9 @@ namespace GParted
 Win_GParted::Win_GParted( const std::vector<Glib::ustring> & user_devices )
 {
 	gparted_core .set_user_devices( user_devices ) ;
+	gparted_core.signal_usage_read.connect(sigc::mem_fun(*this, &Win_GParted::on_usage_read));
+	gparted_core.signal_usage_finished.connect(sigc::mem_fun(*this, &Win_GParted::on_usage_finished));
+	m_device_monitor.start();
 
 	//==== GUI =========================
 	this ->set_title( _("GParted") );
@@ -219,6 +224,14 @@ void Win_GParted::init_menubar()
 	menu->append(*item);
 	mainmenu_items[MENU_APPLY_OPERATIONS] = item;
 
+	item = Gtk::manage(new GParted::Menu_Helpers::SeparatorElem());
+	menu->append(*item);
+
+	item = Gtk::manage(new GParted::Menu_Helpers::CheckMenuElem(
+		_("_Verify Copied Data"), sigc::mem_fun(*this, &Win_GParted::menu_edit_verify_copies)));
+	menu->append(*item);
+	mainmenu_items[MENU_VERIFY_COPIES] = item;
+
 	item = Gtk::manage(new GParted::Menu_Helpers::MenuElem(
 		_("_Edit"), *menu));
 	menubar_main.append(*item);
@@ -889,6 +902,14 @@ void Win_GParted::fill_device_info(DeviceInfoValuesType show_values)
 
 bool Win_GParted::on_delete_event( GdkEventAny *event )
 {
+	if (m_reading_usage)
+	{
+		// Quit once the partitions currently having their usage read are done.
+		gparted_core.cancel_reading_usage();
+		m_quit_after_usage = true;
+		return true;
+	}
+
 	return ! Quit_Check_Operations();
 }	
 
@@ -941,7 +962,7 @@ bool Win_GParted::merge_operation(const Operation& candidate)
 	// to use signed int.
 	for (signed int i = static_cast<signed int>(m_operations.size())-1; i >= 0; i--)
 	{
-		if (operations_affect_same_partition(*m_operations[i], candidate))
+		if (OperationOptimizer::operations_affect_same_partition(*m_operations[i], candidate))
 		{
 			return m_operations[i]->merge_operations(candidate);
 		}
@@ -950,52 +971,6 @@ bool Win_GParted::merge_operation(const Operation& candidate)
 }
 
 
-// Report whether the second candidate operation affects the same partition(s) as the
-// first target operation.
-bool Win_GParted::operations_affect_same_partition(const Operation& first_op, const Operation& second_op)
-{
-	if (first_op.m_type == OPERATION_DELETE)
-		// First target operation is deleting the partition so there is no
-		// partition to merge the second candidate operation into.
-		return false;
-
-	if (first_op.get_partition_new().get_path() == second_op.get_partition_original().get_path())
-		return true;
-
-	// A copy operation is considered to affect both the copied source and pasted
-	// target partitions, to prevent merging of operations past either.  Two copy
-	// operations have four partition combinations to check.  The one above covering
-	// all operations and three more below.
-	Glib::ustring first_copied_path;
-	if (first_op.m_type == OPERATION_COPY)
-	{
-		const OperationCopy& first_copy_op = static_cast<const OperationCopy&>(first_op);
-		first_copied_path = first_copy_op.get_partition_copied().get_path();
-
-		if (first_copied_path == second_op.get_partition_original().get_path())
-			return true;
-	}
-
-	Glib::ustring second_copied_path;
-	if (second_op.m_type == OPERATION_COPY)
-	{
-		const OperationCopy& second_copy_op = static_cast<const OperationCopy&>(second_op);
-		second_copied_path = second_copy_op.get_partition_copied().get_path();
-
-		if (first_op.get_partition_new().get_path() == second_copied_path)
-			return true;
-	}
-
-	if (first_op.m_type == OPERATION_COPY && second_op.m_type == OPERATION_COPY)
-	{
-		if (first_copied_path == second_copied_path)
-			return true;
-	}
-
-	return false;
-}
-
-
 void Win_GParted::Refresh_Visual()
 {
 	// How GParted displays partitions in the GUI and manages the lifetime and
@@ -1012,6 +987,11 @@ void Win_GParted::Refresh_Visual()
 	//                 GParted_Core::set_devices_thread( devices )
 	//                     devices.clear()
 	//                     etc.
+	//             Win_GParted::start_reading_usage()
+	//                 gparted_core.start_reading_usage()
+	//
+	//     File system usage is filled in afterwards in the background, with each
+	//     partition's usage set by the main thread as it is read.
 	//
 	// (2) Takes a copy of the device and partitions for the device currently being
 	//     shown in the GUI and visually applies pending operations.
@@ -1641,6 +1621,7 @@ void Win_GParted::combo_devices_changed()
 	if (m_current_device >= m_devices.size())
 		m_current_device = 0;
 	set_title(Glib::ustring::compose(_("%1 - GParted"), m_devices[m_current_device]->get_path()));
+	gparted_core.set_usage_priority_device(m_devices[m_current_device]->get_path());
 
 	// Switch the menus and column header between disk device and Volume Group variants.
 	set_device_type_ui();
@@ -1694,17 +1675,166 @@ void Win_GParted::on_show()
 bool Win_GParted::initial_device_refresh()
 {
 	menu_gparted_refresh_devices();
+	if (m_reading_usage)
+		m_check_moves_after_usage = true;
+	else
+		check_interrupted_moves();
 	return false;  // One shot, remove this callback.
 }
 
 
+// Offer to resume any moves of file systems which were interrupted in an earlier run of
+// GParted.
+void Win_GParted::check_interrupted_moves()
+{
+	std::vector<Glib::ustring> filenames = MoveJournal::find_journals();
+	for (unsigned int i = 0; i < filenames.size(); i++)
+		offer_resume_move(filenames[i]);
+}
+
+
+// Offer to resume one interrupted move by queuing a move from the all encompassing
+// partition it left behind.
+void Win_GParted::offer_resume_move(const Glib::ustring& filename)
+{
+	MoveJournal journal;
+	if (! journal.load(filename))
+		return;
+
+	unsigned int     device_index = 0;
+	const Partition* partition    = nullptr;
+	for (unsigned int i = 0; partition == nullptr && i < m_devices.size(); i++)
+	{
+		if (m_devices[i]->get_path() != journal.get_device_path())
+			continue;
+		const PartitionVector& partitions = m_devices[i]->partitions;
+		for (unsigned int j = 0; partition == nullptr && j < partitions.size(); j++)
+		{
+			const PartitionVector& candidates = (partitions[j].type == TYPE_EXTENDED)
+			                                    ? partitions[j].logicals : partitions;
+			for (unsigned int k = 0; k < candidates.size(); k++)
+			{
+				if (candidates[k].partition_number == journal.get_partition_number() &&
+				    candidates[k].sector_start     == journal.get_all_space_start()  &&
+				    candidates[k].sector_end       == journal.get_all_space_end()      )
+				{
+					device_index = i;
+					partition    = &candidates[k];
+					break;
+				}
+			}
+		}
+	}
+	if (partition == nullptr)
+	{
+		// The device may have been renamed or not scanned in this run, so keep the
+		// journal unless the user chooses to discard it.
+		Gtk::MessageDialog dialog(*this,
+		                          _("An interrupted move of a file system could not be matched"),
+		                          false,
+		                          Gtk::MESSAGE_WARNING,
+		                          Gtk::BUTTONS_NONE,
+		                          true);
+		dialog.set_secondary_text(Glib::ustring::compose(
+		                /*TO TRANSLATORS: looks like   GParted stopped while moving the file system in partition 3 on /dev/sdb, but no partition on /dev/sdb matches it now. */
+		                _("GParted stopped while moving the file system in partition %1 on %2, but no partition on %2 matches it now."),
+		                journal.get_partition_number(),
+		                journal.get_device_path())
+		        + "\n\n"
+		        + Glib::ustring::compose(
+		                /*TO TRANSLATORS: looks like   The record of the move is kept in /root/.local/share/gparted/move-journal-sdb-3 so that the move can be resumed when the device is found again.  Discard it only if the move is no longer needed. */
+		                _("The record of the move is kept in %1 so that the move can be resumed when the device is found again.  Discard it only if the move is no longer needed."),
+		                journal.get_filename()));
+		dialog.add_button(_("_Keep"), Gtk::RESPONSE_CANCEL);
+		dialog.add_button(_("_Discard"), Gtk::RESPONSE_OK);
+		dialog.set_default_response(Gtk::RESPONSE_CANCEL);
+		if (dialog.run() == Gtk::RESPONSE_OK)
+			journal.end();
+		return;
+	}
+
+	Gtk::MessageDialog dialog(*this,
+	                          _("An interrupted move of a file system was found"),
+	                          false,
+	                          Gtk::MESSAGE_QUESTION,
+	                          Gtk::BUTTONS_YES_NO,
+	                          true);
+	dialog.set_secondary_text(Glib::ustring::compose(
+	                /*TO TRANSLATORS: looks like   GParted stopped while moving the file system in partition /dev/sda3 with 1.00 GiB of 4.00 GiB moved. */
+	                _("GParted stopped while moving the file system in partition %1 with %2 of %3 moved."),
+	                partition->get_path(),
+	                Utils::format_size(journal.get_done(), 1),
+	                Utils::format_size(journal.get_sector_length() * journal.get_sector_size(), 1))
+	        + "\n\n"
+	        + _("Do you want to queue an operation to resume the move?  Until it is resumed the file system is unusable."));
+	if (dialog.run() != Gtk::RESPONSE_YES)
+		return;
+	dialog.hide();
+
+	Partition* partition_new = partition->clone();
+	partition_new->sector_start = journal.get_dst_start();
+	partition_new->sector_end   = journal.get_dst_start() + journal.get_sector_length() - 1;
+	partition_new->fstype       = journal.get_fstype();
+	partition_new->alignment    = ALIGN_STRICT;
+
+	std::unique_ptr<Operation> operation = std::make_unique<OperationResizeMove>(
+	                        *m_devices[device_index],
+	                        *partition,
+	                        *partition_new);
+	operation->m_icon = Utils::mk_pixbuf(*this, Gtk::Stock::GOTO_LAST, Gtk::ICON_SIZE_MENU);
+
+	delete partition_new;
+	partition_new = nullptr;
+
+	if (device_index != m_current_device)
+		combo_devices.set_active(device_index);
+	add_operation(*m_devices[device_index], std::move(operation));
+	show_operationslist();
+}
+
+
 void Win_GParted::menu_gparted_refresh_devices()
 {
-	show_pulsebar( _("Scanning all devices...") ) ;
-	gparted_core.set_devices(m_devices);
-	hide_pulsebar();
+	Glib::ustring current_path;
+	if (m_current_device < m_devices.size())
+		current_path = m_devices[m_current_device]->get_path();
+
+	// Only search the devices which have changed since the last scan when they are
+	// known, otherwise search them all.
+	std::vector<Glib::ustring> changed_paths;
+	bool refreshed = false;
+	if (m_device_monitor.get_changed_devices(changed_paths))
+	{
+		show_pulsebar(_("Scanning changed devices..."));
+		refreshed = gparted_core.refresh_devices(m_devices, changed_paths);
+		hide_pulsebar();
+	}
+	if (! refreshed)
+	{
+		show_pulsebar( _("Scanning all devices...") ) ;
+		gparted_core.set_devices(m_devices);
+		hide_pulsebar();
+	}
+	m_device_monitor.reset();
+	// Search devices again on the next refresh when commands timed out this time.
+	for (unsigned int i = 0; i < m_devices.size(); i++)
+	{
+		if (! m_devices[i]->incomplete)
+			continue;
+		if (m_devices[i]->is_partition_table_device())
+			m_device_monitor.mark_changed(m_devices[i]->get_path());
+		else
+			// Volume Groups are only searched by scanning all devices.
+			m_device_monitor.mark_all_changed();
+	}
 
 	// Check if m_current_device is still available (think about hotpluggable stuff like USB devices)
+	// and follow it to its new position in the list.
+	for (unsigned int i = 0; i < m_devices.size(); i++)
+	{
+		if (m_devices[i]->get_path() == current_path)
+			m_current_device = i;
+	}
 	if (m_current_device >= m_devices.size())
 		m_current_device = 0;
 
@@ -1768,7 +1898,101 @@ void Win_GParted::menu_gparted_refresh_devices()
 		treeview_detail .set_sensitive( true ) ;
 		
 		refresh_combo_devices() ;	
+
+		start_reading_usage();
+	}
+}
+
+
+// Read the file system usage of the scanned partitions in the background.  Meanwhile
+// devices and partitions can be selected and looked at, with the selected device read
+// first, but nothing else done.
+void Win_GParted::start_reading_usage()
+{
+	gparted_core.set_usage_priority_device(m_devices[m_current_device]->get_path());
+	if (! gparted_core.start_reading_usage())
+		return;
+
+	m_reading_usage = true;
+	pulsebar.show();
+	statusbar.push(_("Reading file system usage..."));
+	toolbar_main.set_sensitive(false);
+	menubar_main.set_sensitive(false);
+	menu_partition.set_sensitive(false);
+	pulsetimer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Win_GParted::pulsebar_pulse), 100);
+}
+
+
+void Win_GParted::on_usage_read(const Glib::ustring& device_path)
+{
+	if (m_devices[m_current_device]->get_path() != device_path || m_usage_refresh_timer.connected())
+		return;
+	m_usage_refresh_timer = Glib::signal_timeout().connect(
+	                sigc::mem_fun(*this, &Win_GParted::refresh_usage_visual), 250);
+}
+
+
+void Win_GParted::on_usage_finished()
+{
+	m_reading_usage = false;
+	pulsetimer.disconnect();
+	pulsebar.hide();
+	statusbar.pop();
+	toolbar_main.set_sensitive(true);
+	menubar_main.set_sensitive(true);
+	menu_partition.set_sensitive(true);
+
+	m_usage_refresh_timer.disconnect();
+	refresh_usage_visual();
+
+	if (m_quit_after_usage)
+	{
+		m_quit_after_usage = false;
+		if (Quit_Check_Operations())
+			hide();
+		return;
+	}
+	if (m_check_moves_after_usage)
+	{
+		m_check_moves_after_usage = false;
+		check_interrupted_moves();
+	}
+}
+
+
+// Redraw the current device with the usage read so far, keeping the selected partition
+// selected.
+bool Win_GParted::refresh_usage_visual()
+{
+	Glib::ustring selected_path;
+	if (selected_partition_ptr != nullptr && selected_partition_ptr->fstype != FS_UNALLOCATED)
+		selected_path = selected_partition_ptr->get_path();
+
+	Refresh_Visual();
+
+	if (selected_path.empty())
+		return false;
+	for (unsigned int i = 0; i < m_display_device->partitions.size(); i++)
+	{
+		const Partition* partition_ptr = nullptr;
+		if (m_display_device->partitions[i].get_path() == selected_path)
+			partition_ptr = &m_display_device->partitions[i];
+		for (unsigned int j = 0; j < m_display_device->partitions[i].logicals.size(); j++)
+		{
+			if (m_display_device->partitions[i].logicals[j].fstype != FS_UNALLOCATED &&
+			    m_display_device->partitions[i].logicals[j].get_path() == selected_path  )
+				partition_ptr = &m_display_device->partitions[i].logicals[j];
+		}
+		if (partition_ptr != nullptr)
+		{
+			selected_partition_ptr = partition_ptr;
+			set_valid_operations();
+			drawingarea_visualdisk.set_selected(partition_ptr);
+			treeview_detail.set_selected(partition_ptr);
+			break;
+		}
 	}
+	return false;  // One shot, remove this callback.
 }
 
 void Win_GParted::menu_gparted_features()
@@ -1802,6 +2026,12 @@ void Win_GParted::menu_gparted_quit()
 		this ->hide();
 }
 
+void Win_GParted::menu_edit_verify_copies()
+{
+	gparted_core.set_verify_copies(
+		static_cast<Gtk::CheckMenuItem *>(mainmenu_items[MENU_VERIFY_COPIES])->get_active());
+}
+
 void Win_GParted::menu_view_harddisk_info()
 { 
 	if (static_cast<Gtk::CheckMenuItem *>(mainmenu_items[MENU_DEVICE_INFORMATION])->get_active())
@@ -2021,11 +2251,15 @@ void Win_GParted::on_partition_selected( const Partition * partition_ptr, bool s
 
 void Win_GParted::on_partition_activated() 
 {
+	if (m_reading_usage)
+		return;
 	activate_info() ;
 }
 
 void Win_GParted::on_partition_popup_menu( unsigned int button, unsigned int time ) 
 {
+	if (m_reading_usage)
+		return;
 	menu_partition .popup( button, time );
 }
 
@@ -3246,6 +3480,7 @@ void Win_GParted::activate_disklabel()
 
 		dialog .hide() ;
 			
+		m_device_monitor.mark_changed(m_devices[m_current_device]->get_path());
 		menu_gparted_refresh_devices() ;
 	}
 }
@@ -3273,7 +3508,10 @@ void Win_GParted::activate_manage_flags()
 	dialog .hide() ;
 
 	if (dialog.m_changed)
+	{
+		m_device_monitor.mark_changed(m_devices[m_current_device]->get_path());
 		menu_gparted_refresh_devices() ;
+	}
 }
 
 
@@ -3513,6 +3751,27 @@ int  Win_GParted::active_partitions_on_device_count( const Device & device )
 
 void Win_GParted::activate_apply()
 {
+	// Fold the pending operations in a plan which only replaces them once the user
+	// has confirmed applying them.
+	OperationOptimizer optimizer(m_operations);
+	if (optimizer.get_num_operations() == 0)
+	{
+		Gtk::MessageDialog dialog(*this,
+		                          _("The pending operations cancel each other out"),
+		                          false,
+		                          Gtk::MESSAGE_INFO,
+		                          Gtk::BUTTONS_OK,
+		                          true);
+		dialog.set_secondary_text(_("Nothing needs to be applied so the operations have been removed."));
+		dialog.run();
+		dialog.hide();
+
+		remove_operation(REMOVE_ALL);
+		close_operationslist();
+		Refresh_Visual();
+		return;
+	}
+
 	Gtk::MessageDialog dialog( *this,
 				   _("Are you sure you want to apply the pending operations?"),
 				   false,
@@ -3523,6 +3782,13 @@ void Win_GParted::activate_apply()
 	temp =  _( "Editing partitions has the potential to cause LOSS of DATA.") ;
 	temp += "\n" ;
 	temp += _( "You are advised to backup your data before proceeding." ) ;
+	if (optimizer.get_bytes_saved() > 0)
+	{
+		temp += "\n\n";
+		/*TO TRANSLATORS: looks like   Pending operations will be combined to avoid moving about 12.00 GiB of data. */
+		temp += Glib::ustring::compose(_("Pending operations will be combined to avoid moving about %1 of data."),
+		                               Utils::format_size(optimizer.get_bytes_saved(), 1));
+	}
 	dialog .set_secondary_text( temp ) ;
 	dialog .set_title( _( "Apply operations to device" ) );
 	
@@ -3534,6 +3800,12 @@ void Win_GParted::activate_apply()
 	{
 		dialog .hide() ; //hide confirmationdialog
 
+		if (optimizer.changed())
+		{
+			optimizer.commit(m_operations);
+			Refresh_Visual();
+		}
+
 		Dialog_Progress dialog_progress(m_devices, m_operations);
 		dialog_progress .set_transient_for( *this ) ;
 		dialog_progress .signal_apply_operation .connect(
@@ -3557,6 +3829,7 @@ void Win_GParted::activate_apply()
 		m_new_count = 1;
 
 		//reread devices and their layouts...
+		m_device_monitor.mark_all_changed();
 		menu_gparted_refresh_devices() ;
 	}
 }
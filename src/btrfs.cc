@@ -23,6 +23,7 @@
 #include "Mount_Info.h"
 #include "OperationDetail.h"
 #include "Partition.h"
+#include "SuperblockReader.h"
 #include "Utils.h"
 
 #include <glibmm/miscutils.h>
@@ -203,44 +204,48 @@ void btrfs::set_used_sectors(Partition& partition)
 	// This calculation also ignores that btrfs allocates chunks at the volume manager
 	// level.  So when fully compacted there will be partially filled chunks for
 	// metadata and data for each storage profile (RAID level) not accounted for.
-	Glib::ustring output;
-	Glib::ustring error;
-	Utils::execute_command("btrfs inspect-internal dump-super " + Glib::shell_quote(partition.get_path()),
-		               output, error, true);
-	// btrfs inspect-internal dump-super returns zero exit status for both success and
-	// failure.  Instead use non-empty stderr to identify failure.
-	if (! error.empty())
+	//
+	// The same figures are read directly from the primary superblock, falling back
+	// to dump-super.
+	long long total_bytes = -1;           // File system wide size (sum of devid sizes)
+	long long bytes_used = -1;            // File system wide used bytes
+	long long sector_size = -1;
+	long long dev_item_total_bytes = -1;  // This device size
+	SuperblockReader superblock(partition.get_path());
+	if (! superblock.open() ||
+	    ! superblock.read_btrfs(total_bytes, bytes_used, sector_size, dev_item_total_bytes))
 	{
-		if (! output.empty())
-			partition.push_back_message(output);
+		Glib::ustring output;
+		Glib::ustring error;
+		Utils::execute_command("btrfs inspect-internal dump-super " + Glib::shell_quote(partition.get_path()),
+			               output, error, true);
+		// btrfs inspect-internal dump-super returns zero exit status for both success and
+		// failure.  Instead use non-empty stderr to identify failure.
 		if (! error.empty())
-			partition.push_back_message(error);
-		return;
-	}
+		{
+			if (! output.empty())
+				partition.push_back_message(output);
+			if (! error.empty())
+				partition.push_back_message(error);
+			return;
+		}
 
-	// Btrfs file system wide size (sum of devid sizes)
-	long long total_bytes = -1;
-	Glib::ustring::size_type index = output.find("\ntotal_bytes");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\ntotal_bytes %lld", &total_bytes);
+		Glib::ustring::size_type index = output.find("\ntotal_bytes");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\ntotal_bytes %lld", &total_bytes);
 
-	// Btrfs file system wide used bytes
-	long long bytes_used = -1;
-	index = output.find("\nbytes_used");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\nbytes_used %lld", &bytes_used);
+		index = output.find("\nbytes_used");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\nbytes_used %lld", &bytes_used);
 
-	// Sector size
-	long long sector_size = -1;
-	index = output.find("\nsectorsize");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\nsectorsize %lld", &sector_size);
+		index = output.find("\nsectorsize");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\nsectorsize %lld", &sector_size);
 
-	// Btrfs this device size
-	long long dev_item_total_bytes = -1;
-	index = output.find("\ndev_item.total_bytes");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\ndev_item.total_bytes %lld", &dev_item_total_bytes);
+		index = output.find("\ndev_item.total_bytes");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\ndev_item.total_bytes %lld", &dev_item_total_bytes);
+	}
 
 	if (total_bytes > -1 && bytes_used > -1 && dev_item_total_bytes > -1 && sector_size > -1)
 	{
@@ -413,7 +418,7 @@ Glib::ustring btrfs::get_mount_device( const Glib::ustring & path )
 
 	for ( unsigned int i = 0 ; i < btrfs_dev .members .size() ; i ++ )
 		if ( Mount_Info::is_dev_mounted( btrfs_dev.members[i] ) )
-			return btrfs_dev.members[i].m_name;
+			return btrfs_dev.members[i].get_name();
 	return "" ;
 }
 
@@ -422,7 +427,7 @@ std::vector<Glib::ustring> btrfs::get_members( const Glib::ustring & path )
 	const BTRFS_Device& btrfs_dev = get_cache_entry(path);
 	std::vector<Glib::ustring> membs;
 	for ( unsigned int i = 0 ; i < btrfs_dev.members.size() ; i ++ )
-		membs.push_back( btrfs_dev.members[i].m_name );
+		membs.push_back( btrfs_dev.members[i].get_name() );
 	return membs;
 }
 
@@ -18,18 +18,23 @@
 
 #include "ext2.h"
 
+#include "AllocationMap.h"
 #include "FileSystem.h"
 #include "OperationDetail.h"
 #include "Partition.h"
 #include "ProgressBar.h"
+#include "SuperblockReader.h"
 #include "Utils.h"
 
 #include <glibmm/miscutils.h>
 #include <glibmm/shell.h>
 #include <glibmm/ustring.h>
 #include <sigc++/signal.h>
+#include <algorithm>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 
 namespace GParted
@@ -125,38 +130,49 @@ FS ext2::get_filesystem_support()
 void ext2::set_used_sectors(Partition& partition)
 {
 	// Called when file system is unmounted *and* when mounted.  Always read
-	// the file system size from the on disk superblock using dumpe2fs to
-	// avoid overhead subtraction.  When mounted read the free space from
-	// the kernel via the statvfs() system call.  When unmounted read the
-	// free space using resize2fs itself falling back to using dumpe2fs.
-	Glib::ustring output;
-	Glib::ustring error;
-	int exit_status = Utils::execute_command("dumpe2fs -h " + Glib::shell_quote(partition.get_path()),
-	                        output, error, true);
-	if (exit_status != 0)
+	// the file system size from the on disk superblock, directly or using
+	// dumpe2fs, to avoid overhead subtraction.  When mounted read the free
+	// space from the kernel via the statvfs() system call.  When unmounted
+	// read the free space using resize2fs itself falling back to the
+	// superblock.
+	long long block_count = -1;
+	long long block_size = -1;
+	long long sb_free_blocks = -1;
+	SuperblockReader superblock(partition.get_path());
+	if (! superblock.open() || ! superblock.read_ext2(block_count, block_size, sb_free_blocks))
 	{
-		if (! output.empty())
-			partition.push_back_message(output);
-		if (! error.empty())
-			partition.push_back_message(error);
-		return;
-	}
+		Glib::ustring output;
+		Glib::ustring error;
+		int exit_status = Utils::execute_command("dumpe2fs -h " + Glib::shell_quote(partition.get_path()),
+		                        output, error, true);
+		if (exit_status != 0)
+		{
+			if (! output.empty())
+				partition.push_back_message(output);
+			if (! error.empty())
+				partition.push_back_message(error);
+			return;
+		}
 
-	long long block_count = -1;
-	Glib::ustring::size_type index = output.find("\nBlock count:");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\nBlock count: %lld", &block_count);
+		Glib::ustring::size_type index = output.find("\nBlock count:");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\nBlock count: %lld", &block_count);
 
-	long long block_size = -1;
-	index = output.find("\nBlock size:");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\nBlock size: %lld", &block_size);
+		index = output.find("\nBlock size:");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\nBlock size: %lld", &block_size);
+
+		index = output.find("\nFree blocks:");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\nFree blocks: %lld", &sb_free_blocks);
+	}
 
 	long long free_blocks = -1;
 	if (partition.busy)
 	{
 		Byte_Value ignored;
 		Byte_Value fs_free_bytes;
+		Glib::ustring error;
 		if (Utils::get_mounted_filesystem_usage(partition.get_mountpoint(),
 		                                        ignored, fs_free_bytes, error) == 0)
 		{
@@ -183,13 +199,9 @@ void ext2::set_used_sectors(Partition& partition)
 		}
 
 		// Resize2fs can fail reporting please run fsck first.  Fall back to
-		// reading dumpe2fs output for free space.
+		// the superblock free blocks count for free space.
 		if (free_blocks == -1)
-		{
-			index = output.find("\nFree blocks:");
-			if (index < output.length())
-				sscanf(output.substr(index).c_str(), "\nFree blocks: %lld", &free_blocks);
-		}
+			free_blocks = sb_free_blocks;
 
 		if (free_blocks == -1 && error2.empty())
 			partition.push_back_message(error2);
@@ -358,6 +370,131 @@ bool ext2::copy( const Partition & src_part,
 }
 
 
+// Ext2/3/4 on disk superblock and group descriptor constants.
+// Reference:
+//     https://www.kernel.org/doc/html/latest/filesystems/ext4/globals.html
+static const uint16_t EXT2_SUPER_MAGIC                       = 0xEF53;
+static const uint16_t EXT2_VALID_FS                          = 0x0001;
+static const uint32_t EXT2_FEATURE_COMPAT_SPARSE_SUPER2      = 0x0200;
+static const uint32_t EXT3_FEATURE_INCOMPAT_RECOVER          = 0x0004;
+static const uint32_t EXT2_FEATURE_INCOMPAT_META_BG          = 0x0010;
+static const uint32_t EXT4_FEATURE_INCOMPAT_64BIT            = 0x0080;
+static const uint32_t EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER    = 0x0001;
+static const uint32_t EXT4_FEATURE_RO_COMPAT_GDT_CSUM        = 0x0010;
+static const uint32_t EXT4_FEATURE_RO_COMPAT_BIGALLOC        = 0x0200;
+static const uint32_t EXT4_FEATURE_RO_COMPAT_METADATA_CSUM   = 0x0400;
+static const uint16_t EXT4_BG_BLOCK_UNINIT                   = 0x0002;
+
+
+static bool is_power_of(uint64_t num, uint64_t base)
+{
+	while (num > 1 && num % base == 0)
+		num /= base;
+	return num == 1;
+}
+
+
+// Decode the block group descriptors and block bitmaps.
+bool ext2::read_allocation_map(AllocationMap& map)
+{
+	unsigned char sb[1024];
+	if (! map.read(1024, sb, sizeof(sb)) || get_le16(sb + 0x38) != EXT2_SUPER_MAGIC)
+		return false;
+
+	uint32_t compat    = get_le32(sb + 0x5C);
+	uint32_t incompat  = get_le32(sb + 0x60);
+	uint32_t ro_compat = get_le32(sb + 0x64);
+	// Only trust the bitmaps of a cleanly unmounted file system without a journal to
+	// replay.  Leave the less common layouts with clusters or meta block groups to a
+	// full copy.
+	if (! (get_le16(sb + 0x3A) & EXT2_VALID_FS)             ||
+	    (incompat & (EXT3_FEATURE_INCOMPAT_RECOVER | EXT2_FEATURE_INCOMPAT_META_BG)) ||
+	    (ro_compat & EXT4_FEATURE_RO_COMPAT_BIGALLOC)            )
+		return false;
+
+	uint32_t log_block_size = get_le32(sb + 0x18);
+	if (log_block_size > 6)
+		return false;
+	Byte_Value block_size = 1024LL << log_block_size;
+
+	uint64_t blocks_count = get_le32(sb + 0x04);
+	uint16_t desc_size = 32;
+	if (incompat & EXT4_FEATURE_INCOMPAT_64BIT)
+	{
+		blocks_count |= static_cast<uint64_t>(get_le32(sb + 0x150)) << 32;
+		desc_size = get_le16(sb + 0xFE);
+	}
+	uint32_t first_data_block    = get_le32(sb + 0x14);
+	uint32_t blocks_per_group    = get_le32(sb + 0x20);
+	uint32_t inodes_per_group    = get_le32(sb + 0x28);
+	uint16_t inode_size          = (get_le32(sb + 0x4C) >= 1) ? get_le16(sb + 0x58) : 128;
+	uint16_t reserved_gdt_blocks = get_le16(sb + 0xCE);
+
+	if (desc_size < 32 || desc_size > block_size || (desc_size & (desc_size - 1)) != 0 ||
+	    blocks_per_group == 0 || blocks_per_group > 8 * block_size                   ||
+	    first_data_block >= blocks_count                                               ||
+	    static_cast<Byte_Value>(blocks_count) > map.get_fs_length() / block_size         )
+		return false;
+
+	uint64_t group_count = (blocks_count - first_data_block + blocks_per_group - 1) / blocks_per_group;
+	Byte_Value gdt_bytes  = group_count * desc_size;
+	Byte_Value gdt_blocks = (gdt_bytes + block_size - 1) / block_size;
+	Byte_Value inode_table_blocks = (static_cast<Byte_Value>(inodes_per_group) * inode_size +
+	                                 block_size - 1) / block_size;
+
+	std::vector<unsigned char> gdt(gdt_bytes);
+	if (! map.read((first_data_block + 1) * block_size, gdt.data(), gdt_bytes))
+		return false;
+
+	bool csum = ro_compat & (EXT4_FEATURE_RO_COMPAT_GDT_CSUM | EXT4_FEATURE_RO_COMPAT_METADATA_CSUM);
+	std::vector<unsigned char> bitmap(block_size);
+	for (uint64_t group = 0; group < group_count; group++)
+	{
+		const unsigned char* desc = gdt.data() + group * desc_size;
+		uint64_t block_bitmap = get_le32(desc + 0x00);
+		uint64_t inode_bitmap = get_le32(desc + 0x04);
+		uint64_t inode_table  = get_le32(desc + 0x08);
+		if (desc_size >= 64)
+		{
+			block_bitmap |= static_cast<uint64_t>(get_le32(desc + 0x20)) << 32;
+			inode_bitmap |= static_cast<uint64_t>(get_le32(desc + 0x24)) << 32;
+			inode_table  |= static_cast<uint64_t>(get_le32(desc + 0x28)) << 32;
+		}
+		uint64_t group_first  = first_data_block + group * blocks_per_group;
+		uint64_t group_blocks = std::min<uint64_t>(blocks_per_group, blocks_count - group_first);
+
+		if (csum && (get_le16(desc + 0x12) & EXT4_BG_BLOCK_UNINIT))
+		{
+			// Block bitmap not initialised on disk.  Only the superblock and group
+			// descriptor backups and the group's own metadata can be in use.
+			bool has_super;
+			if (group == 0)
+				has_super = true;
+			else if (compat & EXT2_FEATURE_COMPAT_SPARSE_SUPER2)
+				has_super = group == get_le32(sb + 0x24C) || group == get_le32(sb + 0x250);
+			else if (ro_compat & EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER)
+				has_super = group == 1 || is_power_of(group, 3) || is_power_of(group, 5) ||
+				            is_power_of(group, 7);
+			else
+				has_super = true;
+			if (has_super)
+				map.add_allocated(group_first * block_size,
+				                  (1 + gdt_blocks + reserved_gdt_blocks) * block_size);
+			map.add_allocated(block_bitmap * block_size, block_size);
+			map.add_allocated(inode_bitmap * block_size, block_size);
+			map.add_allocated(inode_table * block_size, inode_table_blocks * block_size);
+			continue;
+		}
+
+		if (! map.read(block_bitmap * block_size, bitmap.data(), block_size))
+			return false;
+		map.add_allocated_bits(bitmap.data(), group_blocks, group_first * block_size, block_size);
+	}
+
+	return true;
+}
+
+
 //Private methods
 
 void ext2::resize_progress( OperationDetail *operationdetail )
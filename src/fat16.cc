@@ -16,16 +16,21 @@
  */
 
 #include "fat16.h"
+#include "AllocationMap.h"
 #include "FileSystem.h"
 #include "OperationDetail.h"
 #include "Partition.h"
+#include "SuperblockReader.h"
 #include "Utils.h"
 
 #include <glibmm/miscutils.h>
 #include <glibmm/shell.h>
 #include <glibmm/ustring.h>
+#include <algorithm>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 
 namespace GParted
@@ -139,6 +144,33 @@ FS fat16::get_filesystem_support()
 }
 
 void fat16::set_used_sectors( Partition & partition ) 
+{
+	long long logical_sector_size = -1;  // FS logical sector size in bytes
+	long long cluster_size = -1;         // Cluster size in FS logical sectors
+	long long logical_sectors = -1;      // FS size in logical sectors
+	long long bytes_free = -1;
+
+	// Read the boot sector and FAT directly, falling back to mdir and minfo.
+	SuperblockReader superblock(partition.get_path());
+	if (! superblock.open() ||
+	    ! superblock.read_fat(logical_sector_size, cluster_size, logical_sectors, bytes_free))
+	{
+		if (! mtools_read_usage(partition, logical_sector_size, cluster_size, logical_sectors, bytes_free))
+			return;
+	}
+
+	if (bytes_free > -1 && logical_sector_size > -1 && cluster_size > -1 && logical_sectors > -1)
+	{
+		Sector fs_free = bytes_free / partition.sector_size;
+		Sector fs_size = logical_sectors * logical_sector_size / partition.sector_size;
+		partition.set_sector_usage(fs_size, fs_free);
+		partition.fs_block_size = logical_sector_size * cluster_size;
+	}
+}
+
+
+bool fat16::mtools_read_usage(Partition& partition, long long& logical_sector_size, long long& cluster_size,
+                              long long& logical_sectors, long long& bytes_free)
 {
 	// Use mdir's scanning of the FAT to get the free space.
 	// https://en.wikipedia.org/wiki/Design_of_the_FAT_file_system#File_Allocation_Table
@@ -152,14 +184,13 @@ void fat16::set_used_sectors( Partition & partition )
 			partition.push_back_message(output);
 		if (! error.empty())
 			partition.push_back_message(error);
-		return;
+		return false;
 	}
 
 	// Bytes free.  Parse the value from the bottom of the directory listing by mdir.
 	// Example line "                        277 221 376 bytes free".
 	Glib::ustring spaced_number_str = Utils::regexp_label(output, "^ *([0-9 ]*) bytes free$");
 	Glib::ustring number_str = remove_spaces(spaced_number_str);
-	long long bytes_free = -1;
 	if (number_str.size() > 0)
 		bytes_free = atoll(number_str.c_str());
 
@@ -174,17 +205,15 @@ void fat16::set_used_sectors( Partition & partition )
 			partition.push_back_message(output);
 		if (! error.empty())
 			partition.push_back_message(error);
-		return;
+		return false;
 	}
 
 	// FS logical sector size in bytes
-	long long logical_sector_size = -1;
 	Glib::ustring::size_type index = output.find("sector size:");
 	if (index < output.length())
 		sscanf(output.substr(index).c_str(), "sector size: %lld bytes", &logical_sector_size);
 
 	// Cluster size in FS logical sectors
-	long long cluster_size = -1;
 	index = output.find("cluster size:");
 	if (index < output.length())
 		sscanf(output.substr(index).c_str(), "cluster size: %lld sectors", &cluster_size);
@@ -202,19 +231,12 @@ void fat16::set_used_sectors( Partition & partition )
 		sscanf(output.substr(index).c_str(), "big size: %lld sectors", &big_size);
 
 	// FS size in logical sectors
-	long long logical_sectors = -1;
 	if (small_size > 0)
 		logical_sectors = small_size;
 	else if (big_size > 0)
 		logical_sectors = big_size;
 
-	if (bytes_free > -1 && logical_sector_size > -1 && cluster_size > -1 && logical_sectors > -1)
-	{
-		Sector fs_free = bytes_free / partition.sector_size;
-		Sector fs_size = logical_sectors * logical_sector_size / partition.sector_size;
-		partition.set_sector_usage(fs_size, fs_free);
-		partition.fs_block_size = logical_sector_size * cluster_size;
-	}
+	return true;
 }
 
 
@@ -325,6 +347,92 @@ bool fat16::check_repair( const Partition & partition, OperationDetail & operati
 }
 
 
+// Decode the File Allocation Table.  Every cluster with a non-zero FAT entry is in use.
+// The reserved sectors, FATs and FAT12/16 root directory preceding the data area are
+// always in use.
+// Reference:
+//     Microsoft Extensible Firmware Initiative FAT32 File System Specification
+bool fat16::read_allocation_map(AllocationMap& map)
+{
+	unsigned char bs[512];
+	if (! map.read(0, bs, sizeof(bs)) || bs[510] != 0x55 || bs[511] != 0xAA)
+		return false;
+
+	Byte_Value bytes_per_sector    = get_le16(bs + 0x0B);
+	Byte_Value sectors_per_cluster = bs[0x0D];
+	Byte_Value reserved_sectors    = get_le16(bs + 0x0E);
+	Byte_Value num_fats            = bs[0x10];
+	Byte_Value root_entries        = get_le16(bs + 0x11);
+	Byte_Value total_sectors       = get_le16(bs + 0x13);
+	if (total_sectors == 0)
+		total_sectors = get_le32(bs + 0x20);
+	Byte_Value fat_sectors         = get_le16(bs + 0x16);
+	if (fat_sectors == 0)
+		fat_sectors = get_le32(bs + 0x24);
+
+	if (bytes_per_sector < 512 || bytes_per_sector > 4096 ||
+	    (bytes_per_sector & (bytes_per_sector - 1)) != 0     ||
+	    sectors_per_cluster == 0                             ||
+	    (sectors_per_cluster & (sectors_per_cluster - 1)) != 0 ||
+	    reserved_sectors == 0 || num_fats == 0 || fat_sectors == 0 ||
+	    total_sectors * bytes_per_sector > map.get_fs_length()       )
+		return false;
+
+	Byte_Value root_dir_sectors  = (root_entries * 32 + bytes_per_sector - 1) / bytes_per_sector;
+	Byte_Value first_data_sector = reserved_sectors + num_fats * fat_sectors + root_dir_sectors;
+	if (first_data_sector >= total_sectors)
+		return false;
+	Byte_Value cluster_count = (total_sectors - first_data_sector) / sectors_per_cluster;
+
+	// FAT type is determined solely by the count of clusters.
+	int fat_bits = 32;
+	if (cluster_count < 4085)
+		fat_bits = 12;
+	else if (cluster_count < 65525)
+		fat_bits = 16;
+	Byte_Value entry_size = (fat_bits == 32) ? 4 : 2;
+	Byte_Value fat_bytes  = fat_sectors * bytes_per_sector;
+	if ((cluster_count + 1) * fat_bits / 8 + entry_size > fat_bytes)
+		return false;
+
+	Byte_Value cluster_size = sectors_per_cluster * bytes_per_sector;
+	Byte_Value data_offset  = first_data_sector * bytes_per_sector;
+	map.add_allocated(0, data_offset);
+
+	// Read the first FAT in chunks.  A chunk size which is a multiple of 3 bytes keeps
+	// FAT12 entry pairs together.
+	const Byte_Value FAT_CHUNK_SIZE = 3 * 256 * KIBIBYTE;
+	std::vector<unsigned char> buf(FAT_CHUNK_SIZE);
+	Byte_Value buf_start = 0;
+	Byte_Value buf_len   = 0;
+	for (Byte_Value cluster = 2; cluster < cluster_count + 2; cluster++)
+	{
+		Byte_Value entry_offset = cluster * fat_bits / 8;
+		if (entry_offset + entry_size > buf_start + buf_len)
+		{
+			buf_start = entry_offset;
+			buf_len   = std::min(FAT_CHUNK_SIZE, fat_bytes - buf_start);
+			if (! map.read(reserved_sectors * bytes_per_sector + buf_start, buf.data(), buf_len))
+				return false;
+		}
+
+		const unsigned char* p = buf.data() + (entry_offset - buf_start);
+		uint32_t entry;
+		if (fat_bits == 12)
+			entry = (cluster & 1) ? get_le16(p) >> 4 : get_le16(p) & 0x0FFF;
+		else if (fat_bits == 16)
+			entry = get_le16(p);
+		else
+			entry = get_le32(p) & 0x0FFFFFFF;
+
+		if (entry != 0)
+			map.add_allocated(data_offset + (cluster - 2) * cluster_size, cluster_size);
+	}
+
+	return true;
+}
+
+
 //Private methods
 
 Glib::ustring fat16::sanitize_label(const Glib::ustring& label)
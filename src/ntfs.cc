@@ -18,6 +18,7 @@
 
 #include "ntfs.h"
 
+#include "AllocationMap.h"
 #include "FileSystem.h"
 #include "OperationDetail.h"
 #include "Partition.h"
@@ -27,7 +28,11 @@
 #include <glibmm/shell.h>
 #include <glibmm/ustring.h>
 #include <sigc++/signal.h>
+#include <algorithm>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 
 namespace GParted
@@ -245,6 +250,146 @@ bool ntfs::check_repair( const Partition & partition, OperationDetail & operatio
 }
 
 
+// NTFS on disk format constants.
+// Reference:
+//     Linux kernel fs/ntfs3/ntfs.h
+static const Byte_Value NTFS_FIXUP_BLOCK_SIZE  = 512;  // Update sequence stride
+static const Byte_Value NTFS_BITMAP_MFT_RECORD = 6;    // $Bitmap
+static const uint32_t   NTFS_ATTR_DATA         = 0x80;
+static const uint32_t   NTFS_ATTR_END          = 0xFFFFFFFF;
+
+
+// Apply the update sequence array fixups to a multi-sector MFT record.
+static bool apply_fixups(std::vector<unsigned char>& record)
+{
+	uint16_t usa_ofs   = get_le16(record.data() + 4);
+	uint16_t usa_count = get_le16(record.data() + 6);
+	if (usa_count == 0 || static_cast<size_t>(usa_ofs + usa_count * 2) > record.size() ||
+	    (usa_count - 1) * NTFS_FIXUP_BLOCK_SIZE > static_cast<Byte_Value>(record.size()))
+		return false;
+
+	const unsigned char* usa = record.data() + usa_ofs;
+	for (uint16_t i = 1; i < usa_count; i++)
+	{
+		unsigned char* p = record.data() + i * NTFS_FIXUP_BLOCK_SIZE - 2;
+		if (memcmp(p, usa, 2) != 0)
+			return false;
+		memcpy(p, usa + i * 2, 2);
+	}
+	return true;
+}
+
+
+// Read the $Bitmap system file, which has one bit per cluster of the volume.  Its
+// location is decoded from the unnamed $DATA attribute runlist in MFT record 6.
+bool ntfs::read_allocation_map(AllocationMap& map)
+{
+	unsigned char bs[512];
+	if (! map.read(0, bs, sizeof(bs)) || memcmp(bs + 3, "NTFS    ", 8) != 0)
+		return false;
+
+	Byte_Value bytes_per_sector    = get_le16(bs + 0x0B);
+	Byte_Value sectors_per_cluster = bs[0x0D];
+	if (sectors_per_cluster > 0x80)
+		sectors_per_cluster = 1LL << (256 - sectors_per_cluster);
+	Byte_Value total_sectors       = get_le64(bs + 0x28);
+	Byte_Value mft_lcn             = get_le64(bs + 0x30);
+	int8_t clusters_per_mft_record = static_cast<int8_t>(bs[0x40]);
+	if (bytes_per_sector < 256 || bytes_per_sector > 4096 ||
+	    (bytes_per_sector & (bytes_per_sector - 1)) != 0     ||
+	    sectors_per_cluster == 0                             ||
+	    (sectors_per_cluster & (sectors_per_cluster - 1)) != 0 ||
+	    total_sectors <= 0 || total_sectors > map.get_fs_length() / bytes_per_sector)
+		return false;
+
+	Byte_Value cluster_size  = bytes_per_sector * sectors_per_cluster;
+	Byte_Value cluster_count = total_sectors / sectors_per_cluster;
+	Byte_Value record_size;
+	if (clusters_per_mft_record > 0)
+		record_size = clusters_per_mft_record * cluster_size;
+	else if (clusters_per_mft_record >= -16)
+		record_size = 1LL << -clusters_per_mft_record;
+	else
+		return false;
+	if (record_size < NTFS_FIXUP_BLOCK_SIZE || record_size > 64 * KIBIBYTE)
+		return false;
+
+	// The first MFT records are always contiguous at the start of the MFT.
+	std::vector<unsigned char> record(record_size);
+	if (mft_lcn <= 0 || mft_lcn >= cluster_count                                                    ||
+	    ! map.read(mft_lcn * cluster_size + NTFS_BITMAP_MFT_RECORD * record_size, record.data(), record_size) ||
+	    memcmp(record.data(), "FILE", 4) != 0 || ! apply_fixups(record)                              )
+		return false;
+
+	// Find the unnamed, non-resident $DATA attribute.  $Bitmap is never resident and
+	// only a severely fragmented one would need an $ATTRIBUTE_LIST, which isn't handled.
+	const unsigned char* attr = nullptr;
+	Byte_Value pos = get_le16(record.data() + 0x14);
+	while (pos + 16 <= record_size)
+	{
+		const unsigned char* a = record.data() + pos;
+		uint32_t type   = get_le32(a);
+		uint32_t length = get_le32(a + 4);
+		if (type == NTFS_ATTR_END || length < 16 || pos + length > record_size)
+			break;
+		if (type == NTFS_ATTR_DATA && a[9] == 0)
+		{
+			if (a[8] != 1 || length < 0x40 || get_le64(a + 0x10) != 0)
+				return false;
+			attr = a;
+			break;
+		}
+		pos += length;
+	}
+	if (attr == nullptr)
+		return false;
+
+	// Decode the mapping pairs runlist and read the bitmap run by run.
+	const unsigned char* run     = attr + get_le16(attr + 0x20);
+	const unsigned char* run_end = attr + get_le32(attr + 4);
+	const Byte_Value CHUNK_SIZE = 1 * MEBIBYTE;
+	Byte_Value lcn       = 0;
+	Byte_Value bits_done = 0;
+	std::vector<unsigned char> buf(CHUNK_SIZE);
+	while (run < run_end && *run != 0 && bits_done < cluster_count)
+	{
+		unsigned int len_size = *run & 0x0F;
+		unsigned int off_size = *run >> 4;
+		if (len_size == 0 || len_size > 8 || off_size == 0 || off_size > 8 ||
+		    run + 1 + len_size + off_size > run_end                          )
+			return false;
+
+		Byte_Value run_length = 0;
+		for (unsigned int i = 0; i < len_size; i++)
+			run_length |= static_cast<Byte_Value>(run[1 + i]) << (i * 8);
+		Byte_Value run_offset = 0;
+		for (unsigned int i = 0; i < off_size; i++)
+			run_offset |= static_cast<Byte_Value>(run[1 + len_size + i]) << (i * 8);
+		if (off_size < 8 && (run[len_size + off_size] & 0x80))
+			run_offset -= 1LL << (off_size * 8);  // Sign extend
+		lcn += run_offset;
+		run += 1 + len_size + off_size;
+		if (run_length <= 0 || lcn <= 0 || lcn + run_length > cluster_count)
+			return false;
+
+		Byte_Value run_bytes = std::min(run_length * cluster_size,
+		                                (cluster_count - bits_done + 7) / 8);
+		for (Byte_Value done = 0; done < run_bytes; )
+		{
+			Byte_Value count = std::min(CHUNK_SIZE, run_bytes - done);
+			if (! map.read(lcn * cluster_size + done, buf.data(), count))
+				return false;
+			Byte_Value num_bits = std::min(count * 8, cluster_count - bits_done);
+			map.add_allocated_bits(buf.data(), num_bits, bits_done * cluster_size, cluster_size);
+			bits_done += num_bits;
+			done      += count;
+		}
+	}
+
+	return bits_done >= cluster_count;
+}
+
+
 //Private methods
 
 void ntfs::resize_progress( OperationDetail *operationdetail )
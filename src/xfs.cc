@@ -18,17 +18,23 @@
 
 #include "xfs.h"
 
+#include "AllocationMap.h"
 #include "FileSystem.h"
 #include "OperationDetail.h"
 #include "Partition.h"
 #include "ProgressBar.h"
+#include "SuperblockReader.h"
 #include "Utils.h"
 
 #include <glibmm/miscutils.h>
 #include <glibmm/shell.h>
 #include <glibmm/ustring.h>
 #include <sigc++/signal.h>
+#include <algorithm>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 
 namespace GParted
@@ -107,35 +113,41 @@ FS xfs::get_filesystem_support()
 
 void xfs::set_used_sectors(Partition& partition)
 {
-	Glib::ustring output;
-	Glib::ustring error;
-	int exit_status = Utils::execute_command("xfs_db -r -c 'sb 0' -c 'print blocksize' -c 'print dblocks'"
-	                        " -c 'print fdblocks' " + Glib::shell_quote(partition.get_path()),
-	                        output, error, true);
-	if (exit_status != 0)
+	long long block_size = -1;
+	long long data_blocks = -1;
+	long long free_data_blocks = -1;
+
+	// Read the superblock directly, falling back to xfs_db.
+	SuperblockReader superblock(partition.get_path());
+	if (! superblock.open() || ! superblock.read_xfs(block_size, data_blocks, free_data_blocks))
 	{
-		if (! output.empty())
-			partition.push_back_message(output);
-		if (! error.empty())
-			partition.push_back_message(error);
-		return;
-	}
+		Glib::ustring output;
+		Glib::ustring error;
+		int exit_status = Utils::execute_command("xfs_db -r -c 'sb 0' -c 'print blocksize' -c 'print dblocks'"
+		                        " -c 'print fdblocks' " + Glib::shell_quote(partition.get_path()),
+		                        output, error, true);
+		if (exit_status != 0)
+		{
+			if (! output.empty())
+				partition.push_back_message(output);
+			if (! error.empty())
+				partition.push_back_message(error);
+			return;
+		}
 
-	// blocksize
-	long long block_size = -1;
-	sscanf(output.c_str(), "blocksize = %lld", &block_size);
+		// blocksize
+		sscanf(output.c_str(), "blocksize = %lld", &block_size);
 
-	// filesystem data blocks
-	long long data_blocks = -1;
-	Glib::ustring::size_type index = output.find("\ndblocks");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\ndblocks = %lld", &data_blocks);
+		// filesystem data blocks
+		Glib::ustring::size_type index = output.find("\ndblocks");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\ndblocks = %lld", &data_blocks);
 
-	// free data blocks
-	long long free_data_blocks = -1;
-	index = output.find("\nfdblocks");
-	if (index < output.length())
-		sscanf(output.substr(index).c_str(), "\nfdblocks = %lld", &free_data_blocks);
+		// free data blocks
+		index = output.find("\nfdblocks");
+		if (index < output.length())
+			sscanf(output.substr(index).c_str(), "\nfdblocks = %lld", &free_data_blocks);
+	}
 
 	if (block_size > -1 && data_blocks > -1 && free_data_blocks > -1)
 	{
@@ -364,6 +376,228 @@ bool xfs::check_repair( const Partition & partition, OperationDetail & operation
 }
 
 
+// XFS on disk format constants.
+// Reference:
+//     XFS Algorithms & Data Structures, 3rd Edition
+//     https://git.kernel.org/pub/scm/fs/xfs/xfs-documentation.git
+static const uint16_t XFS_SB_VERSION_NUMBITS     = 0x000F;
+static const uint16_t XFS_SB_VERSION_5           = 5;
+static const uint32_t XFS_BTREE_SBLOCK_LEN       = 16;  // Short form btree block header
+static const uint32_t XFS_BTREE_SBLOCK_CRC_LEN   = 56;  // Short form btree block header, v5
+static const uint32_t XFS_BTREE_MAXLEVELS        = 9;
+static const uint32_t NULLAGBLOCK                = 0xFFFFFFFF;
+static const uint32_t XFS_BBSIZE                 = 512;  // Log basic block size
+static const uint32_t XLOG_HEADER_MAGIC_NUM      = 0xFEEDBABE;
+static const uint32_t XLOG_VERSION_2             = 2;
+static const uint32_t XLOG_HEADER_CYCLE_SIZE     = 32 * 1024;  // Record data covered by each header block
+static const uint32_t XLOG_MAX_RECORD_BBS        = 256 * 1024 / XFS_BBSIZE + 8;  // Largest record with its headers
+static const uint8_t  XLOG_UNMOUNT_TRANS         = 0x08;
+
+
+// Read one block of a free space by block number btree and check its header.
+static bool read_bnobt_block(const AllocationMap& map, Byte_Value offset, std::vector<unsigned char>& block,
+                             const char* magic, uint16_t level)
+{
+	return map.read(offset, block.data(), block.size()) &&
+	       memcmp(block.data(), magic, 4) == 0           &&
+	       get_be16(block.data() + 4) == level;
+}
+
+
+// Read the cycle number of one basic block of the log.  Log record headers hold it after
+// their magic number and every other block starts with it.
+static bool read_log_cycle(const AllocationMap& map, Byte_Value log_offset, uint32_t bb, uint32_t& cycle)
+{
+	unsigned char buf[8];
+	if (! map.read(log_offset + static_cast<Byte_Value>(bb) * XFS_BBSIZE, buf, sizeof(buf)))
+		return false;
+	cycle = (get_be32(buf) == XLOG_HEADER_MAGIC_NUM) ? get_be32(buf + 4) : get_be32(buf);
+	return true;
+}
+
+
+// Was the internal log left clean, as by unmounting or by mkfs.xfs?  That is when the
+// last log record before the head is an unmount record.  Otherwise the log has changes
+// not yet written to the metadata, including the free space btrees, so they can't be
+// trusted.  Anything unexpected is treated as dirty.
+// Reference:
+//     XFS Algorithms & Data Structures, 3rd Edition, Journaling Log
+static bool log_is_clean(const AllocationMap& map, const unsigned char* sb)
+{
+	uint32_t block_size = get_be32(sb + 0x04);
+	uint64_t logstart   = get_be64(sb + 0x30);
+	uint32_t agblocks   = get_be32(sb + 0x54);
+	uint32_t logblocks  = get_be32(sb + 0x60);
+	uint8_t  agblklog   = sb[0x7C];
+	// A log start of 0 means an external log, which can't be read.
+	if (logstart == 0 || logblocks == 0 || agblklog == 0 || agblklog > 31)
+		return false;
+
+	uint64_t agno  = logstart >> agblklog;
+	uint64_t agbno = logstart & ((1ULL << agblklog) - 1);
+	Byte_Value log_offset = static_cast<Byte_Value>(agno * agblocks + agbno) * block_size;
+	uint32_t log_bbs = static_cast<uint64_t>(logblocks) * block_size / XFS_BBSIZE;
+	if (log_offset + static_cast<Byte_Value>(log_bbs) * XFS_BBSIZE > map.get_fs_length())
+		return false;
+
+	// Find the head of the log, the first block not written in the current cycle.
+	// Blocks before it have the cycle of the first block and blocks from it to the end
+	// have the previous cycle.
+	uint32_t first_cycle;
+	uint32_t last_cycle;
+	if (! read_log_cycle(map, log_offset, 0, first_cycle)           ||
+	    ! read_log_cycle(map, log_offset, log_bbs - 1, last_cycle)    )
+		return false;
+	uint32_t head = 0;
+	if (last_cycle != first_cycle)
+	{
+		if (last_cycle + 1 != first_cycle)
+			return false;
+		uint32_t lo = 0;
+		uint32_t hi = log_bbs - 1;
+		while (hi - lo > 1)
+		{
+			uint32_t mid = lo + (hi - lo) / 2;
+			uint32_t cycle;
+			if (! read_log_cycle(map, log_offset, mid, cycle))
+				return false;
+			if (cycle == first_cycle)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		head = hi;
+	}
+
+	// Search back from the head for the header of the last log record.
+	unsigned char header[XFS_BBSIZE];
+	uint32_t rec = head;
+	bool found = false;
+	for (uint32_t i = 0; i < std::min(log_bbs, XLOG_MAX_RECORD_BBS) && ! found; i++)
+	{
+		rec = (rec == 0) ? log_bbs - 1 : rec - 1;
+		if (! map.read(log_offset + static_cast<Byte_Value>(rec) * XFS_BBSIZE, header, sizeof(header)))
+			return false;
+		found = get_be32(header) == XLOG_HEADER_MAGIC_NUM;
+	}
+	if (! found)
+		return false;
+
+	uint32_t h_version    = get_be32(header + 8);
+	uint32_t h_len        = get_be32(header + 12);
+	uint32_t h_num_logops = get_be32(header + 40);
+	uint32_t h_size       = get_be32(header + 320);
+	uint32_t hblks = 1;
+	if ((h_version & XLOG_VERSION_2) && h_size > XLOG_HEADER_CYCLE_SIZE)
+		hblks = (h_size + XLOG_HEADER_CYCLE_SIZE - 1) / XLOG_HEADER_CYCLE_SIZE;
+	uint32_t data_bbs = (h_len + XFS_BBSIZE - 1) / XFS_BBSIZE;
+	if (h_num_logops != 1 || data_bbs == 0 ||
+	    (static_cast<uint64_t>(rec) + hblks + data_bbs) % log_bbs != head)
+		return false;
+
+	// The single operation of an unmount record is flagged as such.  The operation
+	// header is struct xlog_op_header with oh_flags at offset 9.
+	unsigned char data[XFS_BBSIZE];
+	uint32_t data_bb = (static_cast<uint64_t>(rec) + hblks) % log_bbs;
+	if (! map.read(log_offset + static_cast<Byte_Value>(data_bb) * XFS_BBSIZE, data, sizeof(data)))
+		return false;
+	return (data[9] & XLOG_UNMOUNT_TRANS) != 0;
+}
+
+
+// XFS doesn't have an allocation bitmap.  Instead walk the leaves of each allocation
+// group's free space by block number btree and record the space between the free extents
+// as allocated.  AG headers and all other metadata are never in the free space btrees so
+// are correctly recorded as allocated.  Refuse when the log is dirty as then the btrees
+// may not yet include the latest changes.
+bool xfs::read_allocation_map(AllocationMap& map)
+{
+	unsigned char sb[512];
+	if (! map.read(0, sb, sizeof(sb)) || memcmp(sb, "XFSB", 4) != 0)
+		return false;
+
+	uint32_t block_size = get_be32(sb + 0x04);
+	uint64_t dblocks    = get_be64(sb + 0x08);
+	uint32_t agblocks   = get_be32(sb + 0x54);
+	uint32_t agcount    = get_be32(sb + 0x58);
+	uint16_t versionnum = get_be16(sb + 0x64);
+	uint16_t sect_size  = get_be16(sb + 0x66);
+	if (block_size < 512 || block_size > 65536 || (block_size & (block_size - 1)) != 0 ||
+	    sect_size < 512 || sect_size > block_size || (sect_size & (sect_size - 1)) != 0 ||
+	    agblocks == 0 || agcount == 0 || static_cast<uint64_t>(agcount) * agblocks < dblocks ||
+	    static_cast<Byte_Value>(dblocks) > map.get_fs_length() / block_size                    )
+		return false;
+
+	if (! log_is_clean(map, sb))
+		return false;
+
+	bool crc = (versionnum & XFS_SB_VERSION_NUMBITS) == XFS_SB_VERSION_5;
+	const char* magic = crc ? "AB3B" : "ABTB";
+	uint32_t header_len = crc ? XFS_BTREE_SBLOCK_CRC_LEN : XFS_BTREE_SBLOCK_LEN;
+	uint32_t max_leaf_recs = (block_size - header_len) / 8;  // 8 byte records
+	uint32_t max_node_recs = (block_size - header_len) / 12; // 8 byte keys + 4 byte pointers
+
+	std::vector<unsigned char> block(block_size);
+	for (uint32_t agno = 0; agno < agcount; agno++)
+	{
+		Byte_Value ag_start = static_cast<Byte_Value>(agno) * agblocks;
+		Byte_Value ag_len   = std::min<Byte_Value>(agblocks, dblocks - ag_start);
+
+		unsigned char agf[64];
+		if (! map.read(ag_start * block_size + sect_size, agf, sizeof(agf)) ||
+		    memcmp(agf, "XAGF", 4) != 0 || get_be32(agf + 8) != agno          )
+			return false;
+		uint32_t bno_root  = get_be32(agf + 16);
+		uint32_t bno_level = get_be32(agf + 28);
+		if (bno_level == 0 || bno_level > XFS_BTREE_MAXLEVELS)
+			return false;
+
+		// Descend the left edge of the btree to the first leaf.
+		uint32_t agbno = bno_root;
+		for (uint16_t level = bno_level - 1; ; level--)
+		{
+			if (agbno >= ag_len ||
+			    ! read_bnobt_block(map, (ag_start + agbno) * block_size, block, magic, level))
+				return false;
+			if (level == 0)
+				break;
+			if (get_be16(block.data() + 6) == 0)
+				return false;
+			agbno = get_be32(block.data() + header_len + max_node_recs * 8);
+		}
+
+		// Walk the leaves in block number order, following right sibling pointers.
+		Byte_Value cursor = 0;  // AG block up to which space has been recorded
+		for (Byte_Value leaves = 0; ; leaves++)
+		{
+			uint16_t numrecs = get_be16(block.data() + 6);
+			if (numrecs > max_leaf_recs || leaves >= ag_len)
+				return false;
+			for (uint16_t i = 0; i < numrecs; i++)
+			{
+				const unsigned char* rec = block.data() + header_len + i * 8;
+				Byte_Value free_start = get_be32(rec);
+				Byte_Value free_count = get_be32(rec + 4);
+				if (free_start < cursor || free_start + free_count > ag_len)
+					return false;
+				map.add_allocated((ag_start + cursor) * block_size, (free_start - cursor) * block_size);
+				cursor = free_start + free_count;
+			}
+
+			agbno = get_be32(block.data() + 12);
+			if (agbno == NULLAGBLOCK)
+				break;
+			if (agbno >= ag_len ||
+			    ! read_bnobt_block(map, (ag_start + agbno) * block_size, block, magic, 0))
+				return false;
+		}
+		map.add_allocated((ag_start + cursor) * block_size, (ag_len - cursor) * block_size);
+	}
+
+	return true;
+}
+
+
 //Private methods
 
 // Report progress of XFS copy.  Monitor destination FS used bytes and track against
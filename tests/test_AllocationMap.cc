@@ -0,0 +1,527 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test AllocationMap and the FileSystem::read_allocation_map() decoders using small
+ * crafted file system images.
+ */
+
+
+#include "AllocationMap.h"
+#include "Utils.h"
+#include "ext2.h"
+#include "fat16.h"
+#include "ntfs.h"
+#include "xfs.h"
+#include "gtest/gtest.h"
+
+#include <iostream>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+namespace GParted
+{
+
+
+// Print an Extent as part of Google Test failure messages.
+std::ostream& operator<<(std::ostream& out, const Extent& extent)
+{
+	out << "Extent(" << extent.offset << ", " << extent.length << ")";
+	return out;
+}
+
+
+bool operator==(const Extent& lhs, const Extent& rhs)
+{
+	return lhs.offset == rhs.offset && lhs.length == rhs.length;
+}
+
+
+static void put_le16(unsigned char* p, uint16_t v)  { p[0] = v; p[1] = v >> 8; }
+static void put_le32(unsigned char* p, uint32_t v)  { put_le16(p, v); put_le16(p + 2, v >> 16); }
+static void put_le64(unsigned char* p, uint64_t v)  { put_le32(p, v); put_le32(p + 4, v >> 32); }
+static void put_be16(unsigned char* p, uint16_t v)  { p[0] = v >> 8; p[1] = v; }
+static void put_be32(unsigned char* p, uint32_t v)  { put_be16(p, v >> 16); put_be16(p + 2, v); }
+static void put_be64(unsigned char* p, uint64_t v)  { put_be32(p, v >> 32); put_be32(p + 4, v); }
+
+
+// All crafted images are this size so that the always allocated first and last MiB
+// leave space in the middle for the decoded allocation.
+static const Byte_Value IMAGE_SIZE = 8 * MEBIBYTE;
+
+
+class AllocationMapTest : public ::testing::Test
+{
+protected:
+	AllocationMapTest() : m_image(IMAGE_SIZE, 0)  {};
+
+	virtual void write_image_file();
+	virtual void TearDown();
+
+	static const char* s_image_name;
+
+	std::vector<unsigned char> m_image;
+};
+
+
+const char* AllocationMapTest::s_image_name = "test_AllocationMap.img";
+
+
+void AllocationMapTest::write_image_file()
+{
+	unlink(s_image_name);
+	int fd = open(s_image_name, O_WRONLY|O_CREAT, 0666);
+	ASSERT_GE(fd, 0) << "Failed to create image file '" << s_image_name << "'.  errno="
+	                 << errno << "," << strerror(errno);
+	ASSERT_EQ(write(fd, m_image.data(), m_image.size()), (ssize_t)m_image.size())
+	        << "Failed to write image file '" << s_image_name << "'.  errno="
+	        << errno << "," << strerror(errno);
+	close(fd);
+}
+
+
+void AllocationMapTest::TearDown()
+{
+	unlink(s_image_name);
+}
+
+
+TEST_F(AllocationMapTest, AlwaysAllocatedStartAndEnd)
+{
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ExtentVector extents = map.get_extents();
+
+	ASSERT_EQ(2u, extents.size());
+	EXPECT_EQ(Extent(0, MEBIBYTE), extents[0]);
+	EXPECT_EQ(Extent(IMAGE_SIZE - MEBIBYTE, MEBIBYTE), extents[1]);
+}
+
+
+TEST_F(AllocationMapTest, SortsAndMergesExtents)
+{
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	map.add_allocated(5 * MEBIBYTE, 4096);
+	map.add_allocated(3 * MEBIBYTE, 4096);
+	map.add_allocated(3 * MEBIBYTE + 4096, 4096);       // Contiguous with previous
+	map.add_allocated(5 * MEBIBYTE + 2048, 4096);       // Overlaps first
+	map.add_allocated(MEBIBYTE - 4096, 8192);           // Overlaps always allocated start
+	map.add_allocated(IMAGE_SIZE - 4096, 2 * MEBIBYTE); // Runs off the end
+	map.add_allocated(2 * MEBIBYTE, 0);                 // Empty
+	ExtentVector extents = map.get_extents();
+
+	ASSERT_EQ(4u, extents.size());
+	EXPECT_EQ(Extent(0, MEBIBYTE + 4096), extents[0]);
+	EXPECT_EQ(Extent(3 * MEBIBYTE, 8192), extents[1]);
+	EXPECT_EQ(Extent(5 * MEBIBYTE, 6144), extents[2]);
+	EXPECT_EQ(Extent(IMAGE_SIZE - MEBIBYTE, MEBIBYTE), extents[3]);
+}
+
+
+TEST_F(AllocationMapTest, AddAllocatedBits)
+{
+	// Bits 3-12 and 24-32 set, least significant bit of each byte first.
+	const unsigned char bitmap[] = {0xF8, 0x1F, 0x00, 0xFF, 0x01};
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	map.add_allocated_bits(bitmap, 40, 2 * MEBIBYTE, 4096);
+	ExtentVector extents = map.get_extents();
+
+	ASSERT_EQ(4u, extents.size());
+	EXPECT_EQ(Extent(2 * MEBIBYTE + 3 * 4096, 10 * 4096), extents[1]);
+	EXPECT_EQ(Extent(2 * MEBIBYTE + 24 * 4096, 9 * 4096), extents[2]);
+}
+
+
+TEST_F(AllocationMapTest, AlignExtents)
+{
+	ExtentVector extents;
+	extents.push_back(Extent(1000, 100));
+	extents.push_back(Extent(5000, 100));
+	extents.push_back(Extent(20000, 100));
+	extents.push_back(Extent(40900, 1000));
+	ExtentVector aligned = AllocationMap::align_extents(extents, 4096, 8192, 40960);
+
+	// First two merged across a gap smaller than 8192 bytes and the last limited to
+	// the length.
+	ASSERT_EQ(3u, aligned.size());
+	EXPECT_EQ(Extent(0, 8192), aligned[0]);
+	EXPECT_EQ(Extent(16384, 4096), aligned[1]);
+	EXPECT_EQ(Extent(36864, 4096), aligned[2]);
+}
+
+
+TEST_F(AllocationMapTest, ClipAndTotalExtents)
+{
+	ExtentVector extents;
+	extents.push_back(Extent(0, 4096));
+	extents.push_back(Extent(8192, 4096));
+	extents.push_back(Extent(16384, 4096));
+	ExtentVector clipped = AllocationMap::clip_extents(extents, 2048, 16384);
+
+	// Clipped extents are relative to the start of the range.
+	ASSERT_EQ(3u, clipped.size());
+	EXPECT_EQ(Extent(0, 2048), clipped[0]);
+	EXPECT_EQ(Extent(6144, 4096), clipped[1]);
+	EXPECT_EQ(Extent(14336, 2048), clipped[2]);
+	EXPECT_EQ(8192, AllocationMap::total_length(clipped));
+}
+
+
+TEST_F(AllocationMapTest, ReadWithinFileSystemOnly)
+{
+	memcpy(m_image.data() + MEBIBYTE, "GParted", 7);
+	write_image_file();
+
+	AllocationMap map(s_image_name, MEBIBYTE, 2 * MEBIBYTE);
+	unsigned char buf[7];
+	EXPECT_FALSE(map.read(0, buf, sizeof(buf)));  // Not opened yet
+	ASSERT_TRUE(map.open());
+	ASSERT_TRUE(map.read(0, buf, sizeof(buf)));
+	EXPECT_EQ(0, memcmp(buf, "GParted", 7));
+	EXPECT_FALSE(map.read(2 * MEBIBYTE - 4, buf, sizeof(buf)));
+	EXPECT_FALSE(map.read(-1, buf, 1));
+}
+
+
+// Ext2 with 1 KiB blocks in a single block group.  Block bitmap in block 3 with blocks
+// 1-100 and 4001-4100 allocated.
+class Ext2AllocationMapTest : public AllocationMapTest
+{
+protected:
+	virtual void SetUp();
+
+	unsigned char* sb()  { return m_image.data() + 1024; };
+};
+
+
+void Ext2AllocationMapTest::SetUp()
+{
+	put_le32(sb() + 0x04, IMAGE_SIZE / 1024);  // s_blocks_count
+	put_le32(sb() + 0x14, 1);                  // s_first_data_block
+	put_le32(sb() + 0x18, 0);                  // s_log_block_size
+	put_le32(sb() + 0x20, 8192);               // s_blocks_per_group
+	put_le32(sb() + 0x28, 128);                // s_inodes_per_group
+	put_le16(sb() + 0x38, 0xEF53);             // s_magic
+	put_le16(sb() + 0x3A, 0x0001);             // s_state = EXT2_VALID_FS
+
+	unsigned char* desc = m_image.data() + 2 * 1024;
+	put_le32(desc + 0x00, 3);  // bg_block_bitmap
+	put_le32(desc + 0x04, 4);  // bg_inode_bitmap
+	put_le32(desc + 0x08, 5);  // bg_inode_table
+
+	// Bit 0 of the bitmap is the first data block, block 1.
+	unsigned char* bitmap = m_image.data() + 3 * 1024;
+	for (unsigned int i = 0; i < 100; i++)
+		bitmap[i / 8] |= 1 << (i % 8);
+	for (unsigned int i = 4000; i < 4100; i++)
+		bitmap[i / 8] |= 1 << (i % 8);
+}
+
+
+TEST_F(Ext2AllocationMapTest, ReadsBlockBitmap)
+{
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	ext2 fs(FS_EXT2);
+	ASSERT_TRUE(fs.read_allocation_map(map));
+	ExtentVector extents = map.get_extents();
+
+	ASSERT_EQ(3u, extents.size());
+	EXPECT_EQ(Extent(0, MEBIBYTE), extents[0]);
+	EXPECT_EQ(Extent(4001 * 1024, 100 * 1024), extents[1]);
+	EXPECT_EQ(Extent(IMAGE_SIZE - MEBIBYTE, MEBIBYTE), extents[2]);
+}
+
+
+TEST_F(Ext2AllocationMapTest, RefusesNotCleanlyUnmounted)
+{
+	put_le16(sb() + 0x3A, 0x0000);
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	ext2 fs(FS_EXT2);
+	EXPECT_FALSE(fs.read_allocation_map(map));
+}
+
+
+TEST_F(Ext2AllocationMapTest, RefusesJournalNeedingRecovery)
+{
+	put_le32(sb() + 0x60, 0x0004);  // EXT3_FEATURE_INCOMPAT_RECOVER
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	ext2 fs(FS_EXT3);
+	EXPECT_FALSE(fs.read_allocation_map(map));
+}
+
+
+// FAT16 with 512 byte clusters.  Clusters 2-11 and 8000-8009 are in use.
+class Fat16AllocationMapTest : public AllocationMapTest
+{
+protected:
+	virtual void SetUp();
+
+	static const Byte_Value FIRST_DATA_SECTOR = 1 + 2 * 64 + 32;
+};
+
+
+void Fat16AllocationMapTest::SetUp()
+{
+	unsigned char* bs = m_image.data();
+	put_le16(bs + 0x0B, 512);                // BPB_BytsPerSec
+	bs[0x0D] = 1;                            // BPB_SecPerClus
+	put_le16(bs + 0x0E, 1);                  // BPB_RsvdSecCnt
+	bs[0x10] = 2;                            // BPB_NumFATs
+	put_le16(bs + 0x11, 512);                // BPB_RootEntCnt
+	put_le16(bs + 0x13, IMAGE_SIZE / 512);   // BPB_TotSec16
+	put_le16(bs + 0x16, 64);                 // BPB_FATSz16
+	bs[510] = 0x55;
+	bs[511] = 0xAA;
+
+	unsigned char* fat = m_image.data() + 512;
+	for (unsigned int cluster = 2; cluster < 12; cluster++)
+		put_le16(fat + cluster * 2, (cluster == 11) ? 0xFFFF : cluster + 1);
+	for (unsigned int cluster = 8000; cluster < 8010; cluster++)
+		put_le16(fat + cluster * 2, (cluster == 8009) ? 0xFFFF : cluster + 1);
+}
+
+
+TEST_F(Fat16AllocationMapTest, ReadsFileAllocationTable)
+{
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	fat16 fs(FS_FAT16);
+	ASSERT_TRUE(fs.read_allocation_map(map));
+	ExtentVector extents = map.get_extents();
+
+	ASSERT_EQ(3u, extents.size());
+	EXPECT_EQ(Extent(0, MEBIBYTE), extents[0]);
+	EXPECT_EQ(Extent((FIRST_DATA_SECTOR + 7998) * 512, 10 * 512), extents[1]);
+	EXPECT_EQ(Extent(IMAGE_SIZE - MEBIBYTE, MEBIBYTE), extents[2]);
+}
+
+
+TEST_F(Fat16AllocationMapTest, RefusesWithoutBootSignature)
+{
+	m_image[510] = 0x00;
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	fat16 fs(FS_FAT16);
+	EXPECT_FALSE(fs.read_allocation_map(map));
+}
+
+
+// NTFS with 4 KiB clusters and 1 KiB MFT records.  $Bitmap is a single cluster at LCN 16
+// with clusters 0-9 and 1000-1009 in use.
+class NtfsAllocationMapTest : public AllocationMapTest
+{
+protected:
+	virtual void SetUp();
+
+	unsigned char* bitmap_record()  { return m_image.data() + 4 * 4096 + 6 * 1024; };
+};
+
+
+void NtfsAllocationMapTest::SetUp()
+{
+	unsigned char* bs = m_image.data();
+	memcpy(bs + 3, "NTFS    ", 8);
+	put_le16(bs + 0x0B, 512);               // Bytes per sector
+	bs[0x0D] = 8;                           // Sectors per cluster
+	put_le64(bs + 0x28, IMAGE_SIZE / 512);  // Total sectors
+	put_le64(bs + 0x30, 4);                 // $MFT LCN
+	bs[0x40] = 0xF6;                        // MFT record size 2^10
+
+	unsigned char* rec = bitmap_record();
+	memcpy(rec, "FILE", 4);
+	put_le16(rec + 0x04, 0x30);  // Update sequence array offset
+	put_le16(rec + 0x06, 3);     // Update sequence number and one entry per sector
+	put_le16(rec + 0x14, 0x38);  // First attribute
+	// Protect the last two bytes of each sector with the update sequence number.
+	put_le16(rec + 0x30, 0x0001);
+	put_le16(rec + 0x32, 0x0000);
+	put_le16(rec + 0x34, 0x0000);
+	put_le16(rec + 510, 0x0001);
+	put_le16(rec + 1022, 0x0001);
+
+	// Unnamed, non-resident $DATA attribute with a single run of 1 cluster at LCN 16.
+	unsigned char* attr = rec + 0x38;
+	put_le32(attr + 0x00, 0x80);
+	put_le32(attr + 0x04, 0x48);
+	attr[0x08] = 1;
+	put_le16(attr + 0x20, 0x40);
+	attr[0x40] = 0x11;
+	attr[0x41] = 1;
+	attr[0x42] = 16;
+	put_le32(attr + 0x48, 0xFFFFFFFF);
+
+	unsigned char* bitmap = m_image.data() + 16 * 4096;
+	for (unsigned int i = 0; i < 10; i++)
+		bitmap[i / 8] |= 1 << (i % 8);
+	for (unsigned int i = 1000; i < 1010; i++)
+		bitmap[i / 8] |= 1 << (i % 8);
+}
+
+
+TEST_F(NtfsAllocationMapTest, ReadsBitmapFile)
+{
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	ntfs fs;
+	ASSERT_TRUE(fs.read_allocation_map(map));
+	ExtentVector extents = map.get_extents();
+
+	ASSERT_EQ(3u, extents.size());
+	EXPECT_EQ(Extent(0, MEBIBYTE), extents[0]);
+	EXPECT_EQ(Extent(1000 * 4096, 10 * 4096), extents[1]);
+	EXPECT_EQ(Extent(IMAGE_SIZE - MEBIBYTE, MEBIBYTE), extents[2]);
+}
+
+
+TEST_F(NtfsAllocationMapTest, RefusesTornMftRecord)
+{
+	put_le16(bitmap_record() + 1022, 0x0002);
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	ntfs fs;
+	EXPECT_FALSE(fs.read_allocation_map(map));
+}
+
+
+// XFS v4 with 4 KiB blocks in a single allocation group.  The free space btree is a
+// single leaf at AG block 1 with blocks 100-999 and 1100-1999 free.  The internal log of
+// 16 blocks at AG block 1024 holds a single unmount record.
+class XfsAllocationMapTest : public AllocationMapTest
+{
+protected:
+	virtual void SetUp();
+
+	static const Byte_Value LOG_OFFSET = 1024 * 4096;
+
+	unsigned char* log_bb(unsigned int bb)  { return m_image.data() + LOG_OFFSET + bb * 512; };
+};
+
+
+void XfsAllocationMapTest::SetUp()
+{
+	unsigned char* sb = m_image.data();
+	memcpy(sb, "XFSB", 4);
+	put_be32(sb + 0x04, 4096);               // sb_blocksize
+	put_be64(sb + 0x08, IMAGE_SIZE / 4096);  // sb_dblocks
+	put_be64(sb + 0x30, 1024);               // sb_logstart
+	put_be32(sb + 0x54, IMAGE_SIZE / 4096);  // sb_agblocks
+	put_be32(sb + 0x58, 1);                  // sb_agcount
+	put_be32(sb + 0x60, 16);                 // sb_logblocks
+	put_be16(sb + 0x64, 4);                  // sb_versionnum
+	put_be16(sb + 0x66, 512);                // sb_sectsize
+	sb[0x7C] = 11;                           // sb_agblklog
+
+	unsigned char* agf = m_image.data() + 512;
+	memcpy(agf, "XAGF", 4);
+	put_be32(agf + 4, 1);                    // agf_versionnum
+	put_be32(agf + 8, 0);                    // agf_seqno
+	put_be32(agf + 12, IMAGE_SIZE / 4096);   // agf_length
+	put_be32(agf + 16, 1);                   // agf_roots[XFS_BTNUM_BNO]
+	put_be32(agf + 28, 1);                   // agf_levels[XFS_BTNUM_BNO]
+
+	unsigned char* leaf = m_image.data() + 4096;
+	memcpy(leaf, "ABTB", 4);
+	put_be16(leaf + 4, 0);                   // bb_level
+	put_be16(leaf + 6, 2);                   // bb_numrecs
+	put_be32(leaf + 8, 0xFFFFFFFF);          // bb_leftsib
+	put_be32(leaf + 12, 0xFFFFFFFF);         // bb_rightsib
+	put_be32(leaf + 16, 100);
+	put_be32(leaf + 20, 900);
+	put_be32(leaf + 24, 1100);
+	put_be32(leaf + 28, 900);
+
+	// Unmount record in cycle 1 at the start of the log, as written by mkfs.xfs.  The
+	// rest of the log is still in cycle 0.
+	unsigned char* header = log_bb(0);
+	put_be32(header + 0, 0xFEEDBABE);        // h_magicno
+	put_be32(header + 4, 1);                 // h_cycle
+	put_be32(header + 8, 2);                 // h_version
+	put_be32(header + 12, 512);              // h_len
+	put_be32(header + 40, 1);                // h_num_logops
+	put_be32(header + 320, 32768);           // h_size
+	unsigned char* data = log_bb(1);
+	put_be32(data + 0, 1);                   // Cycle in place of oh_tid
+	put_be32(data + 4, 8);                   // oh_len
+	data[8] = 0xAA;                          // oh_clientid = XFS_LOG
+	data[9] = 0x08;                          // oh_flags = XLOG_UNMOUNT_TRANS
+}
+
+
+TEST_F(XfsAllocationMapTest, ReadsFreeSpaceBtree)
+{
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	xfs fs;
+	ASSERT_TRUE(fs.read_allocation_map(map));
+	ExtentVector extents = map.get_extents();
+
+	ASSERT_EQ(3u, extents.size());
+	EXPECT_EQ(Extent(0, MEBIBYTE), extents[0]);
+	EXPECT_EQ(Extent(1000 * 4096, 100 * 4096), extents[1]);
+	EXPECT_EQ(Extent(IMAGE_SIZE - MEBIBYTE, MEBIBYTE), extents[2]);
+}
+
+
+TEST_F(XfsAllocationMapTest, RefusesDirtyLog)
+{
+	// Log record of a transaction after the unmount record.
+	unsigned char* header = log_bb(2);
+	put_be32(header + 0, 0xFEEDBABE);
+	put_be32(header + 4, 1);
+	put_be32(header + 8, 2);
+	put_be32(header + 12, 512);
+	put_be32(header + 40, 1);
+	put_be32(header + 320, 32768);
+	unsigned char* data = log_bb(3);
+	put_be32(data + 0, 1);
+	put_be32(data + 4, 8);
+	data[8] = 0x69;                          // oh_clientid = XFS_TRANSACTION
+	data[9] = 0x01;                          // oh_flags = XLOG_START_TRANS
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	xfs fs;
+	EXPECT_FALSE(fs.read_allocation_map(map));
+}
+
+
+TEST_F(XfsAllocationMapTest, RefusesExternalLog)
+{
+	put_be64(m_image.data() + 0x30, 0);
+	write_image_file();
+	AllocationMap map(s_image_name, 0, IMAGE_SIZE);
+	ASSERT_TRUE(map.open());
+	xfs fs;
+	EXPECT_FALSE(fs.read_allocation_map(map));
+}
+
+
+}  // namespace GParted
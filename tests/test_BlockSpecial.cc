@@ -45,8 +45,10 @@
 #include "BlockSpecial.h"
 #include "gtest/gtest.h"
 
+#include <chrono>
 #include <string>
 #include <iostream>
+#include <vector>
 #include <fstream>
 #include <stdio.h>
 #include <sys/types.h>
@@ -66,7 +68,7 @@ namespace GParted
 // Print method for a BlockSpecial object
 std::ostream& operator<<( std::ostream & out, const BlockSpecial & bs )
 {
-	out << "BlockSpecial{\"" << bs.m_name << "\"," << bs.m_major << "," << bs.m_minor << "}";
+	out << "BlockSpecial{\"" << bs.get_name() << "\"," << bs.m_major << "," << bs.m_minor << "}";
 	return out;
 }
 
@@ -79,7 +81,7 @@ std::ostream& operator<<( std::ostream & out, const BlockSpecial & bs )
                                                 const BlockSpecial & bs, const Glib::ustring & name,
                                                 unsigned long major, unsigned long minor )
 {
-	if ( bs.m_name == name && bs.m_major == major && bs.m_minor == minor )
+	if ( bs.get_name() == name && bs.m_major == major && bs.m_minor == minor )
 		return ::testing::AssertionSuccess();
 	else
 		return ::testing::AssertionFailure()
@@ -230,7 +232,7 @@ TEST( BlockSpecialTest, NamedBlockSpecialObjectBlockDevice )
 	// Test any block special name produces BlockSpecial object (name, major, minor).
 	BlockSpecial::clear_cache();
 	BlockSpecial bs( bname );
-	EXPECT_STREQ( bs.m_name.c_str(), bname.c_str() );
+	EXPECT_STREQ( bs.get_name().c_str(), bname.c_str() );
 	EXPECT_TRUE( bs.m_major > 0 || bs.m_minor > 0 );
 }
 
@@ -244,7 +246,7 @@ TEST( BlockSpecialTest, NamedBlockSpecialObjectBlockDeviceDuplicate )
 	BlockSpecial::clear_cache();
 	BlockSpecial bs1( bname );
 	BlockSpecial bs2( bname );
-	EXPECT_STREQ( bs1.m_name.c_str(), bs2.m_name.c_str() );
+	EXPECT_STREQ( bs1.get_name().c_str(), bs2.get_name().c_str() );
 	EXPECT_EQ( bs1.m_major, bs2.m_major );
 	EXPECT_EQ( bs1.m_minor, bs2.m_minor );
 }
@@ -261,7 +263,7 @@ TEST( BlockSpecialTest, TwoNamedBlockSpecialObjectBlockDevices )
 	BlockSpecial::clear_cache();
 	BlockSpecial bs1( bname1 );
 	BlockSpecial bs2( bname2 );
-	EXPECT_STRNE( bs1.m_name.c_str(), bs2.m_name.c_str() );
+	EXPECT_STRNE( bs1.get_name().c_str(), bs2.get_name().c_str() );
 	EXPECT_TRUE( bs1.m_major != bs2.m_major || bs1.m_minor != bs2.m_minor );
 }
 
@@ -277,7 +279,7 @@ TEST( BlockSpecialTest, NamedBlockSpecialObjectBySymlinkMatches )
 	BlockSpecial::clear_cache();
 	BlockSpecial lnk( lname );
 	BlockSpecial bs( bname );
-	EXPECT_STRNE( lnk.m_name.c_str(), bs.m_name.c_str() );
+	EXPECT_STRNE( lnk.get_name().c_str(), bs.get_name().c_str() );
 	EXPECT_EQ( lnk.m_major, bs.m_major );
 	EXPECT_EQ( lnk.m_minor, bs.m_minor );
 }
@@ -492,5 +494,93 @@ TEST( BlockSpecialTest, OperatorLessThanTwoDifferentBlockDevicesMinorNumbers )
 	EXPECT_TRUE( bs1 < bs2 ) << ON_FAILURE_WHERE( bs1, bs2 );
 }
 
+TEST(BlockSpecialTest, BenchmarkConstructRegisteredNames)
+{
+	// Microbenchmark constructing BlockSpecial objects for names already in the
+	// registry, as happens when looking up cache entries for every partition.
+	// Reports the cost per lookup.
+	const unsigned int NUM_NAMES   = 10000;
+	const unsigned int NUM_LOOKUPS = 1000000;
+	BlockSpecial::clear_cache();
+	std::vector<Glib::ustring> names;
+	for (unsigned int i = 0; i < NUM_NAMES; i++)
+	{
+		names.push_back("/dummy_block" + std::to_string(i));
+		BlockSpecial::register_block_special(names[i], 8, i + 1);
+	}
+
+	unsigned long long sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < NUM_LOOKUPS; i++)
+		sum += BlockSpecial(names[i % NUM_NAMES]).m_minor;
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "BlockSpecial lookup of " << NUM_NAMES << " registered names: "
+	          << elapsed.count() / NUM_LOOKUPS << " ns per lookup" << std::endl;
+
+	unsigned long long expected = (unsigned long long)NUM_LOOKUPS / NUM_NAMES * NUM_NAMES * (NUM_NAMES + 1) / 2;
+	EXPECT_EQ(expected, sum);
+}
+
+TEST(BlockSpecialIndexTest, FindNameNotAdded)
+{
+	// Test names not in the index aren't found.
+	BlockSpecial::clear_cache();
+	BlockSpecial::register_block_special("/dummy_block", 4, 8);
+	BlockSpecialIndex index;
+	EXPECT_EQ(-1, index.find("/dummy_block"));
+	EXPECT_EQ(-1, index.find("/dummy_file"));
+}
+
+TEST(BlockSpecialIndexTest, FindPlainFilesByName)
+{
+	// Test plain files are found by name.
+	BlockSpecial::clear_cache();
+	BlockSpecialIndex index;
+	index.add(BlockSpecial("/dummy_file1"), 0);
+	index.add(BlockSpecial("/dummy_file2"), 1);
+	EXPECT_EQ(0, index.find("/dummy_file1"));
+	EXPECT_EQ(1, index.find("/dummy_file2"));
+	EXPECT_EQ(-1, index.find("/dummy_file3"));
+}
+
+TEST(BlockSpecialIndexTest, FindBlockDeviceByDifferentName)
+{
+	// Test a block device is found by another name for the same major, minor pair,
+	// like a linear search using operator==().
+	BlockSpecial::clear_cache();
+	BlockSpecial::register_block_special("/dummy_block", 4, 8);
+	BlockSpecial::register_block_special("/dummy_link", 4, 8);
+	BlockSpecialIndex index;
+	index.add(BlockSpecial("/dummy_block"), 0);
+	EXPECT_EQ(0, index.find("/dummy_block"));
+	EXPECT_EQ(0, index.find("/dummy_link"));
+}
+
+TEST(BlockSpecialIndexTest, FindFirstOfEqualEntries)
+{
+	// Test the first of several equal entries is found whichever name is looked up,
+	// like a linear search using operator==().
+	BlockSpecial::clear_cache();
+	BlockSpecial::register_block_special("/dummy_block", 4, 8);
+	BlockSpecial::register_block_special("/dummy_link", 4, 8);
+	BlockSpecialIndex index;
+	index.add(BlockSpecial("/dummy_block"), 0);
+	index.add(BlockSpecial("/dummy_link"), 1);
+	index.add(BlockSpecial("/dummy_block"), 2);
+	EXPECT_EQ(0, index.find("/dummy_block"));
+	EXPECT_EQ(0, index.find("/dummy_link"));
+}
+
+TEST(BlockSpecialIndexTest, ClearIndex)
+{
+	// Test nothing is found after clearing the index.
+	BlockSpecial::clear_cache();
+	BlockSpecial::register_block_special("/dummy_block", 4, 8);
+	BlockSpecialIndex index;
+	index.add(BlockSpecial("/dummy_block"), 0);
+	index.clear();
+	EXPECT_EQ(-1, index.find("/dummy_block"));
+}
+
 
 }  // namespace GParted
@@ -0,0 +1,113 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test Checksum CRC-32C implementations against the known answer and each other.
+ */
+
+
+#include "Checksum.h"
+#include "gtest/gtest.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+// Explicit test fixture class to access the private implementations of Checksum.
+class ChecksumTest : public ::testing::Test
+{
+protected:
+	static uint32_t crc32c_slice8(uint32_t crc, const void* buf, size_t length)
+		{ return Checksum::crc32c_slice8(crc, buf, length); };
+	static uint32_t crc32c_sse42(uint32_t crc, const void* buf, size_t length)
+		{ return Checksum::crc32c_sse42(crc, buf, length); };
+
+	static std::vector<unsigned char> random_bytes(size_t length);
+};
+
+
+std::vector<unsigned char> ChecksumTest::random_bytes(size_t length)
+{
+	static std::mt19937 generator(20260101);
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::vector<unsigned char> buf(length);
+	for (size_t i = 0; i < length; i++)
+		buf[i] = byte(generator);
+	return buf;
+}
+
+
+TEST_F(ChecksumTest, KnownAnswer)
+{
+	// Check value of CRC-32C from the Catalogue of parametrised CRC algorithms.
+	EXPECT_EQ(0xE3069283, Checksum::crc32c(0, "123456789", 9));
+	EXPECT_EQ(0xE3069283, crc32c_slice8(0, "123456789", 9));
+	if (Checksum::crc32c_accelerated())
+	{
+		EXPECT_EQ(0xE3069283, crc32c_sse42(0, "123456789", 9));
+	}
+	EXPECT_EQ(0u, Checksum::crc32c(0, "", 0));
+}
+
+
+TEST_F(ChecksumTest, Incremental)
+{
+	const char* data = "123456789";
+	uint32_t crc = 0;
+	for (size_t i = 0; i < 9; i++)
+		crc = Checksum::crc32c(crc, data + i, 1);
+	EXPECT_EQ(0xE3069283, crc);
+	EXPECT_EQ(0xE3069283, Checksum::crc32c(Checksum::crc32c(0, data, 4), data + 4, 5));
+}
+
+
+TEST_F(ChecksumTest, ImplementationsAgreeOnEveryLengthAndAlignment)
+{
+	if (! Checksum::crc32c_accelerated())
+		GTEST_SKIP() << "CPU doesn't have the SSE4.2 CRC32 instruction";
+
+	std::vector<unsigned char> buf = random_bytes(64 + 8);
+	for (size_t align = 0; align < 8; align++)
+	{
+		for (size_t length = 0; length <= 64; length++)
+		{
+			const unsigned char* p = buf.data() + align;
+			EXPECT_EQ(crc32c_slice8(0, p, length), crc32c_sse42(0, p, length))
+			        << "length=" << length << " align=" << align;
+			EXPECT_EQ(crc32c_slice8(0x12345678, p, length), crc32c_sse42(0x12345678, p, length))
+			        << "length=" << length << " align=" << align;
+		}
+	}
+}
+
+
+TEST_F(ChecksumTest, ImplementationsAgreeOnLargeBuffer)
+{
+	if (! Checksum::crc32c_accelerated())
+		GTEST_SKIP() << "CPU doesn't have the SSE4.2 CRC32 instruction";
+
+	std::vector<unsigned char> buf = random_bytes(1024 * 1024 + 13);
+	EXPECT_EQ(crc32c_slice8(0, buf.data(), buf.size()), crc32c_sse42(0, buf.data(), buf.size()));
+	EXPECT_EQ(crc32c_slice8(0, buf.data() + 3, buf.size() - 3), crc32c_sse42(0, buf.data() + 3, buf.size() - 3));
+}
+
+
+}  // namespace GParted
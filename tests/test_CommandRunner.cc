@@ -0,0 +1,139 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test CommandRunner running commands, capturing their output and timing them out.
+ */
+
+
+#include "CommandRunner.h"
+#include "gtest/gtest.h"
+
+#include <glibmm/ustring.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+
+
+namespace GParted
+{
+
+
+typedef std::chrono::steady_clock Clock;
+
+
+static double seconds_since(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+TEST(CommandRunnerTest, CaptureOutputAndExitStatus)
+{
+	Glib::ustring output;
+	Glib::ustring error;
+	CommandRunner runner("sh -c 'echo out; echo err >&2; exit 3'", output, error);
+	ASSERT_TRUE(runner.start(nullptr, false));
+
+	EXPECT_EQ(3, runner.wait());
+	EXPECT_FALSE(runner.timed_out());
+	EXPECT_EQ("out\n", output);
+	EXPECT_EQ("err\n", error);
+}
+
+
+TEST(CommandRunnerTest, WriteInput)
+{
+	Glib::ustring output;
+	Glib::ustring error;
+	CommandRunner runner("cat", output, error);
+	ASSERT_TRUE(runner.start("line 1\nline 2\n", false));
+
+	EXPECT_EQ(0, runner.wait());
+	EXPECT_EQ("line 1\nline 2\n", output);
+}
+
+
+TEST(CommandRunnerTest, CommandNotFound)
+{
+	Glib::ustring output;
+	Glib::ustring error;
+	CommandRunner runner("/nonexistent/command", output, error);
+
+	EXPECT_FALSE(runner.start(nullptr, false));
+	EXPECT_EQ(127, runner.get_exit_status());
+	EXPECT_FALSE(runner.get_start_error().empty());
+}
+
+
+TEST(CommandRunnerTest, InheritedDescriptorsClosedInChildOnly)
+{
+	int fd = open("/dev/null", O_RDONLY);
+	ASSERT_GE(fd, 0);
+
+	Glib::ustring output;
+	Glib::ustring error;
+	CommandRunner runner("sh -c 'if test -e /proc/$$/fd/" + std::to_string(fd) + "; then echo leaked; fi'",
+	                     output, error);
+	ASSERT_TRUE(runner.start(nullptr, false));
+
+	EXPECT_EQ(0, runner.wait());
+	EXPECT_EQ("", output);
+	// Still open, and not marked close-on-exec, in this process.
+	EXPECT_EQ(0, fcntl(fd, F_GETFD));
+	close(fd);
+}
+
+
+TEST(CommandRunnerTest, TimeoutTerminatesCommand)
+{
+	Glib::ustring output;
+	Glib::ustring error;
+	CommandRunner runner("sleep 30", output, error);
+	ASSERT_TRUE(runner.start(nullptr, false));
+	runner.set_timeout(1);
+
+	Clock::time_point start = Clock::now();
+	EXPECT_EQ(124, runner.wait());
+	EXPECT_TRUE(runner.timed_out());
+	// Exited on SIGTERM without needing SIGKILL after the grace period.
+	double elapsed = seconds_since(start);
+	EXPECT_GE(elapsed, 1.0);
+	EXPECT_LT(elapsed, 5.0);
+}
+
+
+TEST(CommandRunnerTest, TimeoutSendsTermThenKill)
+{
+	// Shell which reports and ignores SIGTERM so has to be killed with SIGKILL after
+	// the 5 second grace period.
+	Glib::ustring output;
+	Glib::ustring error;
+	CommandRunner runner("sh -c 'trap \"echo TERM\" TERM; while :; do sleep 1; done'", output, error);
+	ASSERT_TRUE(runner.start(nullptr, false));
+	runner.set_timeout(1);
+
+	Clock::time_point start = Clock::now();
+	EXPECT_EQ(124, runner.wait());
+	EXPECT_TRUE(runner.timed_out());
+	EXPECT_EQ("TERM\n", output);
+	double elapsed = seconds_since(start);
+	EXPECT_GE(elapsed, 6.0);
+	EXPECT_LT(elapsed, 10.0);
+}
+
+
+}  // namespace GParted
@@ -0,0 +1,224 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test LVM2_Info loading its caches from canned "lvm fullreport --reportformat json"
+ * output.
+ */
+
+
+#include "LVM2_Info.h"
+#include "gtest/gtest.h"
+
+#include <glibmm/ustring.h>
+#include <string>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+// Report of two orphan PVs and one VG with two PVs and an LV, in the layout written by
+// lvm fullreport.
+static const char* fullreport =
+	"  {\n"
+	"      \"report\": [\n"
+	"          {\n"
+	"              \"vg\": [\n"
+	"                  {\"vg_name\":\"Test_VG3\", \"vg_attr\":\"wz--n-\", \"vg_extent_size\":\"4194304\", "
+	                    "\"vg_extent_count\":\"126\", \"vg_free_count\":\"30\", "
+	                    "\"vg_uuid\":\"4Yf3hY-U8wO-Ae7F-eYjJ-tBcD-H2t6-8Go7Jx\"}\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"pv\": [\n"
+	"                  {\"pv_name\":\"/dev/sdb16\", \"pv_size\":\"264241152\", \"pv_free\":\"125829120\", "
+	                    "\"vg_name\":\"Test_VG3\"},\n"
+	"                  {\"pv_name\":\"/dev/sdb15\", \"pv_size\":\"264241152\", \"pv_free\":\"0\", "
+	                    "\"vg_name\":\"Test_VG3\"}\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"lv\": [\n"
+	"                  {\"vg_name\":\"Test_VG3\", \"lv_name\":\"lvol0\", \"lv_path\":\"/dev/Test_VG3/lvol0\", "
+	                    "\"lv_size\":\"402653184\", \"lv_metadata_size\":\"\", \"lv_attr\":\"-wi-a-----\"}\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"pvseg\": [\n"
+	"                  {\"pvseg_start\":\"0\"},\n"
+	"                  {\"pvseg_start\":\"0\"}\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"seg\": [\n"
+	"                  {\"seg_start\":\"0\"}\n"
+	"              ]\n"
+	"          }\n"
+	"          ,\n"
+	"          {\n"
+	"              \"vg\": [\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"pv\": [\n"
+	"                  {\"pv_name\":\"/dev/sdb12\", \"pv_size\":\"268435456\", \"pv_free\":\"268435456\", "
+	                    "\"vg_name\":\"\"},\n"
+	"                  {\"pv_name\":\"/dev/sdb11\", \"pv_size\":\"268435456\", \"pv_free\":\"268435456\", "
+	                    "\"vg_name\":\"#orphans_lvm2\"}\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"lv\": [\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"pvseg\": [\n"
+	"              ]\n"
+	"              ,\n"
+	"              \"seg\": [\n"
+	"              ]\n"
+	"          }\n"
+	"      ]\n"
+	"      ,\n"
+	"      \"log\": [\n"
+	"      ]\n"
+	"  }\n";
+
+
+// Explicit test fixture class to parse canned reports and inspect the private caches of
+// LVM2_Info.
+class LVM2_InfoTest : public ::testing::Test
+{
+protected:
+	void SetUp() override;
+	void TearDown() override;
+
+	static bool parse_lvm2_fullreport(const Glib::ustring& output)
+		{ return LVM2_Info::parse_lvm2_fullreport(output); };
+	static const std::vector<LVM2_PV>& pv_cache()  { return LVM2_Info::lvm2_pv_cache; };
+	static const std::vector<LVM2_VG>& vg_cache()  { return LVM2_Info::lvm2_vg_cache; };
+	static const std::vector<LVM2_LV>& lv_cache()  { return LVM2_Info::lvm2_lv_cache; };
+
+	static Glib::ustring report_with_vg_uuid(const char* json_uuid);
+};
+
+
+void LVM2_InfoTest::SetUp()
+{
+	LVM2_Info::clear_cache();
+	// Stop the query methods running lvm to load the caches.
+	LVM2_Info::lvm2_info_cache_initialized = true;
+}
+
+
+void LVM2_InfoTest::TearDown()
+{
+	LVM2_Info::clear_cache();
+}
+
+
+// Return a report containing a single VG with the JSON encoded UUID.
+Glib::ustring LVM2_InfoTest::report_with_vg_uuid(const char* json_uuid)
+{
+	return Glib::ustring("{\"report\": [{\"vg\": [{\"vg_name\":\"Test_VG1\", \"vg_uuid\":\"") +
+	       json_uuid + "\"}], \"pv\": [], \"lv\": []}]}";
+}
+
+
+TEST_F(LVM2_InfoTest, LoadFullReport)
+{
+	ASSERT_TRUE(parse_lvm2_fullreport(fullreport));
+
+	// PVs are ordered by name, with the orphan VG name removed.
+	ASSERT_EQ(4u, pv_cache().size());
+	EXPECT_EQ("/dev/sdb11", pv_cache()[0].pv_name.get_name());
+	EXPECT_EQ("",           pv_cache()[0].vg_name);
+	EXPECT_EQ("/dev/sdb12", pv_cache()[1].pv_name.get_name());
+	EXPECT_EQ("/dev/sdb15", pv_cache()[2].pv_name.get_name());
+	EXPECT_EQ("/dev/sdb16", pv_cache()[3].pv_name.get_name());
+	EXPECT_EQ("Test_VG3",   LVM2_Info::get_vg_name_for_pv("/dev/sdb16"));
+	EXPECT_EQ(264241152,    LVM2_Info::get_pv_size_bytes("/dev/sdb16"));
+	EXPECT_EQ(125829120,    LVM2_Info::get_pv_free_bytes("/dev/sdb16"));
+	EXPECT_EQ(268435456,    LVM2_Info::get_pv_free_bytes("/dev/sdb12"));
+
+	ASSERT_EQ(1u, vg_cache().size());
+	EXPECT_EQ("Test_VG3", vg_cache()[0].vg_name);
+	EXPECT_EQ(4194304,    vg_cache()[0].pe_size);
+	EXPECT_EQ(126,        vg_cache()[0].total_pe);
+	EXPECT_EQ(30,         vg_cache()[0].free_pe);
+	EXPECT_EQ("4Yf3hY-U8wO-Ae7F-eYjJ-tBcD-H2t6-8Go7Jx", vg_cache()[0].uuid);
+
+	ASSERT_EQ(1u, lv_cache().size());
+	EXPECT_EQ("/dev/Test_VG3/lvol0", lv_cache()[0].lv_path);
+	EXPECT_EQ(402653184, LVM2_Info::get_lv_size_bytes("/dev/Test_VG3/lvol0"));
+	EXPECT_EQ(-1,        LVM2_Info::get_lv_metadata_size_bytes("/dev/Test_VG3/lvol0"));
+	EXPECT_TRUE(LVM2_Info::is_lv_active("/dev/Test_VG3/lvol0"));
+}
+
+
+TEST_F(LVM2_InfoTest, EmptyArrays)
+{
+	EXPECT_TRUE(parse_lvm2_fullreport("{\"report\": [{\"vg\": [], \"pv\": [], \"lv\": [], "
+	                                  "\"pvseg\": [], \"seg\": []}], \"log\": []}"));
+	EXPECT_TRUE(pv_cache().empty());
+	EXPECT_TRUE(vg_cache().empty());
+	EXPECT_TRUE(lv_cache().empty());
+
+	EXPECT_TRUE(parse_lvm2_fullreport("{\"report\": []}"));
+	EXPECT_TRUE(pv_cache().empty());
+}
+
+
+TEST_F(LVM2_InfoTest, StringEscapes)
+{
+	ASSERT_TRUE(parse_lvm2_fullreport(report_with_vg_uuid("\\\" \\\\ \\/ \\b\\f\\n\\r\\t")));
+	ASSERT_EQ(1u, vg_cache().size());
+	EXPECT_EQ("\" \\ / \b\f\n\r\t", vg_cache()[0].uuid);
+}
+
+
+TEST_F(LVM2_InfoTest, UnicodeEscapes)
+{
+	// A, e acute, euro sign and, as a surrogate pair, grinning face.
+	ASSERT_TRUE(parse_lvm2_fullreport(report_with_vg_uuid("\\u0041\\u00e9\\u20AC\\ud83d\\ude00")));
+	ASSERT_EQ(1u, vg_cache().size());
+	EXPECT_EQ("A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80", vg_cache()[0].uuid);
+}
+
+
+TEST_F(LVM2_InfoTest, LoneSurrogatesRejected)
+{
+	EXPECT_FALSE(parse_lvm2_fullreport(report_with_vg_uuid("\\ud83d")));
+	EXPECT_FALSE(parse_lvm2_fullreport(report_with_vg_uuid("\\ud83dx")));
+	EXPECT_FALSE(parse_lvm2_fullreport(report_with_vg_uuid("\\ud83d\\n")));
+	EXPECT_FALSE(parse_lvm2_fullreport(report_with_vg_uuid("\\ud83d\\u0041")));
+	EXPECT_FALSE(parse_lvm2_fullreport(report_with_vg_uuid("\\ud83d\\ud83d")));
+	EXPECT_FALSE(parse_lvm2_fullreport(report_with_vg_uuid("\\ude00")));
+	EXPECT_FALSE(parse_lvm2_fullreport(report_with_vg_uuid("\\u12")));
+	EXPECT_TRUE(vg_cache().empty());
+}
+
+
+TEST_F(LVM2_InfoTest, TruncatedInputRejected)
+{
+	// Every truncation of the report before the final closing brace is incomplete.
+	std::string report = fullreport;
+	size_t complete_length = report.rfind('}') + 1;
+	for (size_t length = 0; length < complete_length; length++)
+	{
+		EXPECT_FALSE(parse_lvm2_fullreport(report.substr(0, length))) << "length=" << length;
+		EXPECT_TRUE(pv_cache().empty()) << "length=" << length;
+		EXPECT_TRUE(vg_cache().empty()) << "length=" << length;
+		EXPECT_TRUE(lv_cache().empty()) << "length=" << length;
+	}
+}
+
+
+}  // namespace GParted
@@ -16,6 +16,7 @@
 
 
 #include "common.h"
+#include "GParted_Core.h"
 #include "OperationDetail.h"
 #include "Utils.h"
 #include "gtest/gtest.h"
@@ -497,9 +498,9 @@ int main(int argc, char** argv)
 	printf("Running main() from %s\n", __FILE__);
 	GParted::ensure_x11_display(argc, argv);
 
-	// Initialise Gtk::Main to successfully use OperationDetail::execute_command().
-	// Must be before InitGoogleTest().  (Don't need to initialise
-	// GParted_Core::mainthread as nothing in OperationDetail uses it).
+	// Initialise threading in GParted to successfully use
+	// OperationDetail::execute_command().  Must be before InitGoogleTest().
+	GParted::GParted_Core::mainthread = Glib::Thread::self();
 	Gtk::Main gtk_main = Gtk::Main();
 
 	testing::InitGoogleTest(&argc, argv);
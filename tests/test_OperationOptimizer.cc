@@ -0,0 +1,221 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test OperationOptimizer folding chains of resize/move operations.
+ */
+
+
+#include "OperationOptimizer.h"
+#include "Device.h"
+#include "Operation.h"
+#include "OperationCreate.h"
+#include "OperationResizeMove.h"
+#include "Partition.h"
+#include "Utils.h"
+#include "gtest/gtest.h"
+
+#include <glibmm/ustring.h>
+#include <memory>
+
+
+namespace GParted
+{
+
+
+// Explicit test fixture class with common variables and methods used in each test.
+class OperationOptimizerTest : public ::testing::Test
+{
+protected:
+	OperationOptimizerTest();
+
+	Partition partition(const Glib::ustring& path, int number, Sector start, Sector end) const;
+	void add_resize_move(const Partition& partition_orig, Sector start, Sector end);
+	void add_create(Sector start, Sector end);
+
+	Device          m_device;
+	OperationVector m_operations;
+};
+
+
+OperationOptimizerTest::OperationOptimizerTest()
+{
+	m_device.set_path("/dev/sdb");
+	m_device.length      = 1048576;
+	m_device.sector_size = 512;
+}
+
+
+Partition OperationOptimizerTest::partition(const Glib::ustring& path, int number, Sector start, Sector end) const
+{
+	Partition partition;
+	partition.Set(m_device.get_path(), path, number, TYPE_PRIMARY, FS_EXT4, start, end,
+	              m_device.sector_size, false, false);
+	return partition;
+}
+
+
+// Queue a resize/move of the partition to start..end, like Win_GParted::add_operation().
+void OperationOptimizerTest::add_resize_move(const Partition& partition_orig, Sector start, Sector end)
+{
+	Partition partition_new = partition(partition_orig.get_path(), partition_orig.partition_number,
+	                                    start, end);
+	m_operations.push_back(std::make_unique<OperationResizeMove>(m_device, partition_orig, partition_new));
+}
+
+
+void OperationOptimizerTest::add_create(Sector start, Sector end)
+{
+	Partition unallocated;
+	unallocated.Set_Unallocated(m_device.get_path(), start, end, m_device.sector_size, false);
+	Partition partition_new = partition("New Partition #1", 5, start, end);
+	m_operations.push_back(std::make_unique<OperationCreate>(m_device, unallocated, partition_new));
+}
+
+
+TEST_F(OperationOptimizerTest, FoldMoveAndMove)
+{
+	// Move sdb1 right, resize sdb2 and move sdb1 right again.
+	Partition sdb1 = partition("/dev/sdb1", 1, 2048, 4095);
+	Partition sdb2 = partition("/dev/sdb2", 2, 100000, 199999);
+	add_resize_move(sdb1, 10000, 12047);
+	add_resize_move(sdb2, 100000, 299999);
+	add_resize_move(m_operations[0]->get_partition_new(), 20000, 22047);
+
+	OperationOptimizer optimizer(m_operations);
+	ASSERT_EQ(2u, optimizer.get_num_operations());
+	EXPECT_TRUE(optimizer.changed());
+	const Operation& combined = optimizer.get_operation(1);
+	EXPECT_EQ("/dev/sdb1", combined.get_partition_new().get_path());
+	EXPECT_EQ(2048, combined.get_partition_original().sector_start);
+	EXPECT_EQ(20000, combined.get_partition_new().sector_start);
+	EXPECT_EQ(22047, combined.get_partition_new().sector_end);
+	EXPECT_EQ(&*m_operations[1], &optimizer.get_operation(0));
+	// Usage not known so the whole 1 MiB partition is no longer moved a second time.
+	EXPECT_EQ(2048 * 512, optimizer.get_bytes_saved());
+}
+
+
+TEST_F(OperationOptimizerTest, FoldResizeAndMove)
+{
+	// Grow sdb1 in place, move sdb2 right, then move sdb1 right.
+	Partition sdb1 = partition("/dev/sdb1", 1, 2048, 4095);
+	Partition sdb2 = partition("/dev/sdb2", 2, 100000, 199999);
+	add_resize_move(sdb1, 2048, 8191);
+	add_resize_move(sdb2, 150000, 249999);
+	add_resize_move(m_operations[0]->get_partition_new(), 30000, 36143);
+
+	OperationOptimizer optimizer(m_operations);
+	ASSERT_EQ(2u, optimizer.get_num_operations());
+	const Operation& combined = optimizer.get_operation(1);
+	EXPECT_EQ(OPERATION_RESIZE_MOVE, combined.m_type);
+	EXPECT_EQ(2048, combined.get_partition_original().sector_start);
+	EXPECT_EQ(4095, combined.get_partition_original().sector_end);
+	EXPECT_EQ(30000, combined.get_partition_new().sector_start);
+	EXPECT_EQ(36143, combined.get_partition_new().sector_end);
+	// Growing in place moves nothing.  Moving the grown 3 MiB partition is replaced
+	// by moving the original 1 MiB partition.
+	EXPECT_EQ(4096 * 512, optimizer.get_bytes_saved());
+}
+
+
+TEST_F(OperationOptimizerTest, FoldAtFirstPosition)
+{
+	// Move sdb1 right, move sdb2 left into the space sdb1 vacated, then move sdb1
+	// right again.  Combined move of sdb1 has to happen before sdb2 moves.
+	Partition sdb1 = partition("/dev/sdb1", 1, 2048, 4095);
+	Partition sdb2 = partition("/dev/sdb2", 2, 100000, 102047);
+	add_resize_move(sdb1, 10000, 12047);
+	add_resize_move(sdb2, 2048, 4095);
+	add_resize_move(m_operations[0]->get_partition_new(), 200000, 202047);
+
+	OperationOptimizer optimizer(m_operations);
+	ASSERT_EQ(2u, optimizer.get_num_operations());
+	EXPECT_EQ("/dev/sdb1", optimizer.get_operation(0).get_partition_new().get_path());
+	EXPECT_EQ(200000, optimizer.get_operation(0).get_partition_new().sector_start);
+	EXPECT_EQ("/dev/sdb2", optimizer.get_operation(1).get_partition_new().get_path());
+}
+
+
+TEST_F(OperationOptimizerTest, OverlappingOperationsNotFolded)
+{
+	// Move sdb1 right, move sdb2 into the space sdb1 vacated, then move sdb1 into
+	// the space sdb2 vacated.  sdb2 uses the old position of sdb1 and the new
+	// position of sdb1 so the moves must stay either side of it.
+	Partition sdb1 = partition("/dev/sdb1", 1, 2048, 4095);
+	Partition sdb2 = partition("/dev/sdb2", 2, 100000, 102047);
+	add_resize_move(sdb1, 10000, 12047);
+	add_resize_move(sdb2, 2048, 4095);
+	add_resize_move(m_operations[0]->get_partition_new(), 100000, 102047);
+
+	OperationOptimizer optimizer(m_operations);
+	EXPECT_FALSE(optimizer.changed());
+	ASSERT_EQ(3u, optimizer.get_num_operations());
+	for (unsigned int i = 0; i < 3; i++)
+		EXPECT_EQ(&*m_operations[i], &optimizer.get_operation(i));
+	EXPECT_EQ(0, optimizer.get_bytes_saved());
+}
+
+
+TEST_F(OperationOptimizerTest, CreateOnSameDeviceNotFolded)
+{
+	// Creating a partition can renumber the moved partition.
+	Partition sdb1 = partition("/dev/sdb1", 1, 2048, 4095);
+	add_resize_move(sdb1, 10000, 12047);
+	add_create(500000, 599999);
+	add_resize_move(m_operations[0]->get_partition_new(), 20000, 22047);
+
+	OperationOptimizer optimizer(m_operations);
+	EXPECT_FALSE(optimizer.changed());
+	EXPECT_EQ(3u, optimizer.get_num_operations());
+}
+
+
+TEST_F(OperationOptimizerTest, MoveBackRemoved)
+{
+	Partition sdb1 = partition("/dev/sdb1", 1, 2048, 4095);
+	Partition sdb2 = partition("/dev/sdb2", 2, 100000, 199999);
+	add_resize_move(sdb1, 10000, 12047);
+	add_resize_move(sdb2, 100000, 299999);
+	add_resize_move(m_operations[0]->get_partition_new(), 2048, 4095);
+
+	OperationOptimizer optimizer(m_operations);
+	ASSERT_EQ(1u, optimizer.get_num_operations());
+	EXPECT_EQ("/dev/sdb2", optimizer.get_operation(0).get_partition_new().get_path());
+	EXPECT_EQ(2 * 2048 * 512, optimizer.get_bytes_saved());
+}
+
+
+TEST_F(OperationOptimizerTest, PendingOperationsUnchangedUntilCommit)
+{
+	Partition sdb1 = partition("/dev/sdb1", 1, 2048, 4095);
+	add_resize_move(sdb1, 10000, 12047);
+	add_resize_move(m_operations[0]->get_partition_new(), 20000, 22047);
+	const Operation* second_op = &*m_operations[1];
+
+	OperationOptimizer optimizer(m_operations);
+	ASSERT_EQ(1u, optimizer.get_num_operations());
+	ASSERT_EQ(2u, m_operations.size());
+	EXPECT_EQ(12047, m_operations[0]->get_partition_new().sector_end);
+	EXPECT_EQ(second_op, &*m_operations[1]);
+
+	optimizer.commit(m_operations);
+	ASSERT_EQ(1u, m_operations.size());
+	EXPECT_EQ(2048, m_operations[0]->get_partition_original().sector_start);
+	EXPECT_EQ(20000, m_operations[0]->get_partition_new().sector_start);
+}
+
+
+}  // namespace GParted
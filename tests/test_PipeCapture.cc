@@ -28,6 +28,8 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <chrono>
+#include <iostream>
 #include <sstream>
 #include <unistd.h>
 #include <string.h>
@@ -381,5 +383,32 @@ TEST_F( PipeCaptureTest, LineDisciplineSkipCtrlAB )
 	EXPECT_BINARYSTRINGEQ( expectedstr, capturedstr.raw() );
 }
 
+TEST_F( PipeCaptureTest, LineDisciplineMixedASCIIAndMultiByte )
+{
+	// Test PipeCapture line discipline overwrites runs of ASCII characters and
+	// multi-byte UTF-8 characters alike after a carriage return.
+	inputstr = "abc\xc3\xa9" "def\r\xe6\x97\xa5XY\nZ";
+	PipeCapture pc( pipefds[ReaderFD], capturedstr );
+	pc.connect_signal();
+	run_writer_thread();
+	expectedstr = "\xe6\x97\xa5XY\xc3\xa9" "def\nZ";
+	EXPECT_BINARYSTRINGEQ( expectedstr, capturedstr.raw() );
+}
+
+TEST_F( PipeCaptureTest, BenchmarkASCIIText )
+{
+	// Microbenchmark capturing 16 MiB of ASCII text, as verbose file system tools such
+	// as e2fsck -v write.  Reports the capture throughput.
+	inputstr = repeat( "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_\n", 262144 );
+	PipeCapture pc( pipefds[ReaderFD], capturedstr );
+	pc.connect_signal();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	run_writer_thread();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "PipeCapture of " << inputstr.length() / 1048576 << " MiB ASCII text: "
+	          << inputstr.length() / 1048576 / elapsed.count() << " MiB/s" << std::endl;
+	EXPECT_BINARYSTRINGEQ( inputstr, capturedstr.raw() );
+}
+
 
 }  // namespace GParted
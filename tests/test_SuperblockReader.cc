@@ -0,0 +1,368 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test SuperblockReader reads the same size and free space figures as the file system
+ * tools report from superblocks crafted in memory.
+ */
+
+
+#include "SuperblockReader.h"
+#include "Utils.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+namespace GParted
+{
+
+
+static void put_le16(unsigned char* p, uint16_t v)  { p[0] = v; p[1] = v >> 8; }
+static void put_le32(unsigned char* p, uint32_t v)  { put_le16(p, v); put_le16(p + 2, v >> 16); }
+static void put_le64(unsigned char* p, uint64_t v)  { put_le32(p, v); put_le32(p + 4, v >> 32); }
+static void put_be32(unsigned char* p, uint32_t v)  { p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v; }
+static void put_be64(unsigned char* p, uint64_t v)  { put_be32(p, v >> 32); put_be32(p + 4, v); }
+
+
+// Set the 12-bit FAT entry of a cluster.  Even clusters use the low 12 bits and odd
+// clusters the high 12 bits of the 16-bit little endian word at cluster * 1.5 bytes.
+static void put_fat12(unsigned char* fat, unsigned int cluster, uint16_t entry)
+{
+	unsigned char* p = fat + cluster * 3 / 2;
+	uint16_t word = p[0] | p[1] << 8;
+	if (cluster & 1)
+		word = (word & 0x000F) | entry << 4;
+	else
+		word = (word & 0xF000) | (entry & 0x0FFF);
+	put_le16(p, word);
+}
+
+
+class SuperblockReaderTest : public ::testing::Test
+{
+protected:
+	SuperblockReaderTest() : m_image(MEBIBYTE, 0)  {};
+
+	virtual void write_image_file(Byte_Value size);
+	virtual void TearDown();
+
+	static const char* s_image_name;
+
+	std::vector<unsigned char> m_image;  // Start of the image, the rest is zeros
+};
+
+
+const char* SuperblockReaderTest::s_image_name = "test_SuperblockReader.img";
+
+
+// Write the crafted start of the image extended to size bytes with a hole.
+void SuperblockReaderTest::write_image_file(Byte_Value size)
+{
+	unlink(s_image_name);
+	int fd = open(s_image_name, O_WRONLY|O_CREAT, 0666);
+	ASSERT_GE(fd, 0) << "Failed to create image file '" << s_image_name << "'.  errno="
+	                 << errno << "," << strerror(errno);
+	ASSERT_EQ(write(fd, m_image.data(), m_image.size()), (ssize_t)m_image.size())
+	        << "Failed to write image file '" << s_image_name << "'.  errno="
+	        << errno << "," << strerror(errno);
+	ASSERT_EQ(ftruncate(fd, (off_t)size), 0) << "Failed to set image file '" << s_image_name << "' to size "
+	                                         << size << ".  errno=" << errno << "," << strerror(errno);
+	close(fd);
+}
+
+
+void SuperblockReaderTest::TearDown()
+{
+	unlink(s_image_name);
+}
+
+
+TEST_F(SuperblockReaderTest, Ext2)
+{
+	unsigned char* sb = m_image.data() + 1024;
+	put_le32(sb + 0x04, 2048);    // s_blocks_count
+	put_le32(sb + 0x0C, 1000);    // s_free_blocks_count
+	put_le32(sb + 0x18, 2);       // s_log_block_size
+	put_le16(sb + 0x38, 0xEF53);  // s_magic
+	write_image_file(m_image.size());
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long block_count = -1;
+	long long block_size  = -1;
+	long long free_blocks = -1;
+	ASSERT_TRUE(reader.read_ext2(block_count, block_size, free_blocks));
+	EXPECT_EQ(2048, block_count);
+	EXPECT_EQ(4096, block_size);
+	EXPECT_EQ(1000, free_blocks);
+}
+
+
+TEST_F(SuperblockReaderTest, Ext4With64BitBlockCounts)
+{
+	unsigned char* sb = m_image.data() + 1024;
+	put_le32(sb + 0x04, 2048);
+	put_le32(sb + 0x0C, 1000);
+	put_le32(sb + 0x18, 2);
+	put_le16(sb + 0x38, 0xEF53);
+	put_le32(sb + 0x60, 0x0080);  // EXT4_FEATURE_INCOMPAT_64BIT
+	put_le32(sb + 0x150, 1);      // s_blocks_count_hi
+	put_le32(sb + 0x158, 1);      // s_free_blocks_hi
+	write_image_file(m_image.size());
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long block_count = -1;
+	long long block_size  = -1;
+	long long free_blocks = -1;
+	ASSERT_TRUE(reader.read_ext2(block_count, block_size, free_blocks));
+	EXPECT_EQ(0x100000000LL + 2048, block_count);
+	EXPECT_EQ(4096, block_size);
+	EXPECT_EQ(0x100000000LL + 1000, free_blocks);
+}
+
+
+TEST_F(SuperblockReaderTest, Ext2BadMagic)
+{
+	unsigned char* sb = m_image.data() + 1024;
+	put_le32(sb + 0x04, 2048);
+	put_le16(sb + 0x38, 0xEF54);
+	write_image_file(m_image.size());
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long block_count = -1;
+	long long block_size  = -1;
+	long long free_blocks = -1;
+	EXPECT_FALSE(reader.read_ext2(block_count, block_size, free_blocks));
+}
+
+
+TEST_F(SuperblockReaderTest, Xfs)
+{
+	unsigned char* sb = m_image.data();
+	memcpy(sb, "XFSB", 4);
+	put_be32(sb + 0x04, 4096);  // sb_blocksize
+	put_be64(sb + 0x08, 2048);  // sb_dblocks
+	put_be64(sb + 0x90, 1500);  // sb_fdblocks
+	write_image_file(m_image.size());
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long block_size       = -1;
+	long long data_blocks      = -1;
+	long long free_data_blocks = -1;
+	ASSERT_TRUE(reader.read_xfs(block_size, data_blocks, free_data_blocks));
+	EXPECT_EQ(4096, block_size);
+	EXPECT_EQ(2048, data_blocks);
+	EXPECT_EQ(1500, free_data_blocks);
+}
+
+
+TEST_F(SuperblockReaderTest, Btrfs)
+{
+	unsigned char* sb = m_image.data() + 64 * KIBIBYTE;
+	put_le64(sb + 0x30, 64 * KIBIBYTE);         // bytenr
+	memcpy(sb + 0x40, "_BHRfS_M", 8);           // magic
+	put_le64(sb + 0x70, 512 * MEBIBYTE);        // total_bytes
+	put_le64(sb + 0x78, 3 * MEBIBYTE);          // bytes_used
+	put_le32(sb + 0x90, 4096);                  // sectorsize
+	put_le64(sb + 0xC9 + 0x08, 256 * MEBIBYTE); // dev_item.total_bytes
+	write_image_file(m_image.size());
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long total_bytes          = -1;
+	long long bytes_used           = -1;
+	long long sector_size          = -1;
+	long long dev_item_total_bytes = -1;
+	ASSERT_TRUE(reader.read_btrfs(total_bytes, bytes_used, sector_size, dev_item_total_bytes));
+	EXPECT_EQ(512 * MEBIBYTE, total_bytes);
+	EXPECT_EQ(3 * MEBIBYTE, bytes_used);
+	EXPECT_EQ(4096, sector_size);
+	EXPECT_EQ(256 * MEBIBYTE, dev_item_total_bytes);
+}
+
+
+TEST_F(SuperblockReaderTest, Fat12CountsFreeClusters)
+{
+	// 1.44 MB floppy layout: 2847 clusters of 1 sector.
+	unsigned char* bs = m_image.data();
+	put_le16(bs + 0x0B, 512);   // BPB_BytsPerSec
+	bs[0x0D] = 1;               // BPB_SecPerClus
+	put_le16(bs + 0x0E, 1);     // BPB_RsvdSecCnt
+	bs[0x10] = 2;               // BPB_NumFATs
+	put_le16(bs + 0x11, 224);   // BPB_RootEntCnt
+	put_le16(bs + 0x13, 2880);  // BPB_TotSec16
+	put_le16(bs + 0x16, 9);     // BPB_FATSz16
+	bs[510] = 0x55;
+	bs[511] = 0xAA;
+	unsigned char* fat = m_image.data() + 512;
+	put_fat12(fat, 0, 0xFF0);
+	put_fat12(fat, 1, 0xFFF);
+	put_fat12(fat, 2, 3);
+	put_fat12(fat, 3, 0xFFF);
+	put_fat12(fat, 2848, 0xFFF);  // Last cluster
+	write_image_file(2880 * 512);
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long logical_sector_size = -1;
+	long long cluster_size        = -1;
+	long long logical_sectors     = -1;
+	long long bytes_free          = -1;
+	ASSERT_TRUE(reader.read_fat(logical_sector_size, cluster_size, logical_sectors, bytes_free));
+	EXPECT_EQ(512, logical_sector_size);
+	EXPECT_EQ(1, cluster_size);
+	EXPECT_EQ(2880, logical_sectors);
+	EXPECT_EQ((2847 - 3) * 512, bytes_free);
+}
+
+
+TEST_F(SuperblockReaderTest, Fat16CountsFreeClusters)
+{
+	// 16223 clusters of 1 sector.
+	unsigned char* bs = m_image.data();
+	put_le16(bs + 0x0B, 512);
+	bs[0x0D] = 1;
+	put_le16(bs + 0x0E, 1);
+	bs[0x10] = 2;
+	put_le16(bs + 0x11, 512);
+	put_le16(bs + 0x13, 16384);
+	put_le16(bs + 0x16, 64);
+	bs[510] = 0x55;
+	bs[511] = 0xAA;
+	unsigned char* fat = m_image.data() + 512;
+	for (unsigned int cluster = 2; cluster < 22; cluster++)
+		put_le16(fat + cluster * 2, (cluster == 21) ? 0xFFFF : cluster + 1);
+	write_image_file(16384 * 512);
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long logical_sector_size = -1;
+	long long cluster_size        = -1;
+	long long logical_sectors     = -1;
+	long long bytes_free          = -1;
+	ASSERT_TRUE(reader.read_fat(logical_sector_size, cluster_size, logical_sectors, bytes_free));
+	EXPECT_EQ(512, logical_sector_size);
+	EXPECT_EQ(1, cluster_size);
+	EXPECT_EQ(16384, logical_sectors);
+	EXPECT_EQ((16223 - 20) * 512, bytes_free);
+}
+
+
+// FAT32 with 300000 clusters of 1 sector so that the FAT is larger than one chunk read
+// when counting the free clusters.
+static const uint32_t FAT32_FAT_SECTORS   = 2344;
+static const uint32_t FAT32_CLUSTER_COUNT = 300000;
+static const uint32_t FAT32_TOTAL_SECTORS = 32 + 2 * FAT32_FAT_SECTORS + FAT32_CLUSTER_COUNT;
+
+
+class Fat32SuperblockReaderTest : public SuperblockReaderTest
+{
+protected:
+	virtual void SetUp();
+
+	unsigned char* fsinfo()  { return m_image.data() + 512; };
+};
+
+
+void Fat32SuperblockReaderTest::SetUp()
+{
+	m_image.resize(2 * MEBIBYTE);
+	unsigned char* bs = m_image.data();
+	put_le16(bs + 0x0B, 512);            // BPB_BytsPerSec
+	bs[0x0D] = 1;                        // BPB_SecPerClus
+	put_le16(bs + 0x0E, 32);             // BPB_RsvdSecCnt
+	bs[0x10] = 2;                        // BPB_NumFATs
+	put_le32(bs + 0x20, FAT32_TOTAL_SECTORS);  // BPB_TotSec32
+	put_le32(bs + 0x24, FAT32_FAT_SECTORS);    // BPB_FATSz32
+	put_le16(bs + 0x30, 1);              // BPB_FSInfo
+	bs[510] = 0x55;
+	bs[511] = 0xAA;
+
+	put_le32(fsinfo() + 0, 0x41615252);    // FSI_LeadSig
+	put_le32(fsinfo() + 484, 0x61417272);  // FSI_StrucSig
+	put_le32(fsinfo() + 488, 0xFFFFFFFF);  // FSI_Free_Count unknown
+
+	// Used clusters either side of the first chunk boundary, 3 * 256 KiB after the
+	// entry of cluster 2, and at the end of the FAT.
+	unsigned char* fat = m_image.data() + 32 * 512;
+	put_le32(fat + 0 * 4, 0x0FFFFFF8);
+	put_le32(fat + 1 * 4, 0x0FFFFFFF);
+	put_le32(fat + 2 * 4, 0x0FFFFFFF);
+	put_le32(fat + 196609 * 4, 196610);
+	put_le32(fat + 196610 * 4, 0x0FFFFFFF);
+	put_le32(fat + (FAT32_CLUSTER_COUNT + 1) * 4, 0x0FFFFFFF);
+}
+
+
+TEST_F(Fat32SuperblockReaderTest, CountsFreeClustersAcrossChunks)
+{
+	write_image_file(static_cast<Byte_Value>(FAT32_TOTAL_SECTORS) * 512);
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long logical_sector_size = -1;
+	long long cluster_size        = -1;
+	long long logical_sectors     = -1;
+	long long bytes_free          = -1;
+	ASSERT_TRUE(reader.read_fat(logical_sector_size, cluster_size, logical_sectors, bytes_free));
+	EXPECT_EQ(512, logical_sector_size);
+	EXPECT_EQ(1, cluster_size);
+	EXPECT_EQ(FAT32_TOTAL_SECTORS, logical_sectors);
+	EXPECT_EQ((FAT32_CLUSTER_COUNT - 4) * 512LL, bytes_free);
+}
+
+
+TEST_F(Fat32SuperblockReaderTest, UsesFSInfoFreeCount)
+{
+	put_le32(fsinfo() + 488, 1234);
+	write_image_file(static_cast<Byte_Value>(FAT32_TOTAL_SECTORS) * 512);
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long logical_sector_size = -1;
+	long long cluster_size        = -1;
+	long long logical_sectors     = -1;
+	long long bytes_free          = -1;
+	ASSERT_TRUE(reader.read_fat(logical_sector_size, cluster_size, logical_sectors, bytes_free));
+	EXPECT_EQ(1234 * 512, bytes_free);
+}
+
+
+TEST_F(Fat32SuperblockReaderTest, TruncatedFat)
+{
+	// Image ends part way through the first FAT.
+	write_image_file(MEBIBYTE);
+
+	SuperblockReader reader(s_image_name);
+	ASSERT_TRUE(reader.open());
+	long long logical_sector_size = -1;
+	long long cluster_size        = -1;
+	long long logical_sectors     = -1;
+	long long bytes_free          = -1;
+	EXPECT_FALSE(reader.read_fat(logical_sector_size, cluster_size, logical_sectors, bytes_free));
+}
+
+
+}  // namespace GParted
@@ -0,0 +1,258 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test UdevSettle matching kernel uevents and udev events, as received from the netlink
+ * socket, to the disk being settled.
+ */
+
+
+#include "UdevSettle.h"
+#include "gtest/gtest.h"
+
+#include <arpa/inet.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <set>
+#include <string>
+
+
+namespace GParted
+{
+
+
+// Explicit test fixture class to access the private methods of UdevSettle.
+class UdevSettleTest : public ::testing::Test
+{
+protected:
+	static std::string kernel_uevent(const std::string& action, const std::string& devpath,
+	                                 const std::string& subsystem, const std::string& devname,
+	                                 const std::string& devtype, unsigned long long seqnum);
+	static std::string udev_event(const std::string& devname, unsigned long long seqnum);
+
+	static void add_kernel_uevent(UdevSettle& settle, const std::string& buf)
+		{ settle.add_kernel_uevent(buf.data(), buf.size()); };
+	static void add_udev_event(UdevSettle& settle, const std::string& buf)
+		{ settle.add_udev_event(buf.data(), buf.size()); };
+	static bool is_disk_device(const UdevSettle& settle, const std::string& devname,
+	                           const std::string& devtype, const std::string& devpath)
+		{ return settle.is_disk_device(devname, devtype, devpath); };
+	static void set_udev_running(UdevSettle& settle, bool running)
+		{ settle.m_udev_running = running; };
+	static const std::set<unsigned long long>& pending(const UdevSettle& settle)
+		{ return settle.m_pending; };
+	static bool udev_processed(const UdevSettle& settle)
+		{ return settle.m_udev_processed; };
+};
+
+
+// Kernel uevent as received from the netlink socket: an "ACTION@DEVPATH" header followed
+// by NUL terminated "KEY=VALUE" strings.
+std::string UdevSettleTest::kernel_uevent(const std::string& action, const std::string& devpath,
+                                          const std::string& subsystem, const std::string& devname,
+                                          const std::string& devtype, unsigned long long seqnum)
+{
+	std::string buf = action + "@" + devpath;
+	buf += '\0';
+	buf += "ACTION=" + action;
+	buf += '\0';
+	buf += "DEVPATH=" + devpath;
+	buf += '\0';
+	buf += "SUBSYSTEM=" + subsystem;
+	buf += '\0';
+	buf += "DEVNAME=" + devname;
+	buf += '\0';
+	buf += "DEVTYPE=" + devtype;
+	buf += '\0';
+	buf += "SEQNUM=" + std::to_string(seqnum);
+	buf += '\0';
+	return buf;
+}
+
+
+// Event re-broadcast by udev after running its rules: a 40 byte struct
+// monitor_netlink_header followed by the NUL terminated "KEY=VALUE" properties.
+std::string UdevSettleTest::udev_event(const std::string& devname, unsigned long long seqnum)
+{
+	std::string properties = "ACTION=change";
+	properties += '\0';
+	properties += "SUBSYSTEM=block";
+	properties += '\0';
+	properties += "DEVNAME=/dev/" + devname;
+	properties += '\0';
+	properties += "SEQNUM=" + std::to_string(seqnum);
+	properties += '\0';
+	properties += "ID_FS_TYPE=ext4";
+	properties += '\0';
+
+	unsigned char header[40];
+	memset(header, 0, sizeof(header));
+	memcpy(header, "libudev", 8);
+	uint32_t magic          = htonl(0xfeedcafe);
+	uint32_t header_size    = sizeof(header);
+	uint32_t properties_off = sizeof(header);
+	uint32_t properties_len = properties.size();
+	memcpy(header + 8,  &magic,          sizeof(magic));
+	memcpy(header + 12, &header_size,    sizeof(header_size));
+	memcpy(header + 16, &properties_off, sizeof(properties_off));
+	memcpy(header + 20, &properties_len, sizeof(properties_len));
+	return std::string(reinterpret_cast<char*>(header), sizeof(header)) + properties;
+}
+
+
+TEST_F(UdevSettleTest, IsDiskDeviceScsiPartitions)
+{
+	UdevSettle settle("/dev/sda");
+
+	EXPECT_TRUE(is_disk_device(settle, "sda", "disk", "/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda"));
+	EXPECT_TRUE(is_disk_device(settle, "sda1", "partition", "/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda/sda1"));
+	EXPECT_TRUE(is_disk_device(settle, "sda12", "partition", "/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda/sda12"));
+	EXPECT_FALSE(is_disk_device(settle, "sdb", "disk", "/devices/pci0000:00/0000:00:17.0/ata2/host1/target1:0:0/1:0:0:0/block/sdb"));
+	EXPECT_FALSE(is_disk_device(settle, "sdb1", "partition", "/devices/pci0000:00/0000:00:17.0/ata2/host1/target1:0:0/1:0:0:0/block/sdb/sdb1"));
+	EXPECT_FALSE(is_disk_device(settle, "", "partition", "/devices/virtual/block/sda/sda1"));
+}
+
+
+TEST_F(UdevSettleTest, IsDiskDeviceNvmePartitions)
+{
+	UdevSettle settle("/dev/nvme0n1");
+
+	EXPECT_TRUE(is_disk_device(settle, "nvme0n1", "disk", "/devices/pci0000:00/0000:00:1d.0/0000:3d:00.0/nvme/nvme0/nvme0n1"));
+	EXPECT_TRUE(is_disk_device(settle, "nvme0n1p2", "partition", "/devices/pci0000:00/0000:00:1d.0/0000:3d:00.0/nvme/nvme0/nvme0n1/nvme0n1p2"));
+	EXPECT_FALSE(is_disk_device(settle, "nvme0n10p1", "partition", "/devices/pci0000:00/0000:00:1d.0/0000:3d:00.0/nvme/nvme0/nvme0n10/nvme0n10p1"));
+	EXPECT_FALSE(is_disk_device(settle, "nvme0n2", "disk", "/devices/pci0000:00/0000:00:1d.0/0000:3d:00.0/nvme/nvme0/nvme0n2"));
+}
+
+
+TEST_F(UdevSettleTest, IsDiskDeviceCcissPartitions)
+{
+	// Kernel device names containing '/' are named with '!' in sysfs.
+	UdevSettle settle("/dev/cciss/c0d0");
+
+	EXPECT_TRUE(is_disk_device(settle, "cciss/c0d0", "disk", "/devices/pci0000:00/0000:00:03.0/cciss0/c0d0/block/cciss!c0d0"));
+	EXPECT_TRUE(is_disk_device(settle, "cciss/c0d0p1", "partition", "/devices/pci0000:00/0000:00:03.0/cciss0/c0d0/block/cciss!c0d0/cciss!c0d0p1"));
+	EXPECT_FALSE(is_disk_device(settle, "cciss/c0d1p1", "partition", "/devices/pci0000:00/0000:00:03.0/cciss0/c0d1/block/cciss!c0d1/cciss!c0d1p1"));
+}
+
+
+TEST_F(UdevSettleTest, IsDiskDeviceMapperDevices)
+{
+	// Partitions of a device-mapper device are themselves separate dm-N devices.
+	UdevSettle settle("/dev/mapper/isw_bfdbfijegh_Vol0");
+
+	EXPECT_TRUE(is_disk_device(settle, "dm-0", "disk", "/devices/virtual/block/dm-0"));
+	EXPECT_TRUE(is_disk_device(settle, "dm-3", "disk", "/devices/virtual/block/dm-3"));
+	EXPECT_FALSE(is_disk_device(settle, "sda", "disk", "/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda"));
+	EXPECT_FALSE(is_disk_device(settle, "sda1", "partition", "/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda/sda1"));
+}
+
+
+TEST_F(UdevSettleTest, AddKernelUeventOfDisk)
+{
+	UdevSettle settle("/dev/sda");
+	set_udev_running(settle, true);
+
+	add_kernel_uevent(settle, kernel_uevent("change", "/devices/virtual/block/sda", "block", "sda", "disk", 1001));
+	add_kernel_uevent(settle, kernel_uevent("add", "/devices/virtual/block/sda/sda1", "block", "sda1", "partition", 1002));
+	// Not of the disk.
+	add_kernel_uevent(settle, kernel_uevent("add", "/devices/virtual/block/sdb/sdb1", "block", "sdb1", "partition", 1003));
+	add_kernel_uevent(settle, kernel_uevent("add", "/devices/virtual/bdi/8:0", "bdi", "sda", "", 1004));
+
+	std::set<unsigned long long> expected = {1001, 1002};
+	EXPECT_EQ(expected, pending(settle));
+	EXPECT_FALSE(udev_processed(settle));
+}
+
+
+TEST_F(UdevSettleTest, AddKernelUeventWithoutUdev)
+{
+	// Nothing will process the uevent so don't wait for it.
+	UdevSettle settle("/dev/sda");
+	set_udev_running(settle, false);
+
+	add_kernel_uevent(settle, kernel_uevent("change", "/devices/virtual/block/sda", "block", "sda", "disk", 1001));
+	EXPECT_TRUE(pending(settle).empty());
+}
+
+
+TEST_F(UdevSettleTest, AddTruncatedKernelUevent)
+{
+	UdevSettle settle("/dev/sda");
+	set_udev_running(settle, true);
+
+	// Every length of a uevent cut short before its sequence number, including in
+	// the middle of fields without their terminating NUL.
+	std::string buf = kernel_uevent("change", "/devices/virtual/block/sda", "block", "sda", "disk", 1001);
+	size_t seqnum_value = buf.find("SEQNUM=") + 7;
+	for (size_t len = 0; len <= seqnum_value; len++)
+		add_kernel_uevent(settle, buf.substr(0, len));
+	EXPECT_TRUE(pending(settle).empty());
+}
+
+
+TEST_F(UdevSettleTest, AddUdevEventClearsPending)
+{
+	UdevSettle settle("/dev/nvme0n1");
+	set_udev_running(settle, true);
+	add_kernel_uevent(settle, kernel_uevent("change", "/devices/virtual/nvme/nvme0/nvme0n1", "block", "nvme0n1", "disk", 2001));
+	add_kernel_uevent(settle, kernel_uevent("change", "/devices/virtual/nvme/nvme0/nvme0n1/nvme0n1p1", "block", "nvme0n1p1", "partition", 2002));
+
+	// Udev processed event of another device.
+	add_udev_event(settle, udev_event("sda", 1999));
+	EXPECT_EQ(2u, pending(settle).size());
+	EXPECT_FALSE(udev_processed(settle));
+
+	add_udev_event(settle, udev_event("nvme0n1p1", 2002));
+	std::set<unsigned long long> expected = {2001};
+	EXPECT_EQ(expected, pending(settle));
+	EXPECT_TRUE(udev_processed(settle));
+
+	add_udev_event(settle, udev_event("nvme0n1", 2001));
+	EXPECT_TRUE(pending(settle).empty());
+}
+
+
+TEST_F(UdevSettleTest, AddInvalidUdevEvent)
+{
+	UdevSettle settle("/dev/sda");
+	set_udev_running(settle, true);
+	add_kernel_uevent(settle, kernel_uevent("change", "/devices/virtual/block/sda", "block", "sda", "disk", 3001));
+	std::string buf = udev_event("sda", 3001);
+
+	// Truncated header.
+	add_udev_event(settle, buf.substr(0, 39));
+	// Wrong magic number.
+	std::string bad_magic = buf;
+	bad_magic[8] ^= 0xFF;
+	add_udev_event(settle, bad_magic);
+	// Properties past the end of the event.
+	std::string bad_length = buf;
+	uint32_t properties_len = buf.size();
+	memcpy(&bad_length[20], &properties_len, sizeof(properties_len));
+	add_udev_event(settle, bad_length);
+	// Kernel uevent, not a udev event.
+	add_udev_event(settle, kernel_uevent("change", "/devices/virtual/block/sda", "block", "sda", "disk", 3001));
+
+	EXPECT_EQ(1u, pending(settle).size());
+	EXPECT_FALSE(udev_processed(settle));
+
+	add_udev_event(settle, buf);
+	EXPECT_TRUE(pending(settle).empty());
+	EXPECT_TRUE(udev_processed(settle));
+}
+
+
+}  // namespace GParted
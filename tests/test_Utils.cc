@@ -0,0 +1,146 @@
+/* Copyright (C) 2026 Mike Fleetwood
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Test the tool output parsing methods of Utils.
+ */
+
+
+#include "Utils.h"
+#include "gtest/gtest.h"
+
+#include <glibmm/ustring.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace GParted
+{
+
+
+// Same pattern as Proc_Partitions_Info::load_proc_partitions_info_cache() uses.
+static const char* PROC_PARTITIONS_PATTERN =
+        "^[[:blank:]]*[[:digit:]]+[[:blank:]]+[[:digit:]]+[[:blank:]]+[[:digit:]]+[[:blank:]]+([[:graph:]]+)$";
+
+
+TEST(RegexpLabelTest, FirstSubExpression)
+{
+	EXPECT_EQ("sda1", Utils::regexp_label("   8        1  104857600 sda1", PROC_PARTITIONS_PATTERN));
+	EXPECT_EQ("", Utils::regexp_label("major minor  #blocks  name", PROC_PARTITIONS_PATTERN));
+	EXPECT_EQ("", Utils::regexp_label("", PROC_PARTITIONS_PATTERN));
+}
+
+
+TEST(RegexpLabelTest, MultilineAndCaseless)
+{
+	const char* output = "Filesystem volume name:   root\n"
+	                     "Filesystem UUID:          0cd38ad1-7ab0-4cb2-8d5f-4dab5b5ad3a5\n";
+
+	EXPECT_EQ("root", Utils::regexp_label(output, "^Filesystem volume name:[\t ]*(.*)$"));
+	EXPECT_EQ("0cd38ad1-7ab0-4cb2-8d5f-4dab5b5ad3a5",
+	          Utils::regexp_label(output, "^filesystem uuid:[[:blank:]]*([^\n]*)$"));
+}
+
+
+TEST(RegexpLabelTest, FirstMatchOnly)
+{
+	const char* output = "label: first\nlabel: second\n";
+
+	EXPECT_EQ("first", Utils::regexp_label(output, "^label: ([^\n]*)"));
+	// Same again to use the already compiled pattern.
+	EXPECT_EQ("first", Utils::regexp_label(output, "^label: ([^\n]*)"));
+}
+
+
+TEST(TokenizeTest, SkipsRepeatedDelimiters)
+{
+	std::vector<Glib::ustring> tokens;
+	Utils::tokenize("  word1   word2   ", tokens, " ");
+
+	ASSERT_EQ(2u, tokens.size());
+	EXPECT_EQ("word1", tokens[0]);
+	EXPECT_EQ("word2", tokens[1]);
+}
+
+
+TEST(TokenizeTest, MultibyteCharacters)
+{
+	std::vector<Glib::ustring> tokens;
+	Utils::tokenize("\xc3\xa9t\xc3\xa9\n\n\xe6\x97\xa5\xe6\x9c\xac\n", tokens, "\n");
+
+	ASSERT_EQ(2u, tokens.size());
+	EXPECT_EQ("\xc3\xa9t\xc3\xa9", tokens[0]);
+	EXPECT_EQ(3u, tokens[0].length());
+	EXPECT_EQ("\xe6\x97\xa5\xe6\x9c\xac", tokens[1]);
+}
+
+
+TEST(SplitTest, EveryDelimiter)
+{
+	std::vector<Glib::ustring> result;
+	Utils::split("", result, ":");
+	EXPECT_TRUE(result.empty());
+
+	Utils::split(":a::bb", result, ":");
+	ASSERT_EQ(4u, result.size());
+	EXPECT_EQ("", result[0]);
+	EXPECT_EQ("a", result[1]);
+	EXPECT_EQ("", result[2]);
+	EXPECT_EQ("bb", result[3]);
+}
+
+
+TEST(SplitTest, MultibyteCharacters)
+{
+	std::vector<Glib::ustring> result;
+	Utils::split("\xc3\xa9,,\xe6\x97\xa5", result, ",");
+
+	ASSERT_EQ(3u, result.size());
+	EXPECT_EQ("\xc3\xa9", result[0]);
+	EXPECT_EQ("", result[1]);
+	EXPECT_EQ("\xe6\x97\xa5", result[2]);
+}
+
+
+TEST(UtilsTest, BenchmarkParseProcPartitions)
+{
+	// Microbenchmark parsing /proc/partitions style output as done for every
+	// partition when scanning, splitting into lines and extracting the name from
+	// each.  Reports the cost per partition.
+	const unsigned int NUM_PARTITIONS = 10000;
+	Glib::ustring output = "major minor  #blocks  name\n\n";
+	for (unsigned int i = 0; i < NUM_PARTITIONS; i++)
+		output += "   8       " + std::to_string(i % 256) + "  104857600 sdb" + std::to_string(i) + "\n";
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<Glib::ustring> lines;
+	Utils::tokenize(output, lines, "\n");
+	unsigned int names = 0;
+	for (unsigned int i = 0; i < lines.size(); i++)
+	{
+		if (! Utils::regexp_label(lines[i], PROC_PARTITIONS_PATTERN).empty())
+			names++;
+	}
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Parse /proc/partitions of " << NUM_PARTITIONS << " partitions: "
+	          << elapsed.count() / NUM_PARTITIONS << " ns per partition" << std::endl;
+
+	EXPECT_EQ(NUM_PARTITIONS, names);
+}
+
+
+}  // namespace GParted